@@ -0,0 +1,58 @@
+// Pinned against unpinned pool workers on a memory-latency-bound kernel shaped like BFS over a large CSR graph
+//
+// The array is placed like the graph arrays (WIKIGRAPH_NUMA) and filled by the pool itself, so with first-touch its
+// pages end up near the workers that read them. On a single-node machine the modes mostly differ by migrations.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Utils/Affinity.h"
+#include "Utils/DefaultInitAllocator.h"
+#include "Utils/ResourceProbe.h"
+#include "Utils/WThreadPool.h"
+
+namespace {
+constexpr size_t kEntries = size_t{1} << 25;  // 128 MB of uint32_t, far beyond any last-level cache
+constexpr size_t kChains = size_t{1} << 20;
+constexpr int kHops = 16;
+
+uint32_t next_index(uint64_t i) {
+    // SplitMix64 finalizer, a fixed random permutation-like successor for every entry
+    i += 0x9e3779b97f4a7c15ULL;
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<uint32_t>((i ^ (i >> 31)) % kEntries);
+}
+
+void BM_PoolPointerChase(benchmark::State& state, PinningMode mode) {
+    WThreadPool pool(ResourceProbe::get().worker_threads, Affinity::pin_order(mode));
+    std::vector<uint32_t, DefaultInitAllocator<uint32_t>> next(kEntries);
+    Affinity::place_memory(next.data(), next.size() * sizeof(uint32_t));
+    pool.parallel_for(0, kEntries, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            next[i] = next_index(i);
+        }
+    });
+
+    for (auto _ : state) {
+        pool.parallel_for(0, kChains, [&](size_t begin, size_t end) {
+            uint64_t sum = 0;
+            for (size_t chain = begin; chain < end; chain++) {
+                uint32_t at = next_index(chain);
+                for (int hop = 0; hop < kHops; hop++) {
+                    at = next[at];
+                }
+                sum += at;
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kChains * kHops));
+    state.counters["threads"] = static_cast<double>(pool.size());
+}
+BENCHMARK_CAPTURE(BM_PoolPointerChase, unpinned, PinningMode::None)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_PoolPointerChase, compact, PinningMode::Compact)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_PoolPointerChase, spread, PinningMode::Spread)->Unit(benchmark::kMillisecond)->UseRealTime();
+}  // namespace
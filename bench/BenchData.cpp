@@ -0,0 +1,116 @@
+#include "BenchData.h"
+
+#include <zlib.h>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+namespace BenchData {
+namespace {
+constexpr uint64_t kDefaultPages = 200'000;
+
+// Read a gzip-compressed dump into its lines, keeping only the INSERT lines the loaders parse
+std::vector<std::string> read_insert_lines(const std::filesystem::path& path) {
+    gzFile file = gzopen(path.string().c_str(), "rb");
+    if (file == nullptr) {
+        throw std::runtime_error(std::format("Cannot open {}", path.string()));
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    std::array<char, 1 << 16> buffer{};
+    int read = 0;
+    while ((read = gzread(file, buffer.data(), buffer.size())) > 0) {
+        std::string_view chunk(buffer.data(), static_cast<size_t>(read));
+        size_t newline = 0;
+        while ((newline = chunk.find('\n')) != std::string_view::npos) {
+            line.append(chunk.substr(0, newline));
+            if (line.starts_with("INSERT INTO")) {
+                lines.push_back(std::move(line));
+            }
+            line.clear();
+            chunk.remove_prefix(newline + 1);
+        }
+        line.append(chunk);
+    }
+    gzclose(file);
+    if (read < 0) {
+        throw std::runtime_error(std::format("Cannot decompress {}", path.string()));
+    }
+    if (line.starts_with("INSERT INTO")) {
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+// Owns the generated files and removes them at exit
+struct GeneratedDump {
+    Dump dump;
+
+    GeneratedDump() {
+        dump.options.prefix = "bench";
+        dump.options.pages = pages();
+        dump.dir = std::filesystem::temp_directory_path() /
+                   std::format("wikigraph_bench_{}", std::chrono::steady_clock::now().time_since_epoch().count());
+
+        const auto start = std::chrono::steady_clock::now();
+        dump.summary = SyntheticDump::generate(dump.options, dump.dir);
+        dump.page_lines = read_insert_lines(SyntheticDump::dump_path(dump.dir, dump.options, "page"));
+        dump.linktarget_lines = read_insert_lines(SyntheticDump::dump_path(dump.dir, dump.options, "linktarget"));
+        dump.pagelinks_lines = read_insert_lines(SyntheticDump::dump_path(dump.dir, dump.options, "pagelinks"));
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cerr << std::format("Generated a dump of {} pages and {} links in {:.1f} s\n", dump.summary.pages,
+                                 dump.summary.links, seconds);
+    }
+
+    ~GeneratedDump() {
+        std::error_code ec;
+        std::filesystem::remove_all(dump.dir, ec);
+    }
+
+    GeneratedDump(const GeneratedDump&) = delete;
+    GeneratedDump& operator=(const GeneratedDump&) = delete;
+    GeneratedDump(GeneratedDump&&) = delete;
+    GeneratedDump& operator=(GeneratedDump&&) = delete;
+};
+}  // namespace
+
+uint64_t pages() {
+    static const uint64_t count = [] {
+        const char* value = std::getenv("WIKIGRAPH_BENCH_PAGES");  // NOLINT(concurrency-mt-unsafe) read once
+        return value != nullptr && *value != '\0' ? std::stoull(value) : kDefaultPages;
+    }();
+    return count;
+}
+
+const Dump& dump() {
+    static const GeneratedDump generated;
+    return generated.dump;
+}
+
+WikiFile wiki_file(WikiFileType type) {
+    const Dump& data = dump();
+    static const std::array<const char*, 3> tables{"page", "linktarget", "pagelinks"};
+
+    WikiFile file{};
+    file.exists = true;
+    file.lang_code = data.options.prefix;
+    file.date = data.options.date;
+    file.file_type = type;
+    file.data_path = SyntheticDump::dump_path(data.dir, data.options, tables[static_cast<size_t>(type)]);
+    file.file_size = std::filesystem::file_size(file.data_path);
+    return file;
+}
+
+uint64_t total_bytes(const std::vector<std::string>& lines) {
+    return std::accumulate(lines.begin(), lines.end(), uint64_t{0},
+                           [](uint64_t sum, const std::string& line) { return sum + line.size(); });
+}
+}  // namespace BenchData
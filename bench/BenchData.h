@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "SyntheticDump.h"
+#include "UI/UIBase.h"
+
+/**
+ * @brief Synthetic dump shared by all benchmarks, generated on first use.
+ *
+ * The dump is written to a temporary directory that is removed at exit. Its size is set with
+ * `WIKIGRAPH_BENCH_PAGES` (default 200000 pages, about 4M links) so that a run stays short on a laptop and can be
+ * scaled up on a benchmark machine. The INSERT lines of every table are also kept in memory, so the parser and
+ * hashmap benchmarks measure no I/O or decompression.
+ */
+namespace BenchData {
+struct Dump {
+    std::filesystem::path dir;
+    SyntheticDump::Options options;
+    SyntheticDump::Summary summary;
+
+    std::vector<std::string> page_lines;
+    std::vector<std::string> linktarget_lines;
+    std::vector<std::string> pagelinks_lines;
+};
+
+/** @brief Number of pages of the dump, from `WIKIGRAPH_BENCH_PAGES`. */
+uint64_t pages();
+
+/** @brief The dump, generated and read into memory by the first caller. */
+const Dump& dump();
+
+/** @brief Descriptor of one of the dump files, as the loaders get it from the UI. */
+WikiFile wiki_file(WikiFileType type);
+
+/** @brief Total size of a set of lines in bytes. */
+uint64_t total_bytes(const std::vector<std::string>& lines);
+}  // namespace BenchData
@@ -0,0 +1,287 @@
+// BFS on Graph500-style Kronecker (R-MAT) graphs built in memory, reported in traversed edges per second (TEPS)
+//
+// The graph follows the Graph500 generator: 2^scale vertices, 16 undirected edges per vertex drawn with the
+// initiator probabilities A = 0.57, B = C = 0.19, vertex labels scrambled by a bijection, every edge stored in both
+// directions and self loops and duplicates kept. Scales are set with `WIKIGRAPH_BENCH_SCALES` ("20", "20-28" or
+// "20,22,24", default 20) and the number of search roots with `WIKIGRAPH_BENCH_ROOTS` (default 16). Only the search
+// is timed; every BFS tree is validated afterwards, so a broken hot loop fails the benchmark instead of speeding it up.
+//
+// One isolated vertex is appended to every graph and used as the end of each search. It is never reached, so the
+// engines traverse the whole component of the root as a Graph500 BFS does.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DataLoader/LinkLoader.h"
+#include "PageGraph/PageGraph.h"
+#include "Utils/ResourceProbe.h"
+#include "Utils/WThreadPool.h"
+
+namespace {
+constexpr uint64_t kEdgeFactor = 16;
+constexpr double kInitiatorA = 0.57;
+constexpr double kInitiatorB = 0.19;
+constexpr double kInitiatorC = 0.19;
+constexpr uint64_t kSeed = 0x2b7e151628aed2a6ULL;
+
+// SplitMix64, seeded per edge so the edge list does not depend on how it is split across threads
+struct SplitMix64 {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() {
+        return static_cast<double>(next() >> 11) * 0x1.0p-53;
+    }
+};
+
+// Bijection on [0, 2^scale) that spreads the high-degree vertices R-MAT puts at small labels over the whole range
+uint32_t scramble(uint64_t vertex, int scale) {
+    const uint64_t mask = (uint64_t{1} << scale) - 1;
+    vertex = (vertex * 0x9e3779b97f4a7c15ULL) & mask;  // Odd multiplier, invertible modulo 2^scale
+    vertex ^= vertex >> ((scale + 1) / 2);
+    vertex = (vertex * 0xd6e8feb86659fd93ULL) & mask;
+    return static_cast<uint32_t>(vertex);
+}
+
+// One R-MAT edge: at each bit level pick a quadrant of the adjacency matrix with the initiator probabilities
+Link rmat_edge(uint64_t edge, int scale) {
+    SplitMix64 rng{kSeed ^ (edge * 0xa0761d6478bd642fULL)};
+    uint64_t from = 0;
+    uint64_t to = 0;
+    for (int level = 0; level < scale; level++) {
+        const double r = rng.uniform();
+        // Quadrants in order A (0, 0), B (0, 1), C (1, 0), D (1, 1)
+        const bool row = r >= kInitiatorA + kInitiatorB;
+        const bool column = (r >= kInitiatorA && !row) || r >= kInitiatorA + kInitiatorB + kInitiatorC;
+        from = (from << 1) | uint64_t{row};
+        to = (to << 1) | uint64_t{column};
+    }
+    return {.page_from = scramble(from, scale), .page_to = scramble(to, scale)};
+}
+
+std::unique_ptr<PageGraph> kronecker_graph(int scale, UIState& state) {
+    const uint64_t vertices = uint64_t{1} << scale;
+    const uint64_t edges = kEdgeFactor * vertices;
+    std::vector<Link> links(2 * edges);
+    WThreadPool pool(ResourceProbe::get().worker_threads);
+    pool.parallel_for(0, edges, [&](size_t begin, size_t end) {
+        for (size_t edge = begin; edge < end; edge++) {
+            const Link link = rmat_edge(edge, scale);
+            links[2 * edge] = link;
+            links[(2 * edge) + 1] = {.page_from = link.page_to, .page_to = link.page_from};
+        }
+    });
+    // + 1 for the isolated end vertex
+    return std::make_unique<PageGraph>(state, static_cast<uint32_t>(vertices + 1), std::move(links), NoProgress{});
+}
+
+// The graph of the scale being benchmarked, only one is kept since the large scales take most of the memory
+const PageGraph& graph(int scale) {
+    static int cached_scale = -1;
+    static std::unique_ptr<PageGraph> cached;
+    if (cached_scale != scale) {
+        cached.reset();
+        UIState state;
+        cached = kronecker_graph(scale, state);
+        cached_scale = scale;
+    }
+    return *cached;
+}
+
+// Distinct search roots with at least one neighbour other than themselves, as Graph500 requires
+std::vector<uint32_t> search_roots(const PageGraph& graph, size_t count) {
+    const uint32_t vertices = graph.get_number_of_pages() - 1;
+    SplitMix64 rng{kSeed};
+    std::vector<uint32_t> roots;
+    for (uint64_t attempt = 0; roots.size() < count && attempt < 64 * uint64_t{vertices}; attempt++) {
+        const auto root = static_cast<uint32_t>(rng.next() % vertices);
+        const auto neighbors = graph.get_neighbors(root);
+        const bool connected = std::ranges::any_of(neighbors, [root](uint32_t neighbor) { return neighbor != root; });
+        if (connected && std::ranges::find(roots, root) == roots.end()) {
+            roots.push_back(root);
+        }
+    }
+    return roots;
+}
+
+struct Validation {
+    std::string error;             // Empty if the tree is valid
+    uint64_t traversed_edges = 0;  // Undirected edges within the component of the root, the TEPS numerator
+};
+
+/**
+ * Check the BFS parents against the graph, following the Graph500 validation rules adapted to parent sets:
+ * the root has no parent, every parent of a vertex is one level closer to the root and linked to it, every edge
+ * leaving a reached vertex ends at a reached vertex at most one level further, and an edge from one level to the next
+ * makes its source a parent of its end.
+ */
+template <typename ParentsOf>
+Validation validate(const PageGraph& graph, uint32_t root, ParentsOf parents_of) {
+    const uint32_t vertices = graph.get_number_of_pages();
+    std::vector<uint32_t> level(vertices, UINT32_MAX);
+    level[root] = 0;
+    if (!parents_of(root).empty()) {
+        return {.error = std::format("root {} has a parent", root)};
+    }
+
+    // Levels follow from the parents, a vertex is reached if it has any
+    std::vector<uint32_t> order{root};
+    for (size_t i = 0; i < order.size(); i++) {
+        for (uint32_t child : graph.get_neighbors(order[i])) {
+            if (level[child] == UINT32_MAX && !parents_of(child).empty()) {
+                level[child] = level[order[i]] + 1;
+                order.push_back(child);
+            }
+        }
+    }
+
+    Validation result;
+    uint64_t degree_sum = 0;
+    for (uint32_t vertex = 0; vertex < vertices; vertex++) {
+        const auto& parents = parents_of(vertex);
+        if (level[vertex] == UINT32_MAX) {
+            if (!parents.empty()) {
+                return {.error = std::format("vertex {} has parents but is not connected to the root", vertex)};
+            }
+            continue;
+        }
+        for (uint32_t parent : parents) {
+            if (level[parent] + 1 != level[vertex]) {
+                return {.error = std::format("parent {} of vertex {} is not one level above it", parent, vertex)};
+            }
+            if (!std::ranges::binary_search(graph.get_neighbors(parent), vertex)) {
+                return {.error = std::format("parent {} of vertex {} is not linked to it", parent, vertex)};
+            }
+        }
+        const auto neighbors = graph.get_neighbors(vertex);
+        degree_sum += neighbors.size();
+        for (uint32_t neighbor : neighbors) {
+            if (level[neighbor] == UINT32_MAX || level[neighbor] > level[vertex] + 1) {
+                return {.error = std::format("edge {} -> {} skips a level", vertex, neighbor)};
+            }
+            if (level[neighbor] == level[vertex] + 1 && std::ranges::find(parents_of(neighbor), vertex) ==
+                                                            parents_of(neighbor).end()) {
+                return {.error = std::format("vertex {} is missing parent {}", neighbor, vertex)};
+            }
+        }
+    }
+    result.traversed_edges = degree_sum / 2;  // Both directions of every edge are stored
+    return result;
+}
+
+// The shipped search, which records every shortest-path parent of every vertex
+struct ParentsBFS {
+    static constexpr std::string_view name = "bfs_with_parents";
+
+    static PageGraph::BFSResult run(const PageGraph& graph, UIState& state, uint32_t root) {
+        return graph.bfs_with_parents<NoProgress>(state, root, graph.get_number_of_pages() - 1);
+    }
+
+    static const std::vector<uint32_t>& parents(const PageGraph::BFSResult& result, uint32_t vertex) {
+        return result.parents[vertex];
+    }
+};
+
+// Each engine provides a name, run(graph, state, root) and parents(result, vertex)
+template <typename Engine>
+void BM_Graph500(benchmark::State& state, int scale, size_t root_count) {
+    const PageGraph& g = graph(scale);
+    const std::vector<uint32_t> roots = search_roots(g, root_count);
+    if (roots.empty()) {
+        state.SkipWithError("no vertex with a neighbour to start from");
+        return;
+    }
+
+    UIState ui_state;
+    size_t next_root = 0;
+    uint64_t traversed_edges = 0;
+    double seconds_per_edge = 0.0;  // Sum over the searches, for the harmonic mean
+    for (auto _ : state) {
+        const uint32_t root = roots[next_root++ % roots.size()];
+        const auto start = std::chrono::steady_clock::now();
+        const auto result = Engine::run(g, ui_state, root);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        state.SetIterationTime(elapsed.count());
+
+        const Validation validation =
+            validate(g, root, [&result](uint32_t vertex) -> const auto& { return Engine::parents(result, vertex); });
+        if (!validation.error.empty()) {
+            state.SkipWithError(std::format("invalid BFS tree from root {}: {}", root, validation.error).c_str());
+            break;
+        }
+        traversed_edges += validation.traversed_edges;
+        seconds_per_edge += elapsed.count() / static_cast<double>(validation.traversed_edges);
+    }
+
+    // Graph500 reports the harmonic mean of the per-search TEPS, the rate is total edges over total search time
+    state.counters["TEPS"] = benchmark::Counter(static_cast<double>(traversed_edges), benchmark::Counter::kIsRate);
+    if (seconds_per_edge > 0.0) {
+        state.counters["harmonic_mean_TEPS"] = static_cast<double>(state.iterations()) / seconds_per_edge;
+    }
+    state.counters["vertices"] = static_cast<double>(g.get_number_of_pages() - 1);
+    state.counters["edges"] = static_cast<double>(g.get_number_of_links() / 2);
+}
+
+// "20", "20-28" or "20,22,24"
+std::vector<int> bench_scales() {
+    const char* env = std::getenv("WIKIGRAPH_BENCH_SCALES");  // NOLINT(concurrency-mt-unsafe)
+    const std::string_view spec = env != nullptr ? env : "20";
+    std::vector<int> scales;
+    size_t at = 0;
+    while (at <= spec.size()) {
+        const size_t comma = std::min(spec.find(',', at), spec.size());
+        const std::string item(spec.substr(at, comma - at));
+        const size_t dash = item.find('-');
+        try {
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            for (int scale = std::max(first, 1); scale <= std::min(last, 31); scale++) {
+                scales.push_back(scale);
+            }
+        } catch (const std::exception&) {
+            // Ignore malformed entries rather than failing the whole suite
+        }
+        at = comma + 1;
+    }
+    return scales;
+}
+
+size_t bench_roots() {
+    const char* env = std::getenv("WIKIGRAPH_BENCH_ROOTS");  // NOLINT(concurrency-mt-unsafe)
+    const size_t roots = env != nullptr ? std::strtoull(env, nullptr, 10) : 0;
+    return roots > 0 ? roots : 16;
+}
+
+template <typename Engine>
+void register_engine() {
+    const size_t roots = bench_roots();
+    for (int scale : bench_scales()) {
+        const std::string name = std::format("BM_Graph500/{}/scale:{}", Engine::name, scale);
+        benchmark::RegisterBenchmark(name.c_str(), BM_Graph500<Engine>, scale, roots)
+            ->Iterations(static_cast<benchmark::IterationCount>(roots))
+            ->UseManualTime()
+            ->Unit(benchmark::kMillisecond);
+    }
+}
+
+[[maybe_unused]] const bool registered = [] {
+    register_engine<ParentsBFS>();
+    return true;
+}();
+}  // namespace
@@ -0,0 +1,141 @@
+// Candidates for the Hashmap alias on the keys the loaders actually use
+//
+// Page ids are sparse like real ones, linktarget ids are looked up in pagelinks order, which follows the Zipf
+// popularity of the targets, and titles are looked up from the linktarget table, whose red links are misses.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BenchData.h"
+#include "DataLoader/LinkLoader.h"
+#include "DataLoader/LinkTargetLoader.h"
+#include "DataLoader/PageLoader.h"
+#include "Utils/Hashmap.h"
+
+namespace {
+struct Keys {
+    std::vector<uint32_t> page_ids;          // Every article, in dump order
+    std::vector<std::string> titles;         // Article titles, in dump order
+    std::vector<uint64_t> linktarget_ids;    // Article link targets, in dump order
+    std::vector<uint32_t> link_from_ids;     // Source page of every article link
+    std::vector<uint64_t> link_target_ids;   // Target of every article link
+    std::vector<std::string> target_titles;  // Titles of the article link targets, red links included
+    std::vector<uint32_t> missing_page_ids;  // Ids between article ids: other namespaces and unused ids
+};
+
+const Keys& keys() {
+    static const Keys k = [] {
+        const auto& data = BenchData::dump();
+        Keys result;
+        for (const auto& line : data.page_lines) {
+            for (auto& [id, page] : PageLoader::parse_line(line)) {
+                result.page_ids.push_back(id);
+                result.titles.push_back(std::move(page.page_title));
+            }
+        }
+        for (const auto& line : data.linktarget_lines) {
+            for (auto& [id, title] : LinkTargetLoader::parse_line(line)) {
+                result.linktarget_ids.push_back(id);
+                result.target_titles.push_back(std::move(title));
+            }
+        }
+        for (const auto& line : data.pagelinks_lines) {
+            for (const auto& [from, target] : LinkLoader::parse_line(line)) {
+                result.link_from_ids.push_back(from);
+                result.link_target_ids.push_back(target);
+            }
+        }
+        for (size_t i = 1; i < result.page_ids.size(); i++) {
+            for (uint32_t id = result.page_ids[i - 1] + 1; id < result.page_ids[i]; id++) {
+                result.missing_page_ids.push_back(id);
+            }
+        }
+        return result;
+    }();
+    return k;
+}
+
+template <typename Map, typename Key>
+Map build(const std::vector<Key>& inserted) {
+    Map map;
+    map.reserve(inserted.size());
+    for (size_t i = 0; i < inserted.size(); i++) {
+        map.emplace(inserted[i], static_cast<uint32_t>(i));
+    }
+    return map;
+}
+
+// Insert every key into a map reserved up front, as the loaders do with the estimated row count
+template <typename Map, typename Key>
+void insert(benchmark::State& state, const std::vector<Key>& inserted) {
+    for (auto _ : state) {
+        Map map = build<Map>(inserted);
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * inserted.size()));
+}
+
+template <typename Map, typename Key>
+void lookup(benchmark::State& state, const std::vector<Key>& inserted, const std::vector<Key>& queries) {
+    const Map map = build<Map>(inserted);
+    uint64_t hits = 0;
+    for (auto _ : state) {
+        hits = 0;
+        for (const auto& key : queries) {
+            auto it = map.find(key);
+            if (it != map.end()) {
+                hits++;
+                benchmark::DoNotOptimize(it->second);
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * queries.size()));
+    state.counters["hit_rate"] = queries.empty() ? 0.0 : static_cast<double>(hits) / queries.size();
+}
+
+template <template <typename, typename> typename MapOf>
+void register_backend(const std::string& name) {
+    const auto bench = [&](const std::string& what, auto fn) {
+        benchmark::RegisterBenchmark(("BM_Hashmap/" + name + "/" + what).c_str(), fn)->Unit(benchmark::kMillisecond);
+    };
+    bench("PageId/Insert", [](benchmark::State& s) { insert<MapOf<uint32_t, uint32_t>>(s, keys().page_ids); });
+    bench("PageId/Lookup", [](benchmark::State& s) {
+        lookup<MapOf<uint32_t, uint32_t>>(s, keys().page_ids, keys().link_from_ids);
+    });
+    bench("PageId/Miss", [](benchmark::State& s) {
+        lookup<MapOf<uint32_t, uint32_t>>(s, keys().page_ids, keys().missing_page_ids);
+    });
+    bench("LinkTargetId/Insert",
+          [](benchmark::State& s) { insert<MapOf<uint64_t, uint32_t>>(s, keys().linktarget_ids); });
+    bench("LinkTargetId/Lookup", [](benchmark::State& s) {
+        lookup<MapOf<uint64_t, uint32_t>>(s, keys().linktarget_ids, keys().link_target_ids);
+    });
+    bench("Title/Insert", [](benchmark::State& s) { insert<MapOf<std::string, uint32_t>>(s, keys().titles); });
+    bench("Title/Lookup", [](benchmark::State& s) {
+        lookup<MapOf<std::string, uint32_t>>(s, keys().titles, keys().target_titles);
+    });
+}
+
+template <typename K, typename V>
+using StdMap = std::unordered_map<K, V>;
+
+#ifndef USE_STD_UNORDERED_MAP
+template <typename K, typename V>
+using Emhash6 = Hashmap<K, V, EmhashImpl::emhash6>;
+template <typename K, typename V>
+using Emhash8 = Hashmap<K, V, EmhashImpl::emhash8>;
+#endif
+
+[[maybe_unused]] const bool registered = [] {
+    register_backend<StdMap>("std");
+#ifndef USE_STD_UNORDERED_MAP
+    register_backend<Emhash6>("emhash6");
+    register_backend<Emhash8>("emhash8");
+#endif
+    return true;
+}();
+}  // namespace
@@ -0,0 +1,121 @@
+// Parsing of the INSERT lines: tuple splitting, the tuple parser and the parse_line of every loader
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BenchData.h"
+#include "DataLoader/FileReader/SQLParserUtils.h"
+#include "DataLoader/LinkLoader.h"
+#include "DataLoader/LinkTargetLoader.h"
+#include "DataLoader/PageLoader.h"
+
+namespace {
+// Every tuple of a table, viewing into the cached lines
+std::vector<std::string_view> all_tuples(const std::vector<std::string>& lines) {
+    std::vector<std::string_view> tuples;
+    for (const auto& line : lines) {
+        auto line_tuples = extract_tuples(line);
+        tuples.insert(tuples.end(), line_tuples.begin(), line_tuples.end());
+    }
+    return tuples;
+}
+
+uint64_t total_size(const std::vector<std::string_view>& views) {
+    uint64_t bytes = 0;
+    for (auto view : views) {
+        bytes += view.size();
+    }
+    return bytes;
+}
+
+// Run a loader's parse_line over every line of a table
+template <typename ParseFn>
+void parse_lines(benchmark::State& state, const std::vector<std::string>& lines, ParseFn parse_fn) {
+    uint64_t rows = 0;
+    for (auto _ : state) {
+        rows = 0;
+        for (const auto& line : lines) {
+            auto result = parse_fn(line);
+            rows += result.size();
+            benchmark::DoNotOptimize(result.data());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * BenchData::total_bytes(lines)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * rows));
+}
+
+void BM_ExtractTuples(benchmark::State& state) {
+    const auto& lines = BenchData::dump().pagelinks_lines;
+    uint64_t tuples = 0;
+    for (auto _ : state) {
+        tuples = 0;
+        for (const auto& line : lines) {
+            auto result = extract_tuples(line);
+            tuples += result.size();
+            benchmark::DoNotOptimize(result.data());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * BenchData::total_bytes(lines)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tuples));
+}
+BENCHMARK(BM_ExtractTuples)->Unit(benchmark::kMillisecond);
+
+// The pagelinks tuples are three integers, so this is next_int alone
+void BM_NextInt(benchmark::State& state) {
+    const auto tuples = all_tuples(BenchData::dump().pagelinks_lines);
+    for (auto _ : state) {
+        for (auto tuple : tuples) {
+            SQLTupleParser parser(tuple);
+            uint32_t from = 0;
+            uint32_t from_namespace = 0;
+            uint64_t target = 0;
+            const bool parsed = parser.next_int(from) && parser.next_int(from_namespace) && parser.next_int(target);
+            benchmark::DoNotOptimize(parsed);
+            benchmark::DoNotOptimize(target);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total_size(tuples)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tuples.size() * 3));
+}
+BENCHMARK(BM_NextInt)->Unit(benchmark::kMillisecond);
+
+// The linktarget titles on their own, starting at the opening quote, including the escaped ones
+void BM_NextString(benchmark::State& state) {
+    std::vector<std::string_view> titles;
+    for (auto tuple : all_tuples(BenchData::dump().linktarget_lines)) {
+        const size_t quote = tuple.find('\'');
+        if (quote != std::string_view::npos) {
+            titles.push_back(tuple.substr(quote));
+        }
+    }
+    std::string title;
+    for (auto _ : state) {
+        for (auto view : titles) {
+            SQLTupleParser parser(view);
+            benchmark::DoNotOptimize(parser.next_string(title));
+            benchmark::DoNotOptimize(title.data());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total_size(titles)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * titles.size()));
+}
+BENCHMARK(BM_NextString)->Unit(benchmark::kMillisecond);
+
+void BM_PageParseLine(benchmark::State& state) {
+    parse_lines(state, BenchData::dump().page_lines, PageLoader::parse_line);
+}
+BENCHMARK(BM_PageParseLine)->Unit(benchmark::kMillisecond);
+
+void BM_LinkTargetParseLine(benchmark::State& state) {
+    parse_lines(state, BenchData::dump().linktarget_lines, LinkTargetLoader::parse_line);
+}
+BENCHMARK(BM_LinkTargetParseLine)->Unit(benchmark::kMillisecond);
+
+void BM_LinkParseLine(benchmark::State& state) {
+    parse_lines(state, BenchData::dump().pagelinks_lines, LinkLoader::parse_line);
+}
+BENCHMARK(BM_LinkParseLine)->Unit(benchmark::kMillisecond);
+}  // namespace
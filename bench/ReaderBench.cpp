@@ -0,0 +1,75 @@
+// Decompression throughput of the line reader the build uses, against a plain gzread loop
+
+#include <benchmark/benchmark.h>
+#include <zlib.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "BenchData.h"
+#include "DataLoader/DataLoaderBase.h"
+#include "DataLoader/FlowControl.h"
+#include "Utils/ResourceProbe.h"
+
+namespace {
+// Read a whole file the way the loaders do, returning the credits of each line as soon as it is consumed
+void read_file(benchmark::State& state, WikiFileType type) {
+    const WikiFile file = BenchData::wiki_file(type);
+    uint64_t bytes = 0;
+    uint64_t lines = 0;
+    for (auto _ : state) {
+        FlowControl flow(ResourceProbe::get().pipeline_budget_bytes);
+        ReaderType reader(file, flow);
+        std::string line;
+        bytes = 0;
+        lines = 0;
+        while (reader.get_line(line)) {
+            bytes += line.size();
+            lines++;
+            flow.release(line.size());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lines));
+    state.counters["compressed_bytes_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * file.file_size), benchmark::Counter::kIsRate);
+}
+
+// Lower bound for the readers: single-threaded gzread into a reused buffer, without splitting lines
+void BM_GzRead(benchmark::State& state) {
+    const WikiFile file = BenchData::wiki_file(WikiFileType::PageLinks);
+    std::array<char, 1 << 18> buffer{};
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        gzFile gz = gzopen(file.data_path.string().c_str(), "rb");
+        if (gz == nullptr) {
+            state.SkipWithError("Cannot open the pagelinks dump");
+            return;
+        }
+        gzbuffer(gz, 1 << 18);
+        bytes = 0;
+        int read = 0;
+        while ((read = gzread(gz, buffer.data(), buffer.size())) > 0) {
+            bytes += static_cast<uint64_t>(read);
+        }
+        gzclose(gz);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.counters["compressed_bytes_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * file.file_size), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_GzRead)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+#ifdef PARALLEL_DECOMPRESSION
+void BM_ParallelLineReader(benchmark::State& state) {
+    read_file(state, WikiFileType::PageLinks);
+}
+BENCHMARK(BM_ParallelLineReader)->Unit(benchmark::kMillisecond)->UseRealTime();
+#else
+void BM_AsyncLineReader(benchmark::State& state) {
+    read_file(state, WikiFileType::PageLinks);
+}
+BENCHMARK(BM_AsyncLineReader)->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+}  // namespace
@@ -0,0 +1,55 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BenchData.h"
+#include "Utils/Affinity.h"
+#include "Utils/ResourceProbe.h"
+
+// Like BENCHMARK_MAIN(), but also writes the results as JSON to wikigraph_bench.json unless --benchmark_out is given
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+    bool has_out = false;
+    for (std::string_view arg : args) {
+        has_out = has_out || arg.starts_with("--benchmark_out=");
+    }
+    std::string out = "--benchmark_out=wikigraph_bench.json";
+    std::string format = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(out.data());
+        args.push_back(format.data());
+    }
+    int count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+
+    // The readers log every file they open, which would interleave with the console report
+    spdlog::set_level(spdlog::level::warn);
+
+    // Recorded in the "context" of the JSON report, so results of different builds and machines can be told apart
+    const auto& resources = ResourceProbe::get();
+#ifdef PARALLEL_DECOMPRESSION
+    benchmark::AddCustomContext("line_reader", "ParallelLineReader");
+#else
+    benchmark::AddCustomContext("line_reader", "AsyncLineReader");
+#endif
+#ifdef USE_STD_UNORDERED_MAP
+    benchmark::AddCustomContext("hashmap", "std::unordered_map");
+#else
+    benchmark::AddCustomContext("hashmap", "emhash6");
+#endif
+    benchmark::AddCustomContext("build_type", WIKIGRAPH_BUILD_TYPE);
+    benchmark::AddCustomContext("worker_threads", std::to_string(resources.worker_threads));
+    benchmark::AddCustomContext("numa_nodes", std::to_string(Affinity::topology().node_cpus.size()));
+    benchmark::AddCustomContext("bench_pages", std::to_string(BenchData::pages()));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,15 +1,25 @@
 #pragma once
 #include <algorithm>
 #include <chrono>
+#include <deque>
+#include <format>
 #include <functional>
 #include <future>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
+
+#include "DataLoader/FlowControl.h"
+#include "Log/Trace.h"
+#include "Utils/Affinity.h"
+#include "Utils/ProgressReporter.h"
+#include "Utils/ResourceProbe.h"
 
 #ifdef PARALLEL_DECOMPRESSION
 #include "DataLoader/FileReader/ParallelLineReader.h"
 using ReaderType = ParallelLineReader;
-#include <concurrentqueue.h>
 
 #include "Utils/WThreadPool.h"
 #else
@@ -26,106 +36,182 @@ class DataLoaderBase {
    public:
     using ProgressCallback = std::function<void(size_t, double, ReadProgress)>;
 
+    /**
+     * @brief Flow control of this loader's pipeline, exposes per-stage queue occupancy.
+     */
+    [[nodiscard]] const FlowControl& flow_control() const {
+        return flow_;
+    }
+
+    /**
+     * @brief Rows the parser produced in the last load, including rows the inserter dropped as unresolved.
+     */
+    [[nodiscard]] uint64_t rows_parsed() const {
+        return rows_parsed_;
+    }
+
    protected:
     /**
      * @brief Initialize the underlying line reader for the given wiki file.
      * @param file Wiki file descriptor used to construct the reader
      */
     void init_reader(const WikiFile& file) {
-        reader_ = std::make_unique<ReaderType>(file);
+        reader_.reset();  // The previous reader must be gone before its flow control is reset
+        flow_.reset();
+        rows_parsed_ = 0;
+        reader_ = std::make_unique<ReaderType>(file, flow_);
         reader_file_path_ = file.data_path;
     }
 
     /**
-     * @brief Conditionally invoke the progress callback based on elapsed time.
+     * @brief Invoke the progress callback once the reporter's interval elapsed.
      * @param count Number of parsed records so far
      * @param callback Progress callback to invoke
      * @param reader Reader used to query byte progress
-     * @param start_time Process start time for speed calculation
-     * @param last_time Last time the callback was invoked (updated in-place)
-     * @param refresh_rate Minimum interval between callbacks
+     * @param reporter Throttles the callback and measures the speed since the load started
      * @param force If true, trigger the callback regardless of interval (used for final progress update)
      */
     static void update_progress(size_t count, const ProgressCallback& callback, ReaderType& reader,
-                                std::chrono::steady_clock::time_point start_time,
-                                std::chrono::steady_clock::time_point& last_time,
-                                std::chrono::milliseconds refresh_rate, bool force = false) {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_time);
-
-        // Compute speed based on total time since start
-        auto since_start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time);
-        double seconds = static_cast<double>(since_start_ms.count()) / 1000.0;
-        double speed = static_cast<double>(count) / std::max(seconds, 1e-6);
-
-        if (force || elapsed_ms >= refresh_rate) {
-            if (callback) {
-                callback(count, speed, reader.get_progress());
-            }
-            last_time = now;
+                                ProgressReporter& reporter, bool force = false) {
+        if (!force && !reporter.tick()) {
+            return;
+        }
+        if (callback) {
+            callback(count, reporter.rate(count), reader.get_progress());
         }
     }
 
     /**
      * @brief Parse only INSERT INTO lines and dispatch results, optionally in parallel.
+     *
+     * Every line keeps the flow-control credits the reader took for it until its result has been inserted, so the
+     * reader, the parse tasks in flight and the inserter share one byte budget. The consumer and the parse tasks
+     * report their busy and blocked time to the flow control: waiting for a line counts as the parse stage blocked
+     * on the reader, waiting for a parse task as the insert stage blocked on the parser.
      * @tparam ParseFn Callable: Result(const std::string&)
      * @tparam OnResultFn Callable: void(const Result&)
      * @tparam OnFirstFn Callable: void(const Result&)
      * @param reader Line reader supplying input
      * @param parse_fn Parser for a single INSERT line
      * @param on_result Consumer invoked for every parsed result
-     * @param on_first Consumer invoked once with the first result
+     * @param on_first Invoked once with the first result before on_result gets it, e.g. to reserve capacity
+     * @throws std::runtime_error if the reader failed before the end of the file, so nothing builds on a truncated
+     *         dump
      */
     template <typename ParseFn, typename OnResultFn, typename OnFirstFn>
     void parse_insert_lines(ReaderType& reader, ParseFn parse_fn, OnResultFn on_result, OnFirstFn on_first) {
         std::string line;
         bool is_first_emitted = true;
 
+        auto emit = [&](const auto& res, uint64_t bytes) {
+            Trace::Scope insert_scope("insert", "insert");
+            insert_scope.set_arg("rows", res.size());
+            flow_.track(PipelineStage::Insert, StageActivity::Busy);
+            flow_.enter(PipelineStage::Insert, bytes);
+            rows_parsed_ += res.size();
+            if (is_first_emitted) {
+                on_first(res);
+                is_first_emitted = false;
+            }
+            on_result(res);
+            flow_.leave(PipelineStage::Insert, bytes);
+            flow_.release(bytes);
+            flow_.sample_queues();
+        };
+
 #ifdef PARALLEL_DECOMPRESSION
-        moodycamel::ConcurrentQueue<std::future<decltype(parse_fn(line))>> futures;
-        moodycamel::ConsumerToken token(futures);
-        const size_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
-        WThreadPool pool(num_threads);
-        const size_t max_futures = num_threads * 2;
+        using Result = decltype(parse_fn(line));
+        std::deque<std::pair<std::future<Result>, uint64_t>> pending;  // Parse tasks in submission order
+        // Pinned next to the reader's decompression threads, not on top of them, one worker per CPU left to them
+        std::vector<unsigned int> parse_cpus = Affinity::parse_worker_cpus(ResourceProbe::get().decompression_threads);
+        const size_t parse_workers = parse_cpus.empty()
+                                         ? ResourceProbe::get().worker_threads
+                                         : std::min<size_t>(ResourceProbe::get().worker_threads, parse_cpus.size());
+        WThreadPool pool(parse_workers, std::move(parse_cpus));
 
         auto drain_one = [&] {
-            std::future<decltype(parse_fn(line))> fut;
-            if (futures.try_dequeue(token, fut)) {
-                auto res = fut.get();
-                if (is_first_emitted) {
-                    on_first(res);
-                    is_first_emitted = false;
-                }
-                on_result(res);
-                return true;
+            if (pending.empty()) {
+                return false;
             }
-            return false;
+            auto [fut, bytes] = std::move(pending.front());
+            pending.pop_front();
+            flow_.track(PipelineStage::Insert, StageActivity::Blocked);
+            auto res = [&] {
+                Trace::Scope wait_scope("wait for parse", "insert");
+                return fut.get();
+            }();
+            flow_.leave(PipelineStage::Parse, bytes);
+            emit(res, bytes);
+            return true;
+        };
+        auto front_ready = [&] {
+            return !pending.empty() &&
+                   pending.front().first.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        };
+
+        // Parse tasks account their time on the pool worker that runs them
+        auto timed_parse = [this, &parse_fn](const std::string& task_line) {
+            Trace::Scope parse_scope("parse", "parse");
+            parse_scope.set_arg("bytes", task_line.size());
+            // Closes the interval even if parse_fn throws, the worker would otherwise stay busy for good
+            struct Untrack {
+                FlowControl& flow;
+                ~Untrack() {
+                    flow.untrack();
+                }
+            } untrack{flow_};
+            flow_.track(PipelineStage::Parse, StageActivity::Busy);
+            return parse_fn(task_line);
         };
 
+        flow_.track(PipelineStage::Parse, StageActivity::Blocked);
         while (reader.get_line(line)) {
-            if (!line.starts_with("INSERT INTO")) continue;
-            futures.enqueue(pool.enqueue(parse_fn, line));
+            flow_.track(PipelineStage::Parse, StageActivity::Busy);  // Filtering and dispatching the line
+            const uint64_t bytes = line.size();
+            if (!line.starts_with("INSERT INTO")) {
+                flow_.release(bytes);
+                flow_.track(PipelineStage::Parse, StageActivity::Blocked);
+                continue;
+            }
+            flow_.enter(PipelineStage::Parse, bytes);
+            pending.emplace_back(pool.enqueue(timed_parse, std::move(line)), bytes);
 
-            // Backpressure: keep the futures queue bounded
-            if (futures.size_approx() > max_futures) {
-                // Blockingly process at least one future result
+            // Insert whatever has finished parsing, and once the byte budget is used up keep inserting
+            // (waiting for parse tasks if needed) so the reader gets credits back
+            while (front_ready() || (flow_.exhausted() && !pending.empty())) {
                 drain_one();
             }
+            flow_.track(PipelineStage::Parse, StageActivity::Blocked);
         }
         // Final drain
         while (drain_one()) {
         }
 #else
+        flow_.track(PipelineStage::Parse, StageActivity::Blocked);
         while (reader.get_line(line)) {
-            if (!line.starts_with("INSERT INTO")) continue;
-            auto res = parse_fn(line);
-            if (is_first_emitted) {
-                on_first(res);
-                is_first_emitted = false;
+            flow_.track(PipelineStage::Parse, StageActivity::Busy);
+            const uint64_t bytes = line.size();
+            if (!line.starts_with("INSERT INTO")) {
+                flow_.release(bytes);
+                flow_.track(PipelineStage::Parse, StageActivity::Blocked);
+                continue;
             }
-            on_result(res);
+            flow_.enter(PipelineStage::Parse, bytes);
+            auto res = [&] {
+                Trace::Scope parse_scope("parse", "parse");
+                parse_scope.set_arg("bytes", bytes);
+                return parse_fn(line);
+            }();
+            flow_.leave(PipelineStage::Parse, bytes);
+            emit(res, bytes);
+            flow_.track(PipelineStage::Parse, StageActivity::Blocked);
         }
 #endif
+        flow_.untrack();
+        if (reader.failed()) {
+            throw std::runtime_error(
+                std::format("{} could not be read to the end", reader_file_path_.filename().string()));
+        }
     }
 
     /**
@@ -136,6 +222,12 @@ class DataLoaderBase {
         parse_insert_lines(reader, parse_fn, on_result, [](const auto&) {});
     }
 
+    // Declared before reader_ so that it outlives the reader, which cancels it on destruction
+    // NOLINTNEXTLINE(cppcoreguidelines-non-private-member-variables-in-classes)
+    FlowControl flow_{ResourceProbe::get().pipeline_budget_bytes};
     std::unique_ptr<ReaderType> reader_;      // NOLINT (cppcoreguidelines-non-private-member-variables-in-classes)
     std::filesystem::path reader_file_path_;  // NOLINT (cppcoreguidelines-non-private-member-variables-in-classes)
+
+   private:
+    uint64_t rows_parsed_ = 0;
 };
@@ -2,13 +2,40 @@
 
 #include <spdlog/spdlog.h>
 
+#include <format>
+
+#include "Log/Trace.h"
 #include "PageGraph/PageGraph.h"
+#include "Utils/PerfCounters.h"
+#include "Utils/WThreadPool.h"
+
+namespace {
+// Log the loaders' structures and the telemetry channels after a stage and hand the structures to the UI
+void record_memory(UIState& state, std::string stage, std::vector<StructureMemory> structures) {
+    MemorySnapshot snapshot = MemoryFootprint::snapshot(std::move(stage), std::move(structures));
+    MemoryFootprint::log(snapshot);
+    state.telemetry.log();
+    std::lock_guard<std::mutex> lock(state.memory_mutex);
+    state.memory_snapshots.push_back(std::move(snapshot));
+}
+}  // namespace
 
 DataLoaderManager::DataLoaderManager()
     : page_loader_(std::make_unique<PageLoader>()),
       linktarget_loader_(std::make_unique<LinkTargetLoader>()),
       link_loader_(std::make_unique<LinkLoader>()) {}
 
+std::vector<StructureMemory> DataLoaderManager::memory_usage() const {
+    std::vector<StructureMemory> structures = page_loader_->memory_usage();
+    for (auto& structure : linktarget_loader_->memory_usage()) {
+        structures.push_back(std::move(structure));
+    }
+    for (auto& structure : link_loader_->memory_usage()) {
+        structures.push_back(std::move(structure));
+    }
+    return structures;
+}
+
 void DataLoaderManager::cleanup_after_linktarget_load() {
     // Keep the page title lookup map alive for UI searches
 }
@@ -22,88 +49,141 @@ void DataLoaderManager::cleanup_after_graph_build() {
     link_loader_->destroy_links();
 }
 
+namespace {
+// Run every loading stage and build the graph; throws when a reader fails, e.g. because its download was cancelled
+void load_wiki(UIState& state, std::unique_ptr<DataLoaderManager>& data_manager) {
+    std::string wiki_prefix = state.selected_wiki_prefix;
+    std::string date = state.selected_wiki_date;
+    spdlog::debug("Loading wiki: {} {}", wiki_prefix, date);
+
+    // Opened before the stages start their reader and worker threads so those are counted too. The graph build's
+    // shared pool outlives the session, its workers must exist when it opens to be counted per thread.
+    WThreadPool::shared();
+    PerfCounters::Session counters(PerfCounters::Session::Scope::WithWorkers);
+    CounterValues stage_begin_counters = counters.read();
+    auto log_stage_counters = [&](std::string_view stage) {
+        const CounterValues now = counters.read();
+        PerfCounters::log(stage, now - stage_begin_counters);
+        stage_begin_counters = now;
+    };
+
+    // Page loading stage
+    auto start_time = std::chrono::steady_clock::now();
+    uint64_t stage_begin_ns = Trace::now_ns();
+    spdlog::debug("Loading page table...");
+    spdlog::debug("file: {}", state.selected_wiki.page.data_path.string());
+    data_manager->get_page_loader().load_page_table(
+        state.selected_wiki.page,
+        [&](size_t count, uint32_t speed, ReadProgress progress) {
+            state.page_count = count;
+            state.page_speed = speed;
+            state.page_progress = progress;
+            state.pipeline_activity = data_manager->get_page_loader().flow_control().activity();
+            post_ui_refresh();
+        },
+        UIState::refresh_rate);
+    auto end_time = std::chrono::steady_clock::now();
+    state.page_load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    Trace::record("load pages", "stage", stage_begin_ns, Trace::now_ns());
+    log_stage_counters("load pages");
+    record_memory(state, "pages", data_manager->memory_usage());
+
+    state.stage = UIStage::LoadLinkTargets;
+    state.pipeline_activity = PipelineActivity{};
+    post_ui_refresh();
+
+    // Link target loading stage
+    start_time = std::chrono::steady_clock::now();
+    stage_begin_ns = Trace::now_ns();
+    spdlog::debug("Loading linktarget table...");
+    spdlog::debug("file: {}", state.selected_wiki.linktarget.data_path.string());
+    data_manager->get_linktarget_loader().load_linktarget_table(
+        state.selected_wiki.linktarget, data_manager->get_page_loader(),
+        [&](size_t count, uint32_t speed, ReadProgress progress) {
+            state.linktarget_count = count;
+            state.linktarget_speed = speed;
+            state.linktarget_progress = progress;
+            state.pipeline_activity = data_manager->get_linktarget_loader().flow_control().activity();
+            post_ui_refresh();
+        },
+        UIState::refresh_rate);
+    end_time = std::chrono::steady_clock::now();
+    state.linktarget_load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    Trace::record("load link targets", "stage", stage_begin_ns, Trace::now_ns());
+    log_stage_counters("load link targets");
+
+    // Clean up after linktarget loading
+    data_manager->cleanup_after_linktarget_load();
+    record_memory(state, "link targets", data_manager->memory_usage());
+
+    state.stage = UIStage::LoadLinks;
+    state.pipeline_activity = PipelineActivity{};
+    post_ui_refresh();
+
+    // Link loading stage
+    start_time = std::chrono::steady_clock::now();
+    stage_begin_ns = Trace::now_ns();
+    spdlog::debug("Loading pagelinks table...");
+    spdlog::debug("file: {}", state.selected_wiki.pagelinks.data_path.string());
+    data_manager->get_link_loader().load_pagelinks_table(
+        state.selected_wiki.pagelinks, data_manager->get_page_loader(), data_manager->get_linktarget_loader(),
+        [&](size_t count, uint32_t speed, ReadProgress progress) {
+            state.link_count = count;
+            state.link_speed = speed;
+            state.link_progress = progress;
+            state.pipeline_activity = data_manager->get_link_loader().flow_control().activity();
+            post_ui_refresh();
+        },
+        UIState::refresh_rate);
+    end_time = std::chrono::steady_clock::now();
+    state.link_load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    Trace::record("load links", "stage", stage_begin_ns, Trace::now_ns());
+    log_stage_counters("load links");
+
+    // Clean up after link loading
+    data_manager->cleanup_after_link_load();
+    record_memory(state, "links", data_manager->memory_usage());
+
+    state.stage = UIStage::BuildingGraph;
+    post_ui_refresh();
+
+    start_time = std::chrono::steady_clock::now();
+    stage_begin_ns = Trace::now_ns();
+    // Build the graph with the loaded data
+    PageGraph::init(state, data_manager->move_pages(), data_manager->move_links());
+
+    // Clean up after graph construction
+    data_manager->cleanup_after_graph_build();
+
+    end_time = std::chrono::steady_clock::now();
+    state.graph_build_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    Trace::record("build graph", "stage", stage_begin_ns, Trace::now_ns());
+    log_stage_counters("build graph");
+    std::vector<StructureMemory> structures = data_manager->memory_usage();
+    for (auto& structure : PageGraph::get().memory_usage()) {
+        structures.push_back(std::move(structure));
+    }
+    record_memory(state, "graph build", std::move(structures));
+
+    state.stage = UIStage::UserInput;
+    post_ui_refresh();
+}
+}  // namespace
+
 // Define the loader function that will be called when a wiki is selected
 void start_loader_thread(UIState& state, std::unique_ptr<DataLoaderManager>& data_manager) {
     std::thread loader([&] {
-        std::string wiki_prefix = state.selected_wiki_prefix;
-        std::string date = state.selected_wiki_date;
-        spdlog::debug("Loading wiki: {} {}", wiki_prefix, date);
-
-        // Page loading stage
-        auto start_time = std::chrono::steady_clock::now();
-        spdlog::debug("Loading page table...");
-        spdlog::debug("file: {}", state.selected_wiki.page.data_path.string());
-        data_manager->get_page_loader().load_page_table(
-            state.selected_wiki.page,
-            [&](size_t count, uint32_t speed, ReadProgress progress) {
-                state.page_count = count;
-                state.page_speed = speed;
-                state.page_progress = progress;
-                post_ui_refresh();
-            },
-            UIState::refresh_rate);
-        auto end_time = std::chrono::steady_clock::now();
-        state.page_load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-
-        state.stage = UIStage::LoadLinkTargets;
-        post_ui_refresh();
-
-        // Link target loading stage
-        start_time = std::chrono::steady_clock::now();
-        spdlog::debug("Loading linktarget table...");
-        spdlog::debug("file: {}", state.selected_wiki.linktarget.data_path.string());
-        data_manager->get_linktarget_loader().load_linktarget_table(
-            state.selected_wiki.linktarget, data_manager->get_page_loader(),
-            [&](size_t count, uint32_t speed, ReadProgress progress) {
-                state.linktarget_count = count;
-                state.linktarget_speed = speed;
-                state.linktarget_progress = progress;
-                post_ui_refresh();
-            },
-            UIState::refresh_rate);
-        end_time = std::chrono::steady_clock::now();
-        state.linktarget_load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-
-        // Clean up after linktarget loading
-        data_manager->cleanup_after_linktarget_load();
-
-        state.stage = UIStage::LoadLinks;
-        post_ui_refresh();
-
-        // Link loading stage
-        start_time = std::chrono::steady_clock::now();
-        spdlog::debug("Loading pagelinks table...");
-        spdlog::debug("file: {}", state.selected_wiki.pagelinks.data_path.string());
-        data_manager->get_link_loader().load_pagelinks_table(
-            state.selected_wiki.pagelinks, data_manager->get_page_loader(), data_manager->get_linktarget_loader(),
-            [&](size_t count, uint32_t speed, ReadProgress progress) {
-                state.link_count = count;
-                state.link_speed = speed;
-                state.link_progress = progress;
-                post_ui_refresh();
-            },
-            UIState::refresh_rate);
-        end_time = std::chrono::steady_clock::now();
-        state.link_load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-
-        // Clean up after link loading
-        data_manager->cleanup_after_link_load();
-
-        state.stage = UIStage::BuildingGraph;
-        post_ui_refresh();
-
-        start_time = std::chrono::steady_clock::now();
-        // Build the graph with the loaded data
-        PageGraph::init(state, data_manager->move_pages(), data_manager->move_links());
-
-        // Clean up after graph construction
-        data_manager->cleanup_after_graph_build();
-
-        end_time = std::chrono::steady_clock::now();
-        state.graph_build_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-
-        state.stage = UIStage::UserInput;
-        post_ui_refresh();
+        Trace::set_thread_name("loader");
+        try {
+            load_wiki(state, data_manager);
+        } catch (const std::exception& e) {
+            // A truncated dump would give an incomplete graph, so go back to the download error screen instead
+            spdlog::error("Loading {}wiki stopped: {}", state.selected_wiki_prefix, e.what());
+            state.set_download_error(std::format(
+                "Loading stopped: {}. Restart and select the wiki again to resume the download.", e.what()));
+            state.stage = UIStage::Download;
+            post_ui_refresh();
+        }
     });
     loader.detach();
 }
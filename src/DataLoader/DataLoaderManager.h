@@ -64,6 +64,9 @@ class DataLoaderManager {
     std::vector<Link> move_links() {
         return link_loader_->move_links();
     }
+
+    /** @brief Footprint of every structure the loaders hold. */
+    [[nodiscard]] std::vector<StructureMemory> memory_usage() const;
 };
 
 /**
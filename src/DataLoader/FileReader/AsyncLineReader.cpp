@@ -2,12 +2,16 @@
 
 #include "AsyncLineReader.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <vector>
 
+#include "FetchWikiData/PartialFileReader.h"
+#include "Log/Trace.h"
 #include "spdlog/spdlog.h"
 
-AsyncLineReader::AsyncLineReader(const WikiFile& file) : file_(file), total_bytes_(0), gz_file_(nullptr) {
+AsyncLineReader::AsyncLineReader(const WikiFile& file, FlowControl& flow)
+    : file_(file), total_bytes_(0), gz_file_(nullptr), flow_(flow) {
     calculate_total_bytes();
     initialize_reader();
 
@@ -16,6 +20,11 @@ AsyncLineReader::AsyncLineReader(const WikiFile& file) : file_(file), total_byte
 }
 
 AsyncLineReader::~AsyncLineReader() {
+    // Unblock the reader thread in case the consumer stopped before the end of the file
+    flow_.cancel();
+    if (file_.live_source) {
+        file_.live_source->cancel();
+    }
     if (reader_thread_.joinable()) {
         reader_thread_.join();
     }
@@ -23,31 +32,77 @@ AsyncLineReader::~AsyncLineReader() {
         gzclose(gz_file_);
         gz_file_ = nullptr;
     }
+    if (inflate_initialized_) {
+        inflateEnd(&inflate_);
+    }
 }
 
 bool AsyncLineReader::get_line(std::string& line) {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return !queue_.empty() || done_; });
+    if (queue_.empty() && !done_) {
+        Trace::Scope wait_scope("wait for line", "read");
+        cv_.wait(lock, [this] { return !queue_.empty() || done_; });
+    }
 
     if (!queue_.empty()) {
         line = std::move(queue_.front());
         queue_.pop();
-        cv_.notify_one();
+        lock.unlock();
+        flow_.leave(PipelineStage::Read, line.size());
         return true;
     }
     return false;
 }
 
+bool AsyncLineReader::push_line(std::string&& line) {
+    const uint64_t bytes = line.size();
+    if (!flow_.acquire(bytes)) {
+        return false;
+    }
+    flow_.enter(PipelineStage::Read, bytes);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push(std::move(line));
+
+    // compressed-position update for UI progress
+    // gzoffset reports the current location in the compressed stream
+    if (file_.live_source) {
+        current_pos_.store(file_.live_source->position(), std::memory_order_relaxed);
+    } else if (z_off_t off = gzoffset(gz_file_); off >= 0) {
+        current_pos_.store(static_cast<uint64_t>(off), std::memory_order_relaxed);
+    }
+
+    lock.unlock();
+    cv_.notify_one();
+    return true;
+}
+
 ReadProgress AsyncLineReader::get_progress() {
-    return {.total_bytes = total_bytes_, .current_bytes = current_pos_.load(std::memory_order_relaxed)};
+    // The size of a download is only known once the server answered
+    const uint64_t total_bytes = file_.live_source ? file_.live_source->size() : total_bytes_;
+    return {.total_bytes = total_bytes, .current_bytes = current_pos_.load(std::memory_order_relaxed)};
 }
 
 void AsyncLineReader::calculate_total_bytes() {
+    if (file_.live_source) {
+        return;
+    }
     // Use compressed file size for progress tracking
     total_bytes_ = std::filesystem::file_size(file_.data_path);
 }
 
 void AsyncLineReader::initialize_reader() {
+    if (file_.live_source) {
+        // 16 + MAX_WBITS: expect a gzip header and trailer
+        if (inflateInit2(&inflate_, 16 + MAX_WBITS) != Z_OK) {
+            spdlog::error("Failed to initialize zlib inflate for: {}", file_.data_path.string());
+            return;
+        }
+        inflate_initialized_ = true;
+        compressed_.resize(1 << 20);  // 2^20 = 1 MB buffer
+        spdlog::info("Reading {} while it downloads", file_.data_path.string());
+        return;
+    }
     gz_file_ = gzopen(file_.data_path.string().c_str(), "rb");
     if (gz_file_ == nullptr) {
         spdlog::error("Failed to open gzip file: {}", file_.data_path.string());
@@ -57,74 +112,120 @@ void AsyncLineReader::initialize_reader() {
     spdlog::info("Successfully initialized zlib gzip reader for: {}", file_.data_path.string());
 }
 
+int AsyncLineReader::read_chunk(char* dst, unsigned int size) {
+    if (file_.live_source) {
+        return inflate_live(dst, size);
+    }
+    const int bytes_read = gzread(gz_file_, dst, size);
+    if (bytes_read < 0) {  // Decompression/read error
+        int errnum = 0;
+        const char* errstr = gzerror(gz_file_, &errnum);
+        spdlog::error("Error reading gzip file: {} (err {}): {}", file_.data_path.string(), errnum,
+                      (errstr ? errstr : "unknown"));
+    }
+    return bytes_read;
+}
+
+int AsyncLineReader::inflate_live(char* dst, unsigned int size) {
+    PartialFileReader& source = *file_.live_source;
+    inflate_.next_out = reinterpret_cast<Bytef*>(dst);
+    inflate_.avail_out = size;
+
+    while (inflate_.avail_out == size) {
+        if (inflate_.avail_in == 0) {
+            // Blocks until the download has written more of the file
+            flow_.track(PipelineStage::Read, StageActivity::Blocked);
+            const size_t count = source.read(compressed_.data(), compressed_.size());
+            flow_.track(PipelineStage::Read, StageActivity::Busy);
+            if (count == 0) {
+                if (source.cancelled() || !member_complete_) {
+                    spdlog::error("Download of {} ended at {} bytes before the end of the gzip stream",
+                                  file_.data_path.string(), source.position());
+                    return -1;
+                }
+                return 0;
+            }
+            inflate_.next_in = reinterpret_cast<Bytef*>(compressed_.data());
+            inflate_.avail_in = static_cast<uInt>(count);
+        }
+
+        const int ret = inflate(&inflate_, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            // Dumps may consist of several concatenated gzip members
+            inflateReset(&inflate_);
+            member_complete_ = true;
+        } else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+            member_complete_ = false;
+        } else {
+            spdlog::error("Error inflating {} (err {}): {}", file_.data_path.string(), ret,
+                          (inflate_.msg ? inflate_.msg : "unknown"));
+            return -1;
+        }
+    }
+    return static_cast<int>(size - inflate_.avail_out);
+}
+
 void AsyncLineReader::read_lines() {
-    if (gz_file_ == nullptr) {
+    Trace::set_thread_name("reader");
+    flow_.track(PipelineStage::Read, StageActivity::Busy);
+    if (gz_file_ == nullptr && !inflate_initialized_) {
         spdlog::error("No valid gzip file available for reading");
+        failed_.store(true, std::memory_order_release);
     } else {
         std::vector<char> buffer(1 << 16);  // 64 KB buffer
         std::string pending_line;
         pending_line.reserve(1 << 20);  // Wikipedia dumps have 2^20 = 1 MB lines
 
         while (true) {
-            int bytes_read = gzread(gz_file_, buffer.data(), static_cast<unsigned int>(buffer.size()));
+            int bytes_read = 0;
+            {
+                Trace::Scope chunk_scope("decompress chunk", "read");
+                bytes_read = read_chunk(buffer.data(), static_cast<unsigned int>(buffer.size()));
+                chunk_scope.set_arg("bytes", static_cast<uint64_t>(std::max(bytes_read, 0)));
+            }
             if (bytes_read < 0) {  // Decompression/read error
-                int errnum = 0;
-                const char* errstr = gzerror(gz_file_, &errnum);
-                spdlog::error("Error reading gzip file: {} (err {}): {}", file_.data_path.string(), errnum,
-                              (errstr ? errstr : "unknown"));
+                failed_.store(true, std::memory_order_release);
                 break;
             }
             if (bytes_read == 0) {
                 // EOF
                 break;
             }
+            // Re-announcing the activity publishes the busy time so far to the live view
+            flow_.track(PipelineStage::Read, StageActivity::Busy);
 
             // Scan the chunk for newlines
+            bool cancelled = false;
             int start_index = 0;
             for (int i = 0; i < bytes_read; i++) {
                 if (buffer[static_cast<size_t>(i)] == '\n') {  // found the newline
                     pending_line.append(buffer.data() + start_index, static_cast<size_t>(i - start_index));
-
-                    std::unique_lock<std::mutex> lock(mutex_);
-                    cv_.wait(lock, [this] { return queue_.size() < MAX_QUEUE_SIZE; });
-                    queue_.push(std::move(pending_line));
-                    pending_line.clear();
-
-                    // compressed-position update for UI progress
-                    // gzoffset reports the current location in the compressed stream
-                    z_off_t off = gzoffset(gz_file_);
-                    if (off >= 0) {
-                        current_pos_.store(static_cast<uint64_t>(off), std::memory_order_relaxed);
+                    if (!push_line(std::move(pending_line))) {
+                        cancelled = true;
+                        break;
                     }
-
-                    lock.unlock();
-                    cv_.notify_one();
+                    pending_line.clear();
                     start_index = i + 1;
                 }
             }
+            if (cancelled) {
+                pending_line.clear();
+                break;
+            }
 
             if (start_index < bytes_read) {
                 pending_line.append(buffer.data() + start_index, static_cast<size_t>(bytes_read - start_index));
             }
         }
 
-        // Flush final line
-        if (!pending_line.empty()) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            cv_.wait(lock, [this] { return queue_.size() < MAX_QUEUE_SIZE; });
-            queue_.push(std::move(pending_line));
-
-            // final progress update
-            z_off_t off = gzoffset(gz_file_);
-            if (off >= 0) {
-                current_pos_.store(static_cast<uint64_t>(off), std::memory_order_relaxed);
-            }
-
-            lock.unlock();
-            cv_.notify_one();
+        // Flush final line, unless it is the truncated end of a failed read
+        if (!pending_line.empty() && !failed()) {
+            push_line(std::move(pending_line));
         }
     }
 
+    flow_.untrack();
+
     // Signal that no more lines will be produced
     std::unique_lock<std::mutex> lock(mutex_);
     done_ = true;
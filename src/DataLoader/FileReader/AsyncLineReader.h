@@ -8,7 +8,9 @@
 #include <queue>
 #include <string>
 #include <thread>
+#include <vector>
 
+#include "DataLoader/FlowControl.h"
 #include "UI/UIBase.h"
 #include <zlib.h>
 
@@ -18,14 +20,17 @@
  *
  * Provides a background thread that reads lines from a compressed or
  * uncompressed file and exposes byte-level progress compatible with the UI.
+ * When the file is still downloading (WikiFile::live_source), the compressed bytes are taken from the download as
+ * they arrive and inflated here, so parsing keeps pace with the download instead of waiting for it.
  */
 class AsyncLineReader {
    public:
     /**
      * @brief Constructs an async line reader
      * @param file WikiFile descriptor (compressed or uncompressed)
+     * @param flow Pipeline flow control; every produced line holds credits until the consumer releases them
      */
-    explicit AsyncLineReader(const WikiFile& file);
+    AsyncLineReader(const WikiFile& file, FlowControl& flow);
 
     /**
      * @brief Destructor that ensures proper cleanup
@@ -39,6 +44,14 @@ class AsyncLineReader {
      */
     bool get_line(std::string& line);
 
+    /**
+     * @brief Whether reading stopped at an error instead of the end of the file, e.g. a cancelled download.
+     * Only meaningful once get_line() returned false.
+     */
+    [[nodiscard]] bool failed() const {
+        return failed_.load(std::memory_order_acquire);
+    }
+
     /**
      * @brief Get current read progress in compressed bytes.
      * @return ReadProgress structure with total and current bytes
@@ -46,8 +59,6 @@ class AsyncLineReader {
     ReadProgress get_progress();
 
    private:
-    static constexpr size_t MAX_QUEUE_SIZE = 10;
-
     // File information
     WikiFile file_{};
     uint64_t total_bytes_;
@@ -56,18 +67,46 @@ class AsyncLineReader {
     // zlib stream
     gzFile gz_file_ = nullptr;
 
+    // Inflate state while reading from a download in progress
+    z_stream inflate_{};
+    bool inflate_initialized_ = false;
+    bool member_complete_ = true;  // The last gzip member ended, so the input may end here
+    std::vector<char> compressed_;
+
+    // Backpressure shared with the parser and inserter stages
+    FlowControl& flow_;
+
     // Threading
     std::thread reader_thread_;
     std::queue<std::string> queue_;
     std::mutex mutex_;
     std::condition_variable cv_;
     bool done_ = false;
+    std::atomic<bool> failed_{false};
 
     /**
      * @brief Background worker that reads lines and enqueues them.
      */
     void read_lines();
 
+    /**
+     * @brief Take flow-control credits for a line and hand it to the consumer.
+     * @return false if the pipeline was cancelled
+     */
+    bool push_line(std::string&& line);
+
+    /**
+     * @brief Decompress the next chunk of the file.
+     * @return Bytes written to `dst`, 0 at the end of the file, negative on error
+     */
+    int read_chunk(char* dst, unsigned int size);
+
+    /**
+     * @brief Decompress the next chunk of a file that is still downloading.
+     * @return Bytes written to `dst`, 0 at the end of the file, negative on error
+     */
+    int inflate_live(char* dst, unsigned int size);
+
     /**
      * @brief Initialize the input stream
      */
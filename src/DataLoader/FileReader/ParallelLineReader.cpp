@@ -10,10 +10,26 @@
 #include <rapidgzip/ParallelGzipReader.hpp>
 #include <thread>
 
+#include "FetchWikiData/PartialFileReader.h"
+#include "Log/Trace.h"
+#include "Utils/Affinity.h"
+#include "Utils/ResourceProbe.h"
 #include "spdlog/spdlog.h"
 
-ParallelLineReader::ParallelLineReader(const WikiFile& file, size_t parallelization, size_t chunk_size)
-    : file_(file), parallelization_(parallelization), chunk_size_(chunk_size) {
+ParallelLineReader::ParallelLineReader(const WikiFile& file, FlowControl& flow, size_t parallelization,
+                                       size_t chunk_size)
+    : file_(file),
+      flow_(flow),
+      parallelization_(parallelization != 0 ? parallelization : ResourceProbe::get().decompression_threads),
+      chunk_size_(chunk_size) {
+    // rapidgzip seeks all over the file, so a file that is still downloading has to be complete first
+    if (file_.live_source) {
+        spdlog::info("Waiting for the download of {} to complete", file_.data_path.string());
+        if (!file_.live_source->wait_finished()) {
+            spdlog::error("Download of {} failed", file_.data_path.string());
+            throw std::runtime_error("Download failed!");
+        }
+    }
     calculate_total_bytes();
     initialize_reader();
     // Resolve index path for loading/saving
@@ -22,6 +38,10 @@ ParallelLineReader::ParallelLineReader(const WikiFile& file, size_t parallelizat
 }
 
 ParallelLineReader::~ParallelLineReader() {
+    // Unblock the reader thread in case the consumer stopped before the end of the stream
+    cancelled_.store(true, std::memory_order_release);
+    flow_.cancel();
+
     // Join the reader thread if it is still running
     if (thread_started_.load(std::memory_order_relaxed) && reader_thread_.joinable()) {
         reader_thread_.join();
@@ -38,17 +58,54 @@ bool ParallelLineReader::get_line(std::string& line) {
         }
     }
 
-    // Loop until we get a line or we are sure that no more lines will be produced.
-    while (true) {
-        if (queue_.try_dequeue(line)) {
-            return true;
-        }
+    if (batch_pos_ == batch_.size() && !refill_batch()) {
+        return false;
+    }
+    line = std::move(batch_[batch_pos_++]);
+    return true;
+}
+
+void ParallelLineReader::enqueue_line(std::string&& line) {
+    // Blocks while the pipeline is over its byte budget; rapidgzip simply waits inside our chunk callback
+    const uint64_t bytes = line.size();
+    if (!flow_.acquire(bytes)) {
+        return;  // Cancelled, the consumer is gone
+    }
+    flow_.enter(PipelineStage::Read, bytes);
+    queue_.enqueue(producer_token_, std::move(line));
+    lines_available_.signal();
+}
+
+bool ParallelLineReader::refill_batch() {
+    batch_.resize(DEQUEUE_BATCH_SIZE);
+    batch_pos_ = 0;
 
-        if (done_.load(std::memory_order_acquire)) {
-            return queue_.try_dequeue(line);
+    // Sleep until at least one permit is available, then take as many as are ready up to the batch size
+    size_t permits = 0;
+    {
+        Trace::Scope wait_scope("wait for lines", "read");
+        permits = static_cast<size_t>(lines_available_.waitMany(DEQUEUE_BATCH_SIZE));
+    }
+    size_t dequeued = 0;
+    while (dequeued < permits) {
+        const auto first = batch_.begin() + static_cast<ptrdiff_t>(dequeued);
+        const size_t count = queue_.try_dequeue_bulk(consumer_token_, first, permits - dequeued);
+        if (count == 0) {
+            // Every line is enqueued before its permit is signalled, so a permit without a line can only be the
+            // end-of-stream permit. Put it back so that later calls return false as well.
+            lines_available_.signal();
+            break;
         }
-        std::this_thread::yield();
+        dequeued += count;
     }
+    batch_.resize(dequeued);
+
+    // The lines move on to the parser, their credits stay taken until the consumer releases them
+    for (const auto& line : batch_) {
+        flow_.leave(PipelineStage::Read, line.size());
+    }
+
+    return dequeued > 0;
 }
 
 ReadProgress ParallelLineReader::get_progress() {
@@ -93,6 +150,11 @@ void ParallelLineReader::initialize_reader() {
 }
 
 void ParallelLineReader::read_lines() {
+    // rapidgzip spawns its decompression threads from this thread on first read, they inherit this CPU set
+    Affinity::restrict_current_thread(Affinity::decompression_cpus(parallelization_));
+    Trace::set_thread_name("reader");
+    // Busy time of this thread includes waiting for rapidgzip's decompression threads inside read()
+    flow_.track(PipelineStage::Read, StageActivity::Busy);
     try {
         if (rapidgzip_reader_) {
             std::string line_buffer;
@@ -106,30 +168,35 @@ void ParallelLineReader::read_lines() {
             };
 
             const size_t STRIPE_SIZE = 32 * 1024 * 1024;
-            while (true) {
-                // Lightweight backpressure to avoid unbounded growth when consumer is slower
-                while (queue_.size_approx() > MAX_QUEUE_SIZE) {
-                    std::this_thread::yield();
-                }
+            // Backpressure happens per line in enqueue_line() through the pipeline's flow control
+            while (!cancelled_.load(std::memory_order_acquire)) {
+                Trace::Scope stripe_scope("decompress stripe", "read");
                 const auto bytesRead = rapidgzip_reader_->read(processLines, STRIPE_SIZE);
+                stripe_scope.set_arg("bytes", bytesRead);
                 if (bytesRead == 0) {
                     break;
                 }
                 current_pos_.store(rapidgzip_reader_->tellCompressed() /
                                    8);  // TellCompressed returns bits, we want bytes NOLINT
+                // Re-announcing the activity publishes the busy time so far to the live view
+                flow_.track(PipelineStage::Read, StageActivity::Busy);
             }
 
             if (!line_buffer.empty()) {
-                queue_.enqueue(std::move(line_buffer));
+                enqueue_line(std::move(line_buffer));
             }
 
         } else {
             spdlog::error("Cannot read lines: rapidgzip reader not initialized");
+            failed_.store(true, std::memory_order_release);
         }
     } catch (const std::exception& e) {
         spdlog::error("Error in ParallelLineReader thread: {}", e.what());
+        failed_.store(true, std::memory_order_release);
     }
+    flow_.untrack();
     done_.store(true, std::memory_order_release);
+    lines_available_.signal();  // End-of-stream permit wakes up the consumer
 
     // Export index at the end if we have one
     try {
@@ -168,11 +235,11 @@ void ParallelLineReader::process_chunk_data(const std::shared_ptr<rapidgzip::Chu
             const size_t frag_len = static_cast<size_t>(nl_ptr - data_ptr);
             if (!line_buffer.empty()) {
                 line_buffer.append(data_ptr, frag_len);
-                queue_.enqueue(line_buffer);  // enqueue copy to avoid moved-from issues
+                enqueue_line(std::string(line_buffer));  // enqueue copy to keep line_buffer's capacity
                 line_buffer.clear();
             } else {
                 // Enqueue directly from this fragment without touching line_buffer
-                queue_.enqueue(std::string(data_ptr, frag_len));
+                enqueue_line(std::string(data_ptr, frag_len));
             }
             data_ptr = nl_ptr + 1;
         }
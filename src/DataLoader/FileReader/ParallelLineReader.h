@@ -3,6 +3,7 @@
 #ifdef PARALLEL_DECOMPRESSION
 
 #include <concurrentqueue.h>
+#include <lightweightsemaphore.h>
 
 #include <atomic>
 #include <filesystem>
@@ -10,7 +11,9 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
+#include "DataLoader/FlowControl.h"
 #include "UI/UIBase.h"
 
 // Forward declarations to avoid heavy rapidgzip includes in header
@@ -32,11 +35,12 @@ class ParallelLineReader {
     /**
      * @brief Construct a reader for the given `WikiFile`.
      * @param file Descriptor of the compressed data and optional index paths
-     * @param parallelization Number of worker threads (0 = use all cores)
+     * @param flow Pipeline flow control; every produced line holds credits until the consumer releases them
+     * @param parallelization Number of worker threads (0 = use the usable CPUs, see ResourceProbe)
      * @param chunk_size Size of each decompression chunk in bytes
      */
-    explicit ParallelLineReader(const WikiFile& file,
-                                size_t parallelization = 0,            // 0 means use all cores
+    explicit ParallelLineReader(const WikiFile& file, FlowControl& flow,
+                                size_t parallelization = 0,            // 0 means use the usable CPUs
                                 size_t chunk_size = 4 * 1024 * 1024);  // 4MB chunk size by default NOLINT
 
     ~ParallelLineReader();
@@ -48,12 +52,21 @@ class ParallelLineReader {
     ParallelLineReader& operator=(ParallelLineReader&&) = delete;
 
     /**
-     * @brief Fetch the next decompressed line.
+     * @brief Fetch the next decompressed line, blocking until one is available.
+     * Must only be called from a single consumer thread.
      * @param line Output parameter receiving the next line
      * @return true if a line was produced, false on end of stream
      */
     bool get_line(std::string& line);
 
+    /**
+     * @brief Whether reading stopped at an error instead of the end of the stream.
+     * Only meaningful once get_line() returned false.
+     */
+    [[nodiscard]] bool failed() const {
+        return failed_.load(std::memory_order_acquire);
+    }
+
     /**
      * @brief Return current read progress in compressed bytes.
      * @return Structure with total and current byte counters
@@ -61,8 +74,8 @@ class ParallelLineReader {
     ReadProgress get_progress();
 
    private:
-    // Maximum number of lines decompressed by default before we start yielding for parser threads
-    static constexpr size_t MAX_QUEUE_SIZE = 32;  // 32 lines = 32 MB
+    // Maximum number of lines moved from the shared queue to the consumer per dequeue
+    static constexpr size_t DEQUEUE_BATCH_SIZE = 16;
 
     // Store decompressed data in a buffer
     static constexpr size_t READ_BUFFER_SIZE = 2 * 1024 * 1024;  // 2MB read buffer by default
@@ -83,10 +96,24 @@ class ParallelLineReader {
     // Parallelism coordination
     std::thread reader_thread_;
     std::atomic<bool> done_{false};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> failed_{false};
     moodycamel::ConcurrentQueue<std::string> queue_;
+    moodycamel::ProducerToken producer_token_{queue_};
+    moodycamel::ConsumerToken consumer_token_{queue_};
     std::atomic<bool> thread_started_{false};
     std::mutex start_mutex_;
 
+    // Blocking handoff: one permit per queued line, plus one end-of-stream permit once the reader finished
+    moodycamel::LightweightSemaphore lines_available_;
+
+    // Backpressure shared with the parser and inserter stages
+    FlowControl& flow_;
+
+    // Consumer-side batch of lines taken from the queue with try_dequeue_bulk
+    std::vector<std::string> batch_;
+    size_t batch_pos_ = 0;
+
     // Store rapidgzip reader settings
     size_t parallelization_;
     size_t chunk_size_;
@@ -106,6 +133,18 @@ class ParallelLineReader {
      */
     void read_lines();
 
+    /**
+     * @brief Take flow-control credits for a complete line and publish it to the consumer.
+     * @param line Line to move into the queue
+     */
+    void enqueue_line(std::string&& line);
+
+    /**
+     * @brief Block until lines are available and move up to DEQUEUE_BATCH_SIZE of them into batch_.
+     * @return false if the stream has ended and no more lines will be produced
+     */
+    bool refill_batch();
+
     /**
      * @brief Convert a decompressed chunk into newline-delimited lines and enqueue them.
      * @param chunk_data Shared pointer to decompressed block data
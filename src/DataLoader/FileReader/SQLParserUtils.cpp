@@ -6,6 +6,8 @@
 #include <string_view>
 #include <vector>
 
+#include "FetchWikiData/PartialFileReader.h"
+#include "UI/UIBase.h"
 #include "spdlog/spdlog.h"
 
 SQLTupleParser::SQLTupleParser(std::string_view tuple) : m_tuple(tuple) {};
@@ -97,22 +99,35 @@ std::vector<std::string_view> extract_tuples(std::string_view line) {
 }
 
 // Wikipedia SQL dumps are split into lines of 1 MB (uncompressed)
-uint64_t estimated_number_of_items(const std::filesystem::path& filename, const uint64_t first_line_size) {
-    uint64_t file_size = std::filesystem::file_size(filename);
-
-    std::ifstream file(filename, std::ios::binary);
-    file.seekg(-4, std::ios::end);
-    uint32_t original_size;
-    file.read(reinterpret_cast<char*>(&original_size), 4);
-    double compression_ratio = static_cast<double>(original_size) / file_size;
+uint64_t estimated_number_of_items(const WikiFile& file, const uint64_t first_line_size) {
+    constexpr double TYPICAL_COMPRESSION_RATIO = 6.0;  // Uncompressed dumps are 5-7x larger
+
+    uint64_t file_size = 0;
+    uint32_t original_size = 0;  // Uncompressed size modulo 2^32 from the gzip trailer
+    double compression_ratio = TYPICAL_COMPRESSION_RATIO;
+    if (file.live_source) {
+        // Still downloading: the file on disk is partial and its last bytes are the middle of the deflate stream
+        file_size = file.live_source->size();
+    } else {
+        file_size = std::filesystem::file_size(file.data_path);
+        std::ifstream stream(file.data_path, std::ios::binary);
+        stream.seekg(-4, std::ios::end);
+        stream.read(reinterpret_cast<char*>(&original_size), 4);
+        if (stream && original_size != 0 && file_size != 0) {
+            compression_ratio = static_cast<double>(original_size) / static_cast<double>(file_size);
+        }
+    }
+    if (file_size == 0) {
+        return 0;
+    }
 
     constexpr uint64_t MB = 1024 * 1024;
 
     uint64_t estimated_number_of_items =
         static_cast<uint64_t>((static_cast<double>(file_size) / MB) * first_line_size * compression_ratio);
 
-    spdlog::debug("Estimated number of items: {}, file_size: {}, first_line_size: {}", estimated_number_of_items,
-                  original_size, first_line_size);
+    spdlog::debug("Estimated number of items: {}, file_size: {}, original_size: {}, first_line_size: {}",
+                  estimated_number_of_items, file_size, original_size, first_line_size);
 
     return estimated_number_of_items;
 }
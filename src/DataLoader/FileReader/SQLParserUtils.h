@@ -6,6 +6,8 @@
 #include <type_traits>
 #include <vector>
 
+struct WikiFile;
+
 class SQLTupleParser {
    public:
     /**
@@ -66,8 +68,10 @@ std::vector<std::string_view> extract_tuples(std::string_view line);
 
 /**
  * @brief Estimate the number of tuples/items in a gzip file using first line size.
- * @param filename Path to compressed SQL dump
+ *
+ * A file that is still downloading has no gzip trailer yet, its final size and a typical compression ratio are used.
+ * @param file Compressed SQL dump, possibly still downloading
  * @param first_line_size Size in bytes of the first INSERT line
- * @return Estimated item count
+ * @return Estimated item count, 0 if the size of the file is not known yet
  */
-uint64_t estimated_number_of_items(const std::filesystem::path& filename, uint64_t first_line_size);
+uint64_t estimated_number_of_items(const WikiFile& file, uint64_t first_line_size);
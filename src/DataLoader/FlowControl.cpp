@@ -0,0 +1,350 @@
+#include "FlowControl.h"
+
+#include <algorithm>
+#include <format>
+#include <string>
+
+#include "Log/Trace.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+constexpr double kBytesPerMB = 1024 * 1024;
+constexpr double kNsPerSecond = 1e9;
+constexpr std::array kStages = {PipelineStage::Read, PipelineStage::Parse, PipelineStage::Insert};
+
+// Epochs are unique across all flow controls, so a thread never mistakes a new pipeline for the one it cached
+std::atomic<uint64_t> next_epoch{1};
+
+uint64_t new_epoch() {
+    return next_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Busy share of the time a stage's threads were tracked
+double busy_percent(const StageTiming& timing) {
+    const uint64_t total = timing.busy_ns + timing.blocked_ns;
+    return total > 0 ? 100.0 * static_cast<double>(timing.busy_ns) / static_cast<double>(total) : 0.0;
+}
+
+// Raise an atomic maximum to value if it is larger
+void update_peak(std::atomic<uint64_t>& peak, uint64_t value) {
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+constexpr size_t stage_index(PipelineStage stage) {
+    return static_cast<size_t>(stage);
+}
+
+constexpr const char* stage_name(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::Read:
+            return "read";
+        case PipelineStage::Parse:
+            return "parse";
+        case PipelineStage::Insert:
+            return "insert";
+    }
+    return "unknown";
+}
+}  // namespace
+
+FlowControl::FlowControl(uint64_t capacity_bytes)
+    : capacity_(capacity_bytes),
+      epoch_(new_epoch()),
+      started_(std::chrono::steady_clock::now()),
+      next_sample_(started_) {}
+
+bool FlowControl::acquire(uint64_t bytes) {
+    auto has_room = [&] {
+        return bytes_in_flight_.load(std::memory_order_acquire) + bytes <= capacity_ ||
+               stages_[stage_index(PipelineStage::Read)].items_in_flight.load(std::memory_order_acquire) == 0 ||
+               cancelled_.load(std::memory_order_acquire);
+    };
+
+    if (!has_room()) {
+        // Only the reader acquires, waiting here means the later stages hold the whole budget
+        track(PipelineStage::Read, StageActivity::Blocked);
+        {
+            Trace::Scope wait_scope("wait for credits", "read");
+            // Registered before the predicate is checked, see wake_waiters()
+            waiters_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, has_room);
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        track(PipelineStage::Read, StageActivity::Busy);
+    }
+    if (cancelled_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    const uint64_t in_flight = bytes_in_flight_.fetch_add(bytes, std::memory_order_acq_rel) + bytes;
+    update_peak(peak_bytes_in_flight_, in_flight);
+    return true;
+}
+
+void FlowControl::release(uint64_t bytes) {
+    bytes_in_flight_.fetch_sub(bytes, std::memory_order_acq_rel);
+    wake_waiters();
+}
+
+bool FlowControl::exhausted() const {
+    return bytes_in_flight_.load(std::memory_order_acquire) >= capacity_;
+}
+
+void FlowControl::enter(PipelineStage stage, uint64_t bytes) {
+    auto& counters = stages_[stage_index(stage)];
+    counters.items_in_flight.fetch_add(1, std::memory_order_acq_rel);
+    const uint64_t in_flight = counters.bytes_in_flight.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    update_peak(counters.peak_bytes, in_flight);
+    counters.total_items.fetch_add(1, std::memory_order_relaxed);
+    counters.total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void FlowControl::leave(PipelineStage stage, uint64_t bytes) {
+    auto& counters = stages_[stage_index(stage)];
+    counters.bytes_in_flight.fetch_sub(bytes, std::memory_order_relaxed);
+    const uint64_t remaining = counters.items_in_flight.fetch_sub(1, std::memory_order_acq_rel) - 1;
+
+    // An empty read queue lets the reader exceed the budget, see acquire()
+    if (stage == PipelineStage::Read && remaining == 0) {
+        wake_waiters();
+    }
+}
+
+StageOccupancy FlowControl::occupancy(PipelineStage stage) const {
+    const auto& counters = stages_[stage_index(stage)];
+    return {.items_in_flight = counters.items_in_flight.load(std::memory_order_relaxed),
+            .bytes_in_flight = counters.bytes_in_flight.load(std::memory_order_relaxed),
+            .peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed),
+            .total_items = counters.total_items.load(std::memory_order_relaxed),
+            .total_bytes = counters.total_bytes.load(std::memory_order_relaxed)};
+}
+
+uint64_t FlowControl::bytes_in_flight() const {
+    return bytes_in_flight_.load(std::memory_order_relaxed);
+}
+
+uint64_t FlowControl::peak_bytes_in_flight() const {
+    return peak_bytes_in_flight_.load(std::memory_order_relaxed);
+}
+
+uint64_t FlowControl::capacity() const {
+    return capacity_;
+}
+
+FlowControl::ThreadClock& FlowControl::this_thread_clock() {
+    thread_local ThreadClock clock;
+    return clock;
+}
+
+FlowControl::ThreadClock& FlowControl::clock_for_this_load(std::chrono::steady_clock::time_point now) {
+    ThreadClock& clock = this_thread_clock();
+    if (clock.epoch != epoch_) {
+        std::lock_guard<std::mutex> lock(accounts_mutex_);
+        ThreadAccount& account = accounts_.emplace_back();
+        account.thread = static_cast<uint32_t>(accounts_.size() - 1);
+        clock = {.epoch = epoch_, .account = &account, .slot = -1, .since = now};
+    }
+    return clock;
+}
+
+void FlowControl::track(PipelineStage stage, StageActivity activity) {
+    const auto now = std::chrono::steady_clock::now();
+    ThreadClock& clock = clock_for_this_load(now);
+    const int closed_slot = clock.slot;
+    const auto closed_since = clock.since;
+    clock.slot = static_cast<int>((stage_index(stage) * 2) + static_cast<size_t>(activity));
+    clock.since = now;
+
+    // The new interval is published before the closed one is counted, and activity() reads the counters first, so
+    // it may miss the closed interval for a moment but never counts it twice
+    const auto since_start = std::chrono::duration_cast<std::chrono::nanoseconds>(now - started_).count();
+    clock.account->open.store((static_cast<uint64_t>(std::max<int64_t>(since_start, 0)) << OPEN_SLOT_BITS) |
+                                  static_cast<uint64_t>(clock.slot),
+                              std::memory_order_relaxed);
+    if (closed_slot >= 0) {
+        auto& counter = clock.account->ns[static_cast<size_t>(closed_slot) / 2][static_cast<size_t>(closed_slot) % 2];
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - closed_since).count();
+        counter.store(counter.load(std::memory_order_relaxed) + static_cast<uint64_t>(elapsed),
+                      std::memory_order_release);
+    }
+}
+
+void FlowControl::untrack() {
+    ThreadClock& clock = this_thread_clock();
+    if (clock.epoch != epoch_ || clock.slot < 0) {
+        return;
+    }
+    track(PipelineStage::Read, StageActivity::Busy);  // Closes the open interval
+    clock.slot = -1;
+    clock.account->open.store(NO_OPEN_INTERVAL, std::memory_order_relaxed);
+}
+
+StageTiming FlowControl::timing(PipelineStage stage) const {
+    std::lock_guard<std::mutex> lock(accounts_mutex_);
+    StageTiming timing;
+    for (const auto& account : accounts_) {
+        const auto& ns = account.ns[stage_index(stage)];
+        timing.busy_ns += ns[static_cast<size_t>(StageActivity::Busy)].load(std::memory_order_relaxed);
+        timing.blocked_ns += ns[static_cast<size_t>(StageActivity::Blocked)].load(std::memory_order_relaxed);
+    }
+    return timing;
+}
+
+std::vector<ThreadTiming> FlowControl::thread_timings() const {
+    std::lock_guard<std::mutex> lock(accounts_mutex_);
+    std::vector<ThreadTiming> timings;
+    timings.reserve(accounts_.size());
+    for (const auto& account : accounts_) {
+        ThreadTiming& timing = timings.emplace_back();
+        timing.thread = account.thread;
+        for (auto stage : kStages) {
+            const auto& ns = account.ns[stage_index(stage)];
+            timing.stages[stage_index(stage)] = {
+                .busy_ns = ns[static_cast<size_t>(StageActivity::Busy)].load(std::memory_order_relaxed),
+                .blocked_ns = ns[static_cast<size_t>(StageActivity::Blocked)].load(std::memory_order_relaxed)};
+        }
+    }
+    return timings;
+}
+
+PipelineActivity FlowControl::activity() const {
+    PipelineActivity activity;
+    const auto now_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started_).count());
+    {
+        std::lock_guard<std::mutex> lock(accounts_mutex_);
+        for (const auto& account : accounts_) {
+            for (auto stage : kStages) {
+                const auto& ns = account.ns[stage_index(stage)];
+                StageTiming& timing = activity.stages[stage_index(stage)];
+                timing.busy_ns += ns[static_cast<size_t>(StageActivity::Busy)].load(std::memory_order_acquire);
+                timing.blocked_ns += ns[static_cast<size_t>(StageActivity::Blocked)].load(std::memory_order_acquire);
+            }
+            // The time of the current state only reaches the counters at the thread's next track()
+            const uint64_t open = account.open.load(std::memory_order_relaxed);
+            const uint64_t slot = open & ((uint64_t{1} << OPEN_SLOT_BITS) - 1);
+            if (slot == NO_OPEN_INTERVAL) {
+                continue;
+            }
+            const uint64_t since = open >> OPEN_SLOT_BITS;
+            const uint64_t elapsed = now_ns > since ? now_ns - since : 0;
+            StageTiming& timing = activity.stages[slot / 2];
+            (slot % 2 == static_cast<uint64_t>(StageActivity::Busy) ? timing.busy_ns : timing.blocked_ns) += elapsed;
+        }
+    }
+    activity.read_queue_items = occupancy(PipelineStage::Read).items_in_flight;
+    activity.bytes_in_flight = bytes_in_flight();
+    activity.capacity = capacity_;
+    return activity;
+}
+
+void FlowControl::sample_queues() {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(samples_mutex_);
+    if (now < next_sample_) {
+        return;
+    }
+    if (samples_.size() == MAX_QUEUE_SAMPLES) {
+        // Keep every other sample and halve the rate from now on
+        for (size_t i = 0; i < samples_.size() / 2; i++) {
+            samples_[i] = samples_[2 * i];
+        }
+        samples_.resize(samples_.size() / 2);
+        sample_interval_ *= 2;
+    }
+    samples_.push_back(
+        {.elapsed_ms = static_cast<uint64_t>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(now - started_).count()),
+         .read_items = stages_[stage_index(PipelineStage::Read)].items_in_flight.load(std::memory_order_relaxed),
+         .parse_items = stages_[stage_index(PipelineStage::Parse)].items_in_flight.load(std::memory_order_relaxed),
+         .bytes_in_flight = bytes_in_flight_.load(std::memory_order_relaxed)});
+    next_sample_ = now + sample_interval_;
+}
+
+std::vector<QueueSample> FlowControl::queue_samples() const {
+    std::lock_guard<std::mutex> lock(samples_mutex_);
+    return samples_;
+}
+
+void FlowControl::cancel() {
+    cancelled_.store(true, std::memory_order_release);
+    wake_waiters();
+}
+
+void FlowControl::reset() {
+    bytes_in_flight_.store(0, std::memory_order_relaxed);
+    peak_bytes_in_flight_.store(0, std::memory_order_relaxed);
+    cancelled_.store(false, std::memory_order_relaxed);
+    for (auto& counters : stages_) {
+        counters.items_in_flight.store(0, std::memory_order_relaxed);
+        counters.bytes_in_flight.store(0, std::memory_order_relaxed);
+        counters.peak_bytes.store(0, std::memory_order_relaxed);
+        counters.total_items.store(0, std::memory_order_relaxed);
+        counters.total_bytes.store(0, std::memory_order_relaxed);
+    }
+
+    epoch_ = new_epoch();
+    started_ = std::chrono::steady_clock::now();
+    accounts_.clear();
+    samples_.clear();
+    sample_interval_ = INITIAL_SAMPLE_INTERVAL;
+    next_sample_ = started_;
+}
+
+void FlowControl::log_summary(std::string_view pipeline_name) const {
+    spdlog::info("{} flow control: capacity={:.1f} MB, peak in flight={:.1f} MB", pipeline_name,
+                 static_cast<double>(capacity_) / kBytesPerMB,
+                 static_cast<double>(peak_bytes_in_flight()) / kBytesPerMB);
+    for (auto stage : kStages) {
+        const StageOccupancy occ = occupancy(stage);
+        const StageTiming time = timing(stage);
+        spdlog::info("{} {} stage: items={}, bytes={:.1f} MB, peak queued={:.1f} MB, busy={:.3f} s, blocked={:.3f} s "
+                     "({:.0f}% busy)",
+                     pipeline_name, stage_name(stage), occ.total_items,
+                     static_cast<double>(occ.total_bytes) / kBytesPerMB,
+                     static_cast<double>(occ.peak_bytes) / kBytesPerMB,
+                     static_cast<double>(time.busy_ns) / kNsPerSecond,
+                     static_cast<double>(time.blocked_ns) / kNsPerSecond, busy_percent(time));
+    }
+    for (const ThreadTiming& thread : thread_timings()) {
+        std::string stages;
+        for (auto stage : kStages) {
+            const StageTiming& time = thread.stages[stage_index(stage)];
+            if (time.busy_ns + time.blocked_ns > 0) {
+                stages += std::format(" {} busy={:.3f} s blocked={:.3f} s", stage_name(stage),
+                                      static_cast<double>(time.busy_ns) / kNsPerSecond,
+                                      static_cast<double>(time.blocked_ns) / kNsPerSecond);
+            }
+        }
+        spdlog::info("{} thread {}:{}", pipeline_name, thread.thread, stages);
+    }
+
+    const auto samples = queue_samples();
+    if (!samples.empty()) {
+        uint64_t read_sum = 0;
+        uint64_t read_max = 0;
+        for (const auto& sample : samples) {
+            read_sum += sample.read_items;
+            read_max = std::max(read_max, sample.read_items);
+        }
+        spdlog::info("{} read queue: mean={:.1f} lines, max={} lines over {} samples", pipeline_name,
+                     static_cast<double>(read_sum) / static_cast<double>(samples.size()), read_max, samples.size());
+    }
+}
+
+void FlowControl::wake_waiters() {
+    // Called on every released line, so without a waiter it must not lock. The fences on both sides order the
+    // caller's update and the waiter's registration: either the waiter's predicate sees the update, or this sees
+    // the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    // Taking the lock orders this notification after a waiter's predicate check, so the wakeup cannot be lost
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    cv_.notify_all();
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Stages a line passes through between decompression and insertion into the loader's tables.
+ */
+enum class PipelineStage : uint8_t { Read, Parse, Insert };
+
+/**
+ * @brief Snapshot of how much data currently sits in (and has passed through) one pipeline stage.
+ */
+struct StageOccupancy {
+    uint64_t items_in_flight;  // Lines currently held by the stage
+    uint64_t bytes_in_flight;  // Decompressed bytes of those lines
+    uint64_t peak_bytes;       // Highest bytes_in_flight observed
+    uint64_t total_items;      // Lines that entered the stage so far
+    uint64_t total_bytes;      // Bytes that entered the stage so far
+};
+
+/**
+ * @brief What a pipeline thread is doing: the work of a stage, or waiting for the stage before or after it.
+ */
+enum class StageActivity : uint8_t { Busy, Blocked };
+
+/**
+ * @brief Time threads spent in one stage.
+ */
+struct StageTiming {
+    uint64_t busy_ns = 0;     // Doing the stage's work: decompressing, parsing or inserting
+    uint64_t blocked_ns = 0;  // Waiting on a queue, a parse task or flow-control credits
+};
+
+/**
+ * @brief Time one thread spent in every stage of a load.
+ */
+struct ThreadTiming {
+    uint32_t thread = 0;  // Order in which the thread joined the pipeline
+    std::array<StageTiming, 3> stages{};
+};
+
+/**
+ * @brief Queue depths of a pipeline at one point in time.
+ */
+struct QueueSample {
+    uint64_t elapsed_ms = 0;       // Since the start of the load
+    uint64_t read_items = 0;       // Lines read and waiting for the consumer
+    uint64_t parse_items = 0;      // Lines being parsed
+    uint64_t bytes_in_flight = 0;  // Credits held anywhere in the pipeline
+};
+
+/**
+ * @brief Live activity of a pipeline for the progress UI.
+ */
+struct PipelineActivity {
+    std::array<StageTiming, 3> stages{};  // Summed over the threads of every stage
+    uint64_t read_queue_items = 0;
+    uint64_t bytes_in_flight = 0;
+    uint64_t capacity = 0;
+};
+
+/**
+ * @brief Byte-credit flow control shared by the reader, parser and inserter stages of one load pipeline.
+ *
+ * The reader acquires credits equal to a line's size before queueing it. The credits travel with the line and are
+ * returned with release() once its parsed result has been inserted, so the decompressed data in flight across all
+ * stages stays under one capacity no matter how a dump is laid out. To guarantee progress the reader may always
+ * queue a line while its own queue is empty, which bounds the overshoot to a single line.
+ *
+ * It also accounts where the time of the pipeline threads goes. Every thread tells it with track() which stage it
+ * works in and whether it works or waits, and the time between two calls goes to the state announced by the first.
+ * That costs one clock read per call and no shared writes, so it stays on in release builds.
+ */
+class FlowControl {
+   public:
+    static constexpr uint64_t DEFAULT_CAPACITY = 256ull * 1024 * 1024;  // 256 MB
+
+    /**
+     * @brief Create a flow control with the given budget.
+     * @param capacity_bytes Maximum number of decompressed bytes in flight
+     */
+    explicit FlowControl(uint64_t capacity_bytes = DEFAULT_CAPACITY);
+
+    FlowControl(const FlowControl&) = delete;
+    FlowControl& operator=(const FlowControl&) = delete;
+    FlowControl(FlowControl&&) = delete;
+    FlowControl& operator=(FlowControl&&) = delete;
+
+    /**
+     * @brief Take credits for a line, blocking while the budget is exhausted and the read stage still holds lines.
+     * @param bytes Size of the line in bytes
+     * @return false if the pipeline was cancelled while waiting
+     */
+    bool acquire(uint64_t bytes);
+
+    /**
+     * @brief Return the credits of a line that left the pipeline.
+     * @param bytes Size of the line in bytes
+     */
+    void release(uint64_t bytes);
+
+    /** @brief Whether the credits in flight have reached the capacity. */
+    [[nodiscard]] bool exhausted() const;
+
+    /** @brief Record a line entering a stage. */
+    void enter(PipelineStage stage, uint64_t bytes);
+    /** @brief Record a line leaving a stage. */
+    void leave(PipelineStage stage, uint64_t bytes);
+
+    /** @brief Occupancy metrics of one stage. */
+    [[nodiscard]] StageOccupancy occupancy(PipelineStage stage) const;
+    /** @brief Credits currently held by lines anywhere in the pipeline. */
+    [[nodiscard]] uint64_t bytes_in_flight() const;
+    /** @brief Highest number of credits held at once since the last reset. */
+    [[nodiscard]] uint64_t peak_bytes_in_flight() const;
+    /** @brief Configured budget in bytes. */
+    [[nodiscard]] uint64_t capacity() const;
+
+    /**
+     * @brief Attribute the calling thread's time from now on to an activity in a stage.
+     *
+     * The time since the thread's previous track() call is added to the activity that call announced.
+     */
+    void track(PipelineStage stage, StageActivity activity);
+    /** @brief Stop attributing the calling thread's time, e.g. before it leaves the pipeline. */
+    void untrack();
+
+    /** @brief Time of all threads in one stage. */
+    [[nodiscard]] StageTiming timing(PipelineStage stage) const;
+    /** @brief Time of every thread that took part in the load, in the order they joined. */
+    [[nodiscard]] std::vector<ThreadTiming> thread_timings() const;
+    /**
+     * @brief Stage timing and queue occupancy right now, for the progress UI.
+     *
+     * Includes the time of the intervals still open, so a thread blocked for a long time shows as blocked before it
+     * wakes up.
+     */
+    [[nodiscard]] PipelineActivity activity() const;
+
+    /**
+     * @brief Record the queue depths if the sampling interval has passed since the last sample.
+     *
+     * The interval doubles whenever the sample buffer is full, so a load of any length keeps a bounded number of
+     * evenly spaced samples.
+     */
+    void sample_queues();
+    /** @brief Queue depth samples of the load so far. */
+    [[nodiscard]] std::vector<QueueSample> queue_samples() const;
+
+    /** @brief Wake up and fail every blocked acquire() until the next reset(). */
+    void cancel();
+    /** @brief Clear all counters before a new load. Must not race with any other member call. */
+    void reset();
+
+    /** @brief Log per-stage occupancy, busy and blocked time, per-thread time and queue depth. */
+    void log_summary(std::string_view pipeline_name) const;
+
+   private:
+    static constexpr size_t MAX_QUEUE_SAMPLES = 1024;
+    static constexpr std::chrono::milliseconds INITIAL_SAMPLE_INTERVAL{50};
+    static constexpr uint64_t OPEN_SLOT_BITS = 3;
+    static constexpr uint64_t NO_OPEN_INTERVAL = 7;  // Slot bits of ThreadAccount::open while nothing is timed
+
+    // Nanoseconds per stage and activity of one thread. Only that thread writes them, so plain loads and stores
+    // suffice and readers may see a slightly stale value.
+    struct ThreadAccount {
+        uint32_t thread = 0;
+        std::array<std::array<std::atomic<uint64_t>, 2>, 3> ns{};
+        // Interval being timed, so activity() can count it before it closes: its start in nanoseconds since
+        // started_ above OPEN_SLOT_BITS and its slot below, in one word so a reader never mixes two intervals
+        std::atomic<uint64_t> open{NO_OPEN_INTERVAL};
+    };
+
+    // Per-thread state of track(), see this_thread_clock()
+    struct ThreadClock {
+        uint64_t epoch = 0;  // Load the account belongs to
+        ThreadAccount* account = nullptr;
+        int slot = -1;  // Stage * 2 + activity being timed, -1 if none
+        std::chrono::steady_clock::time_point since;
+    };
+
+    struct StageCounters {
+        std::atomic<uint64_t> items_in_flight{0};
+        std::atomic<uint64_t> bytes_in_flight{0};
+        std::atomic<uint64_t> peak_bytes{0};
+        std::atomic<uint64_t> total_items{0};
+        std::atomic<uint64_t> total_bytes{0};
+    };
+
+    uint64_t capacity_;
+    std::atomic<uint64_t> bytes_in_flight_{0};
+    std::atomic<uint64_t> peak_bytes_in_flight_{0};
+    std::atomic<bool> cancelled_{false};
+    std::array<StageCounters, 3> stages_;
+
+    // Only used to put the reader to sleep while the budget is exhausted
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<uint32_t> waiters_{0};  // Threads in or about to enter cv_.wait(), see wake_waiters()
+
+    // Time accounting, the epoch changes on every reset() so threads drop accounts of earlier loads
+    uint64_t epoch_;
+    std::chrono::steady_clock::time_point started_;
+    std::deque<ThreadAccount> accounts_;  // Stable addresses for the threads' cached pointers
+    mutable std::mutex accounts_mutex_;
+
+    // Queue depth samples, only written by the consumer thread
+    std::vector<QueueSample> samples_;
+    std::chrono::steady_clock::duration sample_interval_{INITIAL_SAMPLE_INTERVAL};
+    std::chrono::steady_clock::time_point next_sample_;
+    mutable std::mutex samples_mutex_;
+
+    /** @brief Notify a blocked acquire() without losing the wakeup. */
+    void wake_waiters();
+
+    /** @brief The calling thread's track() state. */
+    static ThreadClock& this_thread_clock();
+    /** @brief The calling thread's account in this load, created on its first track(). */
+    ThreadClock& clock_for_this_load(std::chrono::steady_clock::time_point now);
+};
@@ -60,25 +60,24 @@ void LinkLoader::load_pagelinks_table(const WikiFile& file, const PageLoader& pa
     init_reader(file);
     auto& reader = *this->reader_;
 
-    auto start_time = std::chrono::steady_clock::now();
-    auto last_time = start_time;
+    ProgressReporter progress(refresh_rate);
 
     parse_insert_lines(
         reader, parse_line,
         [&](const auto& links) {
             insert_links(links, page_loader, linktarget_loader);
-            update_progress(links_.size(), progress_callback, reader, start_time, last_time, refresh_rate);
+            update_progress(links_.size(), progress_callback, reader, progress);
         },
         [&](const auto& first_links) {
-            uint64_t num_links = estimated_number_of_items(file.data_path, first_links.size());
+            uint64_t num_links = estimated_number_of_items(file, first_links.size());
             links_.reserve(num_links);
-            insert_links(first_links, page_loader, linktarget_loader);
         });
 
-    update_progress(links_.size(), progress_callback, reader, start_time, last_time, refresh_rate, true);
+    update_progress(links_.size(), progress_callback, reader, progress, true);
 
     spdlog::info("LinkLoader stats: parsed={}, inserted={}, misses(from_id)={}, misses(link_target_id)={}",
                  total_links_parsed_, links_inserted_, page_from_id_miss_, link_target_id_miss_);
+    flow_.log_summary("LinkLoader");
 }
 
 void LinkLoader::destroy_links() {
@@ -5,6 +5,7 @@
 #include "DataLoaderBase.h"
 #include "LinkTargetLoader.h"
 #include "PageLoader.h"
+#include "Utils/MemoryFootprint.h"
 
 // These are indexes into the pages vector, not Wikipedia page ids
 struct Link {
@@ -46,6 +47,10 @@ class LinkLoader : public DataLoaderBase {
     [[nodiscard]] size_t get_link_count() const {
         return links_.size();
     }
+    /** @brief Footprint of the resolved links. */
+    [[nodiscard]] std::vector<StructureMemory> memory_usage() const {
+        return {{.name = "links", .elements = links_.size(), .bytes = MemoryFootprint::vector_bytes(links_)}};
+    }
 
     // Destroy links when no longer needed
     /** @brief Free stored links to reclaim memory after graph construction. */
@@ -49,8 +49,7 @@ void LinkTargetLoader::load_linktarget_table(const WikiFile& file, const PageLoa
     init_reader(file);
     auto& reader = *this->reader_;
 
-    auto start_time = std::chrono::steady_clock::now();
-    auto last_time = start_time;
+    ProgressReporter progress(refresh_rate);
 
     std::string line;
 
@@ -58,13 +57,14 @@ void LinkTargetLoader::load_linktarget_table(const WikiFile& file, const PageLoa
 
     parse_insert_lines(reader, parse_line, [&](const auto& result) {
         insert_linktargets(result, page_loader);
-        update_progress(linktarget_map_->size(), progress_callback, reader, start_time, last_time, refresh_rate);
+        update_progress(linktarget_map_->size(), progress_callback, reader, progress);
     });
 
-    update_progress(linktarget_map_->size(), progress_callback, reader, start_time, last_time, refresh_rate, true);
+    update_progress(linktarget_map_->size(), progress_callback, reader, progress, true);
 
     spdlog::info("LinkTargetLoader stats: parsed={}, mapped={}, title_misses={}", total_linktargets_parsed_,
                  linktargets_mapped_, title_not_found_in_pages_);
+    flow_.log_summary("LinkTargetLoader");
 }
 
 bool LinkTargetLoader::find_page_index_by_linktarget_id(uint64_t lt_id, uint32_t& index) const {
@@ -5,6 +5,7 @@
 #include "DataLoaderBase.h"
 #include "PageLoader.h"
 #include "Utils/Hashmap.h"
+#include "Utils/MemoryFootprint.h"
 
 /**
  * @brief Loads linktarget table mapping IDs to page indices.
@@ -54,4 +55,9 @@ class LinkTargetLoader : public DataLoaderBase {
     size_t get_linktarget_count() const {
         return linktarget_map_ ? linktarget_map_->size() : 0;
     }
+
+    /** @brief Footprint of the linktarget map, empty once it was destroyed. */
+    [[nodiscard]] std::vector<StructureMemory> memory_usage() const {
+        return {MemoryFootprint::table("linktarget_map", linktarget_map_.get())};
+    }
 };
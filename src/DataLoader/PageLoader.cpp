@@ -55,25 +55,24 @@ void PageLoader::load_page_table(const WikiFile& file, const ProgressCallback& p
     }
     auto& reader = this->reader_;
 
-    auto start_time = std::chrono::steady_clock::now();
-    auto last_time = start_time;
+    ProgressReporter progress(refresh_rate);
 
     parse_insert_lines(
         *reader, parse_line,
         [&](const auto& result) {
             insert_pages(result);
-            update_progress(pages_.size(), progress_callback, *reader, start_time, last_time, refresh_rate);
+            update_progress(pages_.size(), progress_callback, *reader, progress);
         },
         [&](const auto& first_result) {
-            uint64_t num_pages = estimated_number_of_items(file.data_path, first_result.size());
+            uint64_t num_pages = estimated_number_of_items(file, first_result.size());
 
             pages_.reserve(num_pages);
             page_id_to_index_->reserve(num_pages);
             page_title_to_index_->reserve(num_pages);
-            insert_pages(first_result);
         });
 
-    update_progress(pages_.size(), progress_callback, *reader, start_time, last_time, refresh_rate, true);
+    update_progress(pages_.size(), progress_callback, *reader, progress, true);
+    flow_.log_summary("PageLoader");
 
     // The page vector will be used through the lifetime of the program,
     // so it's better to shrink it to optimize memory usage.
@@ -102,6 +101,17 @@ bool PageLoader::find_page_index_by_title(const std::string& title, uint32_t& in
     return false;
 }
 
+std::vector<StructureMemory> PageLoader::memory_usage() const {
+    uint64_t title_bytes = 0;
+    for (const Page& page : pages_) {
+        title_bytes += MemoryFootprint::string_bytes(page.page_title);
+    }
+    return {{.name = "pages", .elements = pages_.size(), .bytes = MemoryFootprint::vector_bytes(pages_) + title_bytes},
+            MemoryFootprint::table("page_id_to_index", page_id_to_index_.get()),
+            MemoryFootprint::table("page_title_to_index", page_title_to_index_.get()),
+            MemoryFootprint::table("redirects", redirects_.get())};
+}
+
 void PageLoader::destroy_id_lookup() {
     if (page_id_to_index_) {
         spdlog::debug("Destroying page ID lookup map to free memory");
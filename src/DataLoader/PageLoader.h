@@ -6,6 +6,7 @@
 #include "DataLoaderBase.h"
 #include "UI/UIBase.h"
 #include "Utils/Hashmap.h"
+#include "Utils/MemoryFootprint.h"
 
 struct Page {
     std::string page_title;
@@ -79,4 +80,7 @@ class PageLoader : public DataLoaderBase {
     bool has_title_lookup() const {
         return page_title_to_index_ != nullptr;
     }
+
+    /** @brief Footprint of the pages and of the lookup maps that still exist. */
+    [[nodiscard]] std::vector<StructureMemory> memory_usage() const;
 };
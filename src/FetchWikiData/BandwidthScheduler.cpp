@@ -0,0 +1,56 @@
+#include "BandwidthScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+// Bytes may run ahead of the rate limit by this much, so short bursts are not paced chunk by chunk
+constexpr std::chrono::milliseconds kBurst{250};
+}  // namespace
+
+BandwidthScheduler::Connection::~Connection() {
+    if (scheduler_ != nullptr) {
+        scheduler_->release();
+    }
+}
+
+BandwidthScheduler::BandwidthScheduler(unsigned int connections, uint64_t bytes_per_second)
+    : connections_(std::max(connections, 1U)), bytes_per_second_(bytes_per_second), free_(connections_) {}
+
+BandwidthScheduler::Connection BandwidthScheduler::acquire(unsigned int priority) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_[priority]++;
+    slot_freed_.wait(lock, [&] { return free_ > 0 && waiting_.begin()->first == priority; });
+    if (--waiting_[priority] == 0) {
+        waiting_.erase(priority);
+    }
+    free_--;
+    lock.unlock();
+    // Another slot may be free for the next waiter
+    slot_freed_.notify_all();
+    return Connection(this);
+}
+
+void BandwidthScheduler::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_++;
+    }
+    slot_freed_.notify_all();
+}
+
+void BandwidthScheduler::throttle(uint64_t bytes) {
+    if (bytes_per_second_ == 0) {
+        return;
+    }
+    const auto cost = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(bytes) / static_cast<double>(bytes_per_second_)));
+    std::chrono::steady_clock::time_point wake;
+    {
+        std::lock_guard<std::mutex> lock(rate_mutex_);
+        const auto now = std::chrono::steady_clock::now();
+        next_send_ = std::max(next_send_, now) + cost;
+        wake = next_send_ - kBurst;
+    }
+    std::this_thread::sleep_until(wake);
+}
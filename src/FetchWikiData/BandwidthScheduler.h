@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+/**
+ * @brief Shares the connections and bandwidth of the running downloads by priority.
+ *
+ * Every connection of every download holds a slot while it transfers one bounded slice of its segment, and asks
+ * for a slot again for the next slice. Free slots go to the waiting download with the lowest
+ * priority value, so the file the loader needs first takes over connections within a slice even when less urgent
+ * files started first, and its slots pass to the next file as it finishes. An optional rate limit paces the bytes
+ * received over all connections.
+ */
+class BandwidthScheduler {
+   public:
+    /**
+     * @brief A connection slot, released when destroyed.
+     */
+    class Connection {
+       public:
+        Connection(Connection&& other) noexcept : scheduler_(other.scheduler_) {
+            other.scheduler_ = nullptr;
+        }
+        Connection& operator=(Connection&&) = delete;
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+        ~Connection();
+
+       private:
+        friend class BandwidthScheduler;
+        explicit Connection(BandwidthScheduler* scheduler) : scheduler_(scheduler) {}
+
+        BandwidthScheduler* scheduler_;
+    };
+
+    /**
+     * @param connections Connections open at once over all downloads
+     * @param bytes_per_second Rate limit over all downloads, 0 for none
+     */
+    BandwidthScheduler(unsigned int connections, uint64_t bytes_per_second);
+
+    /**
+     * @brief Block until a connection slot is free and no more urgent download is waiting for one.
+     * @param priority Lower values are served first
+     */
+    Connection acquire(unsigned int priority);
+
+    /**
+     * @brief Account for received bytes, sleeping as long as the rate limit requires.
+     *
+     * Called from the transfer callback, so sleeping stalls the connection and the server slows down with it.
+     */
+    void throttle(uint64_t bytes);
+
+    [[nodiscard]] unsigned int connections() const {
+        return connections_;
+    }
+
+   private:
+    void release();
+
+    unsigned int connections_;
+    uint64_t bytes_per_second_;
+
+    std::mutex mutex_;
+    std::condition_variable slot_freed_;
+    unsigned int free_;
+    std::map<unsigned int, unsigned int> waiting_;  // Priority -> connections waiting for a slot
+
+    std::mutex rate_mutex_;
+    std::chrono::steady_clock::time_point next_send_{};  // When the bytes accounted so far are paid off
+};
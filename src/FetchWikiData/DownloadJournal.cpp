@@ -0,0 +1,129 @@
+#include "DownloadJournal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+constexpr const char* kJournalSuffix = ".download";
+constexpr const char* kJournalHeader = "wikigraph-download 1";
+}  // namespace
+
+DownloadJournal::DownloadJournal(std::filesystem::path output, std::string url, uint64_t size, uint64_t slice)
+    : output_(std::move(output)), url_(std::move(url)), size_(size) {
+    slice = std::max<uint64_t>(slice, 1);
+    for (uint64_t begin = 0; begin < size; begin += slice) {
+        segments_.push_back({.begin = begin, .end = std::min(begin + slice, size), .received = 0});
+    }
+}
+
+std::optional<DownloadJournal> DownloadJournal::load(const std::filesystem::path& output, const std::string& url,
+                                                     uint64_t size) {
+    std::ifstream file(path_for(output));
+    std::string line;
+    if (!file || !std::getline(file, line) || line != kJournalHeader) {
+        return std::nullopt;
+    }
+
+    DownloadJournal journal;
+    journal.output_ = output;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "url") {
+            fields >> journal.url_;
+        } else if (key == "size") {
+            fields >> journal.size_;
+        } else if (key == "segment") {
+            DownloadSegment segment{};
+            fields >> segment.begin >> segment.end >> segment.received;
+            const uint64_t expected_begin = journal.segments_.empty() ? 0 : journal.segments_.back().end;
+            if (!fields || segment.begin != expected_begin || segment.begin > segment.end ||
+                segment.received > segment.end - segment.begin) {
+                spdlog::warn("Ignoring corrupt download journal {}", path_for(output).string());
+                return std::nullopt;
+            }
+            journal.segments_.push_back(segment);
+        }
+    }
+
+    if (journal.url_ != url || journal.size_ != size || journal.segments_.empty() ||
+        journal.segments_.back().end != size) {
+        spdlog::info("Download journal of {} is for another file, starting over", output.string());
+        return std::nullopt;
+    }
+    return journal;
+}
+
+std::filesystem::path DownloadJournal::path_for(const std::filesystem::path& output) {
+    std::filesystem::path path = output;
+    path += kJournalSuffix;
+    return path;
+}
+
+size_t DownloadJournal::segment_at(uint64_t offset) const {
+    const auto after = std::ranges::upper_bound(segments_, offset, {}, &DownloadSegment::begin);
+    return static_cast<size_t>(std::distance(segments_.begin(), after)) - 1;
+}
+
+void DownloadJournal::add_received(size_t index, uint64_t bytes) {
+    std::atomic_ref<uint64_t>(segments_[index].received).fetch_add(bytes, std::memory_order_relaxed);
+}
+
+uint64_t DownloadJournal::received(size_t index) {
+    return std::atomic_ref<uint64_t>(segments_[index].received).load(std::memory_order_relaxed);
+}
+
+uint64_t DownloadJournal::received() {
+    uint64_t total = 0;
+    for (size_t i = 0; i < segments_.size(); i++) {
+        total += received(i);
+    }
+    return total;
+}
+
+bool DownloadJournal::save(const std::function<bool()>& sync_data) {
+    // Counts first, then the data they cover is synced, so bytes counted later are not claimed before they are durable
+    std::vector<uint64_t> counts(segments_.size());
+    for (size_t i = 0; i < segments_.size(); i++) {
+        counts[i] = received(i);
+    }
+    if (sync_data && !sync_data()) {
+        return false;
+    }
+
+    const std::filesystem::path path = path_for(output_);
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        file << kJournalHeader << '\n' << "url " << url_ << '\n' << "size " << size_ << '\n';
+        for (size_t i = 0; i < segments_.size(); i++) {
+            file << "segment " << segments_[i].begin << ' ' << segments_[i].end << ' ' << counts[i] << '\n';
+        }
+        if (!file) {
+            spdlog::warn("Failed to write download journal {}", tmp_path.string());
+            return false;
+        }
+    }
+    // Rename so that an interruption never leaves a half-written journal behind
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        spdlog::warn("Failed to update download journal {}: {}", path.string(), ec.message());
+        return false;
+    }
+    return true;
+}
+
+void DownloadJournal::remove() const {
+    std::error_code ec;
+    std::filesystem::remove(path_for(output_), ec);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Byte range `[begin, end)` of a download, fetched over one connection at a time.
+ */
+struct DownloadSegment {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t received;  // Bytes from begin already written to disk, updated concurrently through std::atomic_ref
+};
+
+/**
+ * @brief Progress of a ranged download, persisted next to the output file so an interrupted download can resume.
+ *
+ * The journal lives in `<output>.download` while the download is incomplete and is removed once every segment has
+ * been received, so its presence also marks the output file as partial. Segments may complete in any order, each
+ * records how much of it was received.
+ */
+class DownloadJournal {
+   public:
+    /**
+     * @brief Split a new download of `size` bytes into consecutive segments of `slice` bytes, the last one shorter.
+     */
+    DownloadJournal(std::filesystem::path output, std::string url, uint64_t size, uint64_t slice);
+
+    /**
+     * @brief Load the journal of an interrupted download, if it was for the same URL and size.
+     */
+    static std::optional<DownloadJournal> load(const std::filesystem::path& output, const std::string& url,
+                                               uint64_t size);
+
+    /** @brief Journal file of an output file. */
+    static std::filesystem::path path_for(const std::filesystem::path& output);
+
+    [[nodiscard]] std::vector<DownloadSegment>& segments() {
+        return segments_;
+    }
+    [[nodiscard]] uint64_t size() const {
+        return size_;
+    }
+
+    /** @brief Index of the segment that contains byte `offset`. */
+    [[nodiscard]] size_t segment_at(uint64_t offset) const;
+
+    /** @brief Record `bytes` more bytes of segment `index` as written, callable from the segment's thread. */
+    void add_received(size_t index, uint64_t bytes);
+    /** @brief Bytes of segment `index` written so far. */
+    uint64_t received(size_t index);
+    /** @brief Bytes of all segments written so far. */
+    uint64_t received();
+
+    /**
+     * @brief Atomically replace the journal file with the current progress.
+     * @param sync_data Called after the progress was read and before it is saved, to make the counted bytes durable
+     *                  first (DumpWriter::sync). Nothing is saved if it returns false, so the journal never counts
+     *                  bytes that a crash could still lose.
+     */
+    bool save(const std::function<bool()>& sync_data = {});
+    /** @brief Delete the journal file once the download is complete. */
+    void remove() const;
+
+   private:
+    DownloadJournal() = default;
+
+    std::filesystem::path output_;
+    std::string url_;
+    uint64_t size_ = 0;
+    std::vector<DownloadSegment> segments_;
+};
@@ -2,78 +2,416 @@
 
 #include <cpr/cpr.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
-#include <fstream>
-#include <iostream>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <optional>
 #include <regex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BandwidthScheduler.h"
+#include "DownloadJournal.h"
+#include "DumpChecksum.h"
+#include "DumpWriter.h"
+#include "PartialFileReader.h"
+#include "Utils/ResourceProbe.h"
 
 #include "spdlog/spdlog.h"
 
-void download_file(std::string url, std::string output_filename, std::atomic<UIState::DownloadProgress>& dp,
-                   std::chrono::milliseconds refresh_rate) {
-    auto last_refresh = std::chrono::steady_clock::now();
-    uint64_t last_dlnow = 0;
-
-    cpr::Response r =
-        cpr::Get(cpr::Url{url},
-                 // https://docs.libcpr.org/advanced-usage.html#:~:text=ProgressCallback
-                 cpr::ProgressCallback([&](cpr::cpr_off_t dltotal_, cpr::cpr_off_t dlnow_, cpr::cpr_off_t ultotal,
-                                           cpr::cpr_off_t ulnow, intptr_t userdata) -> bool {
-                     // Unused parameters for upload and userdata
-                     (void)userdata;
-                     (void)ultotal;
-                     (void)ulnow;
-
-                     // Cast cpr_off_t to uint64_t
-                     auto dlnow = static_cast<uint64_t>(dlnow_);
-                     auto dltotal = static_cast<uint64_t>(dltotal_);
-
-                     // This callback is called every time a chunk of data is received, which is very frequent.
-                     // We only want to update the UI every refresh_rate milliseconds.
-                     auto now = std::chrono::steady_clock::now();
-                     std::chrono::duration<double, std::milli> dt = now - last_refresh;
-                     if (dt < refresh_rate || dlnow <= last_dlnow) {
-                         return true;
-                     }
-
-                     last_refresh = now;
-
-                     // Calculate download speed in bytes/s
-                     auto dlspeed = static_cast<uint64_t>((dlnow - last_dlnow) / (dt.count() / 1000.0));
-                     dp.store({.dlnow = dlnow, .dltotal = dltotal, .dlspeed = dlspeed});
-
-                     last_dlnow = dlnow;
-
-                     post_ui_refresh();
-
-                     return true;
-                 }),
-                 // https://docs.libcpr.org/advanced-usage.html#:~:text=WriteCallback
-                 cpr::WriteCallback([&](const std::string_view& data, intptr_t userdata) -> bool {
-                     // Unused parameter userdata
-                     (void)userdata;
-
-                     // Append data to the output file
-                     std::ofstream file(output_filename, std::ios::app | std::ios::binary);
-                     file.write(data.data(), static_cast<std::streamsize>(data.size()));
-                     file.flush();
-
-                     return true;
-                 }));
+namespace {
+constexpr unsigned int kDefaultConnections = 4;
+// Journal segment of a new download and bytes a connection requests per slot, so a more urgent file waits for one
+// slice at most
+constexpr uint64_t kSliceBytes = uint64_t{4} * 1024 * 1024;
+// Slot priority of downloads the loader does not follow, they share the slots equally and yield to followed ones
+constexpr unsigned int kUnfollowedPriority = std::numeric_limits<unsigned int>::max();
+constexpr int kMaxAttempts = 5;
+constexpr std::chrono::seconds kRetryDelay{2};
+constexpr std::chrono::seconds kJournalInterval{1};
+constexpr long kStatusOk = 200;
+constexpr long kStatusPartialContent = 206;
+constexpr long kStatusTooManyRequests = 429;
+constexpr long kStatusServerError = 500;
 
-    if (r.status_code != 200) {
-        spdlog::error("Failed to download file: {}", url);
-        return;
+unsigned int download_connections() {
+    static const unsigned int connections = [] {
+        const char* value = std::getenv("WIKIGRAPH_DOWNLOAD_CONNECTIONS");  // NOLINT(concurrency-mt-unsafe) read once
+        if (value == nullptr || *value == '\0') {
+            return kDefaultConnections;
+        }
+        const unsigned long parsed = std::strtoul(value, nullptr, 10);
+        if (parsed == 0 || parsed > 64) {
+            spdlog::warn("Ignoring invalid value '{}' of WIKIGRAPH_DOWNLOAD_CONNECTIONS", value);
+            return kDefaultConnections;
+        }
+        return static_cast<unsigned int>(parsed);
+    }();
+    return connections;
+}
+
+// Overall download rate limit in bytes per second, 0 for none
+uint64_t download_rate_limit() {
+    const char* value = std::getenv("WIKIGRAPH_DOWNLOAD_RATE");  // NOLINT(concurrency-mt-unsafe) read once
+    if (value == nullptr || *value == '\0') {
+        return 0;
+    }
+    const std::optional<uint64_t> parsed = ResourceProbe::parse_size(value);
+    if (!parsed) {
+        spdlog::warn("Ignoring invalid value '{}' of WIKIGRAPH_DOWNLOAD_RATE", value);
+        return 0;
+    }
+    return *parsed;
+}
+
+// Shared by every download, so WIKIGRAPH_DOWNLOAD_CONNECTIONS caps the connections of all files together. Files loaded
+// while they download get them in loading order, the rate limit applies to all downloads.
+BandwidthScheduler& scheduler() {
+    static BandwidthScheduler scheduler = [] {
+        const uint64_t rate = download_rate_limit();
+        if (rate != 0) {
+            spdlog::info("Limiting downloads to {:.2f} MB/s", static_cast<double>(rate) / (1024 * 1024));
+        }
+        return BandwidthScheduler(download_connections(), rate);
+    }();
+    return scheduler;
+}
+
+struct RemoteFile {
+    uint64_t size;        // Content-Length, 0 if the server did not send one
+    bool accepts_ranges;  // Server advertised "Accept-Ranges: bytes"
+};
+
+std::optional<RemoteFile> probe_remote_file(const std::string& url) {
+    cpr::Response r = cpr::Head(cpr::Url{url});
+    if (r.status_code != kStatusOk) {
+        spdlog::error("HEAD {} failed with status {}: {}", url, r.status_code, r.error.message);
+        return std::nullopt;
+    }
+    RemoteFile remote{.size = 0, .accepts_ranges = false};
+    if (auto it = r.header.find("Content-Length"); it != r.header.end()) {
+        remote.size = std::strtoull(it->second.c_str(), nullptr, 10);
+    }
+    if (auto it = r.header.find("Accept-Ranges"); it != r.header.end()) {
+        remote.accepts_ranges = it->second.find("bytes") != std::string::npos;
+    }
+    return remote;
+}
+
+// Status code of an HTTP status line such as "HTTP/1.1 206 Partial Content", 0 for other header lines
+long parse_status_line(std::string_view header) {
+    if (!header.starts_with("HTTP/")) {
+        return 0;
+    }
+    const size_t space = header.find(' ');
+    return space == std::string_view::npos ? 0 : std::strtol(header.data() + space + 1, nullptr, 10);
+}
+
+// Fetch the missing tail of one segment through writer stream `stream_id`, reconnecting with a fresh Range request
+// after a dropped connection. The tail is requested one slice per connection slot, so the slots keep cycling back to
+// the scheduler. Segments of a journal from an older version may span several slices.
+bool fetch_segment(cpr::Session& session, const std::string& url, DownloadJournal& journal, size_t index,
+                   DumpWriter& writer, size_t stream_id, unsigned int priority) {
+    const DownloadSegment& segment = journal.segments()[index];
+    int attempt = 0;
+    while (true) {
+        const uint64_t offset = segment.begin + journal.received(index);
+        if (offset == segment.end) {
+            return true;
+        }
+        const uint64_t request_end = std::min(segment.end, offset + kSliceBytes);
+
+        long status = 0;  // Status of the last response, redirects send several
+        bool write_failed = false;
+        cpr::Response r;
+        {
+            // Waits while more urgent files use every connection, the slot is given back after the request
+            const BandwidthScheduler::Connection connection = scheduler().acquire(priority);
+            DumpWriter::Stream stream = writer.open_stream(stream_id, offset);
+            session.SetHeader(cpr::Header{{"Range", std::format("bytes={}-{}", offset, request_end - 1)}});
+            session.SetHeaderCallback(
+                cpr::HeaderCallback([&](const std::string_view& header, intptr_t /*userdata*/) -> bool {
+                    if (const long code = parse_status_line(header); code != 0) {
+                        status = code;
+                    }
+                    return true;
+                }));
+            session.SetWriteCallback(
+                cpr::WriteCallback([&](const std::string_view& data, intptr_t /*userdata*/) -> bool {
+                    // Anything but a partial response would write the wrong bytes at this offset
+                    if (status != kStatusPartialContent) {
+                        return false;
+                    }
+                    if (stream.position() + data.size() > request_end || !stream.write(data)) {
+                        write_failed = true;
+                        return false;
+                    }
+                    scheduler().throttle(data.size());
+                    return true;
+                }));
+            r = session.Get();
+            // The journal counts bytes once the writer thread has written them, wait for this connection's share
+            if (!stream.flush()) {
+                write_failed = true;
+            }
+        }
+
+        const uint64_t received_end = segment.begin + journal.received(index);
+        if (received_end == segment.end) {
+            return true;
+        }
+        if (received_end == request_end && !write_failed) {
+            continue;  // Slice complete, ask for a slot for the next one
+        }
+        // Overload and transient server errors are worth another attempt, other responses are not
+        const bool retryable = status == 0 || status == kStatusPartialContent || status == kStatusTooManyRequests ||
+                               status >= kStatusServerError;
+        if (write_failed || !retryable) {
+            spdlog::error("Segment {} of {} failed (status {}), not retrying", index, url, status);
+            return false;
+        }
+        // Only failures in a row without progress count, a long segment may see many dropped connections
+        if (received_end > offset) {
+            attempt = 0;
+        }
+        attempt++;
+        spdlog::warn("Segment {} of {} interrupted at {} bytes (status {}: {}), attempt {}/{}", index, url,
+                     journal.received(index), r.status_code, r.error.message, attempt, kMaxAttempts);
+        if (attempt == kMaxAttempts) {
+            return false;
+        }
+        std::this_thread::sleep_for(kRetryDelay * attempt);
+    }
+}
+
+// Publishes download progress to the UI at most every refresh_rate
+class ProgressPublisher {
+   public:
+    ProgressPublisher(Telemetry<UIState::DownloadProgress>& dp, std::chrono::milliseconds refresh_rate,
+                      uint64_t initial_bytes)
+        : dp_(dp), refresh_rate_(refresh_rate), last_bytes_(initial_bytes) {}
+
+    void update(uint64_t dlnow, uint64_t dltotal) {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> dt = now - last_refresh_;
+        if (dt < refresh_rate_ || dlnow <= last_bytes_) {
+            return;
+        }
+        auto dlspeed = static_cast<uint64_t>(static_cast<double>(dlnow - last_bytes_) / (dt.count() / 1000.0));
+        dp_.store({.dlnow = dlnow, .dltotal = dltotal, .dlspeed = dlspeed});
+        last_refresh_ = now;
+        last_bytes_ = dlnow;
+        post_ui_refresh();
+    }
+
+   private:
+    Telemetry<UIState::DownloadProgress>& dp_;
+    std::chrono::milliseconds refresh_rate_;
+    std::chrono::steady_clock::time_point last_refresh_ = std::chrono::steady_clock::now();
+    uint64_t last_bytes_;
+};
+
+// Everything that consumes the file while it downloads: the checksum and optionally the loader
+struct PrefixFollowers {
+    ChecksumVerifier& verifier;
+    PartialFileReader* live;
+
+    // A buffer the writer thread just wrote, the verifier keeps it to hash the bytes from memory when it can
+    void written(size_t stream, DumpWriter::WrittenBuffer buffer) const {
+        if (live != nullptr) {
+            live->mark_written(buffer.offset(), buffer.data().size());
+        }
+        verifier.add_written(stream, std::move(buffer));
     }
 
-    spdlog::info("Download complete: {}", output_filename);
+    // Bytes kept in the file from an interrupted download
+    void kept(uint64_t offset, uint64_t size) const {
+        verifier.mark_written(offset, size);
+        if (live != nullptr) {
+            live->mark_written(offset, size);
+        }
+    }
+};
+
+// Plain download over one connection, for servers that do not support ranges. Cannot resume.
+bool download_single(const std::string& url, const std::filesystem::path& output, uint64_t size,
+                     const PrefixFollowers& followers, unsigned int priority,
+                     Telemetry<UIState::DownloadProgress>& dp, std::chrono::milliseconds refresh_rate) {
+    // Held for the whole download, a request without ranges cannot be split into slices
+    const BandwidthScheduler::Connection connection = scheduler().acquire(priority);
+    DumpWriter writer(output, size, false, 1, [&](size_t stream, DumpWriter::WrittenBuffer buffer) {
+        followers.written(stream, std::move(buffer));
+    });
+    DumpWriter::Stream stream = writer.open_stream(0, 0);
+    ProgressPublisher progress(dp, refresh_rate, 0);
+
+    long status = 0;  // Status of the last response, redirects send several
+    cpr::Response r = cpr::Get(
+        cpr::Url{url}, cpr::HeaderCallback([&](const std::string_view& header, intptr_t /*userdata*/) -> bool {
+            if (const long code = parse_status_line(header); code != 0) {
+                status = code;
+            }
+            return true;
+        }),
+        cpr::WriteCallback([&](const std::string_view& data, intptr_t /*userdata*/) -> bool {
+            // An error page must not reach the file, the loader or the checksum
+            if (status != kStatusOk || !stream.write(data)) {
+                return false;
+            }
+            scheduler().throttle(data.size());
+            progress.update(stream.position(), std::max(size, stream.position()));
+            return true;
+        }));
+
+    if (!stream.flush() || r.status_code != kStatusOk || (size != 0 && stream.position() != size)) {
+        spdlog::error("GET {} failed with status {}: {}", url, r.status_code, r.error.message);
+        return false;
+    }
+    return followers.verifier.finish() != ChecksumVerdict::Mismatch;
+}
+
+// Download over as many connections as the server allows, see download_file()
+bool fetch_file(const std::string& url, const std::string& output_filename, Telemetry<UIState::DownloadProgress>& dp,
+                std::chrono::milliseconds refresh_rate, const std::string& expected_sha1, PartialFileReader* live,
+                unsigned int priority) {
+    const std::filesystem::path output(output_filename);
+    const std::optional<RemoteFile> remote = probe_remote_file(url);
+    if (!remote) {
+        return false;
+    }
+    if (live != nullptr) {
+        live->set_size(remote->size);
+    }
+    // Hashes the file as the written prefix grows
+    ChecksumVerifier verifier(output, remote->size, expected_sha1);
+    const PrefixFollowers followers{.verifier = verifier, .live = live};
+    // Only the loader benefits from getting one file before the others
+    const unsigned int slot_priority = live != nullptr ? priority : kUnfollowedPriority;
+
+    if (!remote->accepts_ranges || remote->size == 0) {
+        spdlog::info("{} does not support ranged requests, downloading over a single connection", url);
+        if (!download_single(url, output, remote->size, followers, slot_priority, dp, refresh_rate)) {
+            spdlog::error("Failed to download file: {}", url);
+            return false;
+        }
+        spdlog::info("Download complete: {}", output_filename);
+        return true;
+    }
+
+    std::optional<DownloadJournal> journal = DownloadJournal::load(output, url, remote->size);
+    const bool resuming = journal.has_value() && std::filesystem::exists(output);
+    if (!resuming) {
+        journal.emplace(output, url, remote->size, kSliceBytes);
+    } else {
+        spdlog::info("Resuming download of {} at {} of {} bytes", output_filename, journal->received(),
+                     remote->size);
+    }
+    journal->save();
+
+    const size_t segments = journal->segments().size();
+    const size_t connections = std::min<size_t>(download_connections(), segments);
+    // A buffer never crosses a segment end, each stream writes one segment at a time
+    DumpWriter writer(output, remote->size, resuming, connections,
+                      [&](size_t stream, DumpWriter::WrittenBuffer buffer) {
+                          journal->add_received(journal->segment_at(buffer.offset()), buffer.data().size());
+                          followers.written(stream, std::move(buffer));
+                      });
+    // Bytes kept from an interrupted download still have to be hashed and loaded
+    for (size_t i = 0; i < segments; i++) {
+        followers.kept(journal->segments()[i].begin, journal->received(i));
+    }
+    ProgressPublisher progress(dp, refresh_rate, journal->received());
+
+    // Every connection takes the next unfinished segment from the front, so the file fills in order and the written
+    // prefix that the loader and the checksum follow grows while the download runs, not only once it completes
+    std::atomic<size_t> next_segment{0};
+    std::atomic<size_t> running{connections};
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> workers;
+    workers.reserve(connections);
+    for (size_t c = 0; c < connections; c++) {
+        workers.emplace_back([&, c] {
+            // Reused by every request of the connection, so a slice can go over the connection the last one left open
+            cpr::Session session;
+            session.SetUrl(cpr::Url{url});
+            while (!failed.load(std::memory_order_relaxed)) {
+                const size_t i = next_segment.fetch_add(1, std::memory_order_relaxed);
+                if (i >= segments) {
+                    break;
+                }
+                if (!fetch_segment(session, url, *journal, i, writer, c, slot_priority)) {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // Publish progress and persist the journal while the segments download, the data it counts reaches the disk first
+    const auto sync_data = [&writer] { return writer.sync(); };
+    auto last_save = std::chrono::steady_clock::now();
+    while (running.load(std::memory_order_acquire) > 0) {
+        std::this_thread::sleep_for(refresh_rate);
+        progress.update(journal->received(), remote->size);
+        if (std::chrono::steady_clock::now() - last_save >= kJournalInterval) {
+            journal->save(sync_data);
+            last_save = std::chrono::steady_clock::now();
+        }
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (failed.load(std::memory_order_relaxed) || journal->received() != remote->size) {
+        journal->save(sync_data);
+        spdlog::error("Failed to download file: {} ({} of {} bytes, will resume on the next attempt)", url,
+                      journal->received(), remote->size);
+        return false;
+    }
+
+    journal->remove();
+    spdlog::info("Download complete: {} over {} connections", output_filename, connections);
+    return verifier.finish() != ChecksumVerdict::Mismatch;
+}
+}  // namespace
+
+std::string dumps_base_url() {
+    static const std::string base_url = [] {
+        const char* value = std::getenv("WIKIGRAPH_DUMPS_URL");  // NOLINT(concurrency-mt-unsafe) read once
+        std::string url = (value == nullptr || *value == '\0') ? "https://dumps.wikimedia.org" : value;
+        while (url.ends_with('/')) {
+            url.pop_back();
+        }
+        return url;
+    }();
+    return base_url;
+}
+
+bool download_file(std::string url, std::string output_filename, Telemetry<UIState::DownloadProgress>& dp,
+                   std::chrono::milliseconds refresh_rate, const std::string& expected_sha1, PartialFileReader* live,
+                   unsigned int priority) {
+    const bool ok = fetch_file(url, output_filename, dp, refresh_rate, expected_sha1, live, priority);
+    // A loader following the download must not wait for bytes that will never come, nor load a corrupt file
+    if (live != nullptr) {
+        if (ok) {
+            live->finish();
+        } else {
+            live->cancel();
+        }
+    }
+    return ok;
 }
 
 DownloadURLs get_urls_from_rss(std::string& wiki_prefix) {
     // Make a request to the RSS feed to get the latest dump date
-    std::string rss_url = std::format("https://dumps.wikimedia.org/{}wiki/latest/{}wiki-latest-page.sql.gz-rss.xml",
+    std::string rss_url = std::format("{}/{}wiki/latest/{}wiki-latest-page.sql.gz-rss.xml", dumps_base_url(),
                                       wiki_prefix, wiki_prefix);
 
     cpr::Response r = cpr::Get(cpr::Url{rss_url});
@@ -91,12 +429,13 @@ DownloadURLs get_urls_from_rss(std::string& wiki_prefix) {
     spdlog::debug("Latest available dump date: {}", date);
 
     DownloadURLs urls;
-    urls.page = std::format("https://dumps.wikimedia.org/{}wiki/{}/{}wiki-{}-page.sql.gz", wiki_prefix, date,
-                            wiki_prefix, date);
-    urls.pagelinks = std::format("https://dumps.wikimedia.org/{}wiki/{}/{}wiki-{}-pagelinks.sql.gz", wiki_prefix, date,
-                                 wiki_prefix, date);
-    urls.linktarget = std::format("https://dumps.wikimedia.org/{}wiki/{}/{}wiki-{}-linktarget.sql.gz", wiki_prefix,
-                                  date, wiki_prefix, date);
+    // All three files share the prefix "<base>/<wiki>/<date>/<wiki>-<date>"
+    const std::string file_prefix =
+        std::format("{}/{}wiki/{}/{}wiki-{}", dumps_base_url(), wiki_prefix, date, wiki_prefix, date);
+    urls.page = file_prefix + "-page.sql.gz";
+    urls.pagelinks = file_prefix + "-pagelinks.sql.gz";
+    urls.linktarget = file_prefix + "-linktarget.sql.gz";
+    urls.sha1sums = file_prefix + "-sha1sums.txt";
     urls.date = date;
 
     spdlog::debug("Download URL page: {}", urls.page);
@@ -1,9 +1,11 @@
-
+#pragma once
 #include <atomic>
 #include <string>
 
 #include "../UI/UIBase.h"
 
+class PartialFileReader;
+
 /**
  * @brief Container for dump URLs of a specific wiki and date.
  */
@@ -12,10 +14,32 @@ struct DownloadURLs {
     std::string page;
     std::string pagelinks;
     std::string linktarget;
+    std::string sha1sums;  // Published SHA-1 checksums of the dump's files
 };
 
-/** @brief Download a file to disk while updating a progress struct. */
-void download_file(std::string url, std::string output_filename, std::atomic<UIState::DownloadProgress>& dp,
-                   std::chrono::milliseconds refresh_rate);
+/**
+ * @brief Base URL of the Wikimedia dumps server, overridable with `WIKIGRAPH_DUMPS_URL` (e.g. a local mirror).
+ */
+std::string dumps_base_url();
+
+/**
+ * @brief Download a file to disk while updating a progress struct.
+ *
+ * When the server supports ranged requests the file is split into 4 MB segments fetched front to back over
+ * `WIKIGRAPH_DOWNLOAD_CONNECTIONS` (default 4) concurrent connections, so the written prefix grows steadily while the
+ * download runs. Progress is journaled next to the file, so an interrupted download resumes where it stopped on the
+ * next call with the same URL.
+ * The connections are shared by all downloads, so the setting caps them over all files, and are handed out one slice
+ * of a few MB at a time (see BandwidthScheduler): downloads that the loader follows (`live`) by priority, the others
+ * equally after them. All downloads share the overall rate limit `WIKIGRAPH_DOWNLOAD_RATE`.
+ * The file is hashed while it downloads and the verdict is recorded next to it (see DumpChecksum).
+ * @param expected_sha1 Published SHA-1 of the file, empty if unknown
+ * @param live Reader that loads the file while it downloads, finished on success and cancelled on failure
+ * @param priority Files with lower values get connections first, only used with `live`
+ * @return true if the whole file was downloaded and did not fail verification
+ */
+bool download_file(std::string url, std::string output_filename, Telemetry<UIState::DownloadProgress>& dp,
+                   std::chrono::milliseconds refresh_rate, const std::string& expected_sha1 = "",
+                   PartialFileReader* live = nullptr, unsigned int priority = 0);
 /** @brief Resolve dump URLs for a wiki prefix by reading the RSS feed. */
 DownloadURLs get_urls_from_rss(std::string& wiki_prefix);
@@ -0,0 +1,253 @@
+#include "DumpChecksum.h"
+
+#include <cpr/cpr.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+constexpr size_t kHashChunkSize = size_t{4} * 1024 * 1024;
+// The listing is a few kilobytes, a server that takes longer than this is treated as having none
+constexpr std::chrono::milliseconds kSha1sumsTimeout{10000};
+
+const char* verdict_name(ChecksumVerdict verdict) {
+    switch (verdict) {
+        case ChecksumVerdict::Ok:
+            return "ok";
+        case ChecksumVerdict::Mismatch:
+            return "mismatch";
+        case ChecksumVerdict::Unverified:
+            return "unverified";
+    }
+    return "unverified";
+}
+}  // namespace
+
+namespace DumpChecksum {
+std::map<std::string, std::string> fetch_sha1sums(const std::string& url) {
+    std::map<std::string, std::string> sums;
+    cpr::Response r = cpr::Get(cpr::Url{url}, cpr::Timeout{kSha1sumsTimeout});
+    if (r.status_code != 200) {
+        spdlog::warn("No checksums available at {} (status {}), downloads will not be verified", url, r.status_code);
+        return sums;
+    }
+
+    // Every line is "<sha1>  <file name>"
+    std::istringstream lines(r.text);
+    std::string sha1;
+    std::string name;
+    while (lines >> sha1 >> name) {
+        sums[name] = sha1;
+    }
+    spdlog::debug("Fetched {} checksums from {}", sums.size(), url);
+    return sums;
+}
+
+std::filesystem::path path_for(const std::filesystem::path& dump) {
+    std::filesystem::path path = dump;
+    path += ".sha1";
+    return path;
+}
+
+void record(const std::filesystem::path& dump, ChecksumVerdict verdict, const std::string& actual,
+            const std::string& expected) {
+    std::ofstream file(path_for(dump), std::ios::trunc);
+    file << verdict_name(verdict) << ' ' << actual << ' ' << (expected.empty() ? "-" : expected) << '\n';
+    if (!file) {
+        spdlog::warn("Failed to record checksum verdict of {}", dump.string());
+    }
+}
+
+std::optional<ChecksumVerdict> load(const std::filesystem::path& dump) {
+    std::ifstream file(path_for(dump));
+    std::string verdict;
+    if (!(file >> verdict)) {
+        return std::nullopt;
+    }
+    for (ChecksumVerdict candidate : {ChecksumVerdict::Ok, ChecksumVerdict::Mismatch, ChecksumVerdict::Unverified}) {
+        if (verdict == verdict_name(candidate)) {
+            return candidate;
+        }
+    }
+    return std::nullopt;
+}
+}  // namespace DumpChecksum
+
+ChecksumVerifier::ChecksumVerifier(std::filesystem::path path, uint64_t size, std::string expected)
+    : path_(std::move(path)), size_(size), expected_(std::move(expected)) {
+    thread_ = std::thread([this] { hash_loop(); });
+}
+
+ChecksumVerifier::~ChecksumVerifier() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+        }
+        changed_.notify_all();
+        thread_.join();
+    }
+}
+
+void ChecksumVerifier::add_written(size_t stream, DumpWriter::WrittenBuffer buffer) {
+    const uint64_t begin = buffer.offset();
+    const uint64_t end = begin + buffer.data().size();
+    if (begin == end) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cancelled_) {
+            return;
+        }
+        if (begin != ready_end_ && waiting_.contains(stream)) {
+            // Holding a second buffer of the stream could leave it none to fill, so these bytes are read back instead
+            add_range(begin, end);
+        } else {
+            if (begin != ready_end_) {
+                waiting_[stream] = begin;
+            }
+            pending_.emplace(begin, Chunk{.end = end, .stream = stream, .buffer = std::move(buffer)});
+            extend_ready();
+        }
+    }
+    changed_.notify_all();
+}
+
+void ChecksumVerifier::mark_written(uint64_t offset, uint64_t size) {
+    if (size == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        add_range(offset, offset + size);
+    }
+    changed_.notify_all();
+}
+
+void ChecksumVerifier::add_range(uint64_t begin, uint64_t end) {
+    // Merge with a range to read back that ends where this one begins, so a segment stays one range as it grows
+    if (auto before = pending_.lower_bound(begin); before != pending_.begin()) {
+        Chunk& previous = std::prev(before)->second;
+        if (previous.end == begin && !previous.buffer) {
+            previous.end = end;
+            extend_ready();
+            return;
+        }
+    }
+    Chunk& chunk = pending_[begin];
+    chunk.end = std::max(chunk.end, end);
+    extend_ready();
+}
+
+void ChecksumVerifier::extend_ready() {
+    for (auto it = pending_.find(ready_end_); it != pending_.end(); it = pending_.find(ready_end_)) {
+        const Chunk& chunk = it->second;
+        if (chunk.buffer) {
+            if (auto waiting = waiting_.find(chunk.stream); waiting != waiting_.end() && waiting->second == it->first) {
+                waiting_.erase(waiting);
+            }
+        }
+        ready_end_ = chunk.end;
+    }
+}
+
+void ChecksumVerifier::hash_loop() {
+    while (true) {
+        uint64_t begin = 0;
+        Chunk chunk{};
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] {
+                return cancelled_ || finished_ || (!pending_.empty() && pending_.begin()->first <= hashed_);
+            });
+            if (cancelled_ || pending_.empty() || pending_.begin()->first > hashed_) {
+                return;
+            }
+            begin = hashed_;
+            chunk = std::move(pending_.begin()->second);
+            pending_.erase(pending_.begin());
+        }
+
+        bool ok = true;
+        if (chunk.buffer) {
+            sha1_.update(chunk.buffer->data().substr(begin - chunk.buffer->offset()));
+            chunk.buffer.reset();  // Back to the writer's pool
+        } else {
+            ok = read_back(begin, chunk.end);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ok) {
+                hashed_ = chunk.end;
+            } else {
+                // The file cannot be verified any more, the held buffers go back to the writer
+                cancelled_ = true;
+                pending_.clear();
+                waiting_.clear();
+            }
+        }
+        changed_.notify_all();
+    }
+}
+
+bool ChecksumVerifier::read_back(uint64_t begin, uint64_t end) {
+    if (!file_.is_open()) {
+        file_.open(path_, std::ios::binary);
+        if (!file_) {
+            spdlog::error("Failed to open {} for hashing", path_.string());
+            return false;
+        }
+    }
+    std::vector<char> chunk(static_cast<size_t>(std::min<uint64_t>(end - begin, kHashChunkSize)));
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(begin));
+    for (uint64_t position = begin; position < end;) {
+        const auto count = static_cast<size_t>(std::min<uint64_t>(end - position, chunk.size()));
+        file_.read(chunk.data(), static_cast<std::streamsize>(count));
+        if (static_cast<size_t>(file_.gcount()) != count) {
+            spdlog::error("Short read of {} at offset {} while hashing", path_.string(), position);
+            return false;
+        }
+        sha1_.update({chunk.data(), count});
+        position += count;
+    }
+    read_back_bytes_ += end - begin;
+    return true;
+}
+
+ChecksumVerdict ChecksumVerifier::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+
+    // A gap or a failed read leaves the file unhashed, which only a missing checksum does not turn into a mismatch
+    const bool complete = !cancelled_ && pending_.empty() && (size_ == 0 || hashed_ == size_);
+    if (complete) {
+        actual_ = sha1_.hex_digest();
+        spdlog::debug("Hashed {}: {} bytes read back from the file, the rest from the download buffers",
+                      path_.string(), read_back_bytes_);
+    }
+
+    ChecksumVerdict verdict = ChecksumVerdict::Unverified;
+    if (!expected_.empty()) {
+        verdict = actual_ == expected_ ? ChecksumVerdict::Ok : ChecksumVerdict::Mismatch;
+    }
+    if (verdict == ChecksumVerdict::Mismatch) {
+        spdlog::error("Checksum mismatch for {}: SHA-1 {}, expected {}", path_.string(), actual_, expected_);
+    } else {
+        spdlog::info("SHA-1 of {}: {} ({})", path_.string(), actual_, verdict_name(verdict));
+    }
+    DumpChecksum::record(path_, verdict, actual_, expected_);
+    return verdict;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "DumpWriter.h"
+#include "Utils/Sha1.h"
+
+/**
+ * @brief Outcome of checking a downloaded dump against Wikimedia's published SHA-1.
+ */
+enum class ChecksumVerdict : uint8_t {
+    Ok,          // Matches the published checksum
+    Mismatch,    // Differs from the published checksum, the file is corrupt
+    Unverified,  // No checksum was published for the file
+};
+
+/**
+ * @brief Published dump checksums and the verdict files recorded next to downloaded dumps.
+ *
+ * The verdict of `<file>` is stored in `<file>.sha1` as "<verdict> <actual sha1> <expected sha1>".
+ */
+namespace DumpChecksum {
+/**
+ * @brief Download a `<wiki>-<date>-sha1sums.txt` listing. Blocks for up to 10 seconds, so not on the UI thread.
+ * @return Map from file name to its lowercase hex SHA-1, empty if unavailable or the server did not answer in time
+ */
+std::map<std::string, std::string> fetch_sha1sums(const std::string& url);
+
+/** @brief Verdict file of a dump. */
+std::filesystem::path path_for(const std::filesystem::path& dump);
+
+/** @brief Record the verdict of a dump. */
+void record(const std::filesystem::path& dump, ChecksumVerdict verdict, const std::string& actual,
+            const std::string& expected);
+
+/** @brief Verdict recorded for a dump, if it was downloaded with verification. */
+std::optional<ChecksumVerdict> load(const std::filesystem::path& dump);
+}  // namespace DumpChecksum
+
+/**
+ * @brief Hashes a download while it is being written, so verifying needs no second pass.
+ *
+ * The writer hands its written buffers over and the verifier hashes them in file order on its own thread, returning
+ * each to the writer's pool once hashed. A buffer beyond a gap waits for the gap to fill, at most one per writer
+ * stream so that every stream keeps a buffer to fill. Further buffers beyond a gap and bytes kept from an interrupted
+ * download are read back from the file when their turn comes.
+ */
+class ChecksumVerifier {
+   public:
+    /**
+     * @param path File being downloaded
+     * @param size Final size, 0 if unknown until finish()
+     * @param expected Published SHA-1 of the file, empty if none
+     */
+    ChecksumVerifier(std::filesystem::path path, uint64_t size, std::string expected);
+    /** @brief Cancels hashing if finish() was not called. */
+    ~ChecksumVerifier();
+
+    ChecksumVerifier(const ChecksumVerifier&) = delete;
+    ChecksumVerifier& operator=(const ChecksumVerifier&) = delete;
+    ChecksumVerifier(ChecksumVerifier&&) = delete;
+    ChecksumVerifier& operator=(ChecksumVerifier&&) = delete;
+
+    /**
+     * @brief Hand over a buffer just written by writer stream `stream`, called on the writer thread
+     * (DumpWriter::WrittenCallback). It is hashed from memory when its turn comes, or released and read back later.
+     */
+    void add_written(size_t stream, DumpWriter::WrittenBuffer buffer);
+
+    /** @brief Record that `[offset, offset + size)` already is in the file, to be read back when its turn comes. */
+    void mark_written(uint64_t offset, uint64_t size);
+
+    /**
+     * @brief Wait for the remaining bytes to be hashed, then record and return the verdict.
+     */
+    ChecksumVerdict finish();
+
+   private:
+    // Written bytes not hashed yet, from a buffer or to be read back from the file
+    struct Chunk {
+        uint64_t end;
+        size_t stream;
+        std::optional<DumpWriter::WrittenBuffer> buffer;
+    };
+
+    void hash_loop();
+    bool read_back(uint64_t begin, uint64_t end);
+    void add_range(uint64_t begin, uint64_t end);
+    void extend_ready();
+
+    std::filesystem::path path_;
+    uint64_t size_;
+    std::string expected_;
+    std::string actual_;
+    std::ifstream file_;  // Only used by thread_, opened on the first read back
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    Sha1 sha1_;                           // Only used by thread_ until finish() joins it
+    uint64_t hashed_ = 0;                 // Guarded by mutex_, bytes hashed from the start of the file
+    uint64_t ready_end_ = 0;              // Guarded by mutex_, end of the bytes written without a gap from the start
+    std::map<uint64_t, Chunk> pending_;   // Guarded by mutex_, written bytes at or beyond hashed_, begin -> chunk
+    std::map<size_t, uint64_t> waiting_;  // Guarded by mutex_, stream -> begin of its buffer beyond ready_end_
+    bool finished_ = false;               // Guarded by mutex_
+    bool cancelled_ = false;              // Guarded by mutex_
+    uint64_t read_back_bytes_ = 0;        // Only used by thread_
+    std::thread thread_;                  // Started last, after every member it uses
+};
@@ -0,0 +1,365 @@
+#include "DumpWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Two buffers per stream let a connection keep filling one while the other is written
+constexpr size_t kBuffersPerStream = 2;
+// Buffers merged into one pwritev call, well below IOV_MAX everywhere
+constexpr size_t kMaxIovecs = 64;
+
+#ifndef _WIN32
+
+bool write_all(int fd, uint64_t offset, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = ::pwrite(fd, data.data(), data.size(), static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            spdlog::error("pwrite failed at offset {}: {}", offset, std::strerror(errno));
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+#endif
+
+struct AlignedDelete {
+    void operator()(char* ptr) const noexcept {
+        ::operator delete[](ptr, std::align_val_t{DumpWriter::BUFFER_ALIGNMENT});
+    }
+};
+}  // namespace
+
+struct DumpWriter::Buffer {
+    std::unique_ptr<char[], AlignedDelete> data{
+        static_cast<char*>(::operator new[](BUFFER_SIZE, std::align_val_t{BUFFER_ALIGNMENT}))};
+    size_t stream = 0;
+    uint64_t offset = 0;
+    size_t size = 0;
+
+    [[nodiscard]] std::string_view view() const {
+        return {data.get(), size};
+    }
+};
+
+// Buffers of one writer, which WrittenBuffers may hold on to after the writer is gone
+class DumpWriter::Pool {
+   public:
+    explicit Pool(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            free_.push_back(buffers_.emplace_back(std::make_unique<Buffer>()).get());
+        }
+    }
+
+    // Blocks until a buffer is free
+    Buffer* acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        buffer_free_.wait(lock, [this] { return !free_.empty(); });
+        Buffer* buffer = free_.back();
+        free_.pop_back();
+        return buffer;
+    }
+
+    void release(Buffer* buffer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer->size = 0;
+            free_.push_back(buffer);
+        }
+        buffer_free_.notify_one();
+    }
+
+   private:
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    std::mutex mutex_;
+    std::condition_variable buffer_free_;  // Signalled when a buffer returns to free_
+    std::vector<Buffer*> free_;            // Guarded by mutex_, buffers ready to be filled
+};
+
+//=============================================================================
+// WRITTEN BUFFER
+//=============================================================================
+
+DumpWriter::WrittenBuffer::WrittenBuffer(std::shared_ptr<Pool> pool, Buffer* buffer)
+    : pool_(std::move(pool)), buffer_(buffer) {}
+
+DumpWriter::WrittenBuffer::WrittenBuffer(WrittenBuffer&& other) noexcept
+    : pool_(std::move(other.pool_)), buffer_(std::exchange(other.buffer_, nullptr)) {}
+
+DumpWriter::WrittenBuffer& DumpWriter::WrittenBuffer::operator=(WrittenBuffer&& other) noexcept {
+    if (this != &other) {
+        if (buffer_ != nullptr) {
+            pool_->release(buffer_);
+        }
+        pool_ = std::move(other.pool_);
+        buffer_ = std::exchange(other.buffer_, nullptr);
+    }
+    return *this;
+}
+
+DumpWriter::WrittenBuffer::~WrittenBuffer() {
+    if (buffer_ != nullptr) {
+        pool_->release(buffer_);
+    }
+}
+
+uint64_t DumpWriter::WrittenBuffer::offset() const {
+    return buffer_->offset;
+}
+
+std::string_view DumpWriter::WrittenBuffer::data() const {
+    return buffer_->view();
+}
+
+//=============================================================================
+// STREAM
+//=============================================================================
+
+DumpWriter::Stream::Stream(DumpWriter& writer, size_t id, uint64_t offset)
+    : writer_(&writer), id_(id), position_(offset) {}
+
+DumpWriter::Stream::Stream(Stream&& other) noexcept
+    : writer_(other.writer_),
+      id_(other.id_),
+      position_(other.position_),
+      buffer_(std::exchange(other.buffer_, nullptr)) {}
+
+DumpWriter::Stream::~Stream() {
+    if (buffer_ != nullptr) {
+        flush();
+    }
+}
+
+bool DumpWriter::Stream::write(std::string_view data) {
+    while (!data.empty()) {
+        if (writer_->failed()) {
+            return false;
+        }
+        if (buffer_ == nullptr) {
+            buffer_ = writer_->pool_->acquire();
+            buffer_->stream = id_;
+            buffer_->offset = position_;
+        }
+        const size_t count = std::min(data.size(), BUFFER_SIZE - buffer_->size);
+        std::memcpy(buffer_->data.get() + buffer_->size, data.data(), count);
+        buffer_->size += count;
+        position_ += count;
+        data.remove_prefix(count);
+        if (buffer_->size == BUFFER_SIZE) {
+            writer_->submit(std::exchange(buffer_, nullptr));
+        }
+    }
+    return true;
+}
+
+bool DumpWriter::Stream::flush() {
+    if (buffer_ != nullptr) {
+        if (buffer_->size > 0) {
+            writer_->submit(buffer_);
+        } else {
+            writer_->pool_->release(buffer_);
+        }
+        buffer_ = nullptr;
+    }
+    return writer_->wait_for_stream(id_);
+}
+
+//=============================================================================
+// WRITER
+//=============================================================================
+
+DumpWriter::DumpWriter(const std::filesystem::path& path, uint64_t size, bool keep_contents, size_t streams,
+                       WrittenCallback on_written)
+    : on_written_(std::move(on_written)),
+      pool_(std::make_shared<Pool>(std::max<size_t>(streams, 1) * kBuffersPerStream)),
+      stream_in_flight_(std::max<size_t>(streams, 1), 0) {
+#ifdef _WIN32
+    if (!keep_contents || !std::filesystem::exists(path)) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).close();
+    }
+    if (size > 0) {
+        std::filesystem::resize_file(path, size);
+    }
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_) {
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+#else
+    const int flags = O_WRONLY | O_CREAT | (keep_contents ? 0 : O_TRUNC);
+    fd_ = ::open(path.c_str(), flags, 0644);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+    }
+    if (size > 0) {
+#ifdef __linux__
+        // Reserve the blocks now, so a full disk fails here rather than halfway through the download
+        const int err = posix_fallocate(fd_, 0, static_cast<off_t>(size));
+        if (err != 0) {
+            spdlog::debug("posix_fallocate failed for {}: {}", path.string(), std::strerror(err));
+        }
+        const bool reserved = err == 0;
+#else
+        const bool reserved = false;
+#endif
+        if (!reserved && ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+            spdlog::warn("Failed to resize {} to {} bytes: {}", path.string(), size, std::strerror(errno));
+        }
+    }
+#endif
+
+    thread_ = std::thread([this] { run(); });
+}
+
+DumpWriter::~DumpWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_one();
+    thread_.join();
+#ifndef _WIN32
+    ::close(fd_);
+#endif
+}
+
+DumpWriter::Stream DumpWriter::open_stream(size_t id, uint64_t offset) {
+    return {*this, id, offset};
+}
+
+bool DumpWriter::sync() {
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(file_mutex_);
+    file_.flush();
+    const bool synced = static_cast<bool>(file_);
+    if (!synced) {
+        spdlog::warn("Failed to flush the download to disk");
+    }
+#else
+#ifdef __linux__
+    const bool synced = ::fdatasync(fd_) == 0;
+#else
+    const bool synced = ::fsync(fd_) == 0;
+#endif
+    if (!synced) {
+        spdlog::warn("Failed to flush the download to disk: {}", std::strerror(errno));
+    }
+#endif
+    return synced && !failed();
+}
+
+void DumpWriter::submit(Buffer* buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(buffer);
+        stream_in_flight_[buffer->stream]++;
+    }
+    work_ready_.notify_one();
+}
+
+bool DumpWriter::wait_for_stream(size_t id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stream_written_.wait(lock, [&] { return stream_in_flight_[id] == 0; });
+    return !failed();
+}
+
+void DumpWriter::run() {
+    std::vector<Buffer*> batch;
+    std::vector<size_t> streams;  // Stream of every buffer in the batch, a buffer handed over may be reused at once
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;  // Stopping and nothing left to write
+            }
+            batch.swap(pending_);
+        }
+
+        // Consecutive buffers of one stream, or of neighbouring segments, are written with a single call
+        std::ranges::sort(batch, {}, &Buffer::offset);
+        for (size_t begin = 0; begin < batch.size();) {
+            size_t end = begin + 1;
+            while (end < batch.size() && end - begin < kMaxIovecs &&
+                   batch[end - 1]->offset + batch[end - 1]->size == batch[end]->offset) {
+                end++;
+            }
+            if (!failed() && !write_run(&batch[begin], end - begin)) {
+                failed_.store(true, std::memory_order_relaxed);
+            }
+            begin = end;
+        }
+
+        // The callback takes the buffers over, so a stream's flush() returns once its bytes have been handed on
+        const bool hand_over = on_written_ && !failed();
+        for (Buffer* buffer : batch) {
+            streams.push_back(buffer->stream);
+            if (hand_over) {
+                on_written_(buffer->stream, WrittenBuffer(pool_, buffer));
+            } else {
+                pool_->release(buffer);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const size_t stream : streams) {
+                stream_in_flight_[stream]--;
+            }
+        }
+        stream_written_.notify_all();
+        batch.clear();
+        streams.clear();
+    }
+}
+
+bool DumpWriter::write_run(Buffer* const* run, size_t count) {
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(file_mutex_);
+    file_.seekp(static_cast<std::streamoff>(run[0]->offset));
+    for (size_t i = 0; i < count; i++) {
+        file_.write(run[i]->data.get(), static_cast<std::streamsize>(run[i]->size));
+    }
+    return static_cast<bool>(file_);
+#else
+    std::array<iovec, kMaxIovecs> iov{};
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        iov[i] = {.iov_base = run[i]->data.get(), .iov_len = run[i]->size};
+        total += run[i]->size;
+    }
+    const ssize_t written = ::pwritev(fd_, iov.data(), static_cast<int>(count), static_cast<off_t>(run[0]->offset));
+    if (written == static_cast<ssize_t>(total)) {
+        return true;
+    }
+
+    // Short write or EINTR, finish buffer by buffer
+    size_t done = written > 0 ? static_cast<size_t>(written) : 0;
+    for (size_t i = 0; i < count; i++) {
+        const size_t skip = std::min(done, run[i]->size);
+        done -= skip;
+        if (!write_all(fd_, run[i]->offset + skip, run[i]->view().substr(skip))) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#endif
+
+/**
+ * @brief Output file of a download, filled by several connections at once through large buffers.
+ *
+ * The file is opened once and preallocated to the full download size. Every connection writes through a Stream,
+ * which copies network chunks into 4 MB aligned buffers from a fixed pool. Full buffers are handed to a background
+ * thread that writes all pending buffers at once, merging buffers that are adjacent in the file into a single
+ * `pwritev`. When every buffer is in use, writers block until one returns to the pool, so memory stays bounded.
+ * A written buffer is handed to the WrittenCallback, which may keep it for a while to use its bytes elsewhere.
+ */
+class DumpWriter {
+    struct Buffer;
+    class Pool;
+
+   public:
+    static constexpr size_t BUFFER_SIZE = size_t{4} * 1024 * 1024;  // 4 MB
+    static constexpr size_t BUFFER_ALIGNMENT = 4096;
+
+    /**
+     * @brief A buffer that has been written to the file, returned to the pool when destroyed.
+     * It keeps the pool alive, so it may outlive the writer. Held buffers are not available to the streams.
+     */
+    class WrittenBuffer {
+       public:
+        WrittenBuffer(WrittenBuffer&& other) noexcept;
+        WrittenBuffer& operator=(WrittenBuffer&& other) noexcept;
+        WrittenBuffer(const WrittenBuffer&) = delete;
+        WrittenBuffer& operator=(const WrittenBuffer&) = delete;
+        ~WrittenBuffer();
+
+        /** @brief File offset of the bytes. */
+        [[nodiscard]] uint64_t offset() const;
+        /** @brief The bytes written. */
+        [[nodiscard]] std::string_view data() const;
+
+       private:
+        friend class DumpWriter;
+        WrittenBuffer(std::shared_ptr<Pool> pool, Buffer* buffer);
+
+        std::shared_ptr<Pool> pool_;
+        Buffer* buffer_;
+    };
+
+    /**
+     * @brief Called on the writer thread after a buffer has been written to the file.
+     * @param stream Id of the stream the bytes came from
+     * @param buffer The buffer, back in the pool as soon as the callback lets go of it
+     */
+    using WrittenCallback = std::function<void(size_t stream, WrittenBuffer buffer)>;
+
+    /**
+     * @brief Sequential writer at increasing offsets, used by one connection.
+     */
+    class Stream {
+       public:
+        Stream(Stream&& other) noexcept;
+        Stream& operator=(Stream&&) = delete;
+        Stream(const Stream&) = delete;
+        Stream& operator=(const Stream&) = delete;
+        ~Stream();
+
+        /**
+         * @brief Append a chunk, blocking while every buffer of the pool is in use.
+         * @return false if an earlier write to the file failed
+         */
+        bool write(std::string_view data);
+
+        /**
+         * @brief Submit the partially filled buffer and wait until everything of this stream has been written.
+         * @return false if a write to the file failed
+         */
+        bool flush();
+
+        /** @brief File offset of the next byte written to this stream. */
+        [[nodiscard]] uint64_t position() const {
+            return position_;
+        }
+
+       private:
+        friend class DumpWriter;
+        Stream(DumpWriter& writer, size_t id, uint64_t offset);
+
+        DumpWriter* writer_;
+        size_t id_;
+        uint64_t position_;
+        Buffer* buffer_ = nullptr;  // Buffer being filled, nullptr until the first write
+    };
+
+    /**
+     * @brief Open the output file and start the writer thread.
+     * @param path File to write
+     * @param size Final size of the file, 0 if unknown
+     * @param keep_contents Keep the bytes already in the file (resuming), otherwise truncate it
+     * @param streams Number of streams that will write concurrently, sizes the buffer pool (two buffers per stream)
+     * @param on_written Optional callback invoked for every written buffer
+     */
+    DumpWriter(const std::filesystem::path& path, uint64_t size, bool keep_contents, size_t streams,
+               WrittenCallback on_written = {});
+    /** @brief Write out everything submitted and stop the writer thread. Streams must be destroyed first. */
+    ~DumpWriter();
+
+    DumpWriter(const DumpWriter&) = delete;
+    DumpWriter& operator=(const DumpWriter&) = delete;
+    DumpWriter(DumpWriter&&) = delete;
+    DumpWriter& operator=(DumpWriter&&) = delete;
+
+    /**
+     * @brief Start writing stream `id` at `offset`. Ids must be below the `streams` passed to the constructor.
+     */
+    Stream open_stream(size_t id, uint64_t offset);
+
+    /**
+     * @brief Flush the bytes written to the file so far to the disk, so a journal may count them.
+     * Buffers still waiting for the writer thread are not included. Callable from any thread.
+     * @return false if the flush or an earlier write failed
+     */
+    bool sync();
+
+    /** @brief Whether a write to the file has failed. */
+    [[nodiscard]] bool failed() const {
+        return failed_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    void submit(Buffer* buffer);
+    bool wait_for_stream(size_t id);
+    void run();
+    bool write_run(Buffer* const* run, size_t count);
+
+    WrittenCallback on_written_;
+    std::shared_ptr<Pool> pool_;  // Shared with the WrittenBuffers
+
+    std::mutex mutex_;
+    std::condition_variable stream_written_;  // Signalled when stream_in_flight_ drops
+    std::condition_variable work_ready_;      // Signalled when pending_ grows or on shutdown
+    std::vector<Buffer*> pending_;            // Full buffers waiting for the writer thread
+    std::vector<size_t> stream_in_flight_;    // Buffers submitted but not yet written, per stream
+    bool stopping_ = false;
+    std::atomic<bool> failed_{false};
+
+#ifdef _WIN32
+    std::mutex file_mutex_;  // The stream's position and buffer are shared by write_run() and sync()
+    std::fstream file_;      // Guarded by file_mutex_
+#else
+    int fd_ = -1;
+#endif
+    std::thread thread_;  // Started last, after every member it uses
+};
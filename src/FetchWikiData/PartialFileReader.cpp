@@ -0,0 +1,108 @@
+#include "PartialFileReader.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+PartialFileReader::PartialFileReader(std::filesystem::path path, uint64_t size)
+    : path_(std::move(path)), size_(size) {}
+
+void PartialFileReader::mark_written(uint64_t offset, uint64_t size) {
+    if (size == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint64_t end = offset + size;
+        if (offset > prefix_) {
+            uint64_t& range_end = ranges_[offset];
+            range_end = std::max(range_end, end);
+            return;
+        }
+        prefix_ = std::max(prefix_, end);
+        // Ranges that arrived earlier may now continue the prefix
+        while (!ranges_.empty() && ranges_.begin()->first <= prefix_) {
+            prefix_ = std::max(prefix_, ranges_.begin()->second);
+            ranges_.erase(ranges_.begin());
+        }
+    }
+    grown_.notify_all();
+}
+
+void PartialFileReader::set_size(uint64_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_ = size;
+}
+
+uint64_t PartialFileReader::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+uint64_t PartialFileReader::written() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return prefix_;
+}
+
+void PartialFileReader::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_ = prefix_;
+        finished_ = true;
+    }
+    grown_.notify_all();
+}
+
+bool PartialFileReader::wait_finished() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    grown_.wait(lock, [this] { return finished_ || cancelled_; });
+    return finished_ && !cancelled_;
+}
+
+void PartialFileReader::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    grown_.notify_all();
+}
+
+bool PartialFileReader::cancelled() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cancelled_;
+}
+
+size_t PartialFileReader::read(char* dst, size_t max) {
+    const uint64_t position = position_.load(std::memory_order_relaxed);
+    uint64_t available = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        grown_.wait(lock, [&] { return cancelled_ || prefix_ > position || (finished_ && position >= size_); });
+        if (cancelled_ || prefix_ <= position) {
+            return 0;
+        }
+        available = prefix_ - position;
+    }
+
+    if (!file_.is_open()) {
+        file_.open(path_, std::ios::binary);
+        if (!file_) {
+            spdlog::error("Failed to open {} for reading", path_.string());
+            cancel();
+            return 0;
+        }
+    }
+    const auto count = static_cast<size_t>(std::min<uint64_t>(available, max));
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(position));
+    file_.read(dst, static_cast<std::streamsize>(count));
+    const auto read = static_cast<size_t>(file_.gcount());
+    if (read != count) {
+        spdlog::error("Short read of {} at offset {}", path_.string(), position);
+        cancel();
+        return 0;
+    }
+    position_.store(position + read, std::memory_order_relaxed);
+    return read;
+}
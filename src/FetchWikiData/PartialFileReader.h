@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+/**
+ * @brief Reads a file front to back while a download is still filling it, possibly out of order.
+ *
+ * The writer reports every range it has written with mark_written(). read() hands out bytes of the contiguous
+ * written prefix and blocks at its end until more arrives, so a consumer sees the file in order as early as
+ * possible. The bytes were just written and are read back from the page cache. Each consumer needs its own reader.
+ */
+class PartialFileReader {
+   public:
+    /**
+     * @param path File being written
+     * @param size Final size of the file, 0 if unknown until finish()
+     */
+    PartialFileReader(std::filesystem::path path, uint64_t size);
+
+    /** @brief Record that `[offset, offset + size)` has been written to the file. */
+    void mark_written(uint64_t offset, uint64_t size);
+
+    /** @brief Set the final size once the server reported it. */
+    void set_size(uint64_t size);
+    /** @brief Final size of the file, 0 while unknown. */
+    [[nodiscard]] uint64_t size();
+
+    /** @brief Bytes written from the start of the file without a gap, what read() can hand out. */
+    [[nodiscard]] uint64_t written();
+
+    /** @brief Record that the download completed, the written prefix is the whole file. */
+    void finish();
+
+    /**
+     * @brief Block until the download completed or was cancelled.
+     * @return true if it completed
+     */
+    bool wait_finished();
+
+    /** @brief Abort the download, every blocked and future read() returns 0. */
+    void cancel();
+
+    /**
+     * @brief Read up to `max` bytes at the current position, blocking until at least one is written.
+     * @return Bytes read, 0 at the end of the file or after cancel()
+     */
+    size_t read(char* dst, size_t max);
+
+    /** @brief Bytes handed out by read() so far, safe to call from other threads. */
+    [[nodiscard]] uint64_t position() const {
+        return position_.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Whether cancel() was called. */
+    [[nodiscard]] bool cancelled();
+
+   private:
+    std::filesystem::path path_;
+    std::ifstream file_;  // Opened on the first read, the writer may not have created the file yet
+    std::atomic<uint64_t> position_{0};
+
+    std::mutex mutex_;
+    std::condition_variable grown_;
+    std::map<uint64_t, uint64_t> ranges_;  // Written ranges beyond the prefix, begin -> end
+    uint64_t prefix_ = 0;                  // Bytes written from the start of the file without a gap
+    uint64_t size_;
+    bool finished_ = false;
+    bool cancelled_ = false;
+};
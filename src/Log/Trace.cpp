@@ -0,0 +1,240 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Utils/PathUtils.h"
+#include "spdlog/spdlog.h"
+
+namespace Trace {
+namespace detail {
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables, concurrency-mt-unsafe) read once at startup
+std::atomic<bool> enabled{std::getenv("WIKIGRAPH_TRACE") != nullptr};
+}  // namespace detail
+
+namespace {
+constexpr size_t DEFAULT_EVENTS_PER_THREAD = size_t{1} << 16;
+
+const auto origin = std::chrono::steady_clock::now();
+
+struct Event {
+    const char* name;
+    const char* category;
+    const char* arg_name;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    uint64_t arg;
+    uint32_t tid;  // A buffer passes to a new thread when its thread exits, so every event names its thread
+};
+
+// Ring of the most recent events of one thread. Only the owning thread writes, head counts every event it recorded.
+struct ThreadBuffer {
+    explicit ThreadBuffer(size_t capacity) : events(capacity) {}
+
+    std::vector<Event> events;
+    std::atomic<uint64_t> head{0};
+    bool in_use = true;  // Guarded by the registry mutex
+};
+
+struct Registry {
+    Registry() {
+        // NOLINTBEGIN(concurrency-mt-unsafe) read once at startup
+        if (const char* value = std::getenv("WIKIGRAPH_TRACE"); value != nullptr && std::string_view(value) != "on") {
+            path = value;
+        }
+        if (const char* value = std::getenv("WIKIGRAPH_TRACE_EVENTS"); value != nullptr) {
+            capacity = std::max<size_t>(std::strtoull(value, nullptr, 10), 1);
+        }
+        // NOLINTEND(concurrency-mt-unsafe)
+    }
+
+    std::mutex mutex;
+    // One buffer per thread that is alive and recorded events. A buffer outlives its thread and is handed to the
+    // next new thread, so per-stage thread pools reuse the same few buffers instead of adding one per thread.
+    std::deque<ThreadBuffer> buffers;
+    std::map<uint32_t, std::string> thread_names;
+    uint32_t next_tid = 1;
+    std::filesystem::path path;  // Empty for logs/trace.json
+    size_t capacity = DEFAULT_EVENTS_PER_THREAD;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// The calling thread's trace id and buffer, the buffer is released for reuse when the thread exits
+struct ThreadSlot {
+    ThreadSlot() = default;
+    ThreadSlot(const ThreadSlot&) = delete;
+    ThreadSlot& operator=(const ThreadSlot&) = delete;
+    ThreadSlot(ThreadSlot&&) = delete;
+    ThreadSlot& operator=(ThreadSlot&&) = delete;
+    ~ThreadSlot() {
+        if (buffer != nullptr) {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            buffer->in_use = false;
+        }
+    }
+
+    uint32_t tid = 0;  // Assigned on the first event or name, guarded by the registry mutex
+    ThreadBuffer* buffer = nullptr;
+};
+
+thread_local ThreadSlot this_thread;
+
+// Requires the registry mutex
+uint32_t assign_tid(Registry& reg) {
+    if (this_thread.tid == 0) {
+        this_thread.tid = reg.next_tid++;
+    }
+    return this_thread.tid;
+}
+
+ThreadBuffer& thread_buffer() {
+    if (this_thread.buffer == nullptr) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        assign_tid(reg);
+        auto unused = std::ranges::find_if(reg.buffers, [](const ThreadBuffer& buffer) { return !buffer.in_use; });
+        if (unused != reg.buffers.end()) {
+            unused->in_use = true;
+            this_thread.buffer = &*unused;
+        } else {
+            this_thread.buffer = &reg.buffers.emplace_back(reg.capacity);
+        }
+    }
+    return *this_thread.buffer;
+}
+
+std::string escape(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+double to_us(uint64_t ns) {
+    return static_cast<double>(ns) / 1000.0;
+}
+}  // namespace
+
+void start(const std::filesystem::path& path) {
+    Registry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.path = path;
+    }
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+}
+
+void record(const char* name, const char* category, uint64_t begin_ns, uint64_t end_ns, const char* arg_name,
+            uint64_t arg) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = thread_buffer();
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % buffer.events.size()] = {.name = name,
+                                                  .category = category,
+                                                  .arg_name = arg_name,
+                                                  .begin_ns = begin_ns,
+                                                  .end_ns = end_ns,
+                                                  .arg = arg,
+                                                  .tid = this_thread.tid};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void set_thread_name(std::string name) {
+    if (!enabled()) {
+        return;
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.thread_names[assign_tid(reg)] = std::move(name);
+}
+
+bool write() {
+    if (!enabled()) {
+        return false;
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const std::filesystem::path path =
+        reg.path.empty() ? PathUtils::get_resource_dir("logs") / "trace.json" : reg.path;
+
+    std::string json = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    size_t event_count = 0;
+    auto append = [&](const std::string& event) {
+        json += (event_count++ == 0 ? "  " : ",\n  ") + event;
+    };
+    for (const auto& [tid, name] : reg.thread_names) {
+        append(std::format(R"({{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, "args": {{"name": "{}"}}}})",
+                           tid, escape(name)));
+    }
+    for (const ThreadBuffer& buffer : reg.buffers) {
+        const size_t capacity = buffer.events.size();
+        const uint64_t end = buffer.head.load(std::memory_order_acquire);
+        const uint64_t begin = end > capacity ? end - capacity : 0;
+        std::vector<Event> events;
+        events.reserve(end - begin);
+        for (uint64_t i = begin; i < end; i++) {
+            events.push_back(buffer.events[i % capacity]);
+        }
+        // Events the thread recorded during the copy may have overwritten the oldest ones we copied. The thread
+        // writes event head_after into its slot before it publishes head_after + 1, so that slot may be torn as well.
+        // A buffer whose thread exited cannot change, the registry mutex keeps it from being handed on meanwhile.
+        // The fence keeps the copy above from being reordered after the reload of head, as in Telemetry's seqlock.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t head_after = buffer.head.load(std::memory_order_relaxed);
+        const uint64_t in_flight = buffer.in_use ? 1 : 0;
+        const uint64_t first_intact = head_after + in_flight > capacity ? head_after + in_flight - capacity : 0;
+
+        for (uint64_t i = std::max(begin, first_intact); i < end; i++) {
+            const Event& event = events[i - begin];
+            std::string args;
+            if (event.arg_name != nullptr) {
+                args = std::format(R"(, "args": {{"{}": {}}})", escape(event.arg_name), event.arg);
+            }
+            append(std::format(R"({{"name": "{}", "cat": "{}", "ph": "X", "ts": {:.3f}, "dur": {:.3f}, "pid": 1, )"
+                               R"("tid": {}{}}})",
+                               escape(event.name), escape(event.category), to_us(event.begin_ns),
+                               to_us(event.end_ns - event.begin_ns), event.tid, args));
+        }
+    }
+    json += "\n]}\n";
+
+    std::error_code ec;
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+    std::ofstream out(path, std::ios::trunc);
+    out << json;
+    if (!out.good()) {
+        spdlog::warn("Could not write trace to {}", path.string());
+        return false;
+    }
+    spdlog::info("Wrote {} trace events of {} threads ({} buffers) to {}", event_count, reg.next_tid - 1,
+                 reg.buffers.size(), path.string());
+    return true;
+}
+}  // namespace Trace
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Optional timeline tracer that writes Chrome trace-event JSON, viewable in Perfetto or chrome://tracing.
+ *
+ * Tracing is off unless `WIKIGRAPH_TRACE` is set (to the output file, or to `on` for `logs/trace.json`) or start() is
+ * called. Every thread records complete events into its own ring buffer without taking locks; once a buffer is full
+ * the oldest events are overwritten. A thread's buffer passes to the next new thread when it exits, so memory is
+ * bounded by the number of threads alive at once. write() collects all buffers into one JSON file, the application
+ * does so at exit. When tracing is off, a scope costs one relaxed atomic load.
+ */
+namespace Trace {
+namespace detail {
+extern std::atomic<bool> enabled;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+}  // namespace detail
+
+/** @brief Whether events are being recorded. */
+inline bool enabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/** @brief Start recording, to be written to `path` by write(). */
+void start(const std::filesystem::path& path);
+
+/** @brief Nanoseconds since the trace clock started. */
+uint64_t now_ns();
+
+/**
+ * @brief Record a complete event of the calling thread. Does nothing while tracing is off.
+ * @param name Event name, must be a string literal or otherwise outlive the trace
+ * @param category Event category, same lifetime requirement as name
+ * @param arg_name Name of the optional numeric argument, nullptr for none
+ */
+void record(const char* name, const char* category, uint64_t begin_ns, uint64_t end_ns,
+            const char* arg_name = nullptr, uint64_t arg = 0);
+
+/** @brief Name the calling thread in the trace, e.g. "reader" or "worker 3". Does nothing while tracing is off. */
+void set_thread_name(std::string name);
+
+/**
+ * @brief Write every buffered event to the path given to start() or `WIKIGRAPH_TRACE`.
+ *
+ * May run while other threads keep recording; events overwritten during the copy are left out.
+ * @return false if tracing is off or the file could not be written
+ */
+bool write();
+
+/**
+ * @brief Records the lifetime of the scope as one event.
+ */
+class Scope {
+   public:
+    Scope(const char* name, const char* category)
+        : name_(name), category_(category), active_(enabled()), begin_ns_(active_ ? now_ns() : 0) {}
+    ~Scope() {
+        if (active_) {
+            record(name_, category_, begin_ns_, now_ns(), arg_name_, arg_);
+        }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope(Scope&&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+    /** @brief Attach a numeric argument, such as the bytes or rows the scope handled. */
+    void set_arg(const char* arg_name, uint64_t value) {
+        arg_name_ = arg_name;
+        arg_ = value;
+    }
+
+   private:
+    const char* name_;
+    const char* category_;
+    const char* arg_name_ = nullptr;
+    uint64_t arg_ = 0;
+    bool active_;
+    uint64_t begin_ns_;
+};
+}  // namespace Trace
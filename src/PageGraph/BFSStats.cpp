@@ -0,0 +1,17 @@
+#include "BFSStats.h"
+
+#include <format>
+
+std::string BFSStats::summary() const {
+    uint64_t duration_ns = 0;
+    for (const BFSLayerStats& layer : layers) {
+        duration_ns += layer.duration_ns;
+    }
+    return std::format(
+        "{} layers, max frontier {}, {} edges scanned, {} discovered, {} duplicate parents, {} already visited, "
+        "{} parent appends, {:.1f} MB allocated, {:.3f} ms",
+        layers.size(), max_frontier, total(&BFSLayerStats::edges_scanned), total(&BFSLayerStats::discovered),
+        total(&BFSLayerStats::duplicate_parents), total(&BFSLayerStats::already_visited),
+        total(&BFSLayerStats::discovered) + total(&BFSLayerStats::duplicate_parents),
+        static_cast<double>(bytes_allocated) / (1024 * 1024), static_cast<double>(duration_ns) / 1e6);
+}
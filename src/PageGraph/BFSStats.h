@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Whether the BFS collects its detailed per-layer counters, set by the WIKIGRAPH_BFS_STATS CMake option.
+ *
+ * The counters sit in the innermost loop of the search, so builds without the option compile them out entirely.
+ */
+#ifdef WIKIGRAPH_BFS_STATS
+inline constexpr bool BFS_STATS_ENABLED = true;
+#else
+inline constexpr bool BFS_STATS_ENABLED = false;
+#endif
+
+/**
+ * @brief Work of one BFS layer.
+ */
+struct BFSLayerStats {
+    uint32_t layer = 0;
+    uint64_t frontier = 0;           // Nodes of the layer
+    uint64_t edges_scanned = 0;      // Outgoing links of the layer's nodes
+    uint64_t discovered = 0;         // Links that reached a node for the first time
+    uint64_t duplicate_parents = 0;  // Links to a node of the next layer that already had a parent
+    uint64_t already_visited = 0;    // Links back to this or an earlier layer
+    uint64_t duration_ns = 0;
+
+    /** @brief Parent list appends, one per discovery and one per duplicate parent. */
+    [[nodiscard]] uint64_t parent_appends() const {
+        return discovered + duplicate_parents;
+    }
+};
+
+/**
+ * @brief Detailed work of one BFS, empty unless the search policy collects statistics.
+ */
+struct BFSStats {
+    std::vector<BFSLayerStats> layers;
+    uint64_t max_frontier = 0;
+    // Distance and parent arrays when the search needed a new state, the growth of the parent lists and the queue
+    uint64_t bytes_allocated = 0;
+
+    /** @brief Sum of a per-layer counter, e.g. `total(&BFSLayerStats::discovered)`. */
+    [[nodiscard]] uint64_t total(uint64_t BFSLayerStats::* counter) const {
+        uint64_t sum = 0;
+        for (const BFSLayerStats& layer : layers) {
+            sum += layer.*counter;
+        }
+        return sum;
+    }
+
+    /** @brief One-line summary for the log. */
+    [[nodiscard]] std::string summary() const;
+};
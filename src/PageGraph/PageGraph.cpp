@@ -1,86 +1,193 @@
 #include "PageGraph.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
-#include <queue>
+#include <numeric>
 #include <stack>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include "DataLoader/LinkLoader.h"
 #include "DataLoader/PageLoader.h"
+#include "Log/Trace.h"
 #include "UI/UIBase.h"
+#include "Utils/Affinity.h"
+#include "Utils/ProgressReporter.h"
+#include "Utils/WThreadPool.h"
 #include "spdlog/spdlog.h"
 
 std::unique_ptr<PageGraph> PageGraph::instance = nullptr; // Must persist during the program's lifetime NOLINT
 std::mutex PageGraph::mtx; // Must persist during the program's lifetime NOLINT
 
+namespace {
+// Links handled per parallel_for chunk while building the graph, also the granularity of progress updates
+constexpr size_t LINK_CHUNK_SIZE = 1 << 16;
+// Pages handled per parallel_for chunk when sorting neighbour lists
+constexpr size_t PAGE_CHUNK_SIZE = 1 << 12;
+
+// Apply the NUMA policy to a freshly allocated array and fill it from the pool, so that with first-touch placement
+// each worker's slice of the array ends up on that worker's node
+template <typename Array>
+void place_and_fill(WThreadPool& pool, Array& array, typename Array::value_type value) {
+    Affinity::place_memory(array.data(), array.size() * sizeof(value));
+    pool.parallel_for(
+        0, array.size(),
+        [&](size_t begin, size_t end) {
+            std::fill(array.begin() + static_cast<ptrdiff_t>(begin), array.begin() + static_cast<ptrdiff_t>(end),
+                      value);
+        },
+        LINK_CHUNK_SIZE);
+}
+}  // namespace
+
 // Constuct page graph from pages and links
-PageGraph::PageGraph(UIState& state, std::vector<Page>&& pages, std::vector<Link>&& links)
+template <ProgressPolicy Policy>
+PageGraph::PageGraph(UIState& state, std::vector<Page>&& pages, std::vector<Link>&& links, Policy /*policy*/)
     : pages_(std::move(pages)) {  // Move pages for UI access
     // Pages = nodes, Links = edges
-    this->adjacency_list.resize(pages_.size());
+    build<Policy>(state, pages_.size(), std::move(links));
+}
 
+template <ProgressPolicy Policy>
+PageGraph::PageGraph(UIState& state, uint32_t number_of_pages, std::vector<Link>&& links, Policy /*policy*/) {
+    build<Policy>(state, number_of_pages, std::move(links));
+}
+
+template PageGraph::PageGraph(UIState&, std::vector<Page>&&, std::vector<Link>&&, UIProgress);
+template PageGraph::PageGraph(UIState&, std::vector<Page>&&, std::vector<Link>&&, NoProgress);
+template PageGraph::PageGraph(UIState&, std::vector<Page>&&, std::vector<Link>&&, CountersOnly);
+template PageGraph::PageGraph(UIState&, uint32_t, std::vector<Link>&&, UIProgress);
+template PageGraph::PageGraph(UIState&, uint32_t, std::vector<Link>&&, NoProgress);
+template PageGraph::PageGraph(UIState&, uint32_t, std::vector<Link>&&, CountersOnly);
+
+template <ProgressPolicy Policy>
+void PageGraph::build(UIState& state, size_t num_pages, std::vector<Link>&& links) {
     // Take ownership of links, vector is automatically destroyed when it goes out of scope
     std::vector<Link> links_ = std::move(links);
-
-    // Count number of outgoing links for each page
-    std::vector<uint32_t> out_links_count(pages_.size());
-    for (const auto& link : links_) {
-        out_links_count[link.page_from]++;
+    const auto total_links = static_cast<uint64_t>(links_.size());
+
+    WThreadPool& pool = WThreadPool::shared();
+
+    // Count number of outgoing links for each page, offsets[i + 1] temporarily holds the out-degree of page i
+    {
+        Trace::Scope phase_scope("count degrees", "graph");
+        this->offsets.resize(num_pages + 1);
+        place_and_fill(pool, this->offsets, uint64_t{0});
+        pool.parallel_for(
+            0, links_.size(),
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    std::atomic_ref<uint64_t> degree(this->offsets[links_[i].page_from + 1]);
+                    degree.fetch_add(1, std::memory_order_relaxed);
+                }
+            },
+            LINK_CHUNK_SIZE);
     }
 
-    // Reserve space for outgoing links for each page
-    // This is a performance optimization to avoid reallocations
-    for (uint32_t i = 0; i < pages_.size(); i++) {
-        adjacency_list[i].reserve(out_links_count[i]);
+    // Prefix sum turns out-degrees into the start offset of every page's neighbour list
+    {
+        Trace::Scope phase_scope("prefix sum", "graph");
+        std::inclusive_scan(this->offsets.begin(), this->offsets.end(), this->offsets.begin());
+        this->targets.resize(total_links);
+        if (Affinity::numa_policy() == NumaPolicy::FirstTouch) {
+            place_and_fill(pool, this->targets, uint32_t{0});
+        } else {
+            // The scatter below writes every slot, interleaving only needs the policy in place before that
+            Affinity::place_memory(this->targets.data(), this->targets.size() * sizeof(uint32_t));
+        }
     }
 
     // Initialize graph build progress
-    state.graph_build_progress = {
-        .processed_links = 0, .total_links = static_cast<uint64_t>(links_.size()), .edges_speed = 0};
-
-    // Construct adjacency list with periodic UI updates
-    auto start_time = std::chrono::steady_clock::now();
-    auto last_update_time = start_time;
-    for (const auto& link : links_) {
-        this->adjacency_list[link.page_from].emplace_back(link.page_to);
-        this->number_of_links++;
-
-        // throttle UI updates purely by time using the UI state's refresh rate
-        auto now = std::chrono::steady_clock::now();
-        if (now - last_update_time >= UIState::refresh_rate) {
-            auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count();
-            uint32_t speed = elapsed_ms > 0
-                                 ? static_cast<uint32_t>((static_cast<double>(this->number_of_links) * 1000.0) /
-                                                         static_cast<double>(elapsed_ms))
-                                 : 0u;
-            state.graph_build_progress = {.processed_links = this->number_of_links,
-                                          .total_links = static_cast<uint64_t>(links_.size()),
-                                          .edges_speed = speed};
-            post_ui_refresh();
-            last_update_time = now;
-        }
+    if constexpr (Policy::reports_progress) {
+        state.graph_build_progress = {.processed_links = 0, .total_links = total_links, .edges_speed = 0};
     }
 
+    // Scatter links into their page's slot range. Only the thread that started the build publishes progress,
+    // pool workers just add to the shared counter.
+    std::vector<uint64_t> cursor(this->offsets.begin(), this->offsets.end() - 1);
+    std::atomic<uint64_t> processed_links{0};
+    const auto builder_thread = std::this_thread::get_id();
+    ProgressReporter progress(UIState::refresh_rate, 1);
+    const uint64_t scatter_begin_ns = Trace::enabled() ? Trace::now_ns() : 0;
+    pool.parallel_for(
+        0, links_.size(),
+        [&](size_t begin, size_t end) {
+            Trace::Scope chunk_scope("scatter chunk", "graph");
+            for (size_t i = begin; i < end; i++) {
+                const Link& link = links_[i];
+                const uint64_t slot =
+                    std::atomic_ref<uint64_t>(cursor[link.page_from]).fetch_add(1, std::memory_order_relaxed);
+                this->targets[slot] = link.page_to;
+            }
+            if constexpr (Policy::reports_progress) {
+                const uint64_t done =
+                    processed_links.fetch_add(end - begin, std::memory_order_relaxed) + (end - begin);
+                if (std::this_thread::get_id() != builder_thread || !progress.tick()) {
+                    return;
+                }
+                state.graph_build_progress = {.processed_links = done,
+                                              .total_links = total_links,
+                                              .edges_speed = static_cast<uint32_t>(progress.rate(done))};
+                post_ui_refresh();
+            }
+        },
+        LINK_CHUNK_SIZE);
+    this->number_of_links = total_links;
+    if (Trace::enabled()) {
+        Trace::record("scatter links", "graph", scatter_begin_ns, Trace::now_ns(), "links", total_links);
+    }
+
+    sort_neighbours(pool);
+
     // Final update
-    auto end_time = std::chrono::steady_clock::now();
-    auto total_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-    uint32_t final_speed = total_ms > 0 ? static_cast<uint32_t>((static_cast<double>(this->number_of_links) * 1000.0) /
-                                                                static_cast<double>(total_ms))
-                                        : 0u;
-    state.graph_build_progress = {.processed_links = this->number_of_links,
-                                  .total_links = static_cast<uint64_t>(links_.size()),
-                                  .edges_speed = final_speed};
-    post_ui_refresh();
-
-    spdlog::debug("PageGraph constructed with {} pages and {} links", pages_.size(), this->number_of_links);
+    if constexpr (Policy::reports_progress) {
+        state.graph_build_progress = {.processed_links = this->number_of_links,
+                                      .total_links = total_links,
+                                      .edges_speed = static_cast<uint32_t>(progress.rate(this->number_of_links))};
+        post_ui_refresh();
+    }
+
+    spdlog::debug("PageGraph constructed with {} pages and {} links using {} threads", num_pages,
+                  this->number_of_links, pool.size());
+    HugePages::log_stats();
     // links vector is automatically destroyed when it goes out of scope
 }
 
+void PageGraph::sort_neighbours(WThreadPool& pool) {
+    Trace::Scope phase_scope("sort neighbours", "graph");
+    pool.parallel_for(
+        0, this->offsets.size() - 1,
+        [&](size_t begin, size_t end) {
+            for (size_t page = begin; page < end; page++) {
+                std::sort(this->targets.begin() + static_cast<ptrdiff_t>(this->offsets[page]),
+                          this->targets.begin() + static_cast<ptrdiff_t>(this->offsets[page + 1]));
+            }
+        },
+        PAGE_CHUNK_SIZE);
+}
+
 PageGraph::~PageGraph() {
-    this->adjacency_list.clear();
+    this->targets.clear();
+    this->offsets.clear();
+}
+
+std::vector<StructureMemory> PageGraph::memory_usage() const {
+    uint64_t title_bytes = 0;
+    for (const Page& page : this->pages_) {
+        title_bytes += MemoryFootprint::string_bytes(page.page_title);
+    }
+    return {{.name = "graph.offsets",
+             .elements = this->offsets.size(),
+             .bytes = MemoryFootprint::vector_bytes(this->offsets)},
+            {.name = "graph.targets",
+             .elements = this->targets.size(),
+             .bytes = MemoryFootprint::vector_bytes(this->targets)},
+            {.name = "graph.pages",
+             .elements = this->pages_.size(),
+             .bytes = MemoryFootprint::vector_bytes(this->pages_) + title_bytes}};
 }
 
 PageGraph& PageGraph::get() {
@@ -101,14 +208,17 @@ void PageGraph::init(UIState& state, std::vector<Page> pages, std::vector<Link>
     }
 }
 
+template <ProgressPolicy Policy>
 PageGraph::BFSResult PageGraph::bfs_with_parents(UIState& state, uint32_t start_index, uint32_t end_index) const {
-    const auto& adj = this->adjacency_list;
-
-    std::vector<uint32_t> dist(adj.size(), UINT32_MAX);
-    std::vector<std::vector<uint32_t>> parents(adj.size());
-    std::queue<uint32_t> queue;
-
-    queue.push(start_index);
+    bool fresh_scratch = false;
+    ScratchLease scratch = take_scratch(fresh_scratch);
+    auto& dist = scratch->dist;
+    auto& parents = scratch->parents;
+    auto& queue = scratch->queue;
+    size_t queue_head = 0;  // Nodes before it have been expanded
+    const size_t queue_capacity = queue.capacity();
+
+    queue.push_back(start_index);
     dist[start_index] = 0;
 
     // Track BFS progress
@@ -117,43 +227,103 @@ PageGraph::BFSResult PageGraph::bfs_with_parents(UIState& state, uint32_t start_
 
     uint32_t layer_explored_count = 0;
     uint32_t total_explored_count = 0;
+    uint64_t edges_scanned = 0;
     // Throttle UI updates to avoid excessive refreshes
-    auto last_update_time = std::chrono::steady_clock::now();
+    ProgressReporter progress(UIState::refresh_rate);
+    uint64_t layer_begin_ns = Trace::enabled() ? Trace::now_ns() : 0;
+    bool stopped_at_end = false;  // The layer that reached the end was closed inside the loop
+
+    // Detailed counters, every use is behind `if constexpr (Policy::collects_stats)`
+    BFSStats stats;
+    BFSLayerStats layer_stats{.frontier = 1};
+    auto layer_start_time = std::chrono::steady_clock::time_point{};
+    if constexpr (Policy::collects_stats) {
+        // A reused search state keeps its arrays, only a new one allocates them
+        if (fresh_scratch) {
+            stats.bytes_allocated =
+                (dist.size() * sizeof(uint32_t)) + (parents.size() * sizeof(std::vector<uint32_t>));
+        }
+        layer_start_time = std::chrono::steady_clock::now();
+    }
+    auto finish_layer = [&] {
+        const auto now = std::chrono::steady_clock::now();
+        layer_stats.duration_ns =
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - layer_start_time).count());
+        stats.max_frontier = std::max(stats.max_frontier, layer_stats.frontier);
+        stats.layers.push_back(layer_stats);
+        layer_start_time = now;
+    };
+    auto append_parent = [&](uint32_t node, uint32_t parent) {
+        if constexpr (Policy::collects_stats) {
+            const size_t capacity = parents[node].capacity();
+            parents[node].emplace_back(parent);
+            stats.bytes_allocated += (parents[node].capacity() - capacity) * sizeof(uint32_t);
+        } else {
+            parents[node].emplace_back(parent);
+        }
+    };
 
-    while (!queue.empty()) {
-        uint32_t current_node = queue.front();
-        queue.pop();
+    while (queue_head < queue.size()) {
+        uint32_t current_node = queue[queue_head++];
 
         if (dist[current_node] > current_layer) {  // We are entering a new layer
-            if (dist[end_index] != UINT32_MAX) {   // We have found the end node, stop BFS
+            if (Trace::enabled()) {
+                const uint64_t now_ns = Trace::now_ns();
+                Trace::record("bfs layer", "bfs", layer_begin_ns, now_ns, "nodes", layer_explored_count);
+                layer_begin_ns = now_ns;
+            }
+            if constexpr (Policy::collects_stats) {
+                finish_layer();
+            }
+            if (dist[end_index] != UINT32_MAX) {  // We have found the end node, stop BFS
+                stopped_at_end = true;
                 break;
             }
 
             current_layer = dist[current_node];
             // +1 to account for the node we just popped as part of the new layer
-            layer_size = static_cast<uint32_t>(queue.size()) + 1;
+            layer_size = static_cast<uint32_t>(queue.size() - queue_head) + 1;
             total_explored_count += layer_explored_count;
             layer_explored_count = 0;
+            if constexpr (Policy::collects_stats) {
+                layer_stats = {.layer = current_layer, .frontier = layer_size};
+            }
 
-            state.bfs_progress = {.current_layer = current_layer,
-                                  .layer_size = layer_size,
-                                  .layer_explored_count = layer_explored_count,
-                                  .total_explored_nodes = total_explored_count};
-            spdlog::debug("BFS progress: layer {} ({} nodes), {} nodes explored", current_layer, layer_size,
-                          total_explored_count);
+            if constexpr (Policy::reports_progress) {
+                state.bfs_progress = {.current_layer = current_layer,
+                                      .layer_size = layer_size,
+                                      .layer_explored_count = layer_explored_count,
+                                      .total_explored_nodes = total_explored_count};
+                spdlog::debug("BFS progress: layer {} ({} nodes), {} nodes explored", current_layer, layer_size,
+                              total_explored_count);
 
-            // Trigger UI refresh to show progress
-            post_ui_refresh();
-            last_update_time = std::chrono::steady_clock::now();
+                // Trigger UI refresh to show progress
+                post_ui_refresh();
+            }
         }
 
-        for (uint32_t neighbor : adj[current_node]) {
+        const auto neighbors = get_neighbors(current_node);
+        edges_scanned += neighbors.size();
+        if constexpr (Policy::collects_stats) {
+            layer_stats.edges_scanned += neighbors.size();
+        }
+        for (uint32_t neighbor : neighbors) {
             if (dist[neighbor] == UINT32_MAX) {
                 dist[neighbor] = dist[current_node] + 1;
-                parents[neighbor].emplace_back(current_node);
-                queue.push(neighbor);
+                append_parent(neighbor, current_node);
+                queue.push_back(neighbor);
+                if constexpr (Policy::collects_stats) {
+                    layer_stats.discovered++;
+                }
             } else if (dist[neighbor] == dist[current_node] + 1) {
-                parents[neighbor].emplace_back(current_node);
+                append_parent(neighbor, current_node);
+                if constexpr (Policy::collects_stats) {
+                    layer_stats.duplicate_parents++;
+                }
+            } else {
+                if constexpr (Policy::collects_stats) {
+                    layer_stats.already_visited++;
+                }
             }
         }
 
@@ -161,46 +331,126 @@ PageGraph::BFSResult PageGraph::bfs_with_parents(UIState& state, uint32_t start_
         layer_explored_count++;
 
         // Periodically refresh after processing nodes
-        auto now = std::chrono::steady_clock::now();
-        if (now - last_update_time >= UIState::refresh_rate) {
-            state.bfs_progress = {.current_layer = current_layer,
-                                  .layer_size = layer_size,
-                                  .layer_explored_count = layer_explored_count,
-                                  .total_explored_nodes = total_explored_count + layer_explored_count};
-            post_ui_refresh();
-            last_update_time = now;
+        if constexpr (Policy::reports_progress) {
+            if (progress.tick()) {
+                state.bfs_progress = {.current_layer = current_layer,
+                                      .layer_size = layer_size,
+                                      .layer_explored_count = layer_explored_count,
+                                      .total_explored_nodes = total_explored_count + layer_explored_count};
+                post_ui_refresh();
+            }
+        }
+    }
+
+    if (Trace::enabled() && !stopped_at_end) {
+        Trace::record("bfs layer", "bfs", layer_begin_ns, Trace::now_ns(), "nodes", layer_explored_count);
+    }
+    if constexpr (Policy::collects_stats) {
+        if (!stopped_at_end) {
+            finish_layer();
         }
+        // The queue keeps every node the search reached, for the next search to reset, and keeps its capacity
+        stats.bytes_allocated += (queue.capacity() - queue_capacity) * sizeof(uint32_t);
     }
 
     // Final update
-    state.bfs_progress = {.current_layer = current_layer,
-                          .layer_size = layer_size,
-                          .layer_explored_count = layer_explored_count,
-                          .total_explored_nodes = total_explored_count + layer_explored_count};
-    post_ui_refresh();
+    if constexpr (Policy::reports_progress) {
+        state.bfs_progress = {.current_layer = current_layer,
+                              .layer_size = layer_size,
+                              .layer_explored_count = layer_explored_count,
+                              .total_explored_nodes = total_explored_count + layer_explored_count};
+        post_ui_refresh();
+    }
 
-    return {.parents = std::move(parents), .dist = dist[end_index]};
+    return {.parents = parents,
+            .dist = dist[end_index],
+            .nodes_explored = uint64_t{total_explored_count} + layer_explored_count,
+            .edges_scanned = edges_scanned,
+            .stats = std::move(stats),
+            .scratch = std::move(scratch)};
 }
 
+PageGraph::ScratchLease PageGraph::take_scratch(bool& fresh) const {
+    const uint32_t num_pages = get_number_of_pages();
+    std::unique_ptr<SearchScratch> scratch;
+    {
+        std::lock_guard<std::mutex> lock(scratch_mutex_);
+        if (!idle_scratch_.empty()) {
+            scratch = std::move(idle_scratch_.back());
+            idle_scratch_.pop_back();
+        }
+    }
+    if (!scratch) {
+        // Initialised by the searching thread, so first-touch places it on that thread's node
+        scratch = std::make_unique<SearchScratch>();
+        fresh = true;
+        scratch->dist.assign(num_pages, UINT32_MAX);
+        scratch->parents.resize(num_pages);
+    }
+    // The previous search's result is no longer used, undo what it wrote
+    for (uint32_t node : scratch->queue) {
+        scratch->dist[node] = UINT32_MAX;
+        scratch->parents[node] = {};
+    }
+    scratch->queue.clear();
+    return {scratch.release(), ScratchReturn{.graph = this}};
+}
+
+void PageGraph::ScratchReturn::operator()(SearchScratch* scratch) const {
+    std::unique_ptr<SearchScratch> owned(scratch);
+    std::lock_guard<std::mutex> lock(graph->scratch_mutex_);
+    if (graph->idle_scratch_.size() < MAX_IDLE_SCRATCH) {
+        graph->idle_scratch_.push_back(std::move(owned));
+    }
+    // Otherwise freed here, the arrays of concurrent searches are not kept once they are done
+}
+
+template PageGraph::BFSResult PageGraph::bfs_with_parents<UIProgress>(UIState&, uint32_t, uint32_t) const;
+template PageGraph::BFSResult PageGraph::bfs_with_parents<NoProgress>(UIState&, uint32_t, uint32_t) const;
+template PageGraph::BFSResult PageGraph::bfs_with_parents<CountersOnly>(UIState&, uint32_t, uint32_t) const;
+
+template <ProgressPolicy Policy>
 std::vector<std::vector<uint32_t>> PageGraph::all_shortest_paths(UIState& state, uint32_t start_index,
-                                                                 uint32_t end_index) const {
-    const auto& adj = this->adjacency_list;
+                                                                 uint32_t end_index, SearchStats* stats) const {
+    const uint32_t num_pages = get_number_of_pages();
 
     std::vector<std::vector<uint32_t>> paths;
-    if (start_index >= adj.size() || end_index >= adj.size()) {
+    if (start_index >= num_pages || end_index >= num_pages) {
         spdlog::error("all_shortest_paths start_index {} or end_index {} is out of bounds (graph size: {})",
-                      start_index, end_index, adj.size());
+                      start_index, end_index, num_pages);
         return paths;
     }
+    Trace::Scope query_scope("shortest paths", "bfs");
 
-    auto bfs_result = bfs_with_parents(state, start_index, end_index);
-    spdlog::debug("BFS result: dist={}, parents={}", bfs_result.dist, bfs_result.parents.size());
+    auto bfs_result = bfs_with_parents<Policy>(state, start_index, end_index);
     const auto& parents = bfs_result.parents;
     const auto& dist = bfs_result.dist;
+    // Batch runs time their queries and report the statistics themselves, only interactive searches log them
+    if constexpr (Policy::reports_progress) {
+        spdlog::debug("BFS result: dist={}, parents={}", bfs_result.dist, bfs_result.parents.size());
+        if constexpr (Policy::collects_stats) {
+            spdlog::info("BFS {} -> {}: {}", start_index, end_index, bfs_result.stats.summary());
+            for (const BFSLayerStats& layer : bfs_result.stats.layers) {
+                spdlog::debug("  layer {}: frontier {}, {} edges, {} discovered, {} duplicate parents, {} already "
+                              "visited, {:.3f} ms",
+                              layer.layer, layer.frontier, layer.edges_scanned, layer.discovered,
+                              layer.duplicate_parents, layer.already_visited,
+                              static_cast<double>(layer.duration_ns) / 1e6);
+            }
+        }
+    }
+    if (stats != nullptr) {
+        *stats = {.nodes_explored = bfs_result.nodes_explored,
+                  .edges_scanned = bfs_result.edges_scanned,
+                  .distance = bfs_result.dist,
+                  .bfs = std::move(bfs_result.stats)};
+    }
 
     // Backtrack all paths from end_index to start_index iteratively using DFS
     if (dist != UINT32_MAX) {
-        spdlog::debug("Shortest path distance is {}. Backtracking to find all paths.", dist);
+        if constexpr (Policy::reports_progress) {
+            spdlog::debug("Shortest path distance is {}. Backtracking to find all paths.", dist);
+        }
         std::stack<std::vector<uint32_t>> path_stack;
         path_stack.push({end_index});
 
@@ -227,3 +477,10 @@ std::vector<std::vector<uint32_t>> PageGraph::all_shortest_paths(UIState& state,
 
     return paths;
 }
+
+template std::vector<std::vector<uint32_t>> PageGraph::all_shortest_paths<UIProgress>(UIState&, uint32_t, uint32_t,
+                                                                                       SearchStats*) const;
+template std::vector<std::vector<uint32_t>> PageGraph::all_shortest_paths<NoProgress>(UIState&, uint32_t, uint32_t,
+                                                                                       SearchStats*) const;
+template std::vector<std::vector<uint32_t>> PageGraph::all_shortest_paths<CountersOnly>(UIState&, uint32_t, uint32_t,
+                                                                                         SearchStats*) const;
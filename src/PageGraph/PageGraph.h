@@ -1,42 +1,113 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <span>
 #include <vector>
 
+#include "PageGraph/BFSStats.h"
+#include "PageGraph/ProgressPolicy.h"
 #include "UI/UIBase.h"
+#include "Utils/DefaultInitAllocator.h"
+#include "Utils/HugePageAllocator.h"
+#include "Utils/MemoryFootprint.h"
 
 // Forward declarations
 struct Page;
 struct Link;
+class WThreadPool;
+
+/**
+ * @brief Work done by one shortest-path search.
+ */
+struct SearchStats {
+    uint64_t nodes_explored = 0;     // Nodes dequeued by the BFS
+    uint64_t edges_scanned = 0;      // Outgoing links of those nodes
+    uint32_t distance = UINT32_MAX;  // Length of the shortest paths, UINT32_MAX if the end is unreachable
+    BFSStats bfs;                    // Per-layer detail, only filled by policies that collect statistics
+};
 
 /**
  * @brief Graph of Wikipedia pages
+ *
+ * Outgoing links are stored in compressed sparse row (CSR) form: the neighbours of page `i` are
+ * `targets[offsets[i]] .. targets[offsets[i + 1] - 1]`, sorted by page index.
  */
 class PageGraph {
    private:
-    std::vector<std::vector<uint32_t>> adjacency_list;
-    std::vector<Page> pages_;  // Store pages for UI access
-    uint32_t number_of_links = 0;
+    // Large arrays live on 2 MB pages to cut TLB misses during BFS, and are allocated untouched so that their NUMA
+    // placement is decided when they are filled
+    template <typename T>
+    using GraphArray = std::vector<T, DefaultInitAllocator<T, HugePageAllocator<T>>>;
+
+    GraphArray<uint64_t> offsets;  // Size number_of_pages + 1, start of each page's neighbours in targets
+    GraphArray<uint32_t> targets;  // Concatenated neighbour lists
+    std::vector<Page> pages_;      // Store pages for UI access
+    uint64_t number_of_links = 0;
 
     static std::unique_ptr<PageGraph> instance;
     static std::mutex mtx;
 
-    struct BFSResult {
-        std::vector<std::vector<uint32_t>> parents;
-        uint32_t dist;
-    };
+    /**
+     * @brief Fill the CSR arrays from the links, updating the UI progress while building if the policy reports it.
+     */
+    template <ProgressPolicy Policy>
+    void build(UIState& state, size_t num_pages, std::vector<Link>&& links);
 
     /**
-     * @brief Run BFS and track parent layers for all shortest paths.
+     * @brief Sort every neighbour list by page index, since the parallel scatter in build() fills them in an order
+     * that depends on thread timing. Keeps the graph, and so the order of paths found, the same on every run.
      */
-    [[nodiscard]] BFSResult bfs_with_parents(UIState& state, uint32_t start_index, uint32_t end_index) const;
+    void sort_neighbours(WThreadPool& pool);
+
+    // State of one search, kept by the graph between searches: allocating and faulting in arrays of the graph's size
+    // for every query cost more than a short search. Only the nodes the previous search reached are reset.
+    struct SearchScratch {
+        GraphArray<uint32_t> dist;
+        GraphArray<std::vector<uint32_t>> parents;
+        std::vector<uint32_t> queue;  // Every node the search reached, in BFS order
+    };
+
+    // Gives a search state back to the graph it came from
+    struct ScratchReturn {
+        const PageGraph* graph;
+        void operator()(SearchScratch* scratch) const;
+    };
+    using ScratchLease = std::unique_ptr<SearchScratch, ScratchReturn>;
+
+    // Search states kept between searches. One suffices for searches that run one after another, the extra states
+    // of concurrent searches are freed when they are returned, since each holds about 28 bytes per page.
+    static constexpr size_t MAX_IDLE_SCRATCH = 1;
+    mutable std::vector<std::unique_ptr<SearchScratch>> idle_scratch_;  // Guarded by scratch_mutex_
+    mutable std::mutex scratch_mutex_;
+
+    /** @brief An idle search state of this graph, or a new one, reset for the next search. Sets `fresh` if new. */
+    ScratchLease take_scratch(bool& fresh) const;
 
    public:
+    struct BFSResult {
+        // Every parent of a node on a shortest path from the start, valid while the result lives
+        std::span<const std::vector<uint32_t>> parents;
+        uint32_t dist;  // Distance of the end node, UINT32_MAX if it was not reached
+        uint64_t nodes_explored;
+        uint64_t edges_scanned;
+        BFSStats stats;        // Empty unless the policy collects statistics
+        ScratchLease scratch;  // Holds the search state parents points into, the graph reuses it once released
+    };
+
     /**
      * @brief Construct the graph from pages and links.
+     * @param policy UIProgress to show the build in the UI, NoProgress for batch runs
+     */
+    template <ProgressPolicy Policy = UIProgress>
+    PageGraph(UIState& state, std::vector<Page>&& pages, std::vector<Link>&& links, Policy policy = {});
+
+    /**
+     * @brief Construct a graph without page metadata, such as a synthetic benchmark graph.
      */
-    PageGraph(UIState& state, std::vector<Page>&& pages, std::vector<Link>&& links);  // constructor
+    template <ProgressPolicy Policy = UIProgress>
+    PageGraph(UIState& state, uint32_t number_of_pages, std::vector<Link>&& links, Policy policy = {});
 
     /** @brief Access the singleton graph instance. */
     static PageGraph& get();
@@ -46,21 +117,42 @@ class PageGraph {
     ~PageGraph();
 
     [[nodiscard]] uint32_t get_number_of_pages() const {
-        return static_cast<uint32_t>(this->adjacency_list.size());
+        return static_cast<uint32_t>(this->offsets.size() - 1);
     }
-    [[nodiscard]] uint32_t get_number_of_links() const {
+    [[nodiscard]] uint64_t get_number_of_links() const {
         return this->number_of_links;
     }
-    [[nodiscard]] const std::vector<std::vector<uint32_t>>& get_adjacency_list() const {
-        return this->adjacency_list;
+    /** @brief Outgoing neighbours of a page, sorted by page index. */
+    [[nodiscard]] std::span<const uint32_t> get_neighbors(uint32_t page_index) const {
+        return {this->targets.data() + this->offsets[page_index],
+                this->targets.data() + this->offsets[page_index + 1]};
+    }
+    [[nodiscard]] uint64_t get_out_degree(uint32_t page_index) const {
+        return this->offsets[page_index + 1] - this->offsets[page_index];
     }
     [[nodiscard]] const std::vector<Page>& get_pages() const {
         return this->pages_;
     }
 
+    /** @brief Footprint of the CSR arrays and the page metadata. */
+    [[nodiscard]] std::vector<StructureMemory> memory_usage() const;
+
+    /**
+     * @brief Run BFS and track parent layers for all shortest paths.
+     *
+     * Stops once the layer that reaches `end_index` is complete, so an unreachable end traverses the whole
+     * component of the start. The result's parents point into a search state of the graph, which later searches reuse
+     * once the result is destroyed, so the result must not outlive the graph. Instantiated for UIProgress, NoProgress
+     * and CountersOnly.
+     */
+    template <ProgressPolicy Policy = UIProgress>
+    [[nodiscard]] BFSResult bfs_with_parents(UIState& state, uint32_t start_index, uint32_t end_index) const;
+
     /**
      * @brief Compute all shortest paths between two nodes.
+     * @param stats If given, receives the work the search did
      */
-    std::vector<std::vector<uint32_t>> all_shortest_paths(UIState& state, uint32_t start_index,
-                                                          uint32_t end_index) const;
+    template <ProgressPolicy Policy = UIProgress>
+    std::vector<std::vector<uint32_t>> all_shortest_paths(UIState& state, uint32_t start_index, uint32_t end_index,
+                                                          SearchStats* stats = nullptr) const;
 };
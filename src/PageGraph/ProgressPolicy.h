@@ -0,0 +1,38 @@
+#pragma once
+
+#include <concepts>
+
+#include "PageGraph/BFSStats.h"
+
+/**
+ * @brief Compile-time choice of the bookkeeping the BFS and the graph build do besides their work.
+ *
+ * Both are instantiated once per policy, so a policy that turns something off removes its code from the loops
+ * instead of testing a flag in them.
+ */
+template <typename P>
+concept ProgressPolicy = requires {
+    { P::reports_progress } -> std::convertible_to<bool>;  // Publish progress to UIState and refresh the UI
+    { P::collects_stats } -> std::convertible_to<bool>;    // Fill BFSStats
+};
+
+/** @brief Live progress for the terminal UI, plus the BFS statistics in builds with WIKIGRAPH_BFS_STATS. */
+struct UIProgress {
+    static constexpr bool reports_progress = true;
+    static constexpr bool collects_stats = BFS_STATS_ENABLED;
+};
+
+/** @brief No bookkeeping at all, for batch runs and benchmarks. */
+struct NoProgress {
+    static constexpr bool reports_progress = false;
+    static constexpr bool collects_stats = false;
+};
+
+/**
+ * @brief BFS statistics without UI progress or logging, to tune searches in batch runs. The graph build has no
+ * statistics, so it builds as with NoProgress.
+ */
+struct CountersOnly {
+    static constexpr bool reports_progress = false;
+    static constexpr bool collects_stats = true;
+};
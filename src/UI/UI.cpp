@@ -1,15 +1,20 @@
 #include "UI.h"
 
+#include <array>
 #include <atomic>
 #include <cctype>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <format>
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/dom/table.hpp>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
@@ -17,9 +22,13 @@
 
 #include "DataLoader/PageLoader.h"
 #include "FetchWikiData/DownloadWikiDump.h"
+#include "FetchWikiData/DumpChecksum.h"
+#include "FetchWikiData/PartialFileReader.h"
+#include "Log/Trace.h"
 #include "PageGraph/PageGraph.h"
 #include "UIBase.h"
 #include "Utils/PathUtils.h"
+#include "Utils/PerfCounters.h"
 #include "WikiSelectUI.h"
 #include "spdlog/spdlog.h"
 
@@ -72,10 +81,78 @@ Elements create_progress_display(const std::string& label, size_t count, double
     return elements;
 }
 
+// Busy share and blocked time of every pipeline stage, and how full the pipeline is
+Elements create_pipeline_display(const PipelineActivity& activity) {
+    constexpr std::array<const char*, 3> stage_names = {"read", "parse", "insert"};
+    std::string stages;
+    for (size_t i = 0; i < activity.stages.size(); i++) {
+        const StageTiming& timing = activity.stages[i];
+        const uint64_t total = timing.busy_ns + timing.blocked_ns;
+        const double busy = total > 0 ? 100.0 * static_cast<double>(timing.busy_ns) / static_cast<double>(total) : 0;
+        stages += std::format("{}{} {:.0f}% busy", i == 0 ? "" : " | ", stage_names[i], busy);
+    }
+    return {text("Pipeline: " + stages) | color(Color::GrayDark),
+            text(std::format("Queued: {} lines, {:.1f} / {:.1f} MB in flight", activity.read_queue_items,
+                             static_cast<double>(activity.bytes_in_flight) / kBytesPerMB,
+                             static_cast<double>(activity.capacity) / kBytesPerMB)) |
+                color(Color::GrayDark)};
+}
+
+// RSS and structure footprint after the last finished stage, optionally broken down by structure
+Elements create_memory_display(UIState& state, bool per_structure) {
+    std::lock_guard<std::mutex> lock(state.memory_mutex);
+    if (state.memory_snapshots.empty()) {
+        return {};
+    }
+    const MemorySnapshot& last = state.memory_snapshots.back();
+    Elements elements = {text(std::format("Memory after {}: {:.0f} MB RSS, {:.0f} MB in data structures", last.stage,
+                                          static_cast<double>(last.rss_bytes) / kBytesPerMB,
+                                          static_cast<double>(last.structure_bytes()) / kBytesPerMB)) |
+                         color(Color::GrayDark)};
+    if (per_structure) {
+        for (const StructureMemory& structure : last.structures) {
+            if (structure.bytes == 0) {
+                continue;
+            }
+            elements.push_back(text(std::format("  {:<20} {:>9.1f} MB {:>14L} elements", structure.name,
+                                                static_cast<double>(structure.bytes) / kBytesPerMB,
+                                                structure.elements)) |
+                               color(Color::GrayDark));
+        }
+    }
+    return elements;
+}
+
 // Create step header
 Element create_step_header(const std::string& step, const std::string& description) {
     return text("[" + step + "] " + description) | bold;
 }
+
+/// @brief Whether loading starts while the dump is still downloading, disabled with
+/// `WIKIGRAPH_LOAD_WHILE_DOWNLOADING=off`.
+bool load_while_downloading() {
+    static const bool enabled = [] {
+        const char* value = std::getenv("WIKIGRAPH_LOAD_WHILE_DOWNLOADING");  // NOLINT(concurrency-mt-unsafe) read once
+        return value == nullptr || std::string(value) != "off";
+    }();
+    return enabled;
+}
+
+/// @brief Describe a dump file of the selected wiki in the data directory.
+WikiFile make_wiki_file(const std::string& prefix, const std::string& date, const char* suffix, WikiFileType type) {
+    WikiFile f{};
+    f.exists = true;
+    f.lang_code = prefix;
+    f.date = date;
+    f.file_type = type;
+    f.data_path = PathUtils::get_resource_dir("data") / (prefix + std::string("wiki-") + date + suffix);
+    if (std::filesystem::exists(f.data_path)) {
+        f.file_size = std::filesystem::file_size(f.data_path);
+    } else {
+        f.exists = false;
+    }
+    return f;
+}
 }  // namespace
 
 //=============================================================================
@@ -174,11 +251,13 @@ Component create_main_ui(Component& wiki_select_ui, Component& download_ui, Comp
 // DOWNLOAD STAGE
 //=============================================================================
 
-void download(UIState& state, WikiFileType type, std::string url) {
+void download(UIState& state, WikiFileType type, std::string url, std::string expected_sha1,
+              std::shared_ptr<PartialFileReader> live) {
     struct DownloadConfig {
-        std::atomic<UIState::DownloadProgress>* progress_ptr;
+        Telemetry<UIState::DownloadProgress>* progress_ptr;
         std::atomic<bool>* complete_ptr;
         std::string filename_suffix;
+        unsigned int priority;  // Order in which the loader needs the files
     };
 
     DownloadConfig config{};
@@ -186,23 +265,36 @@ void download(UIState& state, WikiFileType type, std::string url) {
         case WikiFileType::Page:
             config = {.progress_ptr = &state.page_download_progress,
                       .complete_ptr = &state.page_download_complete,
-                      .filename_suffix = "-page.sql.gz"};
+                      .filename_suffix = "-page.sql.gz",
+                      .priority = 0};
             break;
         case WikiFileType::PageLinks:
             config = {.progress_ptr = &state.pagelinks_download_progress,
                       .complete_ptr = &state.pagelinks_download_complete,
-                      .filename_suffix = "-pagelinks.sql.gz"};
+                      .filename_suffix = "-pagelinks.sql.gz",
+                      .priority = 2};
             break;
         case WikiFileType::LinkTarget:
             config = {.progress_ptr = &state.linktarget_download_progress,
                       .complete_ptr = &state.linktarget_download_complete,
-                      .filename_suffix = "-linktarget.sql.gz"};
+                      .filename_suffix = "-linktarget.sql.gz",
+                      .priority = 1};
             break;
     }
     std::filesystem::path full_path =
         PathUtils::get_resource_dir("data") /
         (state.selected_wiki_prefix + "wiki-" + state.selected_wiki_date + config.filename_suffix);
-    download_file(std::move(url), full_path.string(), *config.progress_ptr, UIState::refresh_rate);
+    if (!download_file(std::move(url), full_path.string(), *config.progress_ptr, UIState::refresh_rate,
+                       expected_sha1, live.get(), config.priority)) {
+        state.set_download_error(
+            DumpChecksum::load(full_path) == ChecksumVerdict::Mismatch
+                ? std::format("{} failed checksum verification. Restart and select the wiki again to redownload it.",
+                              full_path.filename().string())
+                : std::format("Failed to download {}. Restart and select the wiki again to resume the download.",
+                              full_path.filename().string()));
+        post_ui_refresh();
+        return;
+    }
     config.complete_ptr->store(true);
 
     UIState::DownloadProgress dp = config.progress_ptr->load();
@@ -215,21 +307,60 @@ void download(UIState& state, WikiFileType type, std::string url) {
 
 void download_in_background(UIState& state, DownloadURLs urls) {
     if (urls.page.empty() || urls.pagelinks.empty() || urls.linktarget.empty()) {
-        state.download_error_message = "Could not find download URLs for the selected wiki.";
+        state.set_download_error("Could not find download URLs for the selected wiki.");
         post_ui_refresh();
         return;
     }
 
-    std::thread download_pages([&, urls] { download(state, WikiFileType::Page, urls.page); });
-    std::thread download_pagelinks([&, urls] { download(state, WikiFileType::PageLinks, urls.pagelinks); });
-    std::thread download_linktarget([&, urls] { download(state, WikiFileType::LinkTarget, urls.linktarget); });
+    // The loaders follow the downloads, so loading finishes shortly after the last byte arrives
+    if (load_while_downloading()) {
+        const std::string& prefix = state.selected_wiki_prefix;
+        auto live_file = [&](const char* suffix, WikiFileType type) {
+            WikiFile f = make_wiki_file(prefix, urls.date, suffix, type);
+            f.exists = true;
+            f.file_size = 0;
+            f.live_source = std::make_shared<PartialFileReader>(f.data_path, 0);
+            return f;
+        };
+        state.selected_wiki.page = live_file("-page.sql.gz", WikiFileType::Page);
+        state.selected_wiki.pagelinks = live_file("-pagelinks.sql.gz", WikiFileType::PageLinks);
+        state.selected_wiki.linktarget = live_file("-linktarget.sql.gz", WikiFileType::LinkTarget);
+        state.selected_wiki.language_code = prefix;
+        state.selected_wiki.date = urls.date;
+        state.selected_wiki.size_on_disk = 0;
+    }
 
-    download_pages.detach();
-    download_pagelinks.detach();
-    download_linktarget.detach();
+    // Files are verified against the published checksums while they download. Fetching the checksums may take until
+    // its timeout, so it runs off the UI thread, before the downloads start.
+    std::thread downloads([&state, urls = std::move(urls), page_live = state.selected_wiki.page.live_source,
+                           pagelinks_live = state.selected_wiki.pagelinks.live_source,
+                           linktarget_live = state.selected_wiki.linktarget.live_source] {
+        const std::map<std::string, std::string> sha1sums = DumpChecksum::fetch_sha1sums(urls.sha1sums);
+        auto expected_sha1 = [&](const std::string& url) {
+            auto it = sha1sums.find(url.substr(url.find_last_of('/') + 1));
+            return it != sha1sums.end() ? it->second : std::string();
+        };
+
+        std::thread download_pages([&state, url = urls.page, sha1 = expected_sha1(urls.page), live = page_live] {
+            download(state, WikiFileType::Page, url, sha1, live);
+        });
+        std::thread download_pagelinks(
+            [&state, url = urls.pagelinks, sha1 = expected_sha1(urls.pagelinks), live = pagelinks_live] {
+                download(state, WikiFileType::PageLinks, url, sha1, live);
+            });
+        std::thread download_linktarget(
+            [&state, url = urls.linktarget, sha1 = expected_sha1(urls.linktarget), live = linktarget_live] {
+                download(state, WikiFileType::LinkTarget, url, sha1, live);
+            });
+
+        download_pages.detach();
+        download_pagelinks.detach();
+        download_linktarget.detach();
+    });
+    downloads.detach();
 }
 
-static Element render_download_progress(std::atomic<UIState::DownloadProgress>& dp) {
+static Element render_download_progress(const Telemetry<UIState::DownloadProgress>& dp) {
     const auto [dlnow, dltotal, dlspeed] = dp.load();
     return hbox({gauge(static_cast<float>(dlnow) / static_cast<float>(dltotal)) | flex, text(" "),
                  text(std::format("{:5.2f} MB / {:5.2f} MB", static_cast<double>(dlnow) / kBytesPerMB,
@@ -237,10 +368,29 @@ static Element render_download_progress(std::atomic<UIState::DownloadProgress>&
                  text(" | "), text(std::format("{:5.2f} MB/s", static_cast<double>(dlspeed) / kBytesPerMB))});
 }
 
+// Download bars shown below the loading progress while the loaders follow the downloads
+static Elements render_live_downloads(UIState& state) {
+    if (std::string error = state.download_error(); !error.empty()) {
+        return {separator(), create_text(error, false, Color::Red)};
+    }
+    if (!state.selected_wiki.page.live_source ||
+        (state.page_download_complete && state.pagelinks_download_complete && state.linktarget_download_complete)) {
+        return {};
+    }
+    return {separator(),
+            create_text("Still downloading", true),
+            text("Page file:"),
+            render_download_progress(state.page_download_progress),
+            text("Link target file:"),
+            render_download_progress(state.linktarget_download_progress),
+            text("Page links file:"),
+            render_download_progress(state.pagelinks_download_progress)};
+}
+
 static Element render_download_ui(UIState& state) {
-    if (!state.download_error_message.empty()) {
-        return vbox({create_text("Download Error", true), separator(),
-                     create_text(state.download_error_message, false, Color::Red), separator(),
+    if (std::string error = state.download_error(); !error.empty()) {
+        return vbox({create_text("Download Error", true), separator(), create_text(error, false, Color::Red),
+                     separator(),
                      text("Press any key to return to wiki selection.")}) |
                border;
     }
@@ -252,7 +402,7 @@ static Element render_download_ui(UIState& state) {
 
     Elements elements;
     std::string url =
-        std::format("https://dumps.wikimedia.org/{}wiki/{}/", state.selected_wiki_prefix, state.selected_wiki_date);
+        std::format("{}/{}wiki/{}/", dumps_base_url(), state.selected_wiki_prefix, state.selected_wiki_date);
     elements.push_back(hbox({create_text(std::format("Downloading {}wiki from ", state.selected_wiki_prefix), true),
                              create_text(url, true, Color::GrayDark) | hyperlink(url),
                              create_text(std::format(" at {:.2f} MB/s", total_speed / kBytesPerMB), true)}));
@@ -295,6 +445,15 @@ Component create_download_ui(UIState& state, std::function<void()> on_start_load
                 state.selected_wiki_date = urls.date;
                 download_in_background(state, urls);
 
+                // Loading does not wait for the downloads when the loaders follow them
+                if (state.selected_wiki.page.live_source && state.download_error().empty() &&
+                    on_start_loading) {
+                    state.stage = UIStage::LoadPages;
+                    post_ui_refresh();
+                    on_start_loading();
+                    return render_download_ui(state);
+                }
+
                 // Start a timer to periodically refresh the UI during downloads
                 std::thread refresh_timer([&] {
                     while (state.stage == UIStage::Download) {
@@ -308,31 +467,18 @@ Component create_download_ui(UIState& state, std::function<void()> on_start_load
             }
         }
 
-        // If all downloads have completed, populate selected_wiki and kick off loading
-        if (state.page_download_complete && state.pagelinks_download_complete && state.linktarget_download_complete) {
+        // If all downloads have completed, populate selected_wiki and kick off loading, unless a load already failed
+        if (state.page_download_complete && state.pagelinks_download_complete && state.linktarget_download_complete &&
+            state.download_error().empty()) {
             // Populate selected_wiki paths for the freshly downloaded files
             if (!state.selected_wiki_prefix.empty() && !state.selected_wiki_date.empty()) {
-                const auto base = PathUtils::get_resource_dir("data");
                 const auto prefix = state.selected_wiki_prefix;
                 const auto date = state.selected_wiki_date;
-                auto make_file = [&](const char* suffix, WikiFileType type) {
-                    WikiFile f{};
-                    f.exists = true;
-                    f.lang_code = prefix;
-                    f.date = date;
-                    f.file_type = type;
-                    f.data_path = base / (prefix + std::string("wiki-") + date + suffix);
-                    if (std::filesystem::exists(f.data_path)) {
-                        f.file_size = std::filesystem::file_size(f.data_path);
-                    } else {
-                        f.exists = false;
-                    }
-                    return f;
-                };
-
-                state.selected_wiki.page = make_file("-page.sql.gz", WikiFileType::Page);
-                state.selected_wiki.pagelinks = make_file("-pagelinks.sql.gz", WikiFileType::PageLinks);
-                state.selected_wiki.linktarget = make_file("-linktarget.sql.gz", WikiFileType::LinkTarget);
+                state.selected_wiki.page = make_wiki_file(prefix, date, "-page.sql.gz", WikiFileType::Page);
+                state.selected_wiki.pagelinks =
+                    make_wiki_file(prefix, date, "-pagelinks.sql.gz", WikiFileType::PageLinks);
+                state.selected_wiki.linktarget =
+                    make_wiki_file(prefix, date, "-linktarget.sql.gz", WikiFileType::LinkTarget);
                 state.selected_wiki.language_code = prefix;
                 state.selected_wiki.date = date;
                 state.selected_wiki.size_on_disk = state.selected_wiki.page.file_size +
@@ -377,6 +523,8 @@ Component create_progress_ui(UIState& state) {
                     auto progress_elems = create_progress_display("Loaded pages", state.page_count.load(),
                                                                   state.page_speed.load(), "pages", progress_ratio);
                     elements.insert(elements.end(), progress_elems.begin(), progress_elems.end());
+                    auto pipeline_elems = create_pipeline_display(state.pipeline_activity.load());
+                    elements.insert(elements.end(), pipeline_elems.begin(), pipeline_elems.end());
                     elements.insert(elements.end(), {text(" "), create_text("Loading...", false, Color::Yellow)});
                     break;
                 }
@@ -388,6 +536,8 @@ Component create_progress_ui(UIState& state) {
                         create_progress_display("Loaded link targets", state.linktarget_count.load(),
                                                 state.linktarget_speed.load(), "targets", progress_ratio);
                     elements.insert(elements.end(), progress_elems.begin(), progress_elems.end());
+                    auto pipeline_elems = create_pipeline_display(state.pipeline_activity.load());
+                    elements.insert(elements.end(), pipeline_elems.begin(), pipeline_elems.end());
                     elements.insert(elements.end(), {text(" "), create_text("Loading...", false, Color::Yellow)});
                     break;
                 }
@@ -398,6 +548,8 @@ Component create_progress_ui(UIState& state) {
                     auto progress_elems = create_progress_display("Loaded links", state.link_count.load(),
                                                                   state.link_speed.load(), "links", progress_ratio);
                     elements.insert(elements.end(), progress_elems.begin(), progress_elems.end());
+                    auto pipeline_elems = create_pipeline_display(state.pipeline_activity.load());
+                    elements.insert(elements.end(), pipeline_elems.begin(), pipeline_elems.end());
                     elements.insert(elements.end(), {text(" "), create_text("Loading...", false, Color::Yellow)});
                     break;
                 }
@@ -427,6 +579,10 @@ Component create_progress_ui(UIState& state) {
                 case UIStage::Done:
                     break;
             }
+            Elements memory = create_memory_display(state, false);
+            elements.insert(elements.end(), memory.begin(), memory.end());
+            Elements downloads = render_live_downloads(state);
+            elements.insert(elements.end(), downloads.begin(), downloads.end());
         } else {
             // Completed stage
             elements = {
@@ -440,6 +596,8 @@ Component create_progress_ui(UIState& state) {
                                   state.link_load_duration.count()),
                 hbox({text("Graph built in " + std::to_string(state.graph_build_duration.count()) + " ms =>"),
                       create_text(" Total " + std::to_string(total_load_duration(state).count()) + " ms", true)})};
+            Elements memory = create_memory_display(state, true);
+            elements.insert(elements.end(), memory.begin(), memory.end());
         }
         return vbox(std::move(elements)) | border;
     });
@@ -515,14 +673,16 @@ void perform_search(UIState& state) {
     spdlog::debug("Searching for {} -> {} (indices: {} -> {})", start_page, end_page, start_idx, end_idx);
 
     // Diagnostics: log out-degree of start node to verify outgoing edges
-    const auto& adj = graph.get_adjacency_list();
-    if (start_idx < adj.size()) {
-        spdlog::debug("Start node '{}' (idx {}) out-degree: {}", start_page, start_idx, adj[start_idx].size());
+    if (start_idx < graph.get_number_of_pages()) {
+        spdlog::debug("Start node '{}' (idx {}) out-degree: {}", start_page, start_idx,
+                      graph.get_out_degree(start_idx));
     }
+    const PerfCounters::Session counters;
     state.found_paths = graph.all_shortest_paths(state, start_idx, end_idx);
 
     const auto end_time = std::chrono::steady_clock::now();
     state.search_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    PerfCounters::log("search", counters.read());
 
     if (state.found_paths.empty()) {
         state.error_message = "No path found between the given pages.";
@@ -532,7 +692,10 @@ void perform_search(UIState& state) {
 }
 
 void handle_search_submit(UIState& state) {
-    std::thread search_thread([&state] { perform_search(state); });
+    std::thread search_thread([&state] {
+        Trace::set_thread_name("search");
+        perform_search(state);
+    });
     search_thread.detach();
     state.stage = UIStage::ShowPaths;
     post_ui_refresh();
@@ -633,10 +796,10 @@ bool handle_key_events(void* event_ptr, UIState& state) {
             post_ui_refresh();
             return true;
         }
-    } else if (state.stage == UIStage::Download && !state.download_error_message.empty()) {
+    } else if (state.stage == UIStage::Download && !state.download_error().empty()) {
         // Handle key press when download error is shown
         if (event.is_character()) {
-            state.download_error_message.clear();
+            state.clear_download_error();
             state.stage = UIStage::WikiSelection;
             post_ui_refresh();
             return true;
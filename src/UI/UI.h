@@ -2,6 +2,7 @@
 
 #include <ftxui/component/component_base.hpp>
 #include <functional>
+#include <memory>
 
 using ftxui::Component;
 
@@ -17,8 +18,12 @@ std::chrono::milliseconds total_load_duration(UIState& state);
 /** @brief Kick off the BFS path search using current input. */
 void perform_search(UIState& state);
 
-/** @brief Download a single file and update progress. */
-void download(UIState& state, WikiFileType type, std::string url);
+/**
+ * @brief Download a single file, verifying it against `expected_sha1` if not empty, and update progress.
+ * @param live Reader of the loader following the download, null if loading waits for it
+ */
+void download(UIState& state, WikiFileType type, std::string url, std::string expected_sha1,
+              std::shared_ptr<PartialFileReader> live = nullptr);
 /** @brief Download all needed files on a background thread. */
 void download_in_background(UIState& state, DownloadURLs urls);
 
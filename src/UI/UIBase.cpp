@@ -0,0 +1,65 @@
+#include "UIBase.h"
+
+namespace {
+TelemetryRegistry::Fields read_progress_fields(const ReadProgress& progress) {
+    return {{"current_bytes", progress.current_bytes}, {"total_bytes", progress.total_bytes}};
+}
+
+TelemetryRegistry::Fields download_fields(const UIState::DownloadProgress& progress) {
+    return {{"dlnow", progress.dlnow}, {"dltotal", progress.dltotal}, {"dlspeed", progress.dlspeed}};
+}
+}  // namespace
+
+UIState::UIState() {
+    telemetry.add("page_count", page_count);
+    telemetry.add("page_speed", page_speed);
+    telemetry.add("page_progress", page_progress, read_progress_fields);
+    telemetry.add("linktarget_count", linktarget_count);
+    telemetry.add("linktarget_speed", linktarget_speed);
+    telemetry.add("linktarget_progress", linktarget_progress, read_progress_fields);
+    telemetry.add("link_count", link_count);
+    telemetry.add("link_speed", link_speed);
+    telemetry.add("link_progress", link_progress, read_progress_fields);
+    telemetry.add("pipeline_activity", pipeline_activity, [](const PipelineActivity& activity) {
+        return TelemetryRegistry::Fields{{"read_busy_ns", activity.stages[0].busy_ns},
+                                         {"read_blocked_ns", activity.stages[0].blocked_ns},
+                                         {"parse_busy_ns", activity.stages[1].busy_ns},
+                                         {"parse_blocked_ns", activity.stages[1].blocked_ns},
+                                         {"insert_busy_ns", activity.stages[2].busy_ns},
+                                         {"insert_blocked_ns", activity.stages[2].blocked_ns},
+                                         {"read_queue_items", activity.read_queue_items},
+                                         {"bytes_in_flight", activity.bytes_in_flight},
+                                         {"capacity", activity.capacity}};
+    });
+    telemetry.add("graph_build_progress", graph_build_progress, [](const GraphBuildProgress& progress) {
+        return TelemetryRegistry::Fields{{"processed_links", progress.processed_links},
+                                         {"total_links", progress.total_links},
+                                         {"edges_speed", progress.edges_speed}};
+    });
+    telemetry.add("bfs_progress", bfs_progress, [](const bfs_progress_counter& progress) {
+        return TelemetryRegistry::Fields{{"current_layer", progress.current_layer},
+                                         {"layer_size", progress.layer_size},
+                                         {"layer_explored_count", progress.layer_explored_count},
+                                         {"total_explored_nodes", progress.total_explored_nodes}};
+    });
+    telemetry.add("page_download_progress", page_download_progress, download_fields);
+    telemetry.add("pagelinks_download_progress", pagelinks_download_progress, download_fields);
+    telemetry.add("linktarget_download_progress", linktarget_download_progress, download_fields);
+}
+
+void UIState::set_download_error(std::string message) {
+    std::lock_guard<std::mutex> lock(download_error_mutex);
+    if (download_error_message.empty()) {
+        download_error_message = std::move(message);
+    }
+}
+
+std::string UIState::download_error() {
+    std::lock_guard<std::mutex> lock(download_error_mutex);
+    return download_error_message;
+}
+
+void UIState::clear_download_error() {
+    std::lock_guard<std::mutex> lock(download_error_mutex);
+    download_error_message.clear();
+}
@@ -5,14 +5,21 @@
 #include <cstdint>
 #include <filesystem>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "DataLoader/FlowControl.h"
+#include "Utils/MemoryFootprint.h"
+#include "Utils/Telemetry.h"
+
 // Forward declarations
 struct Page;
 struct DownloadURLs;
 struct WikiEntry;
 class PageLoader;
+class PartialFileReader;
 
 #include <ftxui/component/screen_interactive.hpp>
 
@@ -60,6 +67,9 @@ struct WikiFile {
 
     std::filesystem::path data_path;
     std::filesystem::path index_path;
+
+    // Set while the file is still downloading, the loader then follows the download instead of opening the file
+    std::shared_ptr<PartialFileReader> live_source;
 };
 
 /// @brief Structure representing a downloaded wiki with its metadata
@@ -75,18 +85,31 @@ struct DownloadedWiki {
 
 // The main UI state struct
 struct UIState {
+    UIState();
+    UIState(const UIState&) = delete;
+    UIState& operator=(const UIState&) = delete;
+    UIState(UIState&&) = delete;
+    UIState& operator=(UIState&&) = delete;
+    ~UIState() = default;
+
     bool offline_mode = false;
 
+    // Progress structs are published through seqlock channels, so the loader, graph build and BFS threads writing
+    // them never wait on the UI thread reading them
+
     // Progress counters
     std::atomic<size_t> page_count{0};
     std::atomic<uint32_t> page_speed{0};
-    std::atomic<ReadProgress> page_progress{ReadProgress{.total_bytes = 0, .current_bytes = 0}};
+    Telemetry<ReadProgress> page_progress;
     std::atomic<size_t> linktarget_count{0};
     std::atomic<uint32_t> linktarget_speed{0};
-    std::atomic<ReadProgress> linktarget_progress{ReadProgress{.total_bytes = 0, .current_bytes = 0}};
+    Telemetry<ReadProgress> linktarget_progress;
     std::atomic<size_t> link_count{0};
     std::atomic<uint32_t> link_speed{0};
-    std::atomic<ReadProgress> link_progress{ReadProgress{.total_bytes = 0, .current_bytes = 0}};
+    Telemetry<ReadProgress> link_progress;
+
+    // Busy and blocked time of the pipeline stages and queue occupancy of the table being loaded
+    Telemetry<PipelineActivity> pipeline_activity;
 
     // Graph build progress counters
     using GraphBuildProgress = struct {
@@ -94,7 +117,7 @@ struct UIState {
         uint64_t total_links;      // total number of edges to insert
         uint32_t edges_speed;      // edges inserted per second
     };
-    std::atomic<GraphBuildProgress> graph_build_progress{GraphBuildProgress{0, 0, 0}};
+    Telemetry<GraphBuildProgress> graph_build_progress;
 
     // BFS progress counters
     using bfs_progress_counter = struct {
@@ -103,7 +126,7 @@ struct UIState {
         uint32_t layer_explored_count;  // number of nodes explored in current layer (for layer progress bar)
         uint32_t total_explored_nodes;  // total number of nodes explored (for total progress bar)
     };
-    std::atomic<bfs_progress_counter> bfs_progress{bfs_progress_counter{0, 0, 0, 0}};
+    Telemetry<bfs_progress_counter> bfs_progress;
     std::atomic<bool> is_searching{false};
 
     // Timing of the different stages of the program (for benchmarking)
@@ -112,6 +135,10 @@ struct UIState {
     std::chrono::milliseconds link_load_duration{0};
     std::chrono::milliseconds graph_build_duration{0};
 
+    // Footprint of the loaded structures and process RSS after every finished stage, written by the loader thread
+    std::mutex memory_mutex;
+    std::vector<MemorySnapshot> memory_snapshots;  // Guarded by memory_mutex
+
     // Current stage
     std::atomic<UIStage> stage{UIStage::WikiSelection};
 
@@ -141,13 +168,24 @@ struct UIState {
     };
 
     // Download state
-    std::atomic<DownloadProgress> page_download_progress{DownloadProgress{0, 0, 0}};
+    Telemetry<DownloadProgress> page_download_progress;
     std::atomic<bool> page_download_complete{false};
-    std::atomic<DownloadProgress> pagelinks_download_progress{DownloadProgress{0, 0, 0}};
+    Telemetry<DownloadProgress> pagelinks_download_progress;
     std::atomic<bool> pagelinks_download_complete{false};
-    std::atomic<DownloadProgress> linktarget_download_progress{DownloadProgress{0, 0, 0}};
+    Telemetry<DownloadProgress> linktarget_download_progress;
     std::atomic<bool> linktarget_download_complete{false};
-    std::string download_error_message;
+    // Set by the download and loader threads, read and cleared by the UI thread
+    std::mutex download_error_mutex;
+    std::string download_error_message;  // Guarded by download_error_mutex
+
+    /// @brief Record a failed download. The first failure wins, later ones are usually its consequences.
+    void set_download_error(std::string message);
+    /// @brief Copy of the current download error, empty while none occurred.
+    std::string download_error();
+    void clear_download_error();
+
+    // Every progress channel and counter above, for the log and exporters
+    TelemetryRegistry telemetry;
 
     // Referesh rate
     static constexpr std::chrono::milliseconds refresh_rate{200};
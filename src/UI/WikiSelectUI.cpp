@@ -11,6 +11,8 @@
 #include <ftxui/dom/table.hpp>
 #include <map>
 
+#include "FetchWikiData/DownloadJournal.h"
+#include "FetchWikiData/DumpChecksum.h"
 #include "UI.h"
 #include "Utils/PathUtils.h"
 
@@ -36,6 +38,17 @@ std::vector<DownloadedWiki> WikiSelectUIManager::scan_downloaded_wikis() {
             if (entry.is_regular_file() && entry.path().string().ends_with(".sql.gz")) {
                 std::string filename = entry.path().filename().string();
 
+                // A download journal next to the file means the download was interrupted
+                if (std::filesystem::exists(DownloadJournal::path_for(entry.path()))) {
+                    spdlog::info("Skipping partially downloaded file: {}", filename);
+                    continue;
+                }
+                // Verdict recorded while downloading, no need to hash the file again
+                if (DumpChecksum::load(entry.path()) == ChecksumVerdict::Mismatch) {
+                    spdlog::error("Skipping {}, it failed checksum verification", filename);
+                    continue;
+                }
+
                 size_t wiki_pos = filename.find("wiki-");
                 if (wiki_pos == std::string::npos) continue;
 
@@ -0,0 +1,285 @@
+#include "Affinity.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "spdlog/spdlog.h"
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Affinity {
+namespace {
+std::string env_string(const char* name) {
+    const char* value = std::getenv(name);  // NOLINT(concurrency-mt-unsafe) read once at startup
+    return value != nullptr ? std::string(value) : std::string();
+}
+
+// Parse a kernel CPU list such as "0-3,8,10-11"
+std::vector<unsigned int> parse_cpu_list(std::string_view text) {
+    std::vector<unsigned int> cpus;
+    while (!text.empty()) {
+        const size_t comma = text.find(',');
+        const std::string_view range = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+
+        unsigned int first = 0;
+        unsigned int last = 0;
+        auto [ptr, err] = std::from_chars(range.data(), range.data() + range.size(), first);
+        if (err != std::errc()) {
+            continue;
+        }
+        last = first;
+        if (ptr != range.data() + range.size() && *ptr == '-') {
+            std::from_chars(ptr + 1, range.data() + range.size(), last);
+        }
+        for (unsigned int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+#ifdef __linux__
+std::set<unsigned int> allowed_cpus() {
+    std::set<unsigned int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.insert(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool set_thread_cpus(const std::vector<unsigned int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#endif
+
+CpuTopology probe_topology() {
+    CpuTopology topo;
+#ifdef __linux__
+    const std::set<unsigned int> allowed = allowed_cpus();
+    const std::filesystem::path node_root = "/sys/devices/system/node";
+    std::error_code ec;
+    std::vector<unsigned int> ids;
+    for (const auto& entry : std::filesystem::directory_iterator(node_root, ec)) {
+        const std::string name = entry.path().filename().string();
+        unsigned int id = 0;
+        if (name.starts_with("node") &&
+            std::from_chars(name.data() + 4, name.data() + name.size(), id).ec == std::errc()) {
+            ids.push_back(id);
+        }
+    }
+    std::ranges::sort(ids);
+    for (unsigned int id : ids) {
+        std::ifstream file(node_root / ("node" + std::to_string(id)) / "cpulist");
+        std::string line;
+        std::getline(file, line);
+        std::vector<unsigned int> cpus;
+        for (unsigned int cpu : parse_cpu_list(line)) {
+            if (allowed.contains(cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            topo.node_cpus.push_back(std::move(cpus));
+            topo.node_ids.push_back(id);
+        }
+    }
+    if (topo.node_cpus.empty() && !allowed.empty()) {
+        topo.node_cpus.emplace_back(allowed.begin(), allowed.end());
+        topo.node_ids.push_back(0);
+    }
+#endif
+    return topo;
+}
+
+std::vector<unsigned int> cpu_order(const CpuTopology& topo, PinningMode mode) {
+    std::vector<unsigned int> order;
+    if (mode == PinningMode::Compact) {
+        for (const auto& cpus : topo.node_cpus) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+    } else if (mode == PinningMode::Spread) {
+        size_t max_cpus = 0;
+        for (const auto& cpus : topo.node_cpus) {
+            max_cpus = std::max(max_cpus, cpus.size());
+        }
+        for (size_t i = 0; i < max_cpus; i++) {
+            for (const auto& cpus : topo.node_cpus) {
+                if (i < cpus.size()) {
+                    order.push_back(cpus[i]);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+constexpr const char* mode_name(PinningMode mode) {
+    switch (mode) {
+        case PinningMode::None:
+            return "none";
+        case PinningMode::Compact:
+            return "compact";
+        case PinningMode::Spread:
+            return "spread";
+    }
+    return "unknown";
+}
+
+constexpr const char* policy_name(NumaPolicy policy) {
+    switch (policy) {
+        case NumaPolicy::Interleave:
+            return "interleave";
+        case NumaPolicy::FirstTouch:
+            return "first-touch";
+        case NumaPolicy::Off:
+            return "off";
+    }
+    return "unknown";
+}
+}  // namespace
+
+const CpuTopology& topology() {
+    static const CpuTopology topo = probe_topology();
+    return topo;
+}
+
+PinningMode pinning_mode() {
+    static const PinningMode mode = [] {
+        const std::string value = env_string("WIKIGRAPH_PIN_THREADS");
+        if (value == "compact" || value == "1") return PinningMode::Compact;
+        if (value == "spread") return PinningMode::Spread;
+        if (!value.empty() && value != "none" && value != "0") {
+            spdlog::warn("Unknown WIKIGRAPH_PIN_THREADS value '{}', pinning disabled", value);
+        }
+        return PinningMode::None;
+    }();
+    return mode;
+}
+
+NumaPolicy numa_policy() {
+    static const NumaPolicy policy = [] {
+        const std::string value = env_string("WIKIGRAPH_NUMA");
+        if (value == "interleave") return NumaPolicy::Interleave;
+        if (value == "first-touch") return NumaPolicy::FirstTouch;
+        if (!value.empty() && value != "off" && value != "none") {
+            spdlog::warn("Unknown WIKIGRAPH_NUMA value '{}', NUMA placement disabled", value);
+        }
+        return NumaPolicy::Off;
+    }();
+    return policy;
+}
+
+const std::vector<unsigned int>& worker_cpus() {
+    static const std::vector<unsigned int> cpus = cpu_order(topology(), pinning_mode());
+    return cpus;
+}
+
+std::vector<unsigned int> pin_order(PinningMode mode) {
+    return cpu_order(topology(), mode);
+}
+
+std::vector<unsigned int> decompression_cpus(size_t threads) {
+    const auto& order = worker_cpus();
+    if (order.empty() || threads == 0) {
+        return {};
+    }
+    const size_t count = std::min(threads, std::max<size_t>(order.size() / 2, 1));
+    return {order.end() - static_cast<ptrdiff_t>(count), order.end()};
+}
+
+std::vector<unsigned int> parse_worker_cpus(size_t decompression_threads) {
+    const auto& order = worker_cpus();
+    const size_t reserved = decompression_cpus(decompression_threads).size();
+    if (reserved >= order.size()) {
+        return order;
+    }
+    return {order.begin(), order.end() - static_cast<ptrdiff_t>(reserved)};
+}
+
+bool pin_current_thread(unsigned int cpu) {
+#ifdef __linux__
+    return set_thread_cpus({cpu});
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool restrict_current_thread(const std::vector<unsigned int>& cpus) {
+#ifdef __linux__
+    return !cpus.empty() && set_thread_cpus(cpus);
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+void place_memory(void* data, size_t bytes) {
+#ifdef __linux__
+    const auto& topo = topology();
+    if (numa_policy() != NumaPolicy::Interleave || topo.node_ids.size() < 2 || data == nullptr) {
+        return;
+    }
+
+    // mbind only accepts page-aligned ranges, leave the partial pages at both ends alone
+    const auto page = static_cast<uintptr_t>(sysconf(_SC_PAGE_SIZE));
+    const auto begin = (reinterpret_cast<uintptr_t>(data) + page - 1) & ~(page - 1);
+    const auto end = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(page - 1);
+    if (end <= begin) {
+        return;
+    }
+
+    constexpr size_t kBitsPerWord = sizeof(unsigned long) * 8;
+    const unsigned int max_node = *std::ranges::max_element(topo.node_ids);
+    std::vector<unsigned long> nodemask(max_node / kBitsPerWord + 1, 0);
+    for (unsigned int node : topo.node_ids) {
+        nodemask[node / kBitsPerWord] |= 1UL << (node % kBitsPerWord);
+    }
+    // glibc has no mbind wrapper without libnuma, call the syscall directly
+    if (syscall(SYS_mbind, begin, end - begin, MPOL_INTERLEAVE, nodemask.data(), nodemask.size() * kBitsPerWord + 1,
+                0) != 0) {
+        spdlog::debug("mbind(MPOL_INTERLEAVE) failed for {} bytes", end - begin);
+    }
+#else
+    (void)data;
+    (void)bytes;
+#endif
+}
+
+void log_topology() {
+    const auto& topo = topology();
+    std::ostringstream nodes;
+    for (size_t i = 0; i < topo.node_cpus.size(); i++) {
+        nodes << (i > 0 ? ", " : "") << "node" << topo.node_ids[i] << ": " << topo.node_cpus[i].size() << " CPUs";
+    }
+    spdlog::info("CPU topology: {} NUMA node(s) ({}), thread pinning: {}, NUMA policy: {}", topo.node_cpus.size(),
+                 nodes.str(), mode_name(pinning_mode()), policy_name(numa_policy()));
+}
+}  // namespace Affinity
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief How worker threads are pinned to CPUs, selected with `WIKIGRAPH_PIN_THREADS`.
+ */
+enum class PinningMode : uint8_t {
+    None,     // Threads float freely (default)
+    Compact,  // Fill the CPUs of one NUMA node before moving to the next
+    Spread,   // Round-robin over NUMA nodes
+};
+
+/**
+ * @brief Where large graph arrays are placed on NUMA machines, selected with `WIKIGRAPH_NUMA`.
+ */
+enum class NumaPolicy : uint8_t {
+    Interleave,  // Spread pages over all nodes, every query thread sees the same average latency
+    FirstTouch,  // Pages land on the node of the (pinned) worker that initialises them
+    Off,         // Leave placement to the kernel (default)
+};
+
+/**
+ * @brief CPUs this process may run on, grouped by NUMA node.
+ */
+struct CpuTopology {
+    std::vector<std::vector<unsigned int>> node_cpus;  // Allowed CPUs of every node that has any
+    std::vector<unsigned int> node_ids;                // Kernel node id of each entry in node_cpus
+};
+
+/**
+ * @brief Optional CPU pinning and NUMA placement for the loader, graph build and BFS.
+ *
+ * Pinning is off by default and enabled with `WIKIGRAPH_PIN_THREADS=compact|spread`. NUMA placement is off by default
+ * too and only does anything on machines with more than one node; `WIKIGRAPH_NUMA=interleave|first-touch` enables it.
+ */
+namespace Affinity {
+/** @brief Topology read once from `/sys/devices/system/node`, a single node on other platforms. */
+const CpuTopology& topology();
+
+/** @brief Pinning mode from the environment. */
+PinningMode pinning_mode();
+/** @brief NUMA placement policy from the environment. */
+NumaPolicy numa_policy();
+
+/**
+ * @brief CPUs worker `i` of a pool should be pinned to (`cpus[i % cpus.size()]`), empty when pinning is off.
+ */
+const std::vector<unsigned int>& worker_cpus();
+
+/**
+ * @brief CPU order a pinning mode gives on this machine regardless of the environment, empty for `None`.
+ */
+std::vector<unsigned int> pin_order(PinningMode mode);
+
+/**
+ * @brief CPU set the decompression threads are confined to, empty when pinning is off.
+ *
+ * The decompression threads take the last CPUs of the pinning order, at most half of them, and the parse workers
+ * of the same load the others (see parse_worker_cpus()), so the two stages never compete for a CPU.
+ */
+std::vector<unsigned int> decompression_cpus(size_t threads);
+
+/**
+ * @brief CPUs of the parse workers that run next to `decompression_threads` decompression threads, empty when
+ * pinning is off. All CPUs of the pinning order if there is only one.
+ */
+std::vector<unsigned int> parse_worker_cpus(size_t decompression_threads);
+
+/**
+ * @brief Pin the calling thread to one CPU.
+ * @return false if the platform does not support it or the call failed
+ */
+bool pin_current_thread(unsigned int cpu);
+
+/**
+ * @brief Restrict the calling thread to a set of CPUs. Threads it creates afterwards inherit the set.
+ * @return false if the platform does not support it or the call failed
+ */
+bool restrict_current_thread(const std::vector<unsigned int>& cpus);
+
+/**
+ * @brief Apply the NUMA policy to a freshly allocated, not yet touched, memory range.
+ *
+ * With `Interleave` the range is bound round-robin to all nodes through `mbind`. Only whole pages inside the range
+ * are affected. Does nothing on single-node machines or with other policies.
+ */
+void place_memory(void* data, size_t bytes);
+
+/** @brief Log the topology and the active pinning and NUMA settings. */
+void log_topology();
+}  // namespace Affinity
@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Allocator adaptor that default-initialises instead of value-initialising elements.
+ *
+ * `std::vector<uint32_t, DefaultInitAllocator<uint32_t>>::resize(n)` then allocates without writing the memory, so
+ * the pages of a large array are first touched by whoever fills it (see Affinity::place_memory()).
+ */
+template <typename T, typename Base = std::allocator<T>>
+class DefaultInitAllocator : public Base {
+    using Traits = std::allocator_traits<Base>;
+
+   public:
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U, typename Traits::template rebind_alloc<U>>;
+    };
+
+    using Base::Base;
+
+    template <typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        Traits::construct(static_cast<Base&>(*this), ptr, std::forward<Args>(args)...);
+    }
+};
@@ -0,0 +1,172 @@
+#include "HugePageAllocator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "spdlog/spdlog.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace HugePages {
+namespace {
+constexpr double kBytesPerMB = 1024 * 1024;
+
+std::atomic<uint64_t> hugetlb_bytes{0};
+std::atomic<uint64_t> thp_bytes{0};
+std::atomic<uint64_t> fallback_bytes{0};
+std::atomic<uint64_t> hugetlb_failures{0};
+
+#ifdef __linux__
+enum class Backing : uint8_t { HugeTlb, Thp };
+
+// Mappings are few and large, a locked map is cheap enough to remember how each one was made
+std::mutex mappings_mutex;
+std::unordered_map<void*, Backing> mappings;
+
+bool enabled() {
+    static const bool on = [] {
+        const char* value = std::getenv("WIKIGRAPH_HUGE_PAGES");  // NOLINT(concurrency-mt-unsafe) read once
+        return value == nullptr || std::string(value) != "off";
+    }();
+    return on;
+}
+
+size_t round_up(size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+#endif
+
+// Read a "<Key>: <value> kB" line of /proc/meminfo or /proc/self/smaps_rollup, in bytes
+uint64_t read_kb_field(const char* path, const std::string& key) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.starts_with(key)) {
+            uint64_t value = std::strtoull(line.c_str() + key.size(), nullptr, 10);
+            return line.ends_with("kB") ? value * 1024 : value;
+        }
+    }
+    return 0;
+}
+
+#ifdef __linux__
+bool hugetlb_pool_has_room(size_t bytes) {
+    if (read_kb_field("/proc/meminfo", "Hugepagesize:") != HUGE_PAGE_SIZE) {
+        return false;
+    }
+    return read_kb_field("/proc/meminfo", "HugePages_Free:") * HUGE_PAGE_SIZE >= bytes;
+}
+
+void* map_hugetlb(size_t bytes) {
+    if (!hugetlb_pool_has_room(bytes)) {
+        return nullptr;
+    }
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr == MAP_FAILED) {
+        hugetlb_failures.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return ptr;
+}
+
+// Map bytes aligned to HUGE_PAGE_SIZE, so THP can back the whole range and not just its aligned middle
+void* map_thp(size_t bytes) {
+    const size_t padded = bytes + HUGE_PAGE_SIZE;
+    void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    const auto begin = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (begin + HUGE_PAGE_SIZE - 1) & ~(uintptr_t{HUGE_PAGE_SIZE} - 1);
+    if (aligned > begin) {
+        munmap(raw, aligned - begin);
+    }
+    if (const uintptr_t tail = begin + padded - (aligned + bytes); tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    auto* ptr = reinterpret_cast<void*>(aligned);
+    madvise(ptr, bytes, MADV_HUGEPAGE);
+    return ptr;
+}
+
+bool use_mapping(size_t bytes) {
+    return bytes >= MIN_BYTES && enabled();
+}
+#endif
+}  // namespace
+
+void* allocate(size_t bytes, size_t alignment) {
+#ifdef __linux__
+    if (use_mapping(bytes)) {
+        const size_t mapped = round_up(bytes);
+        Backing backing = Backing::HugeTlb;
+        void* ptr = map_hugetlb(mapped);
+        if (ptr == nullptr) {
+            backing = Backing::Thp;
+            ptr = map_thp(mapped);
+        }
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        (backing == Backing::HugeTlb ? hugetlb_bytes : thp_bytes).fetch_add(mapped, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mappings_mutex);
+        mappings.emplace(ptr, backing);
+        return ptr;
+    }
+#endif
+    if (bytes >= MIN_BYTES) {
+        fallback_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    return ::operator new(bytes, std::align_val_t{alignment});
+}
+
+void deallocate(void* ptr, size_t bytes, size_t alignment) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+#ifdef __linux__
+    if (use_mapping(bytes)) {
+        const size_t mapped = round_up(bytes);
+        Backing backing = Backing::Thp;
+        {
+            std::lock_guard<std::mutex> lock(mappings_mutex);
+            if (auto it = mappings.find(ptr); it != mappings.end()) {
+                backing = it->second;
+                mappings.erase(it);
+            }
+        }
+        (backing == Backing::HugeTlb ? hugetlb_bytes : thp_bytes).fetch_sub(mapped, std::memory_order_relaxed);
+        munmap(ptr, mapped);
+        return;
+    }
+#endif
+    if (bytes >= MIN_BYTES) {
+        fallback_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    ::operator delete(ptr, std::align_val_t{alignment});
+}
+
+Stats stats() {
+    return {.hugetlb_bytes = hugetlb_bytes.load(std::memory_order_relaxed),
+            .thp_bytes = thp_bytes.load(std::memory_order_relaxed),
+            .fallback_bytes = fallback_bytes.load(std::memory_order_relaxed),
+            .anon_huge_bytes = read_kb_field("/proc/self/smaps_rollup", "AnonHugePages:"),
+            .hugetlb_failures = hugetlb_failures.load(std::memory_order_relaxed)};
+}
+
+void log_stats() {
+    const Stats s = stats();
+    spdlog::info(
+        "Huge pages: {:.1f} MB hugetlbfs, {:.1f} MB madvised for THP ({:.1f} MB backed by THP process-wide), "
+        "{:.1f} MB regular pages, {} hugetlbfs fallbacks",
+        static_cast<double>(s.hugetlb_bytes) / kBytesPerMB, static_cast<double>(s.thp_bytes) / kBytesPerMB,
+        static_cast<double>(s.anon_huge_bytes) / kBytesPerMB, static_cast<double>(s.fallback_bytes) / kBytesPerMB,
+        s.hugetlb_failures);
+}
+}  // namespace HugePages
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+/**
+ * @brief Large allocations backed by 2 MB pages to cut TLB misses on graph-sized arrays.
+ *
+ * Allocations of at least `MIN_BYTES` are mapped directly with `mmap`. Explicit huge pages (`MAP_HUGETLB`) are used
+ * when the hugetlbfs pool has enough free pages, otherwise the 2 MB aligned mapping is marked with
+ * `madvise(MADV_HUGEPAGE)` so transparent huge pages can back it even in `madvise` THP mode. Smaller allocations,
+ * non-Linux platforms and `WIKIGRAPH_HUGE_PAGES=off` fall back to the global allocator.
+ */
+namespace HugePages {
+inline constexpr size_t HUGE_PAGE_SIZE = size_t{2} * 1024 * 1024;  // 2 MB
+inline constexpr size_t MIN_BYTES = size_t{4} * 1024 * 1024;  // Smaller arrays are not worth a dedicated mapping
+
+/** @brief Allocation counters since program start. */
+struct Stats {
+    uint64_t hugetlb_bytes;     // Currently mapped from the hugetlbfs pool
+    uint64_t thp_bytes;         // Currently mapped with MADV_HUGEPAGE
+    uint64_t fallback_bytes;    // Currently allocated from the global allocator despite being large
+    uint64_t anon_huge_bytes;   // AnonHugePages of the whole process, as reported by the kernel
+    uint64_t hugetlb_failures;  // MAP_HUGETLB attempts that fell back to THP
+};
+
+/**
+ * @brief Allocate at least `bytes` bytes aligned to `alignment`.
+ */
+void* allocate(size_t bytes, size_t alignment);
+
+/**
+ * @brief Free memory returned by allocate() with the same size and alignment.
+ */
+void deallocate(void* ptr, size_t bytes, size_t alignment) noexcept;
+
+/** @brief Current allocation counters. */
+Stats stats();
+
+/** @brief Log the allocation counters. */
+void log_stats();
+}  // namespace HugePages
+
+/**
+ * @brief Standard allocator serving its allocations from HugePages.
+ */
+template <typename T>
+class HugePageAllocator {
+   public:
+    using value_type = T;
+
+    HugePageAllocator() noexcept = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>& /*other*/) noexcept {}  // NOLINT(google-explicit-constructor)
+
+    [[nodiscard]] T* allocate(size_t count) {
+        if (count > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(HugePages::allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t count) noexcept {
+        HugePages::deallocate(ptr, count * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>& /*other*/) const noexcept {
+        return true;
+    }
+};
@@ -0,0 +1,26 @@
+#include "MemoryFootprint.h"
+
+#include "Utils/ProcessStats.h"
+#include "spdlog/spdlog.h"
+
+namespace MemoryFootprint {
+namespace {
+constexpr double kBytesPerMB = 1024 * 1024;
+}  // namespace
+
+MemorySnapshot snapshot(std::string stage, std::vector<StructureMemory> structures) {
+    return {.stage = std::move(stage),
+            .rss_bytes = ProcessStats::current_rss_bytes(),
+            .structures = std::move(structures)};
+}
+
+void log(const MemorySnapshot& snapshot) {
+    spdlog::info("Memory after {}: RSS {:.1f} MB, structures {:.1f} MB", snapshot.stage,
+                 static_cast<double>(snapshot.rss_bytes) / kBytesPerMB,
+                 static_cast<double>(snapshot.structure_bytes()) / kBytesPerMB);
+    for (const StructureMemory& structure : snapshot.structures) {
+        spdlog::info("  {}: {:.1f} MB, {} elements", structure.name,
+                     static_cast<double>(structure.bytes) / kBytesPerMB, structure.elements);
+    }
+}
+}  // namespace MemoryFootprint
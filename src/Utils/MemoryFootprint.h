@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Utils/Hashmap.h"
+
+/**
+ * @brief Heap memory held by one data structure.
+ */
+struct StructureMemory {
+    std::string name;
+    uint64_t elements = 0;
+    uint64_t bytes = 0;  // Capacity times element size, plus the heap blocks of strings and hash buckets
+};
+
+/**
+ * @brief Structure footprints and process RSS after one stage of the load.
+ */
+struct MemorySnapshot {
+    std::string stage;  // Stage that had just finished
+    uint64_t rss_bytes = 0;
+    std::vector<StructureMemory> structures;
+
+    /** @brief Sum over all structures. */
+    [[nodiscard]] uint64_t structure_bytes() const {
+        uint64_t total = 0;
+        for (const StructureMemory& structure : structures) {
+            total += structure.bytes;
+        }
+        return total;
+    }
+};
+
+/**
+ * @brief Footprints computed from capacities and the layout of the containers, without walking the heap.
+ *
+ * Hash table sizes follow the bucket layout of the configured backend (emhash6, emhash8 or libstdc++'s
+ * std::unordered_map) and leave out allocator headers.
+ */
+namespace MemoryFootprint {
+/** @brief Heap block of a string, 0 while it fits the small-string buffer. */
+inline uint64_t string_bytes(const std::string& text) {
+    static const size_t inline_capacity = std::string().capacity();
+    return text.capacity() > inline_capacity ? text.capacity() + 1 : 0;
+}
+
+/** @brief Element array of a vector. */
+template <typename T, typename Alloc>
+uint64_t vector_bytes(const std::vector<T, Alloc>& vector) {
+    return vector.capacity() * sizeof(T);
+}
+
+namespace detail {
+constexpr size_t round_up(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+template <typename Map>
+uint64_t key_bytes(const Map& map) {
+    uint64_t bytes = 0;
+    if constexpr (std::is_same_v<typename Map::key_type, std::string>) {
+        for (const auto& entry : map) {
+            bytes += string_bytes(entry.first);
+        }
+    }
+    return bytes;
+}
+}  // namespace detail
+
+#ifdef USE_STD_UNORDERED_MAP
+/** @brief Bucket array, nodes and heap-allocated string keys of a hash table. */
+template <typename K, typename V, typename... Rest>
+uint64_t table_bytes(const std::unordered_map<K, V, Rest...>& map) {
+    // A node holds the next pointer, the value and, for keys without a trivial hash such as strings, the cached hash
+    constexpr size_t hash_bytes = std::is_integral_v<K> ? 0 : sizeof(size_t);
+    constexpr size_t node_bytes =
+        detail::round_up(sizeof(void*) + sizeof(std::pair<const K, V>) + hash_bytes, alignof(std::max_align_t));
+    return (map.bucket_count() * sizeof(void*)) + (map.size() * node_bytes) + detail::key_bytes(map);
+}
+#else
+/** @brief Bucket array, empty-bucket bitmask and heap-allocated string keys of a hash table. */
+template <typename K, typename V, typename... Rest>
+uint64_t table_bytes(const emhash6::HashMap<K, V, Rest...>& map) {
+    // Every bucket stores the pair in place next to a 32-bit link to the next bucket of its chain
+    constexpr size_t slot_bytes =
+        detail::round_up(sizeof(std::pair<K, V>) + sizeof(uint32_t), alignof(std::pair<K, V>));
+    return (map.bucket_count() * slot_bytes) + (map.bucket_count() / 8) + detail::key_bytes(map);
+}
+
+/** @brief Index, dense pair array and heap-allocated string keys of a hash table. */
+template <typename K, typename V, typename... Rest>
+uint64_t table_bytes(const emhash8::HashMap<K, V, Rest...>& map) {
+    // The index has a link and a slot number per bucket, the pairs are sized for the maximum load factor
+    const auto pair_slots = static_cast<uint64_t>(static_cast<double>(map.bucket_count()) * map.max_load_factor());
+    return (map.bucket_count() * 2 * sizeof(uint32_t)) + (pair_slots * sizeof(std::pair<K, V>)) +
+           detail::key_bytes(map);
+}
+#endif
+
+/** @brief Footprint of an optional hash table, zero when it was destroyed. */
+template <typename Map>
+StructureMemory table(std::string name, const Map* map) {
+    if (map == nullptr) {
+        return {.name = std::move(name), .elements = 0, .bytes = 0};
+    }
+    return {.name = std::move(name), .elements = map->size(), .bytes = table_bytes(*map)};
+}
+
+/** @brief Take a snapshot of the given structures together with the current process RSS. */
+MemorySnapshot snapshot(std::string stage, std::vector<StructureMemory> structures);
+
+/** @brief Log every structure of a snapshot. */
+void log(const MemorySnapshot& snapshot);
+}  // namespace MemoryFootprint
@@ -0,0 +1,288 @@
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+bool CounterValues::any() const {
+    for (bool is_valid : valid) {
+        if (is_valid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+double CounterValues::ipc() const {
+    if (!has(HwCounter::Cycles) || !has(HwCounter::Instructions) || get(HwCounter::Cycles) == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(get(HwCounter::Instructions)) / static_cast<double>(get(HwCounter::Cycles));
+}
+
+CounterValues CounterValues::operator-(const CounterValues& earlier) const {
+    CounterValues diff;
+    for (size_t i = 0; i < COUNT; i++) {
+        diff.valid[i] = valid[i] && earlier.valid[i];
+        diff.values[i] = diff.valid[i] && values[i] >= earlier.values[i] ? values[i] - earlier.values[i] : 0;
+    }
+    return diff;
+}
+
+CounterValues& CounterValues::operator+=(const CounterValues& other) {
+    for (size_t i = 0; i < COUNT; i++) {
+        valid[i] = valid[i] && other.valid[i];
+        values[i] = valid[i] ? values[i] + other.values[i] : 0;
+    }
+    return *this;
+}
+
+namespace PerfCounters {
+namespace {
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables) set from the environment or a flag
+std::atomic<bool> is_requested{[] {
+    const char* value = std::getenv("WIKIGRAPH_PERF_COUNTERS");  // NOLINT(concurrency-mt-unsafe) read once
+    return value != nullptr && std::string_view(value) == "on";
+}()};
+
+#ifdef __linux__
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+std::atomic<bool> warned{false};
+
+int read_paranoid_level() {
+    std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+    int level = 0;
+    return file >> level ? level : -1;
+}
+
+// Threads that sessions with Scope::WithWorkers count, never destroyed since pool workers may outlive the statics
+struct TrackedThreads {
+    std::mutex mutex;
+    std::vector<pid_t> tids;
+};
+
+TrackedThreads& tracked_threads() {
+    static auto* threads = new TrackedThreads();
+    return *threads;
+}
+
+pid_t current_tid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));  // NOLINT(cppcoreguidelines-pro-type-vararg)
+}
+
+perf_event_attr attributes(HwCounter counter, bool leader) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+        case HwCounter::Cycles:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case HwCounter::Instructions:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case HwCounter::LlcMisses:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;  // Last-level cache misses on x86 and most ARM cores
+            break;
+        case HwCounter::DtlbMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case HwCounter::BranchMisses:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = leader ? 1 : 0;  // The whole group is enabled at once when every member is open
+    attr.inherit = 1;                // Also count threads started while the counter is open
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return attr;
+}
+
+int open_counter(HwCounter counter, pid_t tid, int group_fd) {
+    perf_event_attr attr = attributes(counter, group_fd < 0);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg) no glibc wrapper for perf_event_open
+    const auto fd = syscall(SYS_perf_event_open, &attr, tid, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+        if (!warned.exchange(true)) {
+            spdlog::warn("Hardware counter {} unavailable: {} (perf_event_paranoid={})", name(counter),
+                         std::strerror(errno), read_paranoid_level());  // NOLINT(concurrency-mt-unsafe)
+        }
+        return -1;
+    }
+    return static_cast<int>(fd);
+}
+
+// Open every counter of a thread as one group led by the cycles counter; without the leader nothing is counted
+std::array<int, CounterValues::COUNT> open_group(pid_t tid) {
+    std::array<int, CounterValues::COUNT> group{};
+    group.fill(-1);
+    group[0] = open_counter(static_cast<HwCounter>(0), tid, -1);
+    if (group[0] < 0) {
+        return group;
+    }
+    for (size_t i = 1; i < group.size(); i++) {
+        group[i] = open_counter(static_cast<HwCounter>(i), tid, group[0]);
+    }
+    ioctl(group[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    return group;
+}
+
+// Counts of one group, all scaled by the same factor since its counters are only ever scheduled together
+CounterValues read_group(const std::array<int, CounterValues::COUNT>& group) {
+    CounterValues result;
+    if (group[0] < 0) {
+        return result;
+    }
+    struct {
+        uint64_t nr;
+        uint64_t time_enabled;
+        uint64_t time_running;
+        std::array<uint64_t, CounterValues::COUNT> values;  // In the order the members were opened
+    } data{};
+    const ssize_t size = ::read(group[0], &data, sizeof(data));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || data.time_running == 0) {
+        return result;
+    }
+    // The kernel time-shares counters when more are open than the PMU has, extrapolate to the whole interval
+    const double scale = static_cast<double>(data.time_enabled) / static_cast<double>(data.time_running);
+    size_t member = 0;
+    for (size_t i = 0; i < group.size() && member < data.nr; i++) {
+        if (group[i] < 0) {
+            continue;
+        }
+        const uint64_t value = data.values[member++];
+        result.values[i] = data.time_running == data.time_enabled
+                               ? value
+                               : static_cast<uint64_t>(static_cast<double>(value) * scale);
+        result.valid[i] = true;
+    }
+    return result;
+}
+#endif
+}  // namespace
+
+void request() {
+    is_requested.store(true, std::memory_order_relaxed);
+}
+
+bool requested() {
+    return is_requested.load(std::memory_order_relaxed);
+}
+
+std::string_view name(HwCounter counter) {
+    switch (counter) {
+        case HwCounter::Cycles:
+            return "cycles";
+        case HwCounter::Instructions:
+            return "instructions";
+        case HwCounter::LlcMisses:
+            return "llc_misses";
+        case HwCounter::DtlbMisses:
+            return "dtlb_misses";
+        case HwCounter::BranchMisses:
+            return "branch_misses";
+    }
+    return "unknown";
+}
+
+void track_this_thread() {
+#ifdef __linux__
+    TrackedThreads& threads = tracked_threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    threads.tids.push_back(current_tid());
+#endif
+}
+
+void untrack_this_thread() {
+#ifdef __linux__
+    TrackedThreads& threads = tracked_threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    std::erase(threads.tids, current_tid());
+#endif
+}
+
+Session::Session([[maybe_unused]] Scope scope) {
+#ifdef __linux__
+    if (!requested()) {
+        return;
+    }
+    const pid_t self = current_tid();
+    groups_.push_back(open_group(self));
+    if (scope == Scope::WithWorkers) {
+        // Under the mutex a tracked thread cannot exit and hand its id to an unrelated thread meanwhile
+        TrackedThreads& threads = tracked_threads();
+        std::lock_guard<std::mutex> lock(threads.mutex);
+        for (const pid_t tid : threads.tids) {
+            if (tid != self) {
+                groups_.push_back(open_group(tid));
+            }
+        }
+    }
+#endif
+}
+
+Session::~Session() {
+#ifdef __linux__
+    for (const Group& group : groups_) {
+        for (int fd : group) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+#endif
+}
+
+CounterValues Session::read() const {
+    CounterValues result;
+#ifdef __linux__
+    if (groups_.empty()) {
+        return result;
+    }
+    result = read_group(groups_.front());
+    // A worker that has not run since the session opened has no counts rather than invalid ones
+    for (size_t g = 1; g < groups_.size(); g++) {
+        const CounterValues worker = read_group(groups_[g]);
+        for (size_t i = 0; i < CounterValues::COUNT; i++) {
+            if (result.valid[i] && worker.valid[i]) {
+                result.values[i] += worker.values[i];
+            }
+        }
+    }
+#endif
+    return result;
+}
+
+void log(std::string_view label, const CounterValues& values) {
+    if (!values.any()) {
+        return;
+    }
+    std::string counters;
+    for (size_t i = 0; i < CounterValues::COUNT; i++) {
+        const auto counter = static_cast<HwCounter>(i);
+        if (values.has(counter)) {
+            counters += std::format(" {}={}", name(counter), values.get(counter));
+        }
+    }
+    spdlog::info("{} counters: ipc={:.2f}{}", label, values.ipc(), counters);
+}
+}  // namespace PerfCounters
@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Hardware events counted by PerfCounters::Session.
+ */
+enum class HwCounter : uint8_t { Cycles, Instructions, LlcMisses, DtlbMisses, BranchMisses };
+
+/**
+ * @brief Hardware counter values, or differences of them. A counter the CPU or kernel did not provide is invalid.
+ */
+struct CounterValues {
+    static constexpr size_t COUNT = 5;
+
+    std::array<uint64_t, COUNT> values{};
+    std::array<bool, COUNT> valid{};
+
+    [[nodiscard]] bool has(HwCounter counter) const {
+        return valid[static_cast<size_t>(counter)];
+    }
+    [[nodiscard]] uint64_t get(HwCounter counter) const {
+        return values[static_cast<size_t>(counter)];
+    }
+    /** @brief Whether any counter is valid. */
+    [[nodiscard]] bool any() const;
+    /** @brief Instructions per cycle, 0 without both counters. */
+    [[nodiscard]] double ipc() const;
+
+    /** @brief Counts between two reads of the same session. */
+    CounterValues operator-(const CounterValues& earlier) const;
+    /** @brief Add the counts of another interval, a counter stays valid only if both have it. */
+    CounterValues& operator+=(const CounterValues& other);
+};
+
+/**
+ * @brief Optional hardware performance counters through Linux `perf_event_open`.
+ *
+ * Off unless `WIKIGRAPH_PERF_COUNTERS=on` is set or request() is called. Counters only cover user space, so they
+ * work with the default `perf_event_paranoid` of 2; when the kernel still refuses (higher paranoia, containers
+ * without the syscall, other platforms) sessions stay empty and a single warning is logged.
+ */
+namespace PerfCounters {
+/** @brief Turn counting on, e.g. from a command line flag. */
+void request();
+/** @brief Whether counting was requested. */
+bool requested();
+
+/** @brief Short name of a counter for logs and reports, e.g. "llc_misses". */
+std::string_view name(HwCounter counter);
+
+/**
+ * @brief Let sessions with Scope::WithWorkers count the calling thread until untrack_this_thread().
+ *
+ * For pool workers: a session only receives the counts of a thread it inherited when that thread exits, which a
+ * parked worker does not do before the session reads.
+ */
+void track_this_thread();
+/** @brief Stop offering the calling thread to new sessions, before it exits. */
+void untrack_this_thread();
+
+/**
+ * @brief Counters of the calling thread and of the threads it starts while the session is open.
+ *
+ * The counters of every thread are opened as one group, so they count over the same intervals even when the kernel
+ * has to multiplex them. Threads that already existed when the session opened are only counted with
+ * Scope::WithWorkers, and only if they are tracked. Workers of a pool created while the session is open are counted
+ * when they exit, so a pool that outlives the session, such as WThreadPool::shared(), has to exist before it opens.
+ */
+class Session {
+   public:
+    enum class Scope : uint8_t {
+        Thread,       // The calling thread and the threads it starts
+        WithWorkers,  // Also every tracked thread alive when the session opens, e.g. the workers of a pool
+    };
+
+    explicit Session(Scope scope = Scope::Thread);
+    ~Session();
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    Session(Session&&) = delete;
+    Session& operator=(Session&&) = delete;
+
+    /** @brief Counts since the session opened, scaled up if the kernel had to multiplex the counters. */
+    [[nodiscard]] CounterValues read() const;
+
+   private:
+    using Group = std::array<int, CounterValues::COUNT>;  // Counter fds of one thread, -1 for those not opened
+
+    std::vector<Group> groups_;  // The calling thread's group first
+};
+
+/** @brief Log the counters of an interval, nothing if none is valid. */
+void log(std::string_view label, const CounterValues& values);
+}  // namespace PerfCounters
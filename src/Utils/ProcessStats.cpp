@@ -0,0 +1,117 @@
+#include "ProcessStats.h"
+
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+// windows.h must come first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace ProcessStats {
+namespace {
+#ifdef __linux__
+// Read a "<field>:   1234 kB" line of /proc/self/status
+uint64_t status_kb(std::string_view field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with(field) && line.size() > field.size() && line[field.size()] == ':') {
+            return std::stoull(line.substr(field.size() + 1)) * 1024;
+        }
+    }
+    return 0;
+}
+#endif
+
+#ifdef _WIN32
+PROCESS_MEMORY_COUNTERS memory_counters() {
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters;
+}
+#endif
+}  // namespace
+
+double cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation;
+    FILETIME exit;
+    FILETIME kernel;
+    FILETIME user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) == 0) {
+        return 0.0;
+    }
+    auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return static_cast<double>(ticks(kernel) + ticks(user)) / 1e7;  // 100 ns ticks
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+    }
+    auto seconds = [](const timeval& time) { return static_cast<double>(time.tv_sec) + time.tv_usec / 1e6; };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+#endif
+}
+
+uint64_t current_rss_bytes() {
+#if defined(__linux__)
+    return status_kb("VmRSS");
+#elif defined(_WIN32)
+    return memory_counters().WorkingSetSize;
+#else
+    return 0;
+#endif
+}
+
+uint64_t peak_rss_bytes() {
+#if defined(__linux__)
+    return status_kb("VmHWM");
+#elif defined(_WIN32)
+    return memory_counters().PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);  // Bytes on macOS
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+bool reset_peak_rss() {
+#ifdef __linux__
+    // "5" resets the VmHWM high-water mark to the current RSS (see proc(5), /proc/pid/clear_refs)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return clear_refs.good();
+#else
+    return false;
+#endif
+}
+
+bool trim_heap() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+    return true;
+#else
+    return false;
+#endif
+}
+}  // namespace ProcessStats
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief CPU time and resident memory of this process, for benchmark reports.
+ *
+ * Values a platform cannot provide are reported as 0.
+ */
+namespace ProcessStats {
+/** @brief User plus system CPU time of all threads so far, in seconds. */
+double cpu_seconds();
+
+/** @brief Resident set size right now, in bytes. */
+uint64_t current_rss_bytes();
+
+/** @brief Highest resident set size since start or since the last reset_peak_rss(), in bytes. */
+uint64_t peak_rss_bytes();
+
+/**
+ * @brief Restart peak tracking from the current resident set size, so a peak can be measured per stage.
+ * @return false if the platform only tracks the peak over the whole process lifetime (only Linux can reset it)
+ */
+bool reset_peak_rss();
+
+/**
+ * @brief Return free heap memory to the system, so memory a previous stage freed does not count as resident.
+ * @return false if the allocator cannot release it (only glibc's can)
+ */
+bool trim_heap();
+}  // namespace ProcessStats
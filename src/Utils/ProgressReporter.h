@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Decides when a hot loop should publish progress, reading the clock only every N ticks.
+ *
+ * tick() is a countdown; only when it runs out does the reporter read the clock. It then adapts N so that clock
+ * reads land about CHECKS_PER_INTERVAL times per interval: N doubles while checks come too often and halves when they
+ * come too rarely, so loops of any speed settle at a few clock reads per refresh instead of one per iteration.
+ *
+ * Not thread-safe, every loop owns its reporter.
+ */
+class ProgressReporter {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint64_t CHECKS_PER_INTERVAL = 4;
+    static constexpr uint64_t MAX_STRIDE = uint64_t{1} << 24;
+
+    /**
+     * @param interval Minimum time between two reports, usually UIState::refresh_rate
+     * @param initial_stride Ticks before the first clock read
+     */
+    explicit ProgressReporter(std::chrono::milliseconds interval, uint64_t initial_stride = 16)
+        : interval_(interval),
+          target_check_(interval / CHECKS_PER_INTERVAL),
+          stride_(std::max<uint64_t>(initial_stride, 1)),
+          countdown_(stride_),
+          start_(Clock::now()),
+          last_check_(start_),
+          last_report_(start_) {}
+
+    /**
+     * @brief Count `amount` iterations and tell whether it is time to report.
+     * @return True at most once per interval
+     */
+    [[nodiscard]] bool tick(uint64_t amount = 1) {
+        if (amount < countdown_) {
+            countdown_ -= amount;
+            return false;
+        }
+        return check();
+    }
+
+    /** @brief Iterations per second since construction, for the speed shown next to the progress. */
+    [[nodiscard]] double rate(uint64_t count) const {
+        const double seconds = std::chrono::duration<double>(Clock::now() - start_).count();
+        return static_cast<double>(count) / std::max(seconds, 1e-6);
+    }
+
+    [[nodiscard]] Clock::time_point start() const {
+        return start_;
+    }
+
+   private:
+    bool check() {
+        const auto now = Clock::now();
+        const auto since_check = now - last_check_;
+        if (since_check < target_check_ / 2) {
+            stride_ = std::min(stride_ * 2, MAX_STRIDE);
+        } else if (since_check > target_check_ * 2) {
+            stride_ = std::max<uint64_t>(stride_ / 2, 1);
+        }
+        countdown_ = stride_;
+        last_check_ = now;
+
+        if (now - last_report_ < interval_) {
+            return false;
+        }
+        last_report_ = now;
+        return true;
+    }
+
+    Clock::duration interval_;
+    Clock::duration target_check_;
+    uint64_t stride_;
+    uint64_t countdown_;
+    Clock::time_point start_;
+    Clock::time_point last_check_;
+    Clock::time_point last_report_;
+};
@@ -0,0 +1,300 @@
+#include "ResourceProbe.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace ResourceProbe {
+namespace {
+constexpr uint64_t kMB = 1024 * 1024;
+constexpr uint64_t kMinPipelineBudget = 32 * kMB;
+constexpr uint64_t kMaxPipelineBudget = 512 * kMB;
+// Fraction of the memory limit handed to a load pipeline's in-flight data, the loaded tables need the rest
+constexpr uint64_t kPipelineBudgetDivisor = 16;
+// cgroup v1 reports "no limit" as a huge page-aligned number
+constexpr uint64_t kUnlimitedThreshold = uint64_t{1} << 60;
+
+std::optional<std::string> read_first_line(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line)) {
+        return std::nullopt;
+    }
+    return line;
+}
+
+// The whole text must be the number, so "8x" or an out-of-range value is rejected rather than cut short
+std::optional<uint64_t> parse_uint(std::string_view text) {
+    uint64_t value = 0;
+    auto [ptr, err] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (err != std::errc() || ptr == text.data() || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<uint64_t> env_value(const char* name, bool is_size) {
+    const char* value = std::getenv(name);  // NOLINT(concurrency-mt-unsafe) read once at startup
+    if (value == nullptr || *value == '\0') {
+        return std::nullopt;
+    }
+    auto parsed = is_size ? parse_size(value) : parse_uint(value);
+    if (!parsed || *parsed == 0) {
+        spdlog::warn("Ignoring invalid value '{}' of {}", value, name);
+        return std::nullopt;
+    }
+    return parsed;
+}
+
+#ifdef __linux__
+constexpr const char* kCgroupRoot = "/sys/fs/cgroup";
+
+// Path of this process's cgroup v2 group relative to the unified hierarchy, from the "0::/path" line
+std::optional<std::filesystem::path> cgroup_v2_path() {
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.starts_with("0::")) {
+            return std::filesystem::path(line.substr(3)).relative_path();
+        }
+    }
+    return std::nullopt;
+}
+
+// Path of this process's group in the cgroup v1 hierarchy of `controller`, from its "<id>:<controllers>:/path" line
+std::optional<std::filesystem::path> cgroup_v1_path(std::string_view controller) {
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t first = line.find(':');
+        const size_t second = first == std::string::npos ? std::string::npos : line.find(':', first + 1);
+        if (second == std::string::npos) {
+            continue;
+        }
+        std::string_view controllers = std::string_view(line).substr(first + 1, second - first - 1);
+        while (!controllers.empty()) {
+            const size_t comma = controllers.find(',');
+            if (controllers.substr(0, comma) == controller) {
+                return std::filesystem::path(line.substr(second + 1)).relative_path();
+            }
+            controllers.remove_prefix(comma == std::string_view::npos ? controllers.size() : comma + 1);
+        }
+    }
+    return std::nullopt;
+}
+
+// Walk from the process's cgroup up to the root of its hierarchy and return the smallest limit, since every ancestor
+// applies. Inside a container the hierarchy is often mounted at the container's own group, then the path from
+// /proc/self/cgroup does not exist below the mount and only the limits from the mount point upwards are read.
+template <typename ReadLimit>
+std::optional<double> min_over_ancestors(const std::filesystem::path& root, const std::filesystem::path& relative,
+                                         ReadLimit read_limit) {
+    std::optional<double> result;
+    std::filesystem::path dir = relative.empty() ? root : root / relative;
+    while (true) {
+        if (auto limit = read_limit(dir)) {
+            result = result ? std::min(*result, *limit) : *limit;
+        }
+        if (dir == root || !dir.has_parent_path() || dir.parent_path() == dir) {
+            break;
+        }
+        dir = dir.parent_path();
+    }
+    return result;
+}
+
+// cgroup v2 "cpu.max" holds "<quota> <period>" or "max <period>"
+std::optional<double> read_cpu_max(const std::filesystem::path& dir) {
+    auto line = read_first_line(dir / "cpu.max");
+    if (!line) return std::nullopt;
+    std::istringstream stream(*line);
+    std::string quota;
+    std::string period;
+    stream >> quota >> period;
+    auto quota_us = parse_uint(quota);
+    auto period_us = parse_uint(period);
+    if (!quota_us || !period_us || *period_us == 0) return std::nullopt;  // "max" means no quota
+    return static_cast<double>(*quota_us) / static_cast<double>(*period_us);
+}
+
+std::optional<double> read_memory_max(const std::filesystem::path& dir) {
+    auto line = read_first_line(dir / "memory.max");
+    if (!line) return std::nullopt;
+    auto bytes = parse_uint(*line);  // "max" means no limit
+    if (!bytes) return std::nullopt;
+    return static_cast<double>(*bytes);
+}
+
+// cgroup v1 "cpu.cfs_quota_us" is -1 without a quota
+std::optional<double> read_cfs_quota(const std::filesystem::path& dir) {
+    auto quota = read_first_line(dir / "cpu.cfs_quota_us");
+    auto period = read_first_line(dir / "cpu.cfs_period_us");
+    if (!quota || !period || quota->starts_with('-')) return std::nullopt;
+    auto quota_us = parse_uint(*quota);
+    auto period_us = parse_uint(*period);
+    if (!quota_us || !period_us || *period_us == 0) return std::nullopt;
+    return static_cast<double>(*quota_us) / static_cast<double>(*period_us);
+}
+
+std::optional<double> read_memory_limit_in_bytes(const std::filesystem::path& dir) {
+    auto line = read_first_line(dir / "memory.limit_in_bytes");
+    if (!line) return std::nullopt;
+    auto bytes = parse_uint(*line);
+    if (!bytes || *bytes >= kUnlimitedThreshold) return std::nullopt;
+    return static_cast<double>(*bytes);
+}
+
+// cgroup v1 mounts every controller as its own hierarchy, the cpu controller under one of two names
+std::optional<double> cgroup_v1_cpu_quota() {
+    const std::filesystem::path relative = cgroup_v1_path("cpu").value_or("");
+    for (const char* mount : {"/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu"}) {
+        if (std::filesystem::exists(mount)) {
+            return min_over_ancestors(mount, relative, read_cfs_quota);
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<double> cgroup_v1_memory_limit() {
+    return min_over_ancestors(std::filesystem::path(kCgroupRoot) / "memory", cgroup_v1_path("memory").value_or(""),
+                              read_memory_limit_in_bytes);
+}
+
+unsigned int affinity_cpu_count() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return 0;
+    }
+    return static_cast<unsigned int>(CPU_COUNT(&set));
+}
+
+uint64_t physical_memory() {
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGE_SIZE);
+    if (pages <= 0 || page_size <= 0) return 0;
+    return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+}
+#endif
+}  // namespace
+
+std::optional<uint64_t> parse_size(std::string_view text) {
+    uint64_t value = 0;
+    auto [ptr, err] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (err != std::errc() || ptr == text.data()) {
+        return std::nullopt;
+    }
+    const std::string_view suffix(ptr, text.data() + text.size() - ptr);
+    if (suffix.empty()) {
+        return value;
+    }
+    if (suffix.size() != 1) {
+        return std::nullopt;
+    }
+    uint64_t unit = 0;
+    switch (std::toupper(static_cast<unsigned char>(suffix.front()))) {
+        case 'K':
+            unit = 1024;
+            break;
+        case 'M':
+            unit = kMB;
+            break;
+        case 'G':
+            unit = 1024 * kMB;
+            break;
+        default:
+            return std::nullopt;
+    }
+    if (value > std::numeric_limits<uint64_t>::max() / unit) {
+        return std::nullopt;
+    }
+    return value * unit;
+}
+
+SystemResources probe() {
+    SystemResources res{};
+    res.hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    res.cpu_count = res.hardware_threads;
+
+#ifdef __linux__
+    // Affinity mask already reflects the cpuset the container was given
+    if (const unsigned int affinity = affinity_cpu_count(); affinity > 0) {
+        res.cpu_count = std::min(res.cpu_count, affinity);
+    }
+
+    std::optional<double> cpu_quota;
+    std::optional<double> memory_limit;
+    const bool unified_hierarchy = std::filesystem::exists(std::filesystem::path(kCgroupRoot) / "cgroup.controllers");
+    if (auto relative = cgroup_v2_path(); relative && unified_hierarchy) {
+        cpu_quota = min_over_ancestors(kCgroupRoot, *relative, read_cpu_max);
+        memory_limit = min_over_ancestors(kCgroupRoot, *relative, read_memory_max);
+    } else {
+        cpu_quota = cgroup_v1_cpu_quota();
+        memory_limit = cgroup_v1_memory_limit();
+    }
+
+    if (cpu_quota) {
+        // A quota of 2.5 CPUs still lets 3 threads make progress
+        const auto quota_cpus = static_cast<unsigned int>(std::max(1.0, std::ceil(*cpu_quota)));
+        res.cpu_count = std::min(res.cpu_count, quota_cpus);
+    }
+
+    res.memory_limit_bytes = physical_memory();
+    if (memory_limit && (res.memory_limit_bytes == 0 || *memory_limit < static_cast<double>(res.memory_limit_bytes))) {
+        res.memory_limit_bytes = static_cast<uint64_t>(*memory_limit);
+    }
+#endif
+
+    res.worker_threads = res.cpu_count;
+    res.decompression_threads = res.cpu_count;
+    if (auto limit = env_value("WIKIGRAPH_MEMORY_LIMIT", true)) {
+        res.memory_limit_bytes = *limit;
+    }
+    res.pipeline_budget_bytes = res.memory_limit_bytes > 0
+                                    ? std::clamp(res.memory_limit_bytes / kPipelineBudgetDivisor, kMinPipelineBudget,
+                                                 kMaxPipelineBudget)
+                                    : 256 * kMB;
+
+    if (auto threads = env_value("WIKIGRAPH_THREADS", false)) {
+        res.worker_threads = static_cast<unsigned int>(*threads);
+    }
+    if (auto threads = env_value("WIKIGRAPH_DECOMPRESSION_THREADS", false)) {
+        res.decompression_threads = static_cast<unsigned int>(*threads);
+    }
+    if (auto budget = env_value("WIKIGRAPH_PIPELINE_BUDGET", true)) {
+        res.pipeline_budget_bytes = *budget;
+    }
+
+    return res;
+}
+
+const SystemResources& get() {
+    static const SystemResources resources = probe();
+    return resources;
+}
+
+void log_resources(const SystemResources& resources) {
+    spdlog::info(
+        "Resources: {} usable CPUs of {} hardware threads, {} worker threads, {} decompression threads, "
+        "memory limit {} MB, pipeline budget {} MB",
+        resources.cpu_count, resources.hardware_threads, resources.worker_threads, resources.decompression_threads,
+        resources.memory_limit_bytes / kMB, resources.pipeline_budget_bytes / kMB);
+}
+}  // namespace ResourceProbe
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+ * @brief CPU and memory resources available to this process, taking container limits into account.
+ */
+struct SystemResources {
+    unsigned int hardware_threads;       // std::thread::hardware_concurrency() of the host
+    unsigned int cpu_count;              // CPUs usable after affinity/cpuset and cgroup CPU quota
+    unsigned int worker_threads;         // Size of parser and graph build thread pools
+    unsigned int decompression_threads;  // Parallelization passed to rapidgzip
+    uint64_t memory_limit_bytes;         // cgroup memory limit, or physical memory if unlimited
+    uint64_t pipeline_budget_bytes;      // Byte budget of each load pipeline (see FlowControl)
+};
+
+/**
+ * @brief Detects the resources this process may actually use.
+ *
+ * Reads the CPU affinity mask (which reflects the cpuset), the cgroup v2 `cpu.max`/`memory.max` files of the
+ * process's cgroup and its ancestors, and the cgroup v1 `cpu.cfs_quota_us`/`memory.limit_in_bytes` files.
+ * Every derived value can be overridden with an environment variable:
+ *  - `WIKIGRAPH_THREADS`: worker pool size
+ *  - `WIKIGRAPH_DECOMPRESSION_THREADS`: rapidgzip parallelization
+ *  - `WIKIGRAPH_MEMORY_LIMIT`: memory limit, accepts K/M/G suffixes
+ *  - `WIKIGRAPH_PIPELINE_BUDGET`: load pipeline byte budget, accepts K/M/G suffixes
+ */
+namespace ResourceProbe {
+/**
+ * @brief Probe resources once and return the cached result on later calls.
+ */
+const SystemResources& get();
+
+/**
+ * @brief Probe resources without caching.
+ */
+SystemResources probe();
+
+/**
+ * @brief Log the detected resources.
+ */
+void log_resources(const SystemResources& resources);
+
+/**
+ * @brief Parse a byte size with an optional K/M/G suffix, e.g. "512M".
+ * @return nullopt for anything else, including trailing characters ("8Gx") and sizes that overflow 64 bits
+ */
+std::optional<uint64_t> parse_size(std::string_view text);
+}  // namespace ResourceProbe
@@ -0,0 +1,98 @@
+#include "Sha1.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+// https://datatracker.ietf.org/doc/html/rfc3174
+Sha1::Sha1() : state_{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0} {}
+
+void Sha1::update(std::string_view data) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t size = data.size();
+    total_bytes_ += size;
+
+    // Top up a partially filled block first
+    if (block_size_ > 0) {
+        const size_t count = std::min(size, block_.size() - block_size_);
+        std::memcpy(block_.data() + block_size_, bytes, count);
+        block_size_ += count;
+        bytes += count;
+        size -= count;
+        if (block_size_ < block_.size()) {
+            return;
+        }
+        process_block(block_.data());
+        block_size_ = 0;
+    }
+    // Whole blocks straight from the input
+    for (; size >= block_.size(); bytes += block_.size(), size -= block_.size()) {
+        process_block(bytes);
+    }
+    std::memcpy(block_.data(), bytes, size);
+    block_size_ = size;
+}
+
+std::string Sha1::hex_digest() {
+    const uint64_t total_bits = total_bytes_ * 8;
+    // Pad with 0x80, zeros up to 56 bytes mod 64, then the message length in bits as big-endian
+    const std::array<char, 1> marker{static_cast<char>(0x80)};
+    update({marker.data(), marker.size()});
+    const std::array<char, 64> zeros{};
+    update({zeros.data(), (block_.size() + 56 - block_size_) % block_.size()});
+    std::array<char, 8> length{};
+    for (size_t i = 0; i < length.size(); i++) {
+        length[i] = static_cast<char>(total_bits >> (56 - 8 * i));
+    }
+    update({length.data(), length.size()});
+
+    std::string hex;
+    for (uint32_t word : state_) {
+        hex += std::format("{:08x}", word);
+    }
+    return hex;
+}
+
+void Sha1::process_block(const uint8_t* block) {
+    std::array<uint32_t, 80> w{};
+    for (size_t i = 0; i < 16; i++) {
+        w[i] = (uint32_t{block[4 * i]} << 24) | (uint32_t{block[4 * i + 1]} << 16) |
+               (uint32_t{block[4 * i + 2]} << 8) | uint32_t{block[4 * i + 3]};
+    }
+    for (size_t i = 16; i < 80; i++) {
+        w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    auto [a, b, c, d, e] = state_;
+    for (size_t i = 0; i < 80; i++) {
+        uint32_t f = 0;
+        uint32_t k = 0;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        const uint32_t temp = std::rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
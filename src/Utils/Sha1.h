@@ -0,0 +1,27 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Incremental SHA-1, as used by Wikimedia's published dump checksums.
+ */
+class Sha1 {
+   public:
+    Sha1();
+
+    /** @brief Hash more bytes. */
+    void update(std::string_view data);
+
+    /** @brief Finish hashing and return the digest as 40 lowercase hex characters. */
+    std::string hex_digest();
+
+   private:
+    void process_block(const uint8_t* block);
+
+    std::array<uint32_t, 5> state_;
+    std::array<uint8_t, 64> block_{};
+    size_t block_size_ = 0;
+    uint64_t total_bytes_ = 0;
+};
@@ -0,0 +1,19 @@
+#include "Telemetry.h"
+
+#include <format>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+void TelemetryRegistry::log() const {
+    if (!spdlog::should_log(spdlog::level::debug)) {
+        return;
+    }
+    for (const Reading& reading : read()) {
+        std::string fields;
+        for (const auto& [name, value] : reading.fields) {
+            fields += std::format(" {}={}", name, value);
+        }
+        spdlog::debug("Telemetry {}:{}", reading.channel, fields);
+    }
+}
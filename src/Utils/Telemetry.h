@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Lock-free single-writer channel for a small trivially copyable struct, built on a sequence lock.
+ *
+ * `std::atomic` of a struct wider than 16 bytes takes a hidden lock in libstdc++, so a progress write in a hot loop
+ * could wait for the UI thread reading it. Here the writer never waits: it makes the sequence number odd, stores the
+ * value word by word and makes the sequence even again. A reader copies the words and retries when the sequence
+ * changed meanwhile, so it always sees a value that was stored as a whole. The words are relaxed atomics, which keeps
+ * the torn copies a reader throws away free of data races.
+ *
+ * Only one thread may store at a time; any number may load.
+ */
+template <typename T>
+class Telemetry {
+    static_assert(std::is_trivially_copyable_v<T>, "Telemetry values are copied word by word");
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+   public:
+    Telemetry() {
+        store(T{});
+    }
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+    Telemetry(Telemetry&&) = delete;
+    Telemetry& operator=(Telemetry&&) = delete;
+    ~Telemetry() = default;
+
+    /** @brief Publish a new value. Never blocks. */
+    void store(const T& value) {
+        std::array<uint64_t, WORDS> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);  // Readers that see a new word also see the odd sequence
+        for (size_t i = 0; i < WORDS; i++) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    Telemetry& operator=(const T& value) {
+        store(value);
+        return *this;
+    }
+
+    /** @brief The last published value, retried while a store is under way. */
+    [[nodiscard]] T load() const {
+        std::array<uint64_t, WORDS> words{};
+        while (true) {
+            const uint64_t before = sequence_.load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                continue;
+            }
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        T value{};
+        std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+        return value;
+    }
+
+    /** @brief Number of stores so far, to tell whether the value changed since the last look. */
+    [[nodiscard]] uint64_t version() const {
+        return sequence_.load(std::memory_order_acquire) / 2;
+    }
+
+   private:
+    std::atomic<uint64_t> sequence_{0};
+    std::array<std::atomic<uint64_t>, WORDS> words_{};
+};
+
+/**
+ * @brief Named telemetry channels that the UI, the log and exporters can read the same way.
+ *
+ * Channels are registered while their owner is constructed, before other threads see it, and must outlive the
+ * registry. Reading a channel only loads it, so any thread can read at any time.
+ */
+class TelemetryRegistry {
+   public:
+    using Fields = std::vector<std::pair<std::string_view, uint64_t>>;
+
+    struct Reading {
+        std::string_view channel;
+        Fields fields;
+    };
+
+    /**
+     * @brief Register a struct channel.
+     * @param fields Splits a value into named numbers, e.g. `{{"current_bytes", p.current_bytes}, ...}`
+     */
+    template <typename T>
+    void add(std::string_view name, const Telemetry<T>& channel,
+             std::type_identity_t<Fields (*)(const T&)> fields) {
+        channels_.push_back({name, [&channel, fields] { return fields(channel.load()); }});
+    }
+
+    /** @brief Register a plain counter. */
+    template <std::integral T>
+    void add(std::string_view name, const std::atomic<T>& counter) {
+        channels_.push_back({name, [&counter] {
+                                 return Fields{{"value", static_cast<uint64_t>(counter.load(std::memory_order_relaxed))}};
+                             }});
+    }
+
+    /** @brief Current values of all channels, in registration order. */
+    [[nodiscard]] std::vector<Reading> read() const {
+        std::vector<Reading> readings;
+        readings.reserve(channels_.size());
+        for (const Channel& channel : channels_) {
+            readings.push_back({channel.name, channel.read()});
+        }
+        return readings;
+    }
+
+    /** @brief Log every channel at debug level. */
+    void log() const;
+
+   private:
+    struct Channel {
+        std::string_view name;
+        std::function<Fields()> read;
+    };
+    std::vector<Channel> channels_;
+};
@@ -1,36 +1,54 @@
 #pragma once
 
-#ifdef PARALLEL_DECOMPRESSION
-// Based on https://github.com/progschj/ThreadPool, modified to use modern C++ and moodycamel::ConcurrentQueue
+// Work-stealing thread pool. Every worker owns a Chase-Lev deque, tasks submitted from outside the pool go through a
+// shared injection queue, and idle workers park on an atomic wait instead of spinning with std::this_thread::yield().
+// Chase-Lev deque follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Nardelli 2013).
 
 // TODO: Use std::jthread and std::stop_source once Apple Clang supports them...
 // https://en.cppreference.com/w/cpp/compiler_support.html#:~:text=std%3A%3Astop_token%20and%20std%3A%3Ajthread%C2%A0%20(FTM)*
 
-#include <concurrentqueue.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "Utils/Affinity.h"
+#include "Utils/PerfCounters.h"
+#include "Utils/ResourceProbe.h"
+#include "Log/Trace.h"
+
 /**
- * Thread pool implementation using moodycamel::ConcurrentQueue for task management.
- * Provides efficient task scheduling with exception handling and graceful shutdown.
+ * Work-stealing thread pool with per-worker Chase-Lev deques, a global injection queue and parking of idle workers.
+ * Supports nested fork/join through parallel_for(): a thread waiting for its chunks keeps executing pool tasks, so
+ * parallel_for() called from inside a pool task does not deadlock or oversubscribe the machine.
  */
 class WThreadPool {
    public:
+    using Task = std::function<void()>;
+
     /**
      * Constructs a thread pool with the specified number of worker threads.
      * @param threads Number of worker threads to create
+     * @param pin_cpus CPUs to pin the workers to, worker i runs on pin_cpus[i % pin_cpus.size()]; empty leaves
+     *                 them unpinned (see Affinity::worker_cpus())
      */
-    inline WThreadPool(size_t threads);
-    
+    inline explicit WThreadPool(size_t threads, std::vector<unsigned int> pin_cpus = {});
+
     /**
      * Enqueues a task for execution by the thread pool.
+     * Tasks submitted by a pool worker go to that worker's own deque, all other submissions use the injection queue.
      * @param func Function to execute
      * @param args Arguments to pass to the function
      * @return Future containing the result of the task
@@ -38,9 +56,35 @@ class WThreadPool {
     template <class F, class... Args>
     [[nodiscard]]
     auto enqueue(F&& func, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
-    
+
     /**
-     * Destructor that gracefully shuts down all worker threads.
+     * Splits [begin, end) into chunks and runs body(chunk_begin, chunk_end) on the pool, blocking until all chunks
+     * finished. The calling thread executes chunks itself while waiting. The first exception thrown by a chunk is
+     * rethrown to the caller after every chunk has completed.
+     * @param begin First index of the range
+     * @param end One past the last index of the range
+     * @param body Callable invoked as body(size_t chunk_begin, size_t chunk_end)
+     * @param grain Chunk size, 0 picks one that yields a few chunks per worker
+     */
+    template <class Body>
+    void parallel_for(size_t begin, size_t end, Body&& body, size_t grain = 0);
+
+    /**
+     * Process-wide pool with ResourceProbe's worker_threads workers, pinned as Affinity::worker_cpus() says. Created
+     * on first use, so fork/join work outside the load pipeline (the graph build) reuses one set of parked workers
+     * instead of starting and joining threads every time.
+     */
+    static inline WThreadPool& shared();
+
+    /**
+     * Number of worker threads in the pool.
+     */
+    [[nodiscard]] size_t size() const {
+        return workers.size();
+    }
+
+    /**
+     * Destructor that runs the remaining tasks and then shuts down all worker threads.
      */
     inline ~WThreadPool();
 
@@ -51,37 +95,167 @@ class WThreadPool {
     WThreadPool& operator=(WThreadPool&&) = delete;
 
    private:
-    std::vector<std::thread> workers;  // Worker threads
-    moodycamel::ConcurrentQueue<std::function<void()>> tasks;  // Task queue
-    std::atomic<bool> stop{false};  // Stop flag for graceful shutdown
+    /**
+     * Chase-Lev deque. The owning worker pushes and pops at the bottom, any other thread steals from the top.
+     * Buffers only ever grow; replaced buffers are kept alive until the deque is destroyed so that a concurrent
+     * thief never reads freed memory.
+     */
+    class WorkStealingDeque {
+       public:
+        WorkStealingDeque() {
+            buffers.push_back(std::make_unique<Buffer>(INITIAL_CAPACITY));
+            buffer.store(buffers.back().get(), std::memory_order_relaxed);
+        }
+
+        // Owner only
+        void push(Task* task) {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            Buffer* buf = buffer.load(std::memory_order_relaxed);
+            if (b - t > buf->capacity - 1) {
+                buf = grow(buf, t, b);
+            }
+            buf->put(b, task);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        // Owner only
+        Task* pop() {
+            const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            Buffer* buf = buffer.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+
+            if (t > b) {  // Deque was empty
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Task* task = buf->get(b);
+            if (t == b) {  // Last element, race against thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    task = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return task;
+        }
+
+        // Any thread
+        Task* steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            Buffer* buf = buffer.load(std::memory_order_acquire);
+            Task* task = buf->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;  // Lost the race against another thief or the owner
+            }
+            return task;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+        }
+
+       private:
+        static constexpr int64_t INITIAL_CAPACITY = 1024;
+
+        struct Buffer {
+            explicit Buffer(int64_t cap) : capacity(cap), slots(std::make_unique<std::atomic<Task*>[]>(cap)) {}
+
+            [[nodiscard]] Task* get(int64_t index) const {
+                return slots[index & (capacity - 1)].load(std::memory_order_relaxed);
+            }
+            void put(int64_t index, Task* task) {
+                slots[index & (capacity - 1)].store(task, std::memory_order_relaxed);
+            }
+
+            int64_t capacity;  // Always a power of two
+            std::unique_ptr<std::atomic<Task*>[]> slots;
+        };
+
+        Buffer* grow(Buffer* old_buf, int64_t t, int64_t b) {
+            auto bigger = std::make_unique<Buffer>(old_buf->capacity * 2);
+            for (int64_t i = t; i < b; i++) {
+                bigger->put(i, old_buf->get(i));
+            }
+            buffers.push_back(std::move(bigger));
+            Buffer* new_buf = buffers.back().get();
+            buffer.store(new_buf, std::memory_order_release);
+            return new_buf;
+        }
+
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::atomic<Buffer*> buffer{nullptr};
+        std::vector<std::unique_ptr<Buffer>> buffers;  // Owner only, keeps retired buffers alive
+    };
+
+    struct Worker {
+        WorkStealingDeque deque;
+        std::thread thread;
+    };
+
+    // Shared state of one parallel_for() call, owned jointly by the caller and its chunk tasks
+    struct ForkJoinState {
+        std::atomic<size_t> pending{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+
+    static constexpr size_t NO_WORKER = SIZE_MAX;
+
+    std::vector<std::unique_ptr<Worker>> workers;  // Worker threads and their deques
+    std::mutex injection_mutex;                    // Guards injection_queue
+    std::deque<Task*> injection_queue;             // Tasks submitted from outside the pool
+    std::atomic<size_t> injection_size{0};         // Lock-free emptiness check for injection_queue
+    std::atomic<uint32_t> wake_epoch{0};           // Bumped on every submission, idle workers wait on it
+    std::atomic<uint32_t> sleeping{0};             // Number of parked workers
+    std::atomic<bool> stop{false};                 // Stop flag for graceful shutdown
+    std::vector<unsigned int> pin_cpus;            // CPUs workers are pinned to, empty if unpinned
+
+    // Identity of the current thread inside a pool, used to route submissions to the local deque
+    static inline thread_local WThreadPool* current_pool = nullptr;
+    static inline thread_local size_t current_index = NO_WORKER;
+
+    [[nodiscard]] size_t self_index() const {
+        return current_pool == this ? current_index : NO_WORKER;
+    }
+
+    inline void submit(Task* task);
+    inline void notify_workers(size_t count);
+    inline Task* find_task(size_t self);
+    inline bool run_one(size_t self);
+    inline bool has_work() const;
+    inline void worker_loop(size_t index);
+    inline void help_until_done(ForkJoinState& state);
 };
 
 // Constructor: launches worker threads
-inline WThreadPool::WThreadPool(size_t threads) {
+inline WThreadPool::WThreadPool(size_t threads, std::vector<unsigned int> cpus) : pin_cpus(std::move(cpus)) {
+    threads = std::max<size_t>(threads, 1);
+    workers.reserve(threads);
     for (size_t i = 0; i < threads; i++) {
-        workers.emplace_back([this] {
-            std::function<void()> task;
-            while (true) {
-                // Try to dequeue a task from the concurrent queue
-                if (tasks.try_dequeue(task)) {
-                    try {
-                        task();
-                    } catch (const std::exception& e) {
-                        spdlog::error("Task exception in WThreadPool: {}", e.what());
-                    }
-                } else {
-                    // No task available, check if the processing has finished and thread should stop
-                    if (stop.load()) {
-                        return;
-                    }
-                    // Yield to other threads to avoid busy waiting
-                    std::this_thread::yield();
-                }
-            }
-        });
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Start threads only after every deque exists, since workers steal from each other right away
+    for (size_t i = 0; i < threads; i++) {
+        workers[i]->thread = std::thread([this, i] { worker_loop(i); });
     }
 }
 
+inline WThreadPool& WThreadPool::shared() {
+    // Never destroyed: its workers stay parked until the process exits instead of being joined while the statics
+    // they log and trace through are torn down
+    static WThreadPool* pool = new WThreadPool(ResourceProbe::get().worker_threads, Affinity::worker_cpus());
+    return *pool;
+}
+
 // Enqueue a new task
 template <class F, class... Args>
 [[nodiscard]]
@@ -90,10 +264,9 @@ auto WThreadPool::enqueue(F&& func, Args&&... args) -> std::future<std::invoke_r
 
     // Create packaged task with forwarding of arguments
     auto task = std::make_shared<std::packaged_task<return_type()>>(
-        [task_func = std::forward<F>(func), ...task_args = std::forward<Args>(args)]() mutable {
+        [task_func = std::forward<F>(func), ... task_args = std::forward<Args>(args)]() mutable {
             return std::invoke(std::move(task_func), std::move(task_args)...);
-        }
-    );
+        });
 
     // Get the future from the packaged task
     std::future<return_type> res = task->get_future();
@@ -103,21 +276,210 @@ auto WThreadPool::enqueue(F&& func, Args&&... args) -> std::future<std::invoke_r
         throw std::runtime_error("enqueue on stopped WThreadPool");
     }
 
-    // Enqueue the task to the concurrent queue
-    tasks.enqueue([task]() { (*task)(); });
+    submit(new Task([task]() { (*task)(); }));
+    notify_workers(1);
 
     return res;
 }
 
+template <class Body>
+void WThreadPool::parallel_for(size_t begin, size_t end, Body&& body, size_t grain) {
+    if (begin >= end) {
+        return;
+    }
+    const size_t count = end - begin;
+    if (grain == 0) {
+        // A few chunks per worker so that stealing can even out unbalanced chunks
+        grain = std::max<size_t>(1, count / (workers.size() * 4));
+    }
+    const size_t num_chunks = (count + grain - 1) / grain;
+    if (num_chunks == 1) {
+        body(begin, end);
+        return;
+    }
+
+    auto state = std::make_shared<ForkJoinState>();
+    state->pending.store(num_chunks - 1, std::memory_order_relaxed);
+
+    // The caller keeps the first chunk for itself, the rest are published to the pool
+    for (size_t chunk = 1; chunk < num_chunks; chunk++) {
+        const size_t chunk_begin = begin + chunk * grain;
+        const size_t chunk_end = std::min(end, chunk_begin + grain);
+        submit(new Task([state, &body, chunk_begin, chunk_end] {
+            try {
+                body(chunk_begin, chunk_end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->error_mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                state->pending.notify_all();
+            }
+        }));
+    }
+    notify_workers(num_chunks - 1);
+
+    std::exception_ptr first_chunk_error;
+    try {
+        body(begin, std::min(end, begin + grain));
+    } catch (...) {
+        first_chunk_error = std::current_exception();
+    }
+
+    help_until_done(*state);
+
+    if (first_chunk_error) {
+        std::rethrow_exception(first_chunk_error);
+    }
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+// Push a task to the local deque when called from a worker of this pool, otherwise to the injection queue
+inline void WThreadPool::submit(Task* task) {
+    const size_t self = self_index();
+    if (self != NO_WORKER) {
+        workers[self]->deque.push(task);
+    } else {
+        std::lock_guard<std::mutex> lock(injection_mutex);
+        injection_queue.push_back(task);
+        injection_size.fetch_add(1, std::memory_order_release);
+    }
+}
+
+// Wake parked workers after new tasks were published
+inline void WThreadPool::notify_workers(size_t count) {
+    wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    if (count == 1) {
+        wake_epoch.notify_one();
+    } else {
+        wake_epoch.notify_all();
+    }
+}
+
+// Look for work: own deque first (LIFO, cache-hot), then the injection queue, then steal from other workers
+inline WThreadPool::Task* WThreadPool::find_task(size_t self) {
+    if (self != NO_WORKER) {
+        if (Task* task = workers[self]->deque.pop()) {
+            return task;
+        }
+    }
+
+    if (injection_size.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(injection_mutex);
+        if (!injection_queue.empty()) {
+            Task* task = injection_queue.front();
+            injection_queue.pop_front();
+            injection_size.fetch_sub(1, std::memory_order_release);
+            return task;
+        }
+    }
+
+    // Start stealing at a per-thread pseudo-random victim to spread contention
+    static thread_local auto victim_seed =
+        static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    victim_seed = victim_seed * 1664525u + 1013904223u;  // LCG step NOLINT
+    const size_t num_workers = workers.size();
+    const size_t start = victim_seed % num_workers;
+    for (size_t i = 0; i < num_workers; i++) {
+        const size_t victim = (start + i) % num_workers;
+        if (victim == self) continue;
+        if (Task* task = workers[victim]->deque.steal()) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+// Run a single task if one can be found
+inline bool WThreadPool::run_one(size_t self) {
+    Task* task = find_task(self);
+    if (task == nullptr) {
+        return false;
+    }
+    std::unique_ptr<Task> owned(task);
+    try {
+        (*owned)();
+    } catch (const std::exception& e) {
+        spdlog::error("Task exception in WThreadPool: {}", e.what());
+    }
+    return true;
+}
+
+inline bool WThreadPool::has_work() const {
+    if (injection_size.load(std::memory_order_acquire) > 0) {
+        return true;
+    }
+    return std::ranges::any_of(workers, [](const auto& worker) { return !worker->deque.empty(); });
+}
+
+inline void WThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    if (!pin_cpus.empty()) {
+        Affinity::pin_current_thread(pin_cpus[index % pin_cpus.size()]);
+    }
+    if (Trace::enabled()) {
+        Trace::set_thread_name("worker " + std::to_string(index));
+    }
+    // Parked workers outlive the counter sessions that use them, which have to count them per thread
+    PerfCounters::track_this_thread();
+
+    while (true) {
+        if (run_one(index)) {
+            continue;
+        }
+
+        // Announce that we are about to park, then re-check so that a concurrent submit is never missed:
+        // either we see its task here, or it sees sleeping > 0 and bumps the epoch we are waiting on.
+        const uint32_t epoch = wake_epoch.load(std::memory_order_seq_cst);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if (has_work()) {
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (stop.load(std::memory_order_acquire)) {
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            PerfCounters::untrack_this_thread();
+            return;
+        }
+        wake_epoch.wait(epoch, std::memory_order_seq_cst);
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// Execute pool tasks until every chunk of a parallel_for() completed, sleeping only when there is nothing to help with
+inline void WThreadPool::help_until_done(ForkJoinState& state) {
+    const size_t self = self_index();
+    while (true) {
+        const size_t pending = state.pending.load(std::memory_order_acquire);
+        if (pending == 0) {
+            return;
+        }
+        if (run_one(self)) {
+            continue;
+        }
+        // Remaining chunks are running on other threads, the last one to finish notifies us
+        state.pending.wait(pending, std::memory_order_acquire);
+    }
+}
+
 // Destructor: gracefully shut down all threads
 inline WThreadPool::~WThreadPool() {
     stop.store(true);
-    
+    wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+    wake_epoch.notify_all();
+
     // Wait for all threads to finish
-    for (std::thread& worker : workers) {
-        if (worker.joinable()) {
-            worker.join();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
         }
     }
 }
-#endif
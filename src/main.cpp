@@ -3,14 +3,21 @@
 #include "DataLoader/DataLoaderManager.h"
 #include "FetchWikiData/DownloadWikiDump.h"
 #include "Log/FileLog.h"
+#include "Log/Trace.h"
 #include "UI/UI.h"
+#include "Utils/Affinity.h"
 #include "Utils/PathUtils.h"
+#include "Utils/ResourceProbe.h"
 
 int main() {
     init_logfile();
 
     PathUtils::ensure_data_dir_exists();
 
+    // Size thread pools and load buffers to the CPU and memory limits of the container we run in
+    ResourceProbe::log_resources(ResourceProbe::get());
+    Affinity::log_topology();
+
     // Speed up I/O operations by disabling synchronization with the C standard library
     std::ios_base::sync_with_stdio(false);
 
@@ -34,5 +41,8 @@ int main() {
     // Run the UI with the callback (blocks until user exits)
     run_ui(state, on_wiki_selected);
 
+    // Write the timeline recorded with WIKIGRAPH_TRACE
+    Trace::write();
+
     return 0;
 }
@@ -0,0 +1,158 @@
+#ifndef PARALLEL_DECOMPRESSION
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DataLoader/FileReader/AsyncLineReader.h"
+#include "DataLoader/FlowControl.h"
+#include "FetchWikiData/PartialFileReader.h"
+#include "TempDirTest.h"
+
+namespace {
+constexpr int kLinesPerMember = 2000;
+// Bytes the download reports as written at once, small enough to split every gzip header and deflate block
+constexpr uint64_t kChunk = 97;
+
+std::vector<std::string> member_lines(int member) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < kLinesPerMember; i++) {
+        lines.push_back("INSERT INTO `page` VALUES (" + std::to_string(member) + "," + std::to_string(i) + ");");
+    }
+    return lines;
+}
+
+// One gzip member holding the lines
+std::string gzip(const std::vector<std::string>& lines) {
+    std::string content;
+    for (const std::string& line : lines) {
+        content += line + '\n';
+    }
+    z_stream stream{};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string compressed(deflateBound(&stream, content.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(content.data());
+    stream.avail_in = static_cast<uInt>(content.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+// Report `[begin, end)` as written in small chunks, every pair in reverse order like connections finishing out of order
+void mark_out_of_order(PartialFileReader& source, uint64_t begin, uint64_t end) {
+    for (uint64_t first = begin; first < end; first += 2 * kChunk) {
+        const uint64_t second = std::min(first + kChunk, end);
+        source.mark_written(second, std::min(second + kChunk, end) - second);
+        source.mark_written(first, second - first);
+    }
+}
+
+class AsyncLineReaderTest : public TempDirTest {
+   protected:
+    // A download of `content`, already on disk but with no bytes reported as written yet
+    WikiFile downloading(const std::string& content) {
+        const std::filesystem::path path = dir_ / "page.sql.gz";
+        std::ofstream(path, std::ios::binary) << content;
+        WikiFile file{.exists = true, .file_size = 0, .data_path = path};
+        file.live_source = std::make_shared<PartialFileReader>(path, content.size());
+        source_ = file.live_source;
+        return file;
+    }
+
+    std::vector<std::string> read_all(AsyncLineReader& reader) {
+        std::vector<std::string> lines;
+        std::string line;
+        while (reader.get_line(line)) {
+            flow_.release(line.size());
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    FlowControl flow_;
+    std::shared_ptr<PartialFileReader> source_;
+};
+}  // namespace
+
+TEST_F(AsyncLineReaderTest, ReadsEveryMemberOfADownload) {
+    const std::string content = gzip(member_lines(0)) + gzip(member_lines(1));
+    AsyncLineReader reader(downloading(content), flow_);
+    std::thread download([&] {
+        mark_out_of_order(*source_, 0, content.size());
+        source_->finish();
+    });
+
+    const std::vector<std::string> lines = read_all(reader);
+    download.join();
+
+    std::vector<std::string> expected = member_lines(0);
+    std::ranges::copy(member_lines(1), std::back_inserter(expected));
+    EXPECT_EQ(lines, expected);
+    EXPECT_FALSE(reader.failed());
+}
+
+TEST_F(AsyncLineReaderTest, CancelledDownloadFailsMidMember) {
+    const std::string content = gzip(member_lines(0));
+    const uint64_t half = content.size() / 2;
+    AsyncLineReader reader(downloading(content), flow_);
+    std::thread download([&] {
+        mark_out_of_order(*source_, 0, half);
+        // Cancel once the reader is waiting for the rest of the member
+        while (source_->position() < half) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        source_->cancel();
+    });
+
+    const std::vector<std::string> lines = read_all(reader);
+    download.join();
+
+    EXPECT_TRUE(reader.failed());
+    EXPECT_LT(lines.size(), static_cast<size_t>(kLinesPerMember));
+}
+
+TEST_F(AsyncLineReaderTest, DownloadMayEndAtAMemberBoundary) {
+    const std::string first = gzip(member_lines(0));
+    const std::string content = first + gzip(member_lines(1));
+    AsyncLineReader reader(downloading(content), flow_);
+    std::thread download([&] {
+        mark_out_of_order(*source_, 0, first.size());
+        source_->finish();
+    });
+
+    const std::vector<std::string> lines = read_all(reader);
+    download.join();
+
+    EXPECT_EQ(lines, member_lines(0));
+    EXPECT_FALSE(reader.failed());
+}
+
+TEST_F(AsyncLineReaderTest, DownloadEndingMidMemberFails) {
+    const std::string content = gzip(member_lines(0));
+    AsyncLineReader reader(downloading(content), flow_);
+    std::thread download([&] {
+        mark_out_of_order(*source_, 0, content.size() / 2);
+        source_->finish();
+    });
+
+    const std::vector<std::string> lines = read_all(reader);
+    download.join();
+
+    EXPECT_TRUE(reader.failed());
+    EXPECT_LT(lines.size(), static_cast<size_t>(kLinesPerMember));
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "DataLoader/FileReader/SQLParserUtils.h"
+#include "DataLoader/LinkLoader.h"
+#include "DataLoader/LinkTargetLoader.h"
+#include "DataLoader/PageLoader.h"
+#include "FetchWikiData/PartialFileReader.h"
+#include "TempDirTest.h"
+
+namespace {
+constexpr std::chrono::milliseconds kRefreshRate{10};
+
+// Two INSERT lines, so a row of the first one inserted twice shows up in the counts
+constexpr const char* kPageDump =
+    "-- MySQL dump\n"
+    "CREATE TABLE `page` (`page_id` int);\n"
+    "INSERT INTO `page` VALUES (1,0,'Alpha',0,0,0.5,'20250101000000',NULL,10,100,'wikitext',NULL),"
+    "(2,0,'Beta',0,0,0.5,'20250101000000',NULL,11,100,'wikitext',NULL),"
+    "(3,1,'Talk_page',0,0,0.5,'20250101000000',NULL,12,100,'wikitext',NULL);\n"
+    "INSERT INTO `page` VALUES (4,0,'Gamma',0,0,0.5,'20250101000000',NULL,13,100,'wikitext',NULL);\n";
+
+constexpr const char* kLinktargetDump =
+    "INSERT INTO `linktarget` VALUES (100,0,'Alpha'),(101,0,'Beta');\n"
+    "INSERT INTO `linktarget` VALUES (102,0,'Gamma'),(103,0,'Red_link');\n";
+
+constexpr const char* kPagelinksDump =
+    "INSERT INTO `pagelinks` VALUES (1,0,101),(1,0,102),(2,0,100);\n"
+    "INSERT INTO `pagelinks` VALUES (4,0,100),(4,0,103),(3,1,100);\n";
+
+class DataLoaderTest : public TempDirTest {
+   protected:
+    WikiFile write_dump(const std::string& name, const std::string& content) const {
+        const std::filesystem::path path = dir_ / name;
+        gzFile file = gzopen(path.string().c_str(), "wb");
+        gzwrite(file, content.data(), static_cast<unsigned>(content.size()));
+        gzclose(file);
+        return WikiFile{.exists = true, .file_size = std::filesystem::file_size(path), .data_path = path};
+    }
+};
+}  // namespace
+
+TEST_F(DataLoaderTest, InsertsEveryPageOnce) {
+    PageLoader pages;
+    pages.load_page_table(write_dump("page.sql.gz", kPageDump), {}, kRefreshRate);
+
+    ASSERT_EQ(pages.get_page_count(), 3U);
+    EXPECT_EQ(pages.get_page(0).page_title, "Alpha");
+    EXPECT_EQ(pages.get_page(1).page_title, "Beta");
+    EXPECT_EQ(pages.get_page(2).page_title, "Gamma");
+    uint32_t index = 0;
+    ASSERT_TRUE(pages.find_page_index_by_id(4, index));
+    EXPECT_EQ(index, 2U);
+    EXPECT_FALSE(pages.find_page_index_by_id(3, index));
+}
+
+TEST_F(DataLoaderTest, InsertsEveryLinkOnce) {
+    PageLoader pages;
+    pages.load_page_table(write_dump("page.sql.gz", kPageDump), {}, kRefreshRate);
+    LinkTargetLoader linktargets;
+    linktargets.load_linktarget_table(write_dump("linktarget.sql.gz", kLinktargetDump), pages, {}, kRefreshRate);
+    LinkLoader links;
+    links.load_pagelinks_table(write_dump("pagelinks.sql.gz", kPagelinksDump), pages, linktargets, {}, kRefreshRate);
+
+    EXPECT_EQ(linktargets.get_linktarget_count(), 3U);
+    // The red link and the link from the talk page are dropped
+    EXPECT_EQ(links.get_link_count(), 4U);
+    EXPECT_EQ(links.rows_parsed(), 5U);
+}
+
+TEST_F(DataLoaderTest, EstimatesDownloadingFilesFromTheirFinalSize) {
+    // A partial download ends in the middle of the deflate stream, its last bytes are no size trailer
+    const std::filesystem::path path = dir_ / "partial.sql.gz";
+    std::ofstream(path, std::ios::binary) << std::string(1024, '\xff');
+    WikiFile file{.exists = true, .file_size = 0, .data_path = path};
+
+    file.live_source = std::make_shared<PartialFileReader>(path, 0);
+    EXPECT_EQ(estimated_number_of_items(file, 1000), 0U);  // Size not known yet
+
+    constexpr uint64_t kMB = 1024 * 1024;
+    file.live_source->set_size(10 * kMB);
+    EXPECT_EQ(estimated_number_of_items(file, 1000), 60000U);  // 10 MB at the typical ratio of 6
+}
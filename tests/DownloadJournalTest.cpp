@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include "FetchWikiData/DownloadJournal.h"
+#include "TempDirTest.h"
+
+namespace {
+constexpr const char* kUrl = "https://dumps.example.org/enwiki/20250101/enwiki-20250101-page.sql.gz";
+constexpr uint64_t kSize = 1000;
+
+class DownloadJournalTest : public TempDirTest {
+   protected:
+    void SetUp() override {
+        TempDirTest::SetUp();
+        output_ = dir_ / "dump.sql.gz";
+    }
+
+    std::string journal_text() const {
+        std::ifstream file(DownloadJournal::path_for(output_));
+        std::stringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    std::filesystem::path output_;
+};
+}  // namespace
+
+TEST_F(DownloadJournalTest, SplitsIntoConsecutiveSlices) {
+    DownloadJournal journal(output_, kUrl, kSize, 300);
+
+    ASSERT_EQ(journal.segments().size(), 4U);
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(journal.segments()[i].begin, i * 300);
+    }
+    EXPECT_EQ(journal.segments()[2].end, 900U);
+    EXPECT_EQ(journal.segments()[3].end, kSize);
+
+    EXPECT_EQ(journal.segment_at(0), 0U);
+    EXPECT_EQ(journal.segment_at(299), 0U);
+    EXPECT_EQ(journal.segment_at(300), 1U);
+    EXPECT_EQ(journal.segment_at(kSize - 1), 3U);
+}
+
+TEST_F(DownloadJournalTest, RecoversSavedProgress) {
+    DownloadJournal journal(output_, kUrl, kSize, kSize / 2);
+    journal.add_received(0, 120);
+    journal.add_received(1, 7);
+    ASSERT_TRUE(journal.save());
+
+    std::optional<DownloadJournal> loaded = DownloadJournal::load(output_, kUrl, kSize);
+    ASSERT_TRUE(loaded.has_value());
+    ASSERT_EQ(loaded->segments().size(), 2U);
+    EXPECT_EQ(loaded->received(0), 120U);
+    EXPECT_EQ(loaded->received(1), 7U);
+    EXPECT_EQ(loaded->received(), 127U);
+
+    journal.remove();
+    EXPECT_FALSE(DownloadJournal::load(output_, kUrl, kSize).has_value());
+}
+
+TEST_F(DownloadJournalTest, IgnoresJournalOfAnotherFile) {
+    DownloadJournal journal(output_, kUrl, kSize, kSize / 2);
+    ASSERT_TRUE(journal.save());
+
+    EXPECT_FALSE(DownloadJournal::load(output_, "https://dumps.example.org/other.sql.gz", kSize).has_value());
+    EXPECT_FALSE(DownloadJournal::load(output_, kUrl, kSize + 1).has_value());
+}
+
+TEST_F(DownloadJournalTest, IgnoresCorruptJournal) {
+    {
+        std::ofstream file(DownloadJournal::path_for(output_));
+        file << "wikigraph-download 1\nurl " << kUrl << "\nsize " << kSize << "\nsegment 0 1000 1001\n";
+    }
+    EXPECT_FALSE(DownloadJournal::load(output_, kUrl, kSize).has_value());
+
+    {
+        std::ofstream file(DownloadJournal::path_for(output_));
+        file << "wikigraph-download 1\nurl " << kUrl << "\nsize " << kSize << "\nsegment 0 400 0\nsegment 500 1000 0\n";
+    }
+    EXPECT_FALSE(DownloadJournal::load(output_, kUrl, kSize).has_value());
+
+    {
+        std::ofstream file(DownloadJournal::path_for(output_));
+        file << "not a journal\n";
+    }
+    EXPECT_FALSE(DownloadJournal::load(output_, kUrl, kSize).has_value());
+}
+
+TEST_F(DownloadJournalTest, KeepsOldProgressWhenDataSyncFails) {
+    DownloadJournal journal(output_, kUrl, kSize, kSize / 2);
+    journal.add_received(0, 50);
+    ASSERT_TRUE(journal.save([] { return true; }));
+    const std::string saved = journal_text();
+
+    journal.add_received(0, 25);
+    EXPECT_FALSE(journal.save([] { return false; }));
+
+    EXPECT_EQ(journal_text(), saved);
+    EXPECT_EQ(DownloadJournal::load(output_, kUrl, kSize)->received(0), 50U);
+}
+
+TEST_F(DownloadJournalTest, CountsBytesReceivedBeforeTheSync) {
+    DownloadJournal journal(output_, kUrl, kSize, kSize / 2);
+    journal.add_received(0, 10);
+    // Bytes that arrive while the data is synced are not covered by the sync and must not be saved yet
+    ASSERT_TRUE(journal.save([&journal] {
+        journal.add_received(0, 5);
+        return true;
+    }));
+
+    EXPECT_EQ(DownloadJournal::load(output_, kUrl, kSize)->received(0), 10U);
+}
@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FetchWikiData/DownloadJournal.h"
+#include "FetchWikiData/DownloadWikiDump.h"
+#include "FetchWikiData/DumpChecksum.h"
+#include "FetchWikiData/PartialFileReader.h"
+#include "TempDirTest.h"
+#include "TestHttpServer.h"
+#include "Utils/Sha1.h"
+
+namespace {
+constexpr uint64_t kMiB = uint64_t{1024} * 1024;
+// Downloaded as ten segments of one slice each
+constexpr uint64_t kRangedSize = 40 * kMiB;
+// Bytes of a segment and requested per connection slot
+constexpr uint64_t kSlice = 4 * kMiB;
+// Segment the fault injecting tests break, in the middle of the file
+constexpr uint64_t kFaultySegment = 5;
+constexpr std::chrono::milliseconds kRefreshRate{10};
+
+std::string random_content(uint64_t size) {
+    std::mt19937_64 random(size);
+    std::string content(size, '\0');
+    for (char& byte : content) {
+        byte = static_cast<char>(random());
+    }
+    return content;
+}
+
+std::string sha1_of(const std::string& content) {
+    Sha1 sha1;
+    sha1.update(content);
+    return sha1.hex_digest();
+}
+
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// Ranged GETs, the HEAD probe left out
+std::vector<TestHttpServer::Request> ranged_gets(const std::vector<TestHttpServer::Request>& requests) {
+    std::vector<TestHttpServer::Request> gets;
+    for (const TestHttpServer::Request& request : requests) {
+        if (request.method == "GET" && request.ranged) {
+            gets.push_back(request);
+        }
+    }
+    return gets;
+}
+
+bool is_faulty_segment(const TestHttpServer::Request& request) {
+    return request.method == "GET" && request.ranged && request.begin >= kFaultySegment * kSlice &&
+           request.begin < (kFaultySegment + 1) * kSlice;
+}
+
+class DownloadTest : public TempDirTest {
+   protected:
+    void SetUp() override {
+        TempDirTest::SetUp();
+        output_ = dir_ / "dump.sql.gz";
+    }
+
+    bool download(const TestHttpServer& server, const std::string& expected_sha1) {
+        return download_file(server.url("dump.sql.gz"), output_.string(), progress_, kRefreshRate, expected_sha1);
+    }
+
+    std::filesystem::path output_;
+    Telemetry<UIState::DownloadProgress> progress_;
+};
+}  // namespace
+
+TEST_F(DownloadTest, DownloadsRangedFileOverSeveralConnections) {
+    const std::string content = random_content(kRangedSize);
+    TestHttpServer server(content);
+
+    ASSERT_TRUE(download(server, sha1_of(content)));
+
+    EXPECT_EQ(read_file(output_), content);
+    EXPECT_FALSE(std::filesystem::exists(DownloadJournal::path_for(output_)));
+    EXPECT_EQ(DumpChecksum::load(output_), ChecksumVerdict::Ok);
+    // Every slice is requested once
+    std::vector<TestHttpServer::Request> gets = ranged_gets(server.requests());
+    ASSERT_EQ(gets.size(), kRangedSize / kSlice);
+    std::ranges::sort(gets, {}, &TestHttpServer::Request::begin);
+    for (size_t i = 0; i < gets.size(); i++) {
+        EXPECT_EQ(gets[i].begin, i * kSlice);
+        EXPECT_EQ(gets[i].end, (i + 1) * kSlice);
+    }
+}
+
+TEST_F(DownloadTest, FallsBackToSingleConnectionWithoutRanges) {
+    const std::string content = random_content(3 * kMiB);
+    TestHttpServer server(content, false);
+
+    ASSERT_TRUE(download(server, sha1_of(content)));
+
+    EXPECT_EQ(read_file(output_), content);
+    EXPECT_TRUE(ranged_gets(server.requests()).empty());
+    EXPECT_EQ(DumpChecksum::load(output_), ChecksumVerdict::Ok);
+}
+
+TEST_F(DownloadTest, SingleConnectionDoesNotWriteErrorPages) {
+    const std::string content = random_content(kMiB);
+    TestHttpServer server(content, false);
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>&) {
+        return TestHttpServer::Reply{.status = request.method == "GET" ? 503 : 0};
+    });
+    PartialFileReader live(output_, 0);
+
+    EXPECT_FALSE(download_file(server.url("dump.sql.gz"), output_.string(), progress_, kRefreshRate, sha1_of(content),
+                               &live));
+
+    EXPECT_EQ(live.written(), 0U);
+    EXPECT_EQ(read_file(output_).find("Service Unavailable"), std::string::npos);
+}
+
+TEST_F(DownloadTest, RetriesDroppedSegmentWhereItStopped) {
+    const std::string content = random_content(kRangedSize);
+    TestHttpServer server(content);
+    constexpr uint64_t kCut = (3 * kMiB) + 123;  // Within the slice
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>& earlier) {
+        const bool first = std::ranges::none_of(earlier, is_faulty_segment);
+        return TestHttpServer::Reply{.cut_after = is_faulty_segment(request) && first ? kCut : UINT64_MAX};
+    });
+
+    ASSERT_TRUE(download(server, sha1_of(content)));
+
+    EXPECT_EQ(read_file(output_), content);
+    std::vector<TestHttpServer::Request> retries;
+    std::ranges::copy_if(server.requests(), std::back_inserter(retries), is_faulty_segment);
+    ASSERT_GE(retries.size(), 2U);
+    EXPECT_EQ(retries[1].begin, retries[0].begin + kCut);
+    EXPECT_EQ(retries[1].end, retries[0].end);
+}
+
+TEST_F(DownloadTest, KeepsRetryingWhileDroppedConnectionsMakeProgress) {
+    const std::string content = random_content(kRangedSize);
+    TestHttpServer server(content);
+    constexpr uint64_t kCut = kSlice / 8;  // Every drop makes progress within the slice
+    constexpr long kDrops = 7;             // More than the attempts allowed in a row
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>& earlier) {
+        const bool drop = is_faulty_segment(request) && std::ranges::count_if(earlier, is_faulty_segment) < kDrops;
+        return TestHttpServer::Reply{.cut_after = drop ? kCut : UINT64_MAX};
+    });
+
+    ASSERT_TRUE(download(server, sha1_of(content)));
+
+    EXPECT_EQ(read_file(output_), content);
+    EXPECT_GT(std::ranges::count_if(server.requests(), is_faulty_segment), kDrops);
+}
+
+TEST_F(DownloadTest, RejectedSegmentFailsWithoutRetrying) {
+    const std::string content = random_content(kRangedSize);
+    TestHttpServer server(content);
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>&) {
+        return TestHttpServer::Reply{.status = is_faulty_segment(request) ? 404 : 0};
+    });
+
+    EXPECT_FALSE(download(server, sha1_of(content)));
+
+    EXPECT_EQ(std::ranges::count_if(server.requests(), is_faulty_segment), 1);
+    // The segments before it are kept for the next attempt
+    const std::optional<DownloadJournal> journal =
+        DownloadJournal::load(output_, server.url("dump.sql.gz"), kRangedSize);
+    ASSERT_TRUE(journal.has_value());
+}
+
+TEST_F(DownloadTest, ResumesFromJournalAfterFailedAttempt) {
+    const std::string content = random_content(kRangedSize);
+    TestHttpServer server(content);
+    constexpr uint64_t kCut = (3 * kMiB) + 77;
+    // One segment breaks off, then the server refuses it
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>& earlier) {
+        if (!is_faulty_segment(request)) {
+            return TestHttpServer::Reply{};
+        }
+        if (std::ranges::none_of(earlier, is_faulty_segment)) {
+            return TestHttpServer::Reply{.cut_after = kCut};
+        }
+        return TestHttpServer::Reply{.status = 403};
+    });
+    ASSERT_FALSE(download(server, sha1_of(content)));
+
+    std::optional<DownloadJournal> journal = DownloadJournal::load(output_, server.url("dump.sql.gz"), kRangedSize);
+    ASSERT_TRUE(journal.has_value());
+    ASSERT_EQ(journal->segments().size(), kRangedSize / kSlice);
+    for (size_t i = 0; i < kFaultySegment; i++) {
+        EXPECT_EQ(journal->received(i), kSlice);
+    }
+    EXPECT_EQ(journal->received(kFaultySegment), kCut);
+
+    server.set_fault({});
+    server.clear_requests();
+    ASSERT_TRUE(download(server, sha1_of(content)));
+
+    // Only the missing tail was requested again, and the kept bytes were hashed as well
+    constexpr uint64_t kResumeAt = (kFaultySegment * kSlice) + kCut;
+    const std::vector<TestHttpServer::Request> gets = ranged_gets(server.requests());
+    EXPECT_EQ(std::ranges::count_if(gets, [](const auto& get) { return get.begin == kResumeAt; }), 1);
+    EXPECT_TRUE(std::ranges::all_of(gets, [](const auto& get) { return get.begin >= kResumeAt; }));
+    EXPECT_EQ(read_file(output_), content);
+    EXPECT_FALSE(std::filesystem::exists(DownloadJournal::path_for(output_)));
+    EXPECT_EQ(DumpChecksum::load(output_), ChecksumVerdict::Ok);
+}
+
+TEST_F(DownloadTest, ReportsChecksumMismatch) {
+    const std::string content = random_content(kRangedSize);
+    TestHttpServer server(content);
+
+    EXPECT_FALSE(download(server, sha1_of("something else")));
+
+    EXPECT_EQ(DumpChecksum::load(output_), ChecksumVerdict::Mismatch);
+}
+
+TEST_F(DownloadTest, ConnectionLimitCoversAllDownloads) {
+    // Sixteen segments per file, paced so every connection stays open long enough to overlap with the others
+    const std::string content = random_content(64 * kMiB);
+    TestHttpServer server(content);
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>&) {
+        return TestHttpServer::Reply{.bytes_per_second = request.method == "GET" ? 4 * kSlice : 0};
+    });
+
+    // Two files nobody follows, which would open eight connections if each kept its own
+    const std::filesystem::path other_output = dir_ / "other.sql.gz";
+    Telemetry<UIState::DownloadProgress> other_progress;
+    bool other_ok = false;
+    std::thread other([&] {
+        other_ok = download_file(server.url("other.sql.gz"), other_output.string(), other_progress, kRefreshRate,
+                                 sha1_of(content));
+    });
+    const bool ok = download(server, sha1_of(content));
+    other.join();
+
+    ASSERT_TRUE(ok);
+    ASSERT_TRUE(other_ok);
+    EXPECT_EQ(read_file(output_), content);
+    EXPECT_EQ(read_file(other_output), content);
+    EXPECT_LE(server.peak_concurrent_gets(), 4);  // WIKIGRAPH_DOWNLOAD_CONNECTIONS defaults to 4
+}
+
+TEST_F(DownloadTest, WrittenPrefixGrowsWhileConnectionsRun) {
+    // Sixteen segments over four connections, each taking 1 s at the paced rate
+    constexpr uint64_t kSize = 64 * kMiB;
+    const std::string content = random_content(kSize);
+    TestHttpServer server(content);
+    server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>&) {
+        return TestHttpServer::Reply{.bytes_per_second = request.method == "GET" ? kSlice : 0};
+    });
+    PartialFileReader live(output_, 0);
+
+    std::atomic<bool> done{false};
+    std::vector<uint64_t> samples;
+    std::thread sampler([&] {
+        while (!done.load()) {
+            samples.push_back(live.written());
+            std::this_thread::sleep_for(kRefreshRate);
+        }
+    });
+    const bool ok = download_file(server.url("dump.sql.gz"), output_.string(), progress_, kRefreshRate,
+                                  sha1_of(content), &live);
+    done = true;
+    sampler.join();
+
+    ASSERT_TRUE(ok);
+    EXPECT_EQ(read_file(output_), content);
+    EXPECT_GT(server.peak_concurrent_gets(), 1);
+    // The connections fill the file front to back, so the loader had the middle of the file before the end arrived
+    EXPECT_TRUE(std::ranges::any_of(samples, [](uint64_t written) {
+        return written > kSize / 4 && written < 3 * kSize / 4;
+    }));
+}
+
+TEST_F(DownloadTest, UrgentFileTakesOverConnectionsOfAnEarlierFile) {
+    // Sixteen segments, each taking 1 s at the paced rate
+    constexpr uint64_t kSlowSize = 64 * kMiB;
+    constexpr uint64_t kSlowRate = 4 * kMiB;
+    const std::string slow_content = random_content(kSlowSize);
+    TestHttpServer slow_server(slow_content);
+    slow_server.set_fault([](const TestHttpServer::Request& request, const std::vector<TestHttpServer::Request>&) {
+        return TestHttpServer::Reply{.bytes_per_second = request.method == "GET" ? kSlowRate : 0};
+    });
+    const std::string urgent_content = random_content(3 * kMiB);
+    TestHttpServer urgent_server(urgent_content);
+
+    // The less urgent file starts first and takes every connection slot
+    const std::filesystem::path slow_output = dir_ / "slow.sql.gz";
+    PartialFileReader slow_live(slow_output, 0);
+    Telemetry<UIState::DownloadProgress> slow_progress;
+    bool slow_ok = false;
+    std::thread slow([&] {
+        slow_ok = download_file(slow_server.url("slow.sql.gz"), slow_output.string(), slow_progress, kRefreshRate,
+                                sha1_of(slow_content), &slow_live, 2);
+    });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (ranged_gets(slow_server.requests()).size() < 4 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(kRefreshRate);
+    }
+
+    PartialFileReader live(output_, 0);
+    const auto start = std::chrono::steady_clock::now();
+    const bool urgent_ok = download_file(urgent_server.url("dump.sql.gz"), output_.string(), progress_, kRefreshRate,
+                                         sha1_of(urgent_content), &live, 0);
+    const auto waited = std::chrono::steady_clock::now() - start;
+    slow.join();
+
+    ASSERT_TRUE(urgent_ok);
+    ASSERT_TRUE(slow_ok);
+    // A slot came back after one slice of the earlier file, not once the whole file was done
+    EXPECT_LT(waited, std::chrono::seconds(3));
+    EXPECT_EQ(read_file(output_), urgent_content);
+    EXPECT_EQ(read_file(slow_output), slow_content);
+    for (const TestHttpServer::Request& request : ranged_gets(slow_server.requests())) {
+        EXPECT_LE(request.end - request.begin, kSlice);
+    }
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "FetchWikiData/DumpChecksum.h"
+#include "FetchWikiData/DumpWriter.h"
+#include "TempDirTest.h"
+#include "Utils/Sha1.h"
+
+namespace {
+std::string sha1_of(std::string_view data) {
+    Sha1 sha1;
+    sha1.update(data);
+    return sha1.hex_digest();
+}
+
+class DumpChecksumTest : public TempDirTest {
+   protected:
+    void SetUp() override {
+        TempDirTest::SetUp();
+        path_ = dir_ / "dump.sql.gz";
+        for (int i = 0; i < 100000; i++) {
+            content_ += std::to_string(i * 7919);
+        }
+        // The verifier only reads back bytes that were written, like the download does
+        std::ofstream(path_, std::ios::binary) << content_;
+    }
+
+    [[nodiscard]] std::string_view part(uint64_t begin, uint64_t end) const {
+        return std::string_view(content_).substr(begin, end - begin);
+    }
+
+    // Writer over the file that hands every written buffer to the verifier, like the download does
+    std::unique_ptr<DumpWriter> writer_for(ChecksumVerifier& verifier, size_t streams) const {
+        return std::make_unique<DumpWriter>(path_, content_.size(), true, streams,
+                                            [&verifier](size_t stream, DumpWriter::WrittenBuffer buffer) {
+                                                verifier.add_written(stream, std::move(buffer));
+                                            });
+    }
+
+    // Write `[begin, end)` of the content as one buffer of writer stream `stream`
+    void write(DumpWriter& writer, size_t stream, uint64_t begin, uint64_t end) const {
+        DumpWriter::Stream out = writer.open_stream(stream, begin);
+        ASSERT_TRUE(out.write(part(begin, end)));
+        ASSERT_TRUE(out.flush());
+    }
+
+    std::filesystem::path path_;
+    std::string content_;
+};
+}  // namespace
+
+TEST_F(DumpChecksumTest, HashesInOrderBuffers) {
+    ChecksumVerifier verifier(path_, content_.size(), sha1_of(content_));
+    const std::unique_ptr<DumpWriter> writer = writer_for(verifier, 1);
+    for (uint64_t offset = 0; offset < content_.size(); offset += 4096) {
+        write(*writer, 0, offset, std::min<uint64_t>(offset + 4096, content_.size()));
+    }
+
+    EXPECT_EQ(verifier.finish(), ChecksumVerdict::Ok);
+    EXPECT_EQ(DumpChecksum::load(path_), ChecksumVerdict::Ok);
+}
+
+TEST_F(DumpChecksumTest, ReadsBackBytesWrittenBeyondAGap) {
+    const uint64_t size = content_.size();
+    const uint64_t half = size / 2;
+    ChecksumVerifier verifier(path_, size, sha1_of(content_));
+    const std::unique_ptr<DumpWriter> writer = writer_for(verifier, 2);
+    // A later segment and bytes kept from an earlier attempt arrive before the start of the file
+    verifier.mark_written(half, 1000);
+    write(*writer, 1, half + 1000, half + 5000);
+    write(*writer, 1, half + 5000, size);
+    write(*writer, 0, 0, 100);
+    write(*writer, 0, 100, half);
+
+    EXPECT_EQ(verifier.finish(), ChecksumVerdict::Ok);
+}
+
+TEST_F(DumpChecksumTest, LeavesEveryStreamABufferWhileWaitingForAGap) {
+    constexpr uint64_t kPart = 10000;
+    ChecksumVerifier verifier(path_, content_.size(), sha1_of(content_));
+    // Two streams share four buffers, a stream running ahead must not take all of them while the first part is missing
+    const std::unique_ptr<DumpWriter> writer = writer_for(verifier, 2);
+    for (uint64_t begin = kPart; begin < 6 * kPart; begin += kPart) {
+        write(*writer, 1, begin, begin + kPart);
+    }
+    write(*writer, 0, 0, kPart);
+    write(*writer, 0, 6 * kPart, content_.size());
+
+    EXPECT_EQ(verifier.finish(), ChecksumVerdict::Ok);
+}
+
+TEST_F(DumpChecksumTest, ReportsMismatch) {
+    ChecksumVerifier verifier(path_, content_.size(), sha1_of("other"));
+    write(*writer_for(verifier, 1), 0, 0, content_.size());
+
+    EXPECT_EQ(verifier.finish(), ChecksumVerdict::Mismatch);
+    EXPECT_EQ(DumpChecksum::load(path_), ChecksumVerdict::Mismatch);
+}
+
+TEST_F(DumpChecksumTest, IncompleteFileDoesNotVerify) {
+    ChecksumVerifier verifier(path_, content_.size(), sha1_of(content_));
+    const std::unique_ptr<DumpWriter> writer = writer_for(verifier, 1);
+    write(*writer, 0, 0, 100);
+    write(*writer, 0, 200, content_.size());
+
+    EXPECT_EQ(verifier.finish(), ChecksumVerdict::Mismatch);
+}
+
+TEST_F(DumpChecksumTest, UnverifiedWithoutPublishedChecksum) {
+    ChecksumVerifier verifier(path_, 0, "");
+    write(*writer_for(verifier, 1), 0, 0, content_.size());
+
+    EXPECT_EQ(verifier.finish(), ChecksumVerdict::Unverified);
+    EXPECT_EQ(DumpChecksum::load(path_), ChecksumVerdict::Unverified);
+}
+
+TEST_F(DumpChecksumTest, CancelsWithoutFinish) {
+    auto verifier = std::make_unique<ChecksumVerifier>(path_, content_.size(), sha1_of(content_));
+    verifier->mark_written(0, 100);
+    verifier.reset();
+
+    EXPECT_FALSE(DumpChecksum::load(path_).has_value());
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "DataLoader/FlowControl.h"
+
+namespace {
+constexpr auto kWait = std::chrono::milliseconds(50);
+constexpr uint64_t kWaitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(kWait).count();
+
+size_t index(PipelineStage stage) {
+    return static_cast<size_t>(stage);
+}
+}  // namespace
+
+TEST(FlowControlTest, ActivityCountsTheCurrentState) {
+    FlowControl flow;
+    std::atomic<bool> blocked{false};
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        flow.track(PipelineStage::Read, StageActivity::Blocked);
+        blocked.store(true);
+        while (!done.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        flow.untrack();
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(kWait);
+
+    // The thread is still blocked, nothing has reached its counters yet
+    EXPECT_EQ(flow.timing(PipelineStage::Read).blocked_ns, 0U);
+    const PipelineActivity activity = flow.activity();
+    EXPECT_GE(activity.stages[index(PipelineStage::Read)].blocked_ns, kWaitNs);
+    EXPECT_EQ(activity.stages[index(PipelineStage::Read)].busy_ns, 0U);
+    EXPECT_EQ(activity.stages[index(PipelineStage::Parse)].blocked_ns, 0U);
+
+    done.store(true);
+    reader.join();
+    // Once closed, the interval is counted exactly once
+    const StageTiming closed = flow.timing(PipelineStage::Read);
+    EXPECT_GE(closed.blocked_ns, kWaitNs);
+    const PipelineActivity after = flow.activity();
+    EXPECT_EQ(after.stages[index(PipelineStage::Read)].blocked_ns, closed.blocked_ns);
+    EXPECT_EQ(after.stages[index(PipelineStage::Read)].busy_ns, closed.busy_ns);
+}
+
+TEST(FlowControlTest, CreditsBoundBytesInFlight) {
+    FlowControl flow(100);
+    flow.enter(PipelineStage::Read, 60);
+    ASSERT_TRUE(flow.acquire(60));
+    EXPECT_FALSE(flow.exhausted());
+
+    // The read queue is not empty, so a line over the budget waits for a release
+    std::atomic<bool> acquired{false};
+    std::thread reader([&] {
+        acquired.store(flow.acquire(60));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(acquired.load());
+
+    flow.release(60);
+    flow.leave(PipelineStage::Read, 60);
+    reader.join();
+    EXPECT_TRUE(acquired.load());
+    EXPECT_EQ(flow.bytes_in_flight(), 60U);
+    EXPECT_EQ(flow.peak_bytes_in_flight(), 60U);
+}
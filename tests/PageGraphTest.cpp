@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "DataLoader/LinkLoader.h"
+#include "PageGraph/PageGraph.h"
+
+namespace {
+using Paths = std::vector<std::vector<uint32_t>>;
+
+// 0 -> 1 -> 3 and 0 -> 2 -> 3 are the shortest paths from 0 to 3, 3 -> 4 leads on, 5 is unreachable
+Paths sorted(Paths paths) {
+    std::ranges::sort(paths);
+    return paths;
+}
+
+std::vector<Link> diamond_links() {
+    return {{.page_from = 0, .page_to = 2}, {.page_from = 0, .page_to = 1}, {.page_from = 1, .page_to = 3},
+            {.page_from = 2, .page_to = 3}, {.page_from = 3, .page_to = 4}, {.page_from = 4, .page_to = 0}};
+}
+}  // namespace
+
+TEST(PageGraphTest, BuildsSortedNeighbourLists) {
+    UIState state;
+    const PageGraph graph(state, 6, diamond_links(), NoProgress{});
+
+    EXPECT_EQ(graph.get_number_of_pages(), 6U);
+    EXPECT_EQ(graph.get_number_of_links(), 6U);
+    const auto neighbors = graph.get_neighbors(0);
+    EXPECT_EQ(std::vector<uint32_t>(neighbors.begin(), neighbors.end()), (std::vector<uint32_t>{1, 2}));
+    EXPECT_EQ(graph.get_out_degree(5), 0U);
+}
+
+TEST(PageGraphTest, FindsAllShortestPaths) {
+    UIState state;
+    const PageGraph graph(state, 6, diamond_links(), NoProgress{});
+
+    EXPECT_EQ(sorted(graph.all_shortest_paths<NoProgress>(state, 0, 3)), (Paths{{0, 1, 3}, {0, 2, 3}}));
+    EXPECT_EQ(graph.all_shortest_paths<NoProgress>(state, 0, 0), (Paths{{0}}));
+    EXPECT_TRUE(graph.all_shortest_paths<NoProgress>(state, 0, 5).empty());
+}
+
+TEST(PageGraphTest, SearchesReuseStateWithoutLeakingResults) {
+    UIState state;
+    const PageGraph graph(state, 6, diamond_links(), NoProgress{});
+
+    // Each search starts from a clean state, whatever the graph searched before
+    EXPECT_EQ(sorted(graph.all_shortest_paths<NoProgress>(state, 0, 4)), (Paths{{0, 1, 3, 4}, {0, 2, 3, 4}}));
+    EXPECT_EQ(graph.all_shortest_paths<NoProgress>(state, 2, 1), (Paths{{2, 3, 4, 0, 1}}));
+    const PageGraph::BFSResult result = graph.bfs_with_parents<NoProgress>(state, 3, 2);
+    EXPECT_EQ(result.dist, 3U);
+    EXPECT_TRUE(result.parents[3].empty());
+    EXPECT_EQ(result.parents[2], (std::vector<uint32_t>{0}));
+    EXPECT_EQ(result.nodes_explored, 3U);  // 3, 4 and 0, the search stops before expanding the layer of 2
+
+    // A held result keeps its state, later searches take another one
+    EXPECT_EQ(sorted(graph.all_shortest_paths<NoProgress>(state, 0, 3)), (Paths{{0, 1, 3}, {0, 2, 3}}));
+    EXPECT_EQ(result.parents[2], (std::vector<uint32_t>{0}));
+    EXPECT_EQ(result.parents[4], (std::vector<uint32_t>{3}));
+
+    // A graph of another size has states of its own size
+    const PageGraph small(state, 2, {{.page_from = 1, .page_to = 0}}, NoProgress{});
+    EXPECT_EQ(small.all_shortest_paths<NoProgress>(state, 1, 0), (Paths{{1, 0}}));
+    EXPECT_EQ(sorted(graph.all_shortest_paths<NoProgress>(state, 0, 3)), (Paths{{0, 1, 3}, {0, 2, 3}}));
+}
+
+TEST(PageGraphTest, CountsSearchArraysOnlyWhenAllocated) {
+    UIState state;
+    const PageGraph graph(state, 6, diamond_links(), NoProgress{});
+    const uint64_t arrays = 6 * (sizeof(uint32_t) + sizeof(std::vector<uint32_t>));
+
+    uint64_t first = 0;
+    {
+        const PageGraph::BFSResult result = graph.bfs_with_parents<CountersOnly>(state, 0, 3);
+        first = result.stats.bytes_allocated;
+        EXPECT_GE(first, arrays);
+    }
+    // The same search on the returned state only allocates parent lists again
+    const PageGraph::BFSResult again = graph.bfs_with_parents<CountersOnly>(state, 0, 3);
+    EXPECT_LT(again.stats.bytes_allocated, arrays);
+    EXPECT_GT(again.stats.bytes_allocated, 0U);
+}
+
+TEST(PageGraphTest, KeepsOneIdleSearchState) {
+    UIState state;
+    const PageGraph graph(state, 6, diamond_links(), NoProgress{});
+    const uint64_t arrays = 6 * (sizeof(uint32_t) + sizeof(std::vector<uint32_t>));
+
+    {
+        // Two searches at once need two states, only one is kept once both are done
+        const PageGraph::BFSResult first = graph.bfs_with_parents<CountersOnly>(state, 0, 3);
+        const PageGraph::BFSResult second = graph.bfs_with_parents<CountersOnly>(state, 0, 3);
+        EXPECT_GE(second.stats.bytes_allocated, arrays);
+    }
+    const PageGraph::BFSResult reused = graph.bfs_with_parents<CountersOnly>(state, 0, 3);
+    const PageGraph::BFSResult fresh = graph.bfs_with_parents<CountersOnly>(state, 0, 3);
+    EXPECT_LT(reused.stats.bytes_allocated, arrays);
+    EXPECT_GE(fresh.stats.bytes_allocated, arrays);
+}
@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <optional>
+
+#include "Utils/ResourceProbe.h"
+
+TEST(ResourceProbeTest, ParsesSizesWithSuffix) {
+    EXPECT_EQ(ResourceProbe::parse_size("4096"), 4096U);
+    EXPECT_EQ(ResourceProbe::parse_size("512K"), uint64_t{512} * 1024);
+    EXPECT_EQ(ResourceProbe::parse_size("128m"), uint64_t{128} * 1024 * 1024);
+    EXPECT_EQ(ResourceProbe::parse_size("8G"), uint64_t{8} * 1024 * 1024 * 1024);
+}
+
+TEST(ResourceProbeTest, RejectsTrailingCharacters) {
+    EXPECT_EQ(ResourceProbe::parse_size("8Gx"), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size("8GB"), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size("8 G"), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size("8T"), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size("G"), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size(""), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size("-1"), std::nullopt);
+}
+
+TEST(ResourceProbeTest, RejectsSizesThatOverflow) {
+    EXPECT_EQ(ResourceProbe::parse_size("18446744073709551615"), UINT64_MAX);
+    EXPECT_EQ(ResourceProbe::parse_size("18446744073709551616"), std::nullopt);
+    EXPECT_EQ(ResourceProbe::parse_size("17179869184G"), std::nullopt);  // 2^34 GB = 2^64 bytes
+    EXPECT_EQ(ResourceProbe::parse_size("17179869183G"), uint64_t{17179869183} << 30);
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+#include "Utils/Sha1.h"
+
+namespace {
+std::string sha1_of(std::string_view data) {
+    Sha1 sha1;
+    sha1.update(data);
+    return sha1.hex_digest();
+}
+}  // namespace
+
+// Test vectors of RFC 3174 section 7.3, plus the empty message
+TEST(Sha1Test, MatchesKnownAnswers) {
+    EXPECT_EQ(sha1_of(""), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    EXPECT_EQ(sha1_of("abc"), "a9993e364706816aba3e25717850c26c9cd0d89d");
+    EXPECT_EQ(sha1_of("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+              "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+}
+
+TEST(Sha1Test, HashesRepeatedUpdates) {
+    Sha1 million_a;
+    const std::string thousand_a(1000, 'a');
+    for (int i = 0; i < 1000; i++) {
+        million_a.update(thousand_a);
+    }
+    EXPECT_EQ(million_a.hex_digest(), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+
+    Sha1 repeated;
+    for (int i = 0; i < 80; i++) {
+        repeated.update("01234567");
+    }
+    EXPECT_EQ(repeated.hex_digest(), "dea356a2cddd90c7a7ecedc5ebb563934f460452");
+}
+
+TEST(Sha1Test, DigestDoesNotDependOnUpdateSizes) {
+    const std::string message(1000000, 'a');
+    Sha1 whole;
+    whole.update(message);
+    Sha1 uneven;
+    for (size_t offset = 0, step = 1; offset < message.size(); offset += step, step = step * 3 % 127 + 1) {
+        uneven.update(std::string_view(message).substr(offset, step));
+    }
+    EXPECT_EQ(whole.hex_digest(), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+    EXPECT_EQ(uneven.hex_digest(), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
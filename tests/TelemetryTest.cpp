@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "Utils/Telemetry.h"
+
+namespace {
+// Wider than 16 bytes, so a reader could see a mix of two stores if the sequence lock did not hold
+struct Sample {
+    uint64_t a;
+    uint64_t b;
+    uint64_t c;
+    uint32_t d;
+};
+
+TelemetryRegistry::Fields sample_fields(const Sample& sample) {
+    return {{"a", sample.a}, {"d", sample.d}};
+}
+}  // namespace
+
+TEST(TelemetryTest, LoadsLastStoredValue) {
+    Telemetry<Sample> channel;
+    EXPECT_EQ(channel.version(), 1U);  // The constructor stores a zero value
+    EXPECT_EQ(channel.load().a, 0U);
+
+    channel.store({.a = 1, .b = 2, .c = 3, .d = 4});
+    channel = Sample{.a = 5, .b = 6, .c = 7, .d = 8};
+
+    const Sample sample = channel.load();
+    EXPECT_EQ(sample.a, 5U);
+    EXPECT_EQ(sample.b, 6U);
+    EXPECT_EQ(sample.c, 7U);
+    EXPECT_EQ(sample.d, 8U);
+    EXPECT_EQ(channel.version(), 3U);
+}
+
+TEST(TelemetryTest, ReaderNeverSeesTornValue) {
+    constexpr uint64_t kStores = 200000;
+    Telemetry<Sample> channel;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (uint64_t i = 1; i <= kStores; i++) {
+            channel.store({.a = i, .b = i, .c = i, .d = static_cast<uint32_t>(i)});
+        }
+        done.store(true);
+    });
+
+    uint64_t last = 0;
+    uint64_t loads = 0;
+    while (!done.load() || last < kStores) {
+        const Sample sample = channel.load();
+        ASSERT_EQ(sample.b, sample.a);
+        ASSERT_EQ(sample.c, sample.a);
+        ASSERT_EQ(sample.d, static_cast<uint32_t>(sample.a));
+        ASSERT_GE(sample.a, last);  // Values only move forward
+        last = sample.a;
+        loads++;
+    }
+    writer.join();
+    EXPECT_GT(loads, 0U);
+    EXPECT_EQ(channel.version(), kStores + 1);
+}
+
+TEST(TelemetryTest, RegistryReadsChannelsInOrder) {
+    Telemetry<Sample> channel;
+    std::atomic<uint32_t> counter{0};
+    TelemetryRegistry registry;
+    registry.add("sample", channel, sample_fields);
+    registry.add("counter", counter);
+
+    channel.store({.a = 10, .b = 0, .c = 0, .d = 20});
+    counter.store(7);
+
+    const std::vector<TelemetryRegistry::Reading> readings = registry.read();
+    ASSERT_EQ(readings.size(), 2U);
+    EXPECT_EQ(readings[0].channel, "sample");
+    EXPECT_EQ(readings[0].fields, (TelemetryRegistry::Fields{{"a", 10}, {"d", 20}}));
+    EXPECT_EQ(readings[1].channel, "counter");
+    EXPECT_EQ(readings[1].fields, (TelemetryRegistry::Fields{{"value", 7}}));
+}
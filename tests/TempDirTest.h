@@ -0,0 +1,40 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Fixture giving every test an empty directory of its own, removed again after the test.
+ *
+ * The directory name holds the process id besides the test's name, so test executables and ctest jobs that run the
+ * same test at the same time do not share it.
+ */
+class TempDirTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+#ifdef _WIN32
+        const int pid = _getpid();
+#else
+        const int pid = static_cast<int>(getpid());
+#endif
+        dir_ = std::filesystem::temp_directory_path() / ("wikigraph_" + std::to_string(pid) + "_" +
+                                                         test->test_suite_name() + "_" + test->name());
+        std::filesystem::remove_all(dir_);
+        std::filesystem::create_directories(dir_);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(dir_);
+    }
+
+    std::filesystem::path dir_;
+};
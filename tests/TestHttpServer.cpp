@@ -0,0 +1,214 @@
+#include "TestHttpServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+bool send_all(int socket, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t sent = ::send(socket, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+// Request line and headers, empty if the client closed the connection first
+std::string read_head(int socket) {
+    std::string head;
+    char buffer[1024];
+    while (head.find("\r\n\r\n") == std::string::npos) {
+        const ssize_t received = ::recv(socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return {};
+        }
+        head.append(buffer, static_cast<size_t>(received));
+    }
+    return head;
+}
+
+std::string status_text(int status) {
+    switch (status) {
+        case 200:
+            return "OK";
+        case 206:
+            return "Partial Content";
+        case 403:
+            return "Forbidden";
+        case 404:
+            return "Not Found";
+        case 416:
+            return "Range Not Satisfiable";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Error";
+    }
+}
+}  // namespace
+
+TestHttpServer::TestHttpServer(std::string content, bool accept_ranges)
+    : content_(std::move(content)), accept_ranges_(accept_ranges) {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listener_ < 0) {
+        throw std::runtime_error("Failed to create the test server socket");
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;  // Any free port
+    socklen_t length = sizeof(address);
+    if (::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener_, 16) != 0 || ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        ::close(listener_);
+        throw std::runtime_error("Failed to start the test server");
+    }
+    port_ = ntohs(address.sin_port);
+    acceptor_ = std::thread([this] { accept_loop(); });
+}
+
+TestHttpServer::~TestHttpServer() {
+    // Wakes the blocked accept()
+    ::shutdown(listener_, SHUT_RDWR);
+    acceptor_.join();
+    ::close(listener_);
+    std::vector<std::thread> connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.swap(connections_);
+    }
+    for (std::thread& connection : connections) {
+        connection.join();
+    }
+}
+
+std::string TestHttpServer::url(std::string_view name) const {
+    return std::format("http://127.0.0.1:{}/{}", port_, name);
+}
+
+void TestHttpServer::set_fault(FaultHook hook) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fault_ = std::move(hook);
+}
+
+std::vector<TestHttpServer::Request> TestHttpServer::requests() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+}
+
+int TestHttpServer::peak_concurrent_gets() const {
+    return peak_gets_.load();
+}
+
+void TestHttpServer::clear_requests() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.clear();
+}
+
+void TestHttpServer::accept_loop() {
+    while (true) {
+        const int client = ::accept(listener_, nullptr, nullptr);
+        if (client < 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_.emplace_back([this, client] {
+            serve(client);
+            ::close(client);
+        });
+    }
+}
+
+void TestHttpServer::serve(int client) {
+    const std::string head = read_head(client);
+    if (head.empty()) {
+        return;
+    }
+
+    Request request{.method = head.substr(0, head.find(' ')), .ranged = false, .begin = 0, .end = content_.size()};
+    if (const size_t range = head.find("\r\nRange: bytes="); range != std::string::npos && accept_ranges_) {
+        const char* first = head.c_str() + range + std::string_view("\r\nRange: bytes=").size();
+        char* last = nullptr;
+        request.ranged = true;
+        request.begin = std::strtoull(first, &last, 10);
+        request.end = std::min<uint64_t>(std::strtoull(last + 1, nullptr, 10) + 1, content_.size());
+    }
+
+    Reply reply;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fault_) {
+            reply = fault_(request, requests_);
+        }
+        requests_.push_back(request);
+    }
+
+    if (reply.status != 0) {
+        // With an error page, as real servers send, which a client must not take for the file
+        const std::string body = request.method == "HEAD" ? "" : std::format("<h1>{}</h1>", status_text(reply.status));
+        send_all(client, std::format("HTTP/1.1 {} {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                                     reply.status, status_text(reply.status), body.size(), body));
+        return;
+    }
+    if (request.begin > request.end) {
+        send_all(client, "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return;
+    }
+
+    const uint64_t length = request.end - request.begin;
+    std::string response_head = std::format("HTTP/1.1 {} {}\r\nContent-Length: {}\r\nConnection: close\r\n",
+                                            request.ranged ? 206 : 200, request.ranged ? "Partial Content" : "OK",
+                                            length);
+    if (accept_ranges_) {
+        response_head += "Accept-Ranges: bytes\r\n";
+    }
+    if (request.ranged) {
+        response_head += std::format("Content-Range: bytes {}-{}/{}\r\n", request.begin, request.end - 1,
+                                     content_.size());
+    }
+    response_head += "\r\n";
+    if (!send_all(client, response_head) || request.method == "HEAD") {
+        return;
+    }
+    // Counted while the body is sent, the client has the connection open at least that long
+    const int active = active_gets_.fetch_add(1) + 1;
+    int peak = peak_gets_.load();
+    while (active > peak && !peak_gets_.compare_exchange_weak(peak, active)) {
+    }
+    struct Leave {
+        std::atomic<int>& active;
+        ~Leave() {
+            active.fetch_sub(1);
+        }
+    } leave{active_gets_};
+    std::string_view body = std::string_view(content_).substr(request.begin, std::min(length, reply.cut_after));
+    if (reply.bytes_per_second == 0) {
+        send_all(client, body);
+        return;
+    }
+    // Paced in chunks of a tenth of a second
+    const uint64_t chunk_size = std::max<uint64_t>(reply.bytes_per_second / 10, 1);
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+    while (!body.empty()) {
+        const std::string_view chunk = body.substr(0, chunk_size);
+        if (!send_all(client, chunk)) {
+            return;
+        }
+        body.remove_prefix(chunk.size());
+        sent += chunk.size();
+        std::this_thread::sleep_until(start + std::chrono::duration<double>(static_cast<double>(sent) /
+                                                                            static_cast<double>(reply.bytes_per_second)));
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Minimal HTTP/1.1 server on 127.0.0.1 standing in for the dumps server in download tests.
+ *
+ * Serves one file from memory at every path: HEAD with its size, GET for the whole file or, when ranges are
+ * enabled, for one `Range: bytes=<first>-<last>` with 206 Partial Content. Every connection answers a single request
+ * and is closed. A fault hook can make any request fail with an error page, break off or arrive slowly, and every request is recorded so
+ * a test can check what the client asked for.
+ */
+class TestHttpServer {
+   public:
+    struct Request {
+        std::string method;
+        bool ranged;
+        uint64_t begin;  // First byte requested, 0 without a range
+        uint64_t end;    // One past the last byte requested, the file size without a range
+    };
+
+    struct Reply {
+        // Error status to answer with, 0 to serve the request
+        int status = 0;
+        // Close the connection after this many bytes of the body, as a dropped connection would
+        uint64_t cut_after = std::numeric_limits<uint64_t>::max();
+        // Send the body no faster than this, as a slow server would, 0 for full speed
+        uint64_t bytes_per_second = 0;
+    };
+
+    /** @brief Decides how to answer a request, given the requests that came before it. */
+    using FaultHook = std::function<Reply(const Request& request, const std::vector<Request>& earlier)>;
+
+    explicit TestHttpServer(std::string content, bool accept_ranges = true);
+    ~TestHttpServer();
+
+    TestHttpServer(const TestHttpServer&) = delete;
+    TestHttpServer& operator=(const TestHttpServer&) = delete;
+    TestHttpServer(TestHttpServer&&) = delete;
+    TestHttpServer& operator=(TestHttpServer&&) = delete;
+
+    /** @brief URL of a file on the server, any name serves the same content. */
+    [[nodiscard]] std::string url(std::string_view name) const;
+
+    void set_fault(FaultHook hook);
+    /** @brief Requests received so far, in arrival order. */
+    [[nodiscard]] std::vector<Request> requests();
+    void clear_requests();
+    /** @brief Most GET responses that were sending their body at the same time. */
+    [[nodiscard]] int peak_concurrent_gets() const;
+
+   private:
+    void accept_loop();
+    void serve(int client);
+
+    std::string content_;
+    bool accept_ranges_;
+    int listener_ = -1;
+    uint16_t port_ = 0;
+
+    std::mutex mutex_;
+    FaultHook fault_;                       // Guarded by mutex_
+    std::vector<Request> requests_;         // Guarded by mutex_
+    std::vector<std::thread> connections_;  // Guarded by mutex_
+    std::atomic<int> active_gets_{0};
+    std::atomic<int> peak_gets_{0};
+    std::thread acceptor_;
+};
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Log/Trace.h"
+
+namespace {
+constexpr uint64_t kCapacity = 8;
+
+struct TracedEvent {
+    uint64_t ts_us;
+    uint32_t tid;
+    uint64_t arg;
+};
+
+class TraceTest : public ::testing::Test {
+   protected:
+    static void SetUpTestSuite() {
+        // Read when the trace registry is created. Nothing in this executable uses it before the first start(),
+        // which is why these tests do not share a process with the other tests.
+        setenv("WIKIGRAPH_TRACE_EVENTS", std::to_string(kCapacity).c_str(), 1);  // NOLINT(concurrency-mt-unsafe)
+        path_ = std::filesystem::temp_directory_path() / "wikigraph_TraceTest" / "trace.json";
+        Trace::start(path_);
+    }
+
+    static void TearDownTestSuite() {
+        Trace::detail::enabled.store(false);
+        std::filesystem::remove_all(path_.parent_path());
+    }
+
+    // Complete events named `name` in the written trace, in file order
+    static std::vector<TracedEvent> written_events(const std::string& name) {
+        EXPECT_TRUE(Trace::write());
+        std::ifstream file(path_);
+        const std::regex pattern(R"re(\{"name": "([^"]*)", "cat": "test", "ph": "X", "ts": (\d+)\.000, )re"
+                                 R"re("dur": [0-9.]+, "pid": 1, "tid": (\d+), "args": \{"i": (\d+)\}\})re");
+        std::vector<TracedEvent> events;
+        std::string line;
+        std::smatch match;
+        while (std::getline(file, line)) {
+            if (std::regex_search(line, match, pattern) && match[1] == name) {
+                events.push_back({.ts_us = std::stoull(match[2]),
+                                  .tid = static_cast<uint32_t>(std::stoul(match[3])),
+                                  .arg = std::stoull(match[4])});
+            }
+        }
+        return events;
+    }
+
+    static std::string written_trace() {
+        EXPECT_TRUE(Trace::write());
+        std::ifstream file(path_);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    // Event i starts at i microseconds, so a torn copy shows up as a start that does not match its argument
+    static void record(const char* name, uint64_t i) {
+        Trace::record(name, "test", i * 1000, (i * 1000) + 500, "i", i);
+    }
+
+    static inline std::filesystem::path path_;
+};
+}  // namespace
+
+TEST_F(TraceTest, KeepsMostRecentEventsOfFullRing) {
+    std::thread([] {
+        for (uint64_t i = 0; i < 20; i++) {
+            record("wrap", i);
+        }
+    }).join();
+
+    const std::vector<TracedEvent> events = written_events("wrap");
+    ASSERT_EQ(events.size(), kCapacity);
+    for (uint64_t i = 0; i < kCapacity; i++) {
+        EXPECT_EQ(events[i].arg, 20 - kCapacity + i);
+        EXPECT_EQ(events[i].ts_us, events[i].arg);
+    }
+}
+
+TEST_F(TraceTest, ExitedThreadPassesItsBufferOn) {
+    // Threads that never run at the same time share one buffer, so only the last thread's events are left
+    for (uint64_t thread = 0; thread < 50; thread++) {
+        std::thread([thread] {
+            for (uint64_t i = 0; i < kCapacity; i++) {
+                record("reuse", (thread * kCapacity) + i);
+            }
+        }).join();
+    }
+
+    const std::vector<TracedEvent> events = written_events("reuse");
+    ASSERT_EQ(events.size(), kCapacity);
+    for (const TracedEvent& event : events) {
+        EXPECT_GE(event.arg, 49 * kCapacity);
+        EXPECT_EQ(event.tid, events.front().tid);  // Events keep the id of the thread that recorded them
+    }
+}
+
+TEST_F(TraceTest, WriteDuringRecordingSkipsOverwrittenEvents) {
+    std::atomic<bool> done{false};
+    std::thread recorder([&] {
+        for (uint64_t i = 0; !done.load(std::memory_order_relaxed); i++) {
+            record("hot", i);
+        }
+    });
+
+    // No ASSERT before the join, the recorder must be stopped on every path
+    for (int round = 0; round < 50 && !HasFailure(); round++) {
+        const std::vector<TracedEvent> events = written_events("hot");
+        EXPECT_LE(events.size(), kCapacity);
+        for (size_t i = 0; i < events.size(); i++) {
+            EXPECT_EQ(events[i].ts_us, events[i].arg);
+            if (i > 0) {
+                EXPECT_EQ(events[i].arg, events[i - 1].arg + 1);
+            }
+        }
+    }
+    done.store(true);
+    recorder.join();
+}
+
+TEST_F(TraceTest, WritesThreadNames) {
+    std::thread([] {
+        Trace::set_thread_name("reader \"main\"");
+        record("named", 1);
+    }).join();
+
+    const std::vector<TracedEvent> events = written_events("named");
+    ASSERT_EQ(events.size(), 1U);
+    const std::string metadata =
+        std::format(R"({{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, )"
+                    R"("args": {{"name": "reader \"main\""}}}})",
+                    events[0].tid);
+    EXPECT_NE(written_trace().find(metadata), std::string::npos);
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Utils/WThreadPool.h"
+
+TEST(WThreadPoolTest, EnqueueReturnsResults) {
+    WThreadPool pool(4);
+    std::vector<std::future<size_t>> futures;
+    for (size_t i = 0; i < 100; i++) {
+        futures.push_back(pool.enqueue([](size_t value) { return value * value; }, i));
+    }
+    for (size_t i = 0; i < futures.size(); i++) {
+        EXPECT_EQ(futures[i].get(), i * i);
+    }
+}
+
+TEST(WThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+    constexpr size_t kCount = 10007;
+    WThreadPool pool(4);
+    for (const size_t grain : {size_t{0}, size_t{1}, size_t{7}, kCount}) {
+        std::vector<std::atomic<uint32_t>> hits(kCount);
+        pool.parallel_for(
+            0, kCount,
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    hits[i].fetch_add(1, std::memory_order_relaxed);
+                }
+            },
+            grain);
+        for (size_t i = 0; i < kCount; i++) {
+            ASSERT_EQ(hits[i].load(), 1U) << "index " << i << ", grain " << grain;
+        }
+    }
+}
+
+TEST(WThreadPoolTest, NestedParallelForCompletes) {
+    // Fewer workers than outer chunks: waiting chunks must run inner chunks instead of blocking their worker
+    WThreadPool pool(2);
+    std::atomic<uint64_t> sum{0};
+    auto outer = [&] {
+        pool.parallel_for(
+            0, 16,
+            [&](size_t, size_t) {
+                pool.parallel_for(
+                    0, 1000,
+                    [&](size_t begin, size_t end) {
+                        for (size_t i = begin; i < end; i++) {
+                            sum.fetch_add(i, std::memory_order_relaxed);
+                        }
+                    },
+                    10);
+            },
+            1);
+    };
+
+    outer();
+    EXPECT_EQ(sum.load(), 16U * (999U * 1000U / 2));
+
+    // The same from inside a pool task
+    sum.store(0);
+    pool.enqueue(outer).get();
+    EXPECT_EQ(sum.load(), 16U * (999U * 1000U / 2));
+}
+
+TEST(WThreadPoolTest, ParallelForRethrowsAfterAllChunksFinished) {
+    WThreadPool pool(4);
+    std::atomic<size_t> finished{0};
+    EXPECT_THROW(pool.parallel_for(
+                     0, 64,
+                     [&](size_t begin, size_t) {
+                         if (begin == 40) {
+                             throw std::runtime_error("chunk failed");
+                         }
+                         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                         finished.fetch_add(1);
+                     },
+                     1),
+                 std::runtime_error);
+    EXPECT_EQ(finished.load(), 63U);
+}
+
+TEST(WThreadPoolTest, IdleWorkersStealFromBusyWorker) {
+    // More tasks than the initial deque capacity, all pushed onto one worker's deque
+    constexpr size_t kTasks = 3000;
+    WThreadPool pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> runners;
+    std::atomic<size_t> runs{0};
+
+    auto spawner = pool.enqueue([&] {
+        std::vector<std::future<void>> futures;
+        futures.reserve(kTasks);
+        for (size_t i = 0; i < kTasks; i++) {
+            futures.push_back(pool.enqueue([&] {
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+                runs.fetch_add(1, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(mutex);
+                runners.insert(std::this_thread::get_id());
+            }));
+        }
+        return futures;
+    });
+    for (std::future<void>& future : spawner.get()) {
+        future.get();
+    }
+
+    EXPECT_EQ(runs.load(), kTasks);
+    EXPECT_GT(runners.size(), 1U);
+}
@@ -0,0 +1,42 @@
+#include "DumpSet.h"
+
+#include <array>
+#include <chrono>
+#include <format>
+#include <system_error>
+
+#include "SyntheticDump.h"
+
+WikiFile DumpSet::file(WikiFileType type) const {
+    static const std::array<const char*, 3> tables{"page", "linktarget", "pagelinks"};
+
+    WikiFile f{};
+    f.exists = true;
+    f.lang_code = prefix;
+    f.date = date;
+    f.file_type = type;
+    f.data_path = dir / std::format("{}wiki-{}-{}.sql.gz", prefix, date, tables[static_cast<size_t>(type)]);
+    f.file_size = std::filesystem::file_size(f.data_path);
+    return f;
+}
+
+TemporaryDump::TemporaryDump(uint64_t pages) {
+    SyntheticDump::Options options;
+    options.pages = pages;
+    dump_.dir = std::filesystem::temp_directory_path() /
+                std::format("wikigraph_dump_{}", std::chrono::steady_clock::now().time_since_epoch().count());
+    dump_.prefix = options.prefix;
+    dump_.date = options.date;
+    try {
+        SyntheticDump::generate(options, dump_.dir);
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove_all(dump_.dir, ec);
+        throw;
+    }
+}
+
+TemporaryDump::~TemporaryDump() {
+    std::error_code ec;
+    std::filesystem::remove_all(dump_.dir, ec);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "UI/UIBase.h"
+
+/**
+ * @brief The three dump files of one wiki and date, as the benchmark tools address them.
+ */
+struct DumpSet {
+    std::filesystem::path dir = "data";
+    std::string prefix = "en";
+    std::string date;
+
+    /**
+     * @brief Descriptor of `<dir>/<prefix>wiki-<date>-<table>.sql.gz`, as the loaders get it from the UI.
+     * @throws std::filesystem::filesystem_error if the file does not exist
+     */
+    [[nodiscard]] WikiFile file(WikiFileType type) const;
+};
+
+/**
+ * @brief A synthetic dump with default options generated in a temporary directory, removed on destruction.
+ */
+class TemporaryDump {
+   public:
+    explicit TemporaryDump(uint64_t pages);
+    ~TemporaryDump();
+
+    TemporaryDump(const TemporaryDump&) = delete;
+    TemporaryDump& operator=(const TemporaryDump&) = delete;
+    TemporaryDump(TemporaryDump&&) = delete;
+    TemporaryDump& operator=(TemporaryDump&&) = delete;
+
+    [[nodiscard]] const DumpSet& dump() const {
+        return dump_;
+    }
+
+   private:
+    DumpSet dump_;
+};
@@ -0,0 +1,242 @@
+#include "Json.h"
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace Json {
+namespace {
+class Parser {
+   public:
+    explicit Parser(std::string_view text) : text(text) {}
+
+    Value document() {
+        Value value = parse_value();
+        skip_whitespace();
+        if (at != text.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+   private:
+    std::string_view text;
+    size_t at = 0;
+
+    [[noreturn]] void fail(std::string_view what) const {
+        throw std::runtime_error(std::format("Invalid JSON at offset {}: {}", at, what));
+    }
+
+    void skip_whitespace() {
+        while (at < text.size() && (text[at] == ' ' || text[at] == '\n' || text[at] == '\r' || text[at] == '\t')) {
+            at++;
+        }
+    }
+
+    bool consume(char c) {
+        skip_whitespace();
+        if (at < text.size() && text[at] == c) {
+            at++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) {
+            fail(std::format("expected '{}'", c));
+        }
+    }
+
+    bool consume_literal(std::string_view literal) {
+        if (text.substr(at).starts_with(literal)) {
+            at += literal.size();
+            return true;
+        }
+        return false;
+    }
+
+    Value parse_value() {
+        skip_whitespace();
+        if (at >= text.size()) {
+            fail("unexpected end");
+        }
+        Value value;
+        const char c = text[at];
+        if (c == '{') {
+            value.type = Value::Type::Object;
+            at++;
+            if (!consume('}')) {
+                do {
+                    skip_whitespace();
+                    std::string key = parse_string();
+                    expect(':');
+                    value.object.emplace_back(std::move(key), parse_value());
+                } while (consume(','));
+                expect('}');
+            }
+        } else if (c == '[') {
+            value.type = Value::Type::Array;
+            at++;
+            if (!consume(']')) {
+                do {
+                    value.array.push_back(parse_value());
+                } while (consume(','));
+                expect(']');
+            }
+        } else if (c == '"') {
+            value.type = Value::Type::String;
+            value.string = parse_string();
+        } else if (consume_literal("true") || consume_literal("false")) {
+            value.type = Value::Type::Bool;
+            value.boolean = c == 't';
+        } else if (consume_literal("null")) {
+            value.type = Value::Type::Null;
+        } else if (consume_literal("NaN")) {  // Not JSON, but written by some reporters for undefined results
+            value.type = Value::Type::Number;
+            value.number = std::numeric_limits<double>::quiet_NaN();
+        } else if (consume_literal("Infinity") || consume_literal("-Infinity")) {
+            value.type = Value::Type::Number;
+            const double infinity = std::numeric_limits<double>::infinity();
+            value.number = c == '-' ? -infinity : infinity;
+        } else {
+            value.type = Value::Type::Number;
+            value.number = parse_number();
+        }
+        return value;
+    }
+
+    double parse_number() {
+        const size_t start = at;
+        while (at < text.size() && (std::isdigit(static_cast<unsigned char>(text[at])) != 0 || text[at] == '-' ||
+                                    text[at] == '+' || text[at] == '.' || text[at] == 'e' || text[at] == 'E')) {
+            at++;
+        }
+        double number = 0.0;
+        const auto [end, error] = std::from_chars(text.data() + start, text.data() + at, number);
+        if (error != std::errc() || end != text.data() + at || start == at) {
+            at = start;
+            fail("invalid number");
+        }
+        return number;
+    }
+
+    std::string parse_string() {
+        if (at >= text.size() || text[at] != '"') {
+            fail("expected a string");
+        }
+        at++;
+        std::string out;
+        while (at < text.size() && text[at] != '"') {
+            char c = text[at++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (at >= text.size()) {
+                break;
+            }
+            c = text[at++];
+            switch (c) {
+                case 'n':
+                    out += '\n';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'u':
+                    append_code_point(out);
+                    break;
+                default:  // '"', '\\' and '/'
+                    out += c;
+            }
+        }
+        if (at >= text.size()) {
+            fail("unterminated string");
+        }
+        at++;
+        return out;
+    }
+
+    // \uXXXX escape as UTF-8, surrogate pairs included
+    void append_code_point(std::string& out) {
+        auto hex4 = [this] {
+            uint32_t value = 0;
+            if (at + 4 > text.size() || std::from_chars(text.data() + at, text.data() + at + 4, value, 16).ptr !=
+                                            text.data() + at + 4) {
+                fail("invalid \\u escape");
+            }
+            at += 4;
+            return value;
+        };
+        uint32_t code = hex4();
+        if (code >= 0xd800 && code < 0xdc00 && consume_literal("\\u")) {
+            code = 0x10000 + ((code - 0xd800) << 10) + (hex4() - 0xdc00);
+        }
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xc0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xe0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+};
+
+const Value null_value;
+}  // namespace
+
+const Value* Value::find(std::string_view key) const {
+    for (const auto& [name, value] : object) {
+        if (name == key) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+const Value& Value::operator[](std::string_view key) const {
+    const Value* value = find(key);
+    return value != nullptr ? *value : null_value;
+}
+
+Value parse(std::string_view text) {
+    return Parser(text).document();
+}
+
+Value parse_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error(std::format("Cannot open {}", path.string()));
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    try {
+        return parse(contents.str());
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(std::format("{}: {}", path.string(), e.what()));
+    }
+}
+}  // namespace Json
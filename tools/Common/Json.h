@@ -0,0 +1,58 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Minimal JSON reader for the reports the benchmark tools write and read back.
+ *
+ * Numbers are read as double, objects keep their keys in document order.
+ */
+namespace Json {
+struct Value {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Value> array;
+    std::vector<std::pair<std::string, Value>> object;
+
+    /** @brief Member of an object, nullptr if this is not an object or has no such key. */
+    [[nodiscard]] const Value* find(std::string_view key) const;
+
+    /** @brief Member of an object, a null value if it is missing. */
+    [[nodiscard]] const Value& operator[](std::string_view key) const;
+
+    /** @brief The number, or `fallback` if this is not a number. */
+    [[nodiscard]] double as_number(double fallback = 0.0) const {
+        return type == Type::Number ? number : fallback;
+    }
+
+    /** @brief The string, or an empty one if this is not a string. */
+    [[nodiscard]] std::string_view as_string() const {
+        return type == Type::String ? std::string_view(string) : std::string_view();
+    }
+
+    /** @brief The boolean, false if this is not a boolean. */
+    [[nodiscard]] bool as_bool() const {
+        return type == Type::Bool && boolean;
+    }
+};
+
+/**
+ * @brief Parse a JSON document.
+ * @throws std::runtime_error with the offset of the first syntax error
+ */
+Value parse(std::string_view text);
+
+/**
+ * @brief Read and parse a JSON file.
+ * @throws std::runtime_error if the file cannot be read or is not valid JSON
+ */
+Value parse_file(const std::filesystem::path& path);
+}  // namespace Json
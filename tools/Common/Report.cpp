@@ -0,0 +1,75 @@
+#include "Report.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <utility>
+
+namespace Report {
+std::string json_string(std::string_view text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += std::format("\\u{:04x}", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::ranges::sort(values);
+    const size_t mid = values.size() / 2;
+    return values.size() % 2 == 1 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+double median_absolute_deviation(const std::vector<double>& values) {
+    const double center = median(values);
+    std::vector<double> deviations;
+    deviations.reserve(values.size());
+    for (double value : values) {
+        deviations.push_back(std::abs(value - center));
+    }
+    return median(std::move(deviations));
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::string counters_json(const CounterValues& counters) {
+    if (!counters.any()) {
+        return "null";
+    }
+    std::string out = "{";
+    for (size_t i = 0; i < CounterValues::COUNT; i++) {
+        const auto counter = static_cast<HwCounter>(i);
+        if (counters.has(counter)) {
+            out += std::format("\"{}\": {}, ", PerfCounters::name(counter), counters.get(counter));
+        }
+    }
+    return out + std::format("\"ipc\": {:.3f}}}", counters.ipc());
+}
+
+std::string timestamp() {
+    return std::format("{:%FT%TZ}", std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+}
+}  // namespace Report
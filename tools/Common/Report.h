@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Utils/PerfCounters.h"
+
+/**
+ * @brief Helpers shared by the benchmark tools to write their JSON reports.
+ */
+namespace Report {
+/** @brief Quote and escape a string as a JSON string literal. */
+std::string json_string(std::string_view text);
+
+/** @brief Median of the values, 0 if there are none. */
+double median(std::vector<double> values);
+
+/** @brief Median absolute deviation from the median, a spread estimate that ignores outliers, 0 if empty. */
+double median_absolute_deviation(const std::vector<double>& values);
+
+/**
+ * @brief Nearest-rank percentile of values that are already sorted ascending, 0 if there are none.
+ * @param fraction Percentile as a fraction, e.g. 0.99
+ */
+double percentile(const std::vector<double>& sorted, double fraction);
+
+/** @brief JSON object of the valid hardware counters and the IPC, `null` if counting was off or unavailable. */
+std::string counters_json(const CounterValues& counters);
+
+/** @brief ISO 8601 UTC time of the call, to date a report. */
+std::string timestamp();
+}  // namespace Report
@@ -0,0 +1,393 @@
+#include "SyntheticDump.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace SyntheticDump {
+namespace {
+// Salts that give every attribute of a page its own random stream
+constexpr uint64_t kSaltPage = 0x7061676500000000;
+constexpr uint64_t kSaltTitle = 0x7469746c65000000;
+constexpr uint64_t kSaltLinks = 0x6c696e6b73000000;
+constexpr uint64_t kSaltRedLink = 0x7265646c6e6b0000;
+
+constexpr size_t kMaxTitleBytes = 255;
+constexpr uint64_t kMaxDegree = 10'000;
+// Page ids are 32-bit in the loaders
+constexpr uint64_t kMaxPages = 3'000'000'000;
+
+// Other namespaces and how often they occur: talk, user, user talk, project, file, template, category
+constexpr std::array<int32_t, 7> kOtherNamespaces{1, 2, 3, 4, 6, 10, 14};
+constexpr std::array<double, 7> kOtherNamespaceWeights{0.30, 0.15, 0.25, 0.05, 0.10, 0.05, 0.10};
+
+constexpr std::array<std::string_view, 24> kSyllables{"ka", "lo", "mer", "tin", "sa", "ve", "ro", "dan",
+                                                      "li", "gor", "na", "pe", "qu", "ast", "bel", "cor",
+                                                      "di", "en", "fa", "hul", "is", "jo", "mun", "zet"};
+// Characters that need escaping in SQL or trip up naive tuple splitting, and multi-byte UTF-8
+constexpr std::array<std::string_view, 10> kTrickyParts{"'", "\"", "\\", "(", ")", ",", "),(", "\xC3\xA9",
+                                                        "\xE6\x97\xA5\xE6\x9C\xAC", "&"};
+
+// SplitMix64, the output only depends on the state, not on the standard library
+class Rng {
+   public:
+    Rng(uint64_t seed, uint64_t index, uint64_t salt) : state_(mix(seed ^ salt) ^ mix(index + salt)) {}
+
+    uint64_t next() {
+        state_ += 0x9E3779B97F4A7C15;
+        return mix(state_);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return static_cast<double>(next() >> 11) * 0x1.0p-53;
+    }
+
+    // Uniform in [0, n)
+    uint64_t below(uint64_t n) {
+        return static_cast<uint64_t>(uniform() * static_cast<double>(n));
+    }
+
+    // Standard normal, Box-Muller
+    double normal() {
+        const double u1 = 1.0 - uniform();
+        const double u2 = uniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * std::numbers::pi * u2);
+    }
+
+   private:
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state_;
+};
+
+// Page ids skip every ninth id, like the gaps deleted pages leave
+uint64_t page_id(uint64_t index) {
+    return index + 1 + index / 8;
+}
+
+// mysqldump escaping of a string literal
+void append_escaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+            case '\0':
+                out += "\\0";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\\':
+            case '\'':
+            case '"':
+                out += '\\';
+                out += c;
+                break;
+            default:
+                out += c;
+        }
+    }
+}
+
+std::string to_base36(uint64_t value) {
+    constexpr std::string_view digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+    std::string out;
+    do {
+        out += digits[value % 36];
+        value /= 36;
+    } while (value != 0);
+    std::ranges::reverse(out);
+    return out;
+}
+
+// Writes the extended INSERT lines of one table to a gzip file
+class TableWriter {
+   public:
+    TableWriter(const std::filesystem::path& path, std::string table, const Options& options)
+        : path_(path), table_(std::move(table)), line_bytes_(options.line_bytes) {
+        file_ = gzopen(path.string().c_str(), std::format("wb{}", options.compression_level).c_str());
+        if (file_ == nullptr) {
+            throw std::runtime_error(std::format("Failed to open {} for writing", path.string()));
+        }
+        gzbuffer(file_, 1 << 20);
+        line_.reserve(line_bytes_ + 4096);
+        write(std::format("-- Synthetic MediaWiki dump, seed {}\n--\n-- Dumping data for table `{}`\n--\n\n",
+                          options.seed, table_));
+        write(std::format("LOCK TABLES `{}` WRITE;\n/*!40000 ALTER TABLE `{}` DISABLE KEYS */;\n", table_, table_));
+    }
+
+    TableWriter(const TableWriter&) = delete;
+    TableWriter& operator=(const TableWriter&) = delete;
+    TableWriter(TableWriter&&) = delete;
+    TableWriter& operator=(TableWriter&&) = delete;
+
+    ~TableWriter() {
+        if (file_ != nullptr) {
+            gzclose(file_);
+        }
+    }
+
+    // Start a row on the current line, the caller appends the tuple's values to the returned line
+    std::string& begin_row() {
+        line_ += line_.empty() ? std::format("INSERT INTO `{}` VALUES (", table_) : ",(";
+        rows_++;
+        return line_;
+    }
+
+    void end_row() {
+        line_ += ')';
+        if (line_.size() >= line_bytes_) {
+            flush_line();
+        }
+    }
+
+    // Finish the file and return its compressed size
+    uint64_t close() {
+        flush_line();
+        write(std::format("/*!40000 ALTER TABLE `{}` ENABLE KEYS */;\nUNLOCK TABLES;\n", table_));
+        if (gzclose(file_) != Z_OK) {
+            file_ = nullptr;
+            throw std::runtime_error(std::format("Failed to write {}", path_.string()));
+        }
+        file_ = nullptr;
+        return std::filesystem::file_size(path_);
+    }
+
+    [[nodiscard]] uint64_t rows() const {
+        return rows_;
+    }
+
+   private:
+    void flush_line() {
+        if (line_.empty()) {
+            return;
+        }
+        line_ += ";\n";
+        write(line_);
+        line_.clear();
+    }
+
+    void write(std::string_view data) {
+        if (gzwrite(file_, data.data(), static_cast<unsigned int>(data.size())) != static_cast<int>(data.size())) {
+            throw std::runtime_error(std::format("Failed to write {}", path_.string()));
+        }
+    }
+
+    std::filesystem::path path_;
+    std::string table_;
+    size_t line_bytes_;
+    gzFile file_ = nullptr;
+    std::string line_;
+    uint64_t rows_ = 0;
+};
+
+class Generator {
+   public:
+    explicit Generator(const Options& options)
+        : options_(options),
+          red_links_(static_cast<uint64_t>(std::ceil(static_cast<double>(options.pages) * options.red_link_fraction))),
+          // Pareto minimum giving the requested mean: mean = x_min * (a - 1) / (a - 2)
+          degree_min_(options.average_degree * (options.degree_exponent - 2.0) / (options.degree_exponent - 1.0)) {
+        if (options.pages == 0 || options.pages > kMaxPages) {
+            throw std::invalid_argument(std::format("The page count must be between 1 and {}", kMaxPages));
+        }
+        if (options.degree_exponent <= 2.0) {
+            throw std::invalid_argument("The degree exponent must be above 2 for the mean degree to exist");
+        }
+        if (options.popularity_exponent < 0.0 || options.popularity_exponent >= 1.0) {
+            throw std::invalid_argument("The popularity exponent must be in [0, 1)");
+        }
+        // Any multiplier coprime to the page count scrambles popularity ranks into page indices
+        scramble_ = 0x9E3779B97F4A7C15 % options.pages;
+        while (std::gcd(scramble_, options.pages) != 1) {
+            scramble_++;
+        }
+    }
+
+    struct Page {
+        int32_t ns;
+        bool redirect;
+    };
+
+    [[nodiscard]] Page page(uint64_t index) const {
+        Rng rng(options_.seed, index, kSaltPage);
+        Page page{.ns = 0, .redirect = false};
+        if (rng.uniform() >= options_.main_namespace_fraction) {
+            double pick = rng.uniform();
+            size_t i = 0;
+            while (i + 1 < kOtherNamespaces.size() && pick >= kOtherNamespaceWeights[i]) {
+                pick -= kOtherNamespaceWeights[i++];
+            }
+            page.ns = kOtherNamespaces[i];
+        }
+        page.redirect = page.ns == 0 && rng.uniform() < options_.redirect_fraction;
+        return page;
+    }
+
+    // Unique title, the base-36 suffix encodes the index
+    [[nodiscard]] std::string title(uint64_t index, uint64_t salt = kSaltTitle) const {
+        Rng rng(options_.seed, index, salt);
+        const double sigma = options_.title_length_sigma;
+        const double mu = std::log(options_.title_length_mean) - sigma * sigma / 2.0;
+        const std::string suffix = "_" + to_base36(index);
+        const size_t max_bytes = kMaxTitleBytes - suffix.size();
+        const auto length = std::clamp<size_t>(static_cast<size_t>(std::exp(mu + sigma * rng.normal())), 1, max_bytes);
+
+        // Built from whole parts, so tricky parts never land inside a multi-byte character
+        std::vector<std::string_view> parts;
+        size_t size = 0;
+        while (size < length) {
+            if (!parts.empty() && rng.uniform() < 0.3) {
+                parts.emplace_back("_");
+                size++;
+            }
+            parts.push_back(kSyllables[rng.below(kSyllables.size())]);
+            size += parts.back().size();
+        }
+
+        if (rng.uniform() < options_.escape_fraction) {
+            for (uint64_t count = 1 + rng.below(3); count > 0; count--) {
+                // Never in front, so titles still start with a letter
+                const size_t at = 1 + rng.below(parts.size());
+                parts.insert(parts.begin() + static_cast<std::ptrdiff_t>(at),
+                             kTrickyParts[rng.below(kTrickyParts.size())]);
+            }
+        }
+
+        // The syllables may overshoot the length and the tricky parts add to it, keep the parts that fit
+        std::string title;
+        for (const std::string_view part : parts) {
+            if (title.size() + part.size() > max_bytes) {
+                break;
+            }
+            title += part;
+        }
+        while (title.size() > 1 && title.back() == '_') {
+            title.pop_back();
+        }
+        title[0] = static_cast<char>(title[0] - 'a' + 'A');
+        return title + suffix;
+    }
+
+    // Link targets of a page, sorted by linktarget id like the dump's primary key
+    void links(uint64_t index, const Page& from, std::vector<uint64_t>& targets) const {
+        targets.clear();
+        Rng rng(options_.seed, index, kSaltLinks);
+        uint64_t degree = 1;
+        if (!from.redirect) {
+            const double pareto = degree_min_ * std::pow(1.0 - rng.uniform(), -1.0 / (options_.degree_exponent - 1.0));
+            degree = std::min<uint64_t>(static_cast<uint64_t>(pareto), kMaxDegree);
+        }
+
+        const uint64_t pages = options_.pages;
+        for (uint64_t i = 0; i < degree; i++) {
+            if (red_links_ > 0 && rng.uniform() < options_.red_link_fraction) {
+                targets.push_back(pages + 1 + rng.below(red_links_));
+                continue;
+            }
+            // Popularity rank r has weight r^-s, sampled by inverting the continuous CDF (r / N)^(1 - s)
+            const double u = rng.uniform();
+            auto rank = static_cast<uint64_t>(static_cast<double>(pages) *
+                                              std::pow(u, 1.0 / (1.0 - options_.popularity_exponent)));
+            rank = std::min(rank, pages - 1);
+            const uint64_t target = rank * scramble_ % pages;  // Both below 2^32, the product does not overflow
+            targets.push_back(target + 1);  // Linktarget id of a page is its index + 1
+        }
+        std::ranges::sort(targets);
+        const auto duplicates = std::ranges::unique(targets);
+        targets.erase(duplicates.begin(), duplicates.end());
+    }
+
+    [[nodiscard]] uint64_t red_links() const {
+        return red_links_;
+    }
+
+   private:
+    const Options& options_;
+    uint64_t red_links_;
+    double degree_min_;
+    uint64_t scramble_ = 1;
+};
+}  // namespace
+
+std::filesystem::path dump_path(const std::filesystem::path& dir, const Options& options, const std::string& table) {
+    return dir / std::format("{}wiki-{}-{}.sql.gz", options.prefix, options.date, table);
+}
+
+Summary generate(const Options& options, const std::filesystem::path& dir) {
+    const Generator generator(options);
+    Summary summary{};
+    std::filesystem::create_directories(dir);
+
+    // Timestamps and revision ids are not read by the loaders, they only give the rows a realistic size
+    TableWriter pages(dump_path(dir, options, "page"), "page", options);
+    for (uint64_t i = 0; i < options.pages; i++) {
+        const Generator::Page page = generator.page(i);
+        Rng rng(options.seed, i, kSaltPage ^ 1);
+        std::string& row = pages.begin_row();
+        row += std::format("{},{},'", page_id(i), page.ns);
+        append_escaped(row, generator.title(i));
+        row += std::format("',{},0,{:.14f},'{}000000','{}000000',{},{},'wikitext',NULL", page.redirect ? 1 : 0,
+                           rng.uniform(), options.date, options.date, 1'000'000 + rng.below(1'000'000'000),
+                           page.redirect ? 20 + rng.below(60) : 100 + rng.below(100'000));
+        pages.end_row();
+        summary.main_pages += page.ns == 0 ? 1 : 0;
+        summary.redirects += page.redirect ? 1 : 0;
+    }
+    summary.pages = pages.rows();
+    summary.bytes += pages.close();
+
+    // One target per page, then the titles of red links
+    TableWriter linktargets(dump_path(dir, options, "linktarget"), "linktarget", options);
+    for (uint64_t i = 0; i < options.pages; i++) {
+        std::string& row = linktargets.begin_row();
+        row += std::format("{},{},'", i + 1, generator.page(i).ns);
+        append_escaped(row, generator.title(i));
+        row += '\'';
+        linktargets.end_row();
+    }
+    for (uint64_t j = 0; j < generator.red_links(); j++) {
+        std::string& row = linktargets.begin_row();
+        row += std::format("{},0,'", options.pages + 1 + j);
+        append_escaped(row, generator.title(options.pages + j, kSaltRedLink));
+        row += '\'';
+        linktargets.end_row();
+    }
+    summary.linktargets = linktargets.rows();
+    summary.bytes += linktargets.close();
+
+    TableWriter pagelinks(dump_path(dir, options, "pagelinks"), "pagelinks", options);
+    std::vector<uint64_t> targets;
+    for (uint64_t i = 0; i < options.pages; i++) {
+        const Generator::Page from = generator.page(i);
+        generator.links(i, from, targets);
+        for (uint64_t target : targets) {
+            std::string& row = pagelinks.begin_row();
+            row += std::format("{},{},{}", page_id(i), from.ns, target);
+            pagelinks.end_row();
+            if (from.ns == 0 && target <= options.pages && generator.page(target - 1).ns == 0) {
+                summary.main_links++;
+            }
+        }
+    }
+    summary.links = pagelinks.rows();
+    summary.bytes += pagelinks.close();
+    return summary;
+}
+}  // namespace SyntheticDump
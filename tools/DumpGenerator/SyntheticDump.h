@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Generator of synthetic MediaWiki `page`, `linktarget` and `pagelinks` dumps.
+ *
+ * The files use the mysqldump format of the Wikimedia dumps: extended INSERT lines of about 1 MB, gzip-compressed,
+ * so the loaders read them exactly like real dumps. Every attribute of a page is derived from the seed and the page
+ * index alone with a built-in generator rather than the standard library's engines, so the output is reproducible
+ * and nothing is held in memory per page, which makes dumps of 100M pages possible.
+ */
+namespace SyntheticDump {
+struct Options {
+    std::string prefix = "synth";  // Files are named "<prefix>wiki-<date>-<table>.sql.gz"
+    std::string date = "20250101";
+    uint64_t pages = 1'000'000;  // At most 3 billion
+    uint64_t seed = 1;
+
+    double main_namespace_fraction = 0.5;  // Pages in the article namespace, the rest is spread over talk, user...
+    double redirect_fraction = 0.1;        // Articles that are redirects, they have a single link
+    double average_degree = 20.0;          // Mean number of links per page
+    double degree_exponent = 2.2;          // Power-law exponent of the out-degree, must be above 2
+    double popularity_exponent = 0.8;      // Zipf exponent of the link targets, in [0, 1)
+    double red_link_fraction = 0.05;       // Links to titles without a page
+    double title_length_mean = 18.0;       // Log-normal title length in bytes
+    double title_length_sigma = 0.5;
+    double escape_fraction = 0.02;  // Titles with quotes, backslashes, parentheses or non-ASCII characters
+
+    size_t line_bytes = size_t{1} << 20;  // Length of an INSERT line
+    int compression_level = 6;
+};
+
+/**
+ * @brief What a generated dump contains, to check what the loaders make of it.
+ */
+struct Summary {
+    uint64_t pages;        // Rows in the page table
+    uint64_t main_pages;   // Pages in the article namespace
+    uint64_t redirects;    // Article redirects
+    uint64_t linktargets;  // Rows in the linktarget table
+    uint64_t links;        // Rows in the pagelinks table
+    uint64_t main_links;   // Links between two existing articles, the edges of the loaded graph
+    uint64_t bytes;        // Compressed size of the three files
+};
+
+/** @brief Path of one of the dump files, `table` is "page", "linktarget" or "pagelinks". */
+std::filesystem::path dump_path(const std::filesystem::path& dir, const Options& options, const std::string& table);
+
+/**
+ * @brief Write the three dump files to `dir`.
+ * @throws std::runtime_error if a file cannot be written
+ */
+Summary generate(const Options& options, const std::filesystem::path& dir);
+}  // namespace SyntheticDump
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "SyntheticDump.h"
+
+namespace {
+void print_usage() {
+    const SyntheticDump::Options defaults;
+    std::cout << std::format(
+        "Usage: wikigraph_dumpgen [options]\n"
+        "Writes <prefix>wiki-<date>-{{page,linktarget,pagelinks}}.sql.gz in the Wikimedia dump format.\n\n"
+        "  --out DIR                  Output directory (default: data)\n"
+        "  --prefix NAME              Wiki prefix (default: {})\n"
+        "  --date YYYYMMDD            Dump date (default: {})\n"
+        "  --pages N                  Number of pages (default: {})\n"
+        "  --seed N                   Random seed (default: {})\n"
+        "  --main-namespace F         Fraction of pages that are articles (default: {})\n"
+        "  --redirects F              Fraction of articles that are redirects (default: {})\n"
+        "  --degree N                 Mean links per page (default: {})\n"
+        "  --degree-exponent A        Power-law exponent of the out-degree, above 2 (default: {})\n"
+        "  --popularity-exponent S    Zipf exponent of link targets, in [0, 1) (default: {})\n"
+        "  --red-links F              Fraction of links to missing pages (default: {})\n"
+        "  --title-length N           Mean title length in bytes (default: {})\n"
+        "  --title-length-sigma S     Log-normal sigma of the title length (default: {})\n"
+        "  --escapes F                Fraction of titles with characters that need escaping (default: {})\n"
+        "  --line-bytes N             Length of an INSERT line (default: {})\n"
+        "  --level N                  gzip compression level (default: {})\n",
+        defaults.prefix, defaults.date, defaults.pages, defaults.seed, defaults.main_namespace_fraction,
+        defaults.redirect_fraction, defaults.average_degree, defaults.degree_exponent, defaults.popularity_exponent,
+        defaults.red_link_fraction, defaults.title_length_mean, defaults.title_length_sigma, defaults.escape_fraction,
+        defaults.line_bytes, defaults.compression_level);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    SyntheticDump::Options options;
+    std::string out = "data";
+
+    auto as_uint = [](uint64_t& field) {
+        return [&field](const std::string& value) { field = std::stoull(value); };
+    };
+    auto as_double = [](double& field) {
+        return [&field](const std::string& value) { field = std::stod(value); };
+    };
+    const std::map<std::string_view, std::function<void(const std::string&)>> flags{
+        {"--out", [&](const std::string& value) { out = value; }},
+        {"--prefix", [&](const std::string& value) { options.prefix = value; }},
+        {"--date", [&](const std::string& value) { options.date = value; }},
+        {"--pages", as_uint(options.pages)},
+        {"--seed", as_uint(options.seed)},
+        {"--main-namespace", as_double(options.main_namespace_fraction)},
+        {"--redirects", as_double(options.redirect_fraction)},
+        {"--degree", as_double(options.average_degree)},
+        {"--degree-exponent", as_double(options.degree_exponent)},
+        {"--popularity-exponent", as_double(options.popularity_exponent)},
+        {"--red-links", as_double(options.red_link_fraction)},
+        {"--title-length", as_double(options.title_length_mean)},
+        {"--title-length-sigma", as_double(options.title_length_sigma)},
+        {"--escapes", as_double(options.escape_fraction)},
+        {"--line-bytes", [&](const std::string& value) { options.line_bytes = std::stoull(value); }},
+        {"--level", [&](const std::string& value) { options.compression_level = std::stoi(value); }},
+    };
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                print_usage();
+                return EXIT_SUCCESS;
+            }
+            auto flag = flags.find(arg);
+            if (flag == flags.end() || i + 1 == argc) {
+                std::cerr << std::format("Unknown option or missing value: {}\n", arg);
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            flag->second(argv[++i]);
+        }
+        if (options.date.size() != 8) {
+            std::cerr << "The date must have the form YYYYMMDD\n";
+            return EXIT_FAILURE;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const SyntheticDump::Summary summary = SyntheticDump::generate(options, out);
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::format(
+            "Wrote {}wiki-{} to {} in {:.1f} s ({:.1f} MB compressed)\n"
+            "  pages:        {} ({} articles, {} redirects)\n"
+            "  linktargets:  {}\n"
+            "  links:        {} ({} between articles)\n",
+            options.prefix, options.date, out, seconds, static_cast<double>(summary.bytes) / (1024 * 1024),
+            summary.pages, summary.main_pages, summary.redirects, summary.linktargets, summary.links,
+            summary.main_links);
+    } catch (const std::exception& e) {
+        std::cerr << std::format("Error: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,417 @@
+// Headless end-to-end load benchmark: loads a dump set like the UI does, several times, and writes a JSON report
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DataLoader/DataLoaderManager.h"
+#include "DumpSet.h"
+#include "Log/Trace.h"
+#include "PageGraph/PageGraph.h"
+#include "Report.h"
+#include "Utils/Affinity.h"
+#include "Utils/PerfCounters.h"
+#include "Utils/ProcessStats.h"
+#include "Utils/ResourceProbe.h"
+#include "Utils/WThreadPool.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+using Report::json_string;
+using Report::median;
+
+struct StageResult {
+    std::string name;
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+    uint64_t compressed_bytes = 0;    // Size of the dump file
+    uint64_t decompressed_bytes = 0;  // Bytes the line reader produced
+    uint64_t rows = 0;                // Rows parsed, or links handed to the graph build
+    uint64_t items = 0;               // Rows kept by the loader, or edges of the graph
+    uint64_t start_rss_bytes = 0;                   // Before the stage, what earlier stages still hold
+    std::optional<uint64_t> peak_rss_growth_bytes;  // Peak above start_rss_bytes, unknown if it could not be reset
+    uint64_t rss_bytes = 0;                         // At the end of the stage, after freeing what it no longer needs
+    std::vector<StructureMemory> structures;  // Footprint of the loaders' and the graph's structures at that point
+    std::array<StageTiming, 3> pipeline{};  // Busy and blocked time of the read, parse and insert stages
+    double mean_read_queue = 0;             // Lines waiting for the consumer, averaged over the queue samples
+    CounterValues counters;                 // Hardware counters of the stage and the threads it started
+};
+
+struct RunResult {
+    bool cold_cache = false;
+    std::vector<StageResult> stages;
+    uint64_t nodes = 0;
+    uint64_t edges = 0;
+};
+
+double rate(double amount, double seconds) {
+    return seconds > 0 ? amount / seconds : 0.0;
+}
+
+std::string bytes_json(const std::optional<uint64_t>& bytes) {
+    return bytes ? std::to_string(*bytes) : "null";
+}
+
+// Evict a file from the page cache, so the next read comes from the disk
+bool drop_from_page_cache(const std::filesystem::path& path) {
+#ifdef __linux__
+    const int fd = open(path.c_str(), O_RDONLY);  // NOLINT(cppcoreguidelines-pro-type-vararg)
+    if (fd < 0) {
+        return false;
+    }
+    // Dirty pages cannot be dropped, a freshly generated dump has to reach the disk first
+    fdatasync(fd);
+    const bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+// Run one stage, measuring its wall and CPU time, how far it raised the RSS and, if requested, its hardware counters
+StageResult measure(std::string name, const std::function<void(StageResult&)>& stage) {
+    StageResult result;
+    result.name = std::move(name);
+    // Heap that earlier stages and runs freed would otherwise stay resident, and be reused by this stage or not
+    ProcessStats::trim_heap();
+    // Without a reset the high-water mark is that of the whole process so far, which is not the stage's peak
+    const bool peak_reset = ProcessStats::reset_peak_rss();
+    result.start_rss_bytes = ProcessStats::current_rss_bytes();
+    static bool warned = false;
+    if (!peak_reset && !warned) {
+        spdlog::warn("Cannot reset the peak RSS, reporting null instead of per-stage peaks");
+        warned = true;
+    }
+    const double cpu_start = ProcessStats::cpu_seconds();
+    const auto start = std::chrono::steady_clock::now();
+    {
+        // The loaders start their threads inside the stage, so the session covers them. The graph build runs on the
+        // shared pool, created before the first stage, whose workers the session counts per thread.
+        const PerfCounters::Session counters(PerfCounters::Session::Scope::WithWorkers);
+        stage(result);
+        result.counters = counters.read();
+    }
+    result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.cpu_seconds = ProcessStats::cpu_seconds() - cpu_start;
+    if (peak_reset) {
+        // The reset starts the high-water mark at the RSS the earlier stages left, count only what the stage added
+        const uint64_t peak = ProcessStats::peak_rss_bytes();
+        result.peak_rss_growth_bytes = peak > result.start_rss_bytes ? peak - result.start_rss_bytes : 0;
+    }
+    result.rss_bytes = ProcessStats::current_rss_bytes();
+    return result;
+}
+
+// The stages of start_loader_thread(), without the UI
+RunResult load_once(const DumpSet& dump, bool cold_cache) {
+    const WikiFile page_file = dump.file(WikiFileType::Page);
+    const WikiFile linktarget_file = dump.file(WikiFileType::LinkTarget);
+    const WikiFile pagelinks_file = dump.file(WikiFileType::PageLinks);
+
+    RunResult run;
+    if (cold_cache) {
+        run.cold_cache = drop_from_page_cache(page_file.data_path) &&
+                         drop_from_page_cache(linktarget_file.data_path) &&
+                         drop_from_page_cache(pagelinks_file.data_path);
+        if (!run.cold_cache) {
+            spdlog::warn("Could not drop the dump from the page cache, measuring a warm cache");
+        }
+    }
+
+    DataLoaderManager manager;
+    const auto no_progress = [](size_t, double, ReadProgress) {};
+    const auto loader_stage = [](StageResult& result, const DataLoaderBase& loader, const WikiFile& file,
+                                 uint64_t items) {
+        result.compressed_bytes = file.file_size;
+        result.decompressed_bytes = loader.flow_control().occupancy(PipelineStage::Read).total_bytes;
+        result.rows = loader.rows_parsed();
+        result.items = items;
+        const FlowControl& flow = loader.flow_control();
+        result.pipeline = {flow.timing(PipelineStage::Read), flow.timing(PipelineStage::Parse),
+                           flow.timing(PipelineStage::Insert)};
+        const auto samples = flow.queue_samples();
+        for (const auto& sample : samples) {
+            result.mean_read_queue += static_cast<double>(sample.read_items) / static_cast<double>(samples.size());
+        }
+    };
+
+    run.stages.push_back(measure("page", [&](StageResult& result) {
+        auto& loader = manager.get_page_loader();
+        loader.load_page_table(page_file, no_progress, UIState::refresh_rate);
+        loader_stage(result, loader, page_file, loader.get_page_count());
+        result.structures = manager.memory_usage();
+    }));
+    run.stages.push_back(measure("linktarget", [&](StageResult& result) {
+        auto& loader = manager.get_linktarget_loader();
+        loader.load_linktarget_table(linktarget_file, manager.get_page_loader(), no_progress, UIState::refresh_rate);
+        loader_stage(result, loader, linktarget_file, loader.get_linktarget_count());
+        manager.cleanup_after_linktarget_load();
+        result.structures = manager.memory_usage();
+    }));
+    run.stages.push_back(measure("pagelinks", [&](StageResult& result) {
+        auto& loader = manager.get_link_loader();
+        loader.load_pagelinks_table(pagelinks_file, manager.get_page_loader(), manager.get_linktarget_loader(),
+                                    no_progress, UIState::refresh_rate);
+        loader_stage(result, loader, pagelinks_file, loader.get_link_count());
+        manager.cleanup_after_link_load();
+        result.structures = manager.memory_usage();
+    }));
+    run.stages.push_back(measure("graph", [&](StageResult& result) {
+        UIState state;
+        std::vector<Link> links = manager.move_links();
+        result.rows = links.size();
+        const PageGraph graph(state, manager.move_pages(), std::move(links));
+        manager.cleanup_after_graph_build();
+        run.nodes = graph.get_number_of_pages();
+        run.edges = graph.get_number_of_links();
+        result.items = run.edges;
+        result.structures = manager.memory_usage();
+        for (auto& structure : graph.memory_usage()) {
+            result.structures.push_back(std::move(structure));
+        }
+    }));
+    return run;
+}
+
+std::string pipeline_json(const StageResult& stage) {
+    constexpr std::array<std::string_view, 3> names = {"read", "parse", "insert"};
+    std::string out = "{";
+    for (size_t i = 0; i < names.size(); i++) {
+        out += std::format("{}\"{}\": {{\"busy_seconds\": {:.6f}, \"blocked_seconds\": {:.6f}}}", i == 0 ? "" : ", ",
+                           names[i], static_cast<double>(stage.pipeline[i].busy_ns) / 1e9,
+                           static_cast<double>(stage.pipeline[i].blocked_ns) / 1e9);
+    }
+    return out + std::format(", \"mean_read_queue_lines\": {:.2f}}}", stage.mean_read_queue);
+}
+
+std::string memory_json(const StageResult& stage) {
+    std::string out = std::format("{{\"rss_bytes\": {}, \"structures\": [", stage.rss_bytes);
+    for (size_t i = 0; i < stage.structures.size(); i++) {
+        const StructureMemory& structure = stage.structures[i];
+        out += std::format("{}{{\"name\": {}, \"elements\": {}, \"bytes\": {}}}", i == 0 ? "" : ", ",
+                           json_string(structure.name), structure.elements, structure.bytes);
+    }
+    return out + "]}";
+}
+
+std::string stage_json(const StageResult& stage) {
+    return std::format(
+        "{{\"name\": {}, \"wall_seconds\": {:.6f}, \"cpu_seconds\": {:.6f}, \"compressed_bytes\": {}, "
+        "\"decompressed_bytes\": {}, \"decompressed_bytes_per_second\": {:.1f}, \"rows\": {}, "
+        "\"rows_per_second\": {:.1f}, \"items\": {}, \"start_rss_bytes\": {}, \"peak_rss_growth_bytes\": {}, "
+        "\"pipeline\": {}, \"memory\": {}, \"counters\": {}}}",
+        json_string(stage.name), stage.wall_seconds, stage.cpu_seconds, stage.compressed_bytes,
+        stage.decompressed_bytes, rate(static_cast<double>(stage.decompressed_bytes), stage.wall_seconds), stage.rows,
+        rate(static_cast<double>(stage.rows), stage.wall_seconds), stage.items, stage.start_rss_bytes,
+        bytes_json(stage.peak_rss_growth_bytes), pipeline_json(stage), memory_json(stage),
+        Report::counters_json(stage.counters));
+}
+
+// Medians over all runs, the part of the report to diff between builds
+std::string summary_json(const std::vector<RunResult>& runs) {
+    std::string out = "{\"stages\": [";
+    const size_t stage_count = runs.front().stages.size();
+    std::vector<double> total_wall(runs.size(), 0.0);
+    std::optional<uint64_t> peak_rss = 0;
+    for (size_t s = 0; s < stage_count; s++) {
+        std::vector<double> wall;
+        std::vector<double> cpu;
+        std::vector<double> decompressed_rate;
+        std::vector<double> rows_rate;
+        std::optional<uint64_t> stage_growth = 0;  // Unknown as soon as one run's peak is
+        for (size_t r = 0; r < runs.size(); r++) {
+            const StageResult& stage = runs[r].stages[s];
+            wall.push_back(stage.wall_seconds);
+            cpu.push_back(stage.cpu_seconds);
+            decompressed_rate.push_back(rate(static_cast<double>(stage.decompressed_bytes), stage.wall_seconds));
+            rows_rate.push_back(rate(static_cast<double>(stage.rows), stage.wall_seconds));
+            stage_growth = stage_growth && stage.peak_rss_growth_bytes
+                               ? std::optional(std::max(*stage_growth, *stage.peak_rss_growth_bytes))
+                               : std::nullopt;
+            // The process peak is the highest RSS any stage reached, on top of what it started with
+            peak_rss = peak_rss && stage.peak_rss_growth_bytes
+                           ? std::optional(std::max(*peak_rss, stage.start_rss_bytes + *stage.peak_rss_growth_bytes))
+                           : std::nullopt;
+            total_wall[r] += stage.wall_seconds;
+        }
+        out += std::format(
+            "{}{{\"name\": {}, \"wall_seconds\": {:.6f}, \"cpu_seconds\": {:.6f}, "
+            "\"decompressed_bytes_per_second\": {:.1f}, \"rows_per_second\": {:.1f}, \"peak_rss_growth_bytes\": {}}}",
+            s == 0 ? "" : ", ", json_string(runs.front().stages[s].name), median(wall), median(cpu),
+            median(decompressed_rate), median(rows_rate), bytes_json(stage_growth));
+    }
+    out += std::format("], \"wall_seconds\": {:.6f}, \"peak_rss_bytes\": {}, \"nodes\": {}, \"edges\": {}}}",
+                       median(total_wall), bytes_json(peak_rss), runs.back().nodes, runs.back().edges);
+    return out;
+}
+
+void write_report(const std::filesystem::path& path, const DumpSet& dump, const std::vector<RunResult>& runs) {
+    const auto& resources = ResourceProbe::get();
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error(std::format("Cannot write {}", path.string()));
+    }
+#ifdef PARALLEL_DECOMPRESSION
+    constexpr std::string_view line_reader = "ParallelLineReader";
+#else
+    constexpr std::string_view line_reader = "AsyncLineReader";
+#endif
+#ifdef USE_STD_UNORDERED_MAP
+    constexpr std::string_view hashmap = "std::unordered_map";
+#else
+    constexpr std::string_view hashmap = "emhash6";
+#endif
+    out << std::format(
+        "{{\n  \"context\": {{\"date\": {}, \"dump_dir\": {}, \"prefix\": {}, \"dump_date\": {}, "
+        "\"build_type\": {}, \"line_reader\": {}, \"hashmap\": {}, \"cpu_count\": {}, \"worker_threads\": {}, "
+        "\"memory_limit_bytes\": {}, \"numa_nodes\": {}}},\n",
+        json_string(Report::timestamp()), json_string(dump.dir.string()), json_string(dump.prefix),
+        json_string(dump.date), json_string(WIKIGRAPH_BUILD_TYPE), json_string(line_reader), json_string(hashmap),
+        resources.cpu_count, resources.worker_threads, resources.memory_limit_bytes,
+        Affinity::topology().node_cpus.size());
+
+    out << "  \"runs\": [\n";
+    for (size_t r = 0; r < runs.size(); r++) {
+        const RunResult& run = runs[r];
+        out << std::format("    {{\"cold_cache\": {}, \"nodes\": {}, \"edges\": {}, \"stages\": [\n",
+                           run.cold_cache ? "true" : "false", run.nodes, run.edges);
+        for (size_t s = 0; s < run.stages.size(); s++) {
+            out << "      " << stage_json(run.stages[s]) << (s + 1 < run.stages.size() ? ",\n" : "\n");
+        }
+        out << (r + 1 < runs.size() ? "    ]},\n" : "    ]}\n");
+    }
+    out << "  ],\n  \"summary\": " << summary_json(runs) << "\n}\n";
+}
+
+void print_run(size_t index, const RunResult& run) {
+    std::cout << std::format("Run {}{}: {} nodes, {} edges\n", index + 1, run.cold_cache ? " (cold cache)" : "",
+                             run.nodes, run.edges);
+    for (const StageResult& stage : run.stages) {
+        const std::optional<uint64_t>& growth = stage.peak_rss_growth_bytes;
+        const std::string peak = growth ? std::format("{:8.0f}", static_cast<double>(*growth) / (1024 * 1024))
+                                        : std::format("{:>8}", "?");
+        std::cout << std::format("  {:<11} {:8.2f} s wall {:8.2f} s cpu {:9.1f} MB/s {:11.0f} rows/s +{} MB peak\n",
+                                 stage.name, stage.wall_seconds, stage.cpu_seconds,
+                                 rate(static_cast<double>(stage.decompressed_bytes), stage.wall_seconds) / 1e6,
+                                 rate(static_cast<double>(stage.rows), stage.wall_seconds), peak);
+        if (stage.counters.any()) {
+            std::cout << std::format("  {:<11} {:8.2f} ipc {:12} llc misses {:12} dtlb misses {:12} branch misses\n", "",
+                                     stage.counters.ipc(), stage.counters.get(HwCounter::LlcMisses),
+                                     stage.counters.get(HwCounter::DtlbMisses),
+                                     stage.counters.get(HwCounter::BranchMisses));
+        }
+    }
+}
+
+void print_usage() {
+    std::cout << "Usage: wikigraph_loadbench [options]\n"
+                 "Loads <dir>/<prefix>wiki-<date>-{page,linktarget,pagelinks}.sql.gz and builds the graph, then "
+                 "writes a JSON report.\n\n"
+                 "  --dir DIR         Directory of the dump files (default: data)\n"
+                 "  --prefix NAME     Wiki prefix (default: en)\n"
+                 "  --date YYYYMMDD   Dump date, required unless --synthetic is given\n"
+                 "  --synthetic N     Generate a synthetic dump of N pages in a temporary directory and load it\n"
+                 "  --runs N          Number of loads (default: 3)\n"
+                 "  --cold            Drop the dump files from the page cache before every load (Linux)\n"
+                 "  --out FILE        JSON report (default: wikigraph_loadbench.json)\n"
+                 "  --trace FILE      Write a Chrome trace-event timeline of the loads\n"
+                 "  --counters        Record hardware performance counters per stage (Linux perf_event_open)\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    DumpSet dump;
+    uint64_t synthetic_pages = 0;
+    uint64_t runs = 3;
+    bool cold = false;
+    std::filesystem::path out = "wikigraph_loadbench.json";
+    std::filesystem::path trace;
+
+    const std::map<std::string_view, std::function<void(const std::string&)>> flags{
+        {"--dir", [&](const std::string& value) { dump.dir = value; }},
+        {"--prefix", [&](const std::string& value) { dump.prefix = value; }},
+        {"--date", [&](const std::string& value) { dump.date = value; }},
+        {"--synthetic", [&](const std::string& value) { synthetic_pages = std::stoull(value); }},
+        {"--runs", [&](const std::string& value) { runs = std::max<uint64_t>(std::stoull(value), 1); }},
+        {"--out", [&](const std::string& value) { out = value; }},
+        {"--trace",
+         [&](const std::string& value) {
+             trace = value;
+             Trace::start(trace);
+         }},
+    };
+
+    spdlog::set_level(spdlog::level::warn);
+    std::unique_ptr<TemporaryDump> synthetic;
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                print_usage();
+                return EXIT_SUCCESS;
+            }
+            if (arg == "--cold") {
+                cold = true;
+                continue;
+            }
+            if (arg == "--counters") {
+                PerfCounters::request();
+                continue;
+            }
+            auto flag = flags.find(arg);
+            if (flag == flags.end() || i + 1 == argc) {
+                std::cerr << std::format("Unknown option or missing value: {}\n", arg);
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            flag->second(argv[++i]);
+        }
+
+        if (synthetic_pages > 0) {
+            synthetic = std::make_unique<TemporaryDump>(synthetic_pages);
+            dump = synthetic->dump();
+        } else if (dump.date.size() != 8) {
+            std::cerr << "Give the dump date as --date YYYYMMDD, or --synthetic N\n";
+            return EXIT_FAILURE;
+        }
+
+        // Started up front, so the first run does not time its startup and the counter sessions find its workers
+        WThreadPool::shared();
+        std::vector<RunResult> results;
+        for (uint64_t run = 0; run < runs; run++) {
+            results.push_back(load_once(dump, cold));
+            print_run(run, results.back());
+        }
+        write_report(out, dump, results);
+        std::cout << std::format("Wrote {}\n", out.string());
+        if (Trace::write() && !trace.empty()) {
+            std::cout << std::format("Wrote {}\n", trace.string());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << std::format("Error: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,420 @@
+// Performance regression gate: compares benchmark reports with a stored baseline and fails when a benchmark got
+// slower or a load stage needs more memory than the noise of both measurements explains
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Json.h"
+#include "Report.h"
+
+namespace {
+using Report::json_string;
+
+constexpr int kBaselineVersion = 2;
+constexpr double kMadToSigma = 1.4826;  // The MAD of normally distributed noise is 0.6745 standard deviations
+
+enum class Kind { Time, Memory };
+
+struct Metric {
+    Kind kind = Kind::Time;
+    std::vector<double> samples;  // Nanoseconds or bytes, one per repetition or run
+};
+
+struct Measurements {
+    std::map<std::string, Metric> metrics;
+    std::map<std::string, std::string> context;  // Machine and build, which must match the baseline's
+    std::vector<std::string> errors;             // Benchmarks that failed, such as an invalid BFS tree
+};
+
+struct Thresholds {
+    double time = 0.10;         // Relative slowdown that fails the check
+    double memory = 0.05;       // Relative peak memory growth that fails the check
+    double noise_factor = 3.0;  // Change must also exceed this many standard deviations of the noisier side
+};
+
+std::string_view kind_name(Kind kind) {
+    return kind == Kind::Time ? "time" : "memory";
+}
+
+double to_nanoseconds(double value, std::string_view unit) {
+    if (unit == "us") {
+        return value * 1e3;
+    }
+    if (unit == "ms") {
+        return value * 1e6;
+    }
+    if (unit == "s") {
+        return value * 1e9;
+    }
+    return value;
+}
+
+std::string context_value(const Json::Value& value) {
+    if (value.type == Json::Value::Type::String) {
+        return value.string;
+    }
+    if (value.type == Json::Value::Type::Bool) {
+        return value.boolean ? "true" : "false";
+    }
+    return std::format("{}", value.number);
+}
+
+// Google Benchmark report: every repetition is one sample, the aggregates it computed itself are ignored
+void read_bench(const Json::Value& report, Measurements& measurements) {
+    for (std::string_view key : {"num_cpus", "library_build_type", "build_type", "line_reader", "hashmap",
+                                 "worker_threads", "bench_pages"}) {
+        if (const Json::Value* value = report["context"].find(key)) {
+            measurements.context[std::string(key)] = context_value(*value);
+        }
+    }
+    for (const auto& benchmark : report["benchmarks"].array) {
+        if (benchmark["run_type"].as_string() == "aggregate") {
+            continue;
+        }
+        std::string name(benchmark["run_name"].as_string());
+        if (name.empty()) {
+            name = benchmark["name"].as_string();
+        }
+        if (benchmark["error_occurred"].as_bool()) {
+            measurements.errors.push_back(std::format("{}: {}", name, benchmark["error_message"].as_string()));
+            continue;
+        }
+        // Real time is the manual time for the benchmarks that time themselves
+        Metric& metric = measurements.metrics["bench/" + name];
+        metric.kind = Kind::Time;
+        const Json::Value& time = benchmark["real_time"];
+        metric.samples.push_back(to_nanoseconds(time.as_number(), benchmark["time_unit"].as_string()));
+    }
+}
+
+// wikigraph_loadbench report: wall time and peak RSS growth of every stage, one sample per run
+void read_load(const Json::Value& report, Measurements& measurements) {
+    for (std::string_view key : {"cpu_count", "worker_threads", "build_type", "line_reader", "hashmap"}) {
+        if (const Json::Value* value = report["context"].find(key)) {
+            measurements.context[std::string(key)] = context_value(*value);
+        }
+    }
+    for (const auto& run : report["runs"].array) {
+        for (const auto& stage : run["stages"].array) {
+            const std::string prefix = std::format("load/{}/", stage["name"].as_string());
+            Metric& wall = measurements.metrics[prefix + "wall_time"];
+            wall.kind = Kind::Time;
+            wall.samples.push_back(stage["wall_seconds"].as_number() * 1e9);
+            // Null when the tool could not measure the stage's own peak, a baseline with one then reports it missing
+            if (const Json::Value& peak = stage["peak_rss_growth_bytes"]; peak.type == Json::Value::Type::Number) {
+                Metric& memory = measurements.metrics[prefix + "peak_rss_growth"];
+                memory.kind = Kind::Memory;
+                memory.samples.push_back(peak.number);
+            }
+        }
+    }
+}
+
+Measurements read_baseline(const std::filesystem::path& path) {
+    const Json::Value baseline = Json::parse_file(path);
+    if (baseline["version"].as_number() != kBaselineVersion) {
+        throw std::runtime_error(std::format("{} is not a version {} baseline, regenerate it with --update",
+                                             path.string(), kBaselineVersion));
+    }
+    Measurements measurements;
+    for (const auto& [key, value] : baseline["context"].object) {
+        measurements.context[key] = value.as_string();
+    }
+    for (const auto& [name, entry] : baseline["metrics"].object) {
+        Metric& metric = measurements.metrics[name];
+        metric.kind = entry["kind"].as_string() == "memory" ? Kind::Memory : Kind::Time;
+        for (const auto& sample : entry["samples"].array) {
+            metric.samples.push_back(sample.as_number());
+        }
+    }
+    return measurements;
+}
+
+void write_baseline(const std::filesystem::path& path, const Measurements& measurements) {
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path());
+    }
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error(std::format("Cannot write {}", path.string()));
+    }
+    out << std::format("{{\n  \"version\": {},\n  \"created\": {},\n  \"context\": {{", kBaselineVersion,
+                       json_string(Report::timestamp()));
+    bool first = true;
+    for (const auto& [key, value] : measurements.context) {
+        out << std::format("{}{}: {}", first ? "" : ", ", json_string(key), json_string(value));
+        first = false;
+    }
+    out << "},\n  \"metrics\": {\n";
+    size_t index = 0;
+    for (const auto& [name, metric] : measurements.metrics) {
+        std::string samples;
+        for (double sample : metric.samples) {
+            samples += std::format("{}{:.1f}", samples.empty() ? "" : ", ", sample);
+        }
+        out << std::format("    {}: {{\"kind\": {}, \"median\": {:.1f}, \"mad\": {:.1f}, \"samples\": [{}]}}{}\n",
+                           json_string(name), json_string(kind_name(metric.kind)), Report::median(metric.samples),
+                           Report::median_absolute_deviation(metric.samples), samples,
+                           ++index < measurements.metrics.size() ? "," : "");
+    }
+    out << "  }\n}\n";
+}
+
+std::string format_value(double value, Kind kind) {
+    if (kind == Kind::Memory) {
+        return std::format("{:.1f} MB", value / (1024 * 1024));
+    }
+    if (value >= 1e9) {
+        return std::format("{:.2f} s", value / 1e9);
+    }
+    if (value >= 1e6) {
+        return std::format("{:.2f} ms", value / 1e6);
+    }
+    if (value >= 1e3) {
+        return std::format("{:.2f} us", value / 1e3);
+    }
+    return std::format("{:.1f} ns", value);
+}
+
+struct Row {
+    std::string name;
+    std::string baseline;
+    std::string current;
+    std::string change;
+    std::string noise;
+    std::string status;
+    bool regression = false;
+    bool missing = false;  // In the baseline but not measured, so a renamed or broken benchmark cannot pass silently
+};
+
+/**
+ * A metric regresses when its median grew by more than the relative threshold of its kind and the growth is also
+ * larger than noise_factor standard deviations, estimated from the MAD of whichever side is noisier. The threshold
+ * ignores small real changes, the noise bound ignores large changes of benchmarks that are too noisy to tell.
+ */
+Row compare(const std::string& name, const Metric* baseline, const Metric* current, const Thresholds& thresholds) {
+    Row row;
+    row.name = name;
+    if (baseline == nullptr || current == nullptr) {
+        const Metric& only = baseline != nullptr ? *baseline : *current;
+        const std::string value = format_value(Report::median(only.samples), only.kind);
+        (baseline != nullptr ? row.baseline : row.current) = value;
+        row.status = baseline != nullptr ? "MISSING" : "new";
+        row.missing = baseline != nullptr;
+        return row;
+    }
+
+    const double before = Report::median(baseline->samples);
+    const double after = Report::median(current->samples);
+    const double sigma = kMadToSigma * std::max(Report::median_absolute_deviation(baseline->samples),
+                                                Report::median_absolute_deviation(current->samples));
+    const double noise = thresholds.noise_factor * sigma;
+    const double threshold = baseline->kind == Kind::Memory ? thresholds.memory : thresholds.time;
+    const double change = before > 0 ? (after - before) / before : 0.0;
+
+    row.baseline = format_value(before, baseline->kind);
+    row.current = format_value(after, baseline->kind);
+    row.change = std::format("{:+.1f}%", change * 100);
+    row.noise = before > 0 ? std::format("+/-{:.1f}%", noise / before * 100) : "";
+    if (change > threshold && after - before > noise) {
+        row.status = baseline->kind == Kind::Memory ? "MORE MEMORY" : "SLOWER";
+        row.regression = true;
+    } else if (change < -threshold && before - after > noise) {
+        row.status = baseline->kind == Kind::Memory ? "less memory" : "faster";
+    } else {
+        row.status = "ok";
+    }
+    return row;
+}
+
+void print_table(const std::vector<Row>& rows) {
+    size_t width = std::string_view("Metric").size();
+    for (const auto& row : rows) {
+        width = std::max(width, row.name.size());
+    }
+    const std::string header = std::format("{:<{}}  {:>12}  {:>12}  {:>8}  {:>8}  {}", "Metric", width, "Baseline",
+                                           "Current", "Change", "Noise", "Status");
+    std::cout << header << "\n" << std::string(header.size(), '-') << "\n";
+    for (const auto& row : rows) {
+        std::cout << std::format("{:<{}}  {:>12}  {:>12}  {:>8}  {:>8}  {}\n", row.name, width, row.baseline,
+                                 row.current, row.change, row.noise, row.status);
+    }
+}
+
+// Timings of a different machine or build say nothing about a regression, so every difference fails the check
+std::vector<std::string> context_mismatches(const Measurements& baseline, const Measurements& current) {
+    std::vector<std::string> mismatches;
+    for (const auto& [key, value] : current.context) {
+        auto it = baseline.context.find(key);
+        if (it == baseline.context.end()) {
+            mismatches.push_back(std::format("{} is {} but the baseline does not record it", key, value));
+        } else if (it->second != value) {
+            mismatches.push_back(std::format("{} is {} but the baseline was recorded with {}", key, value, it->second));
+        }
+    }
+    for (const auto& [key, value] : baseline.context) {
+        if (!current.context.contains(key)) {
+            mismatches.push_back(std::format("{} is not reported but the baseline was recorded with {}", key, value));
+        }
+    }
+    return mismatches;
+}
+
+// A baseline must come from an optimized build, or every later comparison is against the wrong numbers
+std::string unsuitable_for_baseline(const Measurements& current) {
+    auto it = current.context.find("build_type");
+    if (it == current.context.end() || (it->second != "Release" && it->second != "RelWithDebInfo")) {
+        return std::format("the tools were built as '{}', configure with -DCMAKE_BUILD_TYPE=Release",
+                           it != current.context.end() ? it->second : "");
+    }
+    auto library = current.context.find("library_build_type");
+    if (library != current.context.end() && library->second == "debug") {
+        return "Google Benchmark is a debug build";
+    }
+    return {};
+}
+
+void print_usage() {
+    std::cout << "Usage: wikigraph_perfcheck --baseline FILE [--bench FILE] [--load FILE] [options]\n"
+                 "Compares benchmark reports with a baseline and exits with 1 if anything regressed, a baseline\n"
+                 "metric is missing or the machine and build differ from the baseline's.\n\n"
+                 "  --baseline FILE          Baseline JSON to compare with, or to write with --update\n"
+                 "  --bench FILE             wikigraph_bench JSON report, run with --benchmark_repetitions\n"
+                 "  --load FILE              wikigraph_loadbench JSON report, run with --runs\n"
+                 "  --update                 Write the reports as the new baseline instead of comparing\n"
+                 "  --require-baseline       Only check that the baseline exists, before running the benchmarks\n"
+                 "  --time-threshold F       Relative slowdown that fails (default: 0.10)\n"
+                 "  --memory-threshold F     Relative peak memory growth that fails (default: 0.05)\n"
+                 "  --noise-factor F         Standard deviations of noise a change must exceed (default: 3)\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::filesystem::path baseline_path;
+    std::vector<std::filesystem::path> bench_reports;
+    std::vector<std::filesystem::path> load_reports;
+    Thresholds thresholds;
+    bool update = false;
+    bool require_baseline = false;
+
+    const std::map<std::string_view, std::function<void(const std::string&)>> flags{
+        {"--baseline", [&](const std::string& value) { baseline_path = value; }},
+        {"--bench", [&](const std::string& value) { bench_reports.emplace_back(value); }},
+        {"--load", [&](const std::string& value) { load_reports.emplace_back(value); }},
+        {"--time-threshold", [&](const std::string& value) { thresholds.time = std::stod(value); }},
+        {"--memory-threshold", [&](const std::string& value) { thresholds.memory = std::stod(value); }},
+        {"--noise-factor", [&](const std::string& value) { thresholds.noise_factor = std::stod(value); }},
+    };
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                print_usage();
+                return EXIT_SUCCESS;
+            }
+            if (arg == "--update") {
+                update = true;
+                continue;
+            }
+            if (arg == "--require-baseline") {
+                require_baseline = true;
+                continue;
+            }
+            auto flag = flags.find(arg);
+            if (flag == flags.end() || i + 1 == argc) {
+                std::cerr << std::format("Unknown option or missing value: {}\n", arg);
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            flag->second(argv[++i]);
+        }
+        if (require_baseline && !baseline_path.empty()) {
+            if (!std::filesystem::exists(baseline_path)) {
+                std::cerr << std::format("No baseline at {}. Timings only compare on the machine that recorded them, "
+                                         "record one there with the perf-baseline target from a Release build\n",
+                                         baseline_path.string());
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        if (baseline_path.empty() || (bench_reports.empty() && load_reports.empty())) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+
+        Measurements current;
+        for (const auto& path : bench_reports) {
+            read_bench(Json::parse_file(path), current);
+        }
+        for (const auto& path : load_reports) {
+            read_load(Json::parse_file(path), current);
+        }
+        for (const auto& error : current.errors) {
+            std::cout << std::format("Failed: {}\n", error);
+        }
+
+        if (update) {
+            if (!current.errors.empty()) {
+                std::cerr << "Not writing a baseline from failed benchmarks\n";
+                return EXIT_FAILURE;
+            }
+            if (const std::string reason = unsuitable_for_baseline(current); !reason.empty()) {
+                std::cerr << std::format("Not writing a baseline: {}\n", reason);
+                return EXIT_FAILURE;
+            }
+            write_baseline(baseline_path, current);
+            std::cout << std::format("Wrote {} metrics to {}\n", current.metrics.size(), baseline_path.string());
+            return EXIT_SUCCESS;
+        }
+        if (!std::filesystem::exists(baseline_path)) {
+            std::cerr << std::format("No baseline at {}, record one with --update\n", baseline_path.string());
+            return EXIT_FAILURE;
+        }
+
+        const Measurements baseline = read_baseline(baseline_path);
+        const std::vector<std::string> mismatches = context_mismatches(baseline, current);
+        for (const auto& mismatch : mismatches) {
+            std::cout << std::format("Context mismatch: {}\n", mismatch);
+        }
+
+        std::vector<Row> rows;
+        for (const auto& [name, metric] : baseline.metrics) {
+            auto it = current.metrics.find(name);
+            rows.push_back(compare(name, &metric, it != current.metrics.end() ? &it->second : nullptr, thresholds));
+        }
+        for (const auto& [name, metric] : current.metrics) {
+            if (!baseline.metrics.contains(name)) {
+                rows.push_back(compare(name, nullptr, &metric, thresholds));
+            }
+        }
+        std::ranges::sort(rows, {}, &Row::name);
+        print_table(rows);
+
+        const auto regressions = std::ranges::count_if(rows, &Row::regression);
+        const auto missing = std::ranges::count_if(rows, &Row::missing);
+        if (regressions > 0 || missing > 0 || !current.errors.empty() || !mismatches.empty()) {
+            std::cout << std::format(
+                "\nFAILED: {} regressions, {} missing metrics, {} failed benchmarks, {} context mismatches\n",
+                regressions, missing, current.errors.size(), mismatches.size());
+            return EXIT_FAILURE;
+        }
+        std::cout << std::format("\nPassed: {} metrics within thresholds\n", rows.size());
+    } catch (const std::exception& e) {
+        std::cerr << std::format("Error: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,457 @@
+// Query-replay benchmark: loads a graph, runs a list of shortest-path searches and reports latency percentiles
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "DataLoader/DataLoaderManager.h"
+#include "DumpSet.h"
+#include "Log/Trace.h"
+#include "PageGraph/PageGraph.h"
+#include "Report.h"
+#include "Utils/PerfCounters.h"
+#include "Utils/ResourceProbe.h"
+
+namespace {
+using Report::json_string;
+
+enum class SampleMode : uint8_t {
+    Uniform,  // Start and end drawn uniformly from all articles
+    Degree,   // Start weighted by out-degree and end by in-degree, like following a random link at both ends
+};
+
+struct Query {
+    uint32_t start;
+    uint32_t end;
+};
+
+struct QueryResult {
+    double latency_seconds = 0;
+    SearchStats stats;
+    uint64_t paths = 0;
+    CounterValues counters;  // Hardware counters of the search, empty unless --counters is given
+};
+
+struct LoadedGraph {
+    DataLoaderManager manager;  // Keeps the title lookup of the page loader
+    std::unique_ptr<PageGraph> graph;
+};
+
+std::unique_ptr<LoadedGraph> load_graph(const DumpSet& dump) {
+    auto loaded = std::make_unique<LoadedGraph>();
+    DataLoaderManager& manager = loaded->manager;
+    const auto no_progress = [](size_t, double, ReadProgress) {};
+
+    manager.get_page_loader().load_page_table(dump.file(WikiFileType::Page), no_progress, UIState::refresh_rate);
+    manager.get_linktarget_loader().load_linktarget_table(dump.file(WikiFileType::LinkTarget),
+                                                          manager.get_page_loader(), no_progress,
+                                                          UIState::refresh_rate);
+    manager.cleanup_after_linktarget_load();
+    manager.get_link_loader().load_pagelinks_table(dump.file(WikiFileType::PageLinks), manager.get_page_loader(),
+                                                   manager.get_linktarget_loader(), no_progress,
+                                                   UIState::refresh_rate);
+    manager.cleanup_after_link_load();
+
+    UIState state;
+    loaded->graph = std::make_unique<PageGraph>(state, manager.move_pages(), manager.move_links(), NoProgress{});
+    manager.cleanup_after_graph_build();
+    return loaded;
+}
+
+// Tab-separated "start<TAB>end" title pairs, lines starting with # are comments
+std::vector<Query> read_queries(const std::filesystem::path& path, const PageLoader& pages, uint64_t& unresolved) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error(std::format("Cannot read {}", path.string()));
+    }
+    std::vector<Query> queries;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        const size_t tab = line.find('\t');
+        if (line.empty() || line.starts_with('#') || tab == std::string::npos) {
+            continue;
+        }
+        Query query{};
+        if (pages.find_page_index_by_title(line.substr(0, tab), query.start) &&
+            pages.find_page_index_by_title(line.substr(tab + 1), query.end)) {
+            queries.push_back(query);
+        } else {
+            unresolved++;
+        }
+    }
+    return queries;
+}
+
+std::vector<Query> sample_queries(const PageGraph& graph, uint64_t count, SampleMode mode, uint64_t seed) {
+    const uint32_t nodes = graph.get_number_of_pages();
+    if (nodes < 2) {
+        throw std::runtime_error("The graph has fewer than two pages");
+    }
+    std::mt19937_64 rng(seed);
+    std::vector<Query> queries;
+    queries.reserve(count);
+
+    if (mode == SampleMode::Uniform || graph.get_number_of_links() == 0) {
+        while (queries.size() < count) {
+            const auto start = static_cast<uint32_t>(rng() % nodes);
+            const auto end = static_cast<uint32_t>(rng() % nodes);
+            if (start != end) {
+                queries.push_back({start, end});
+            }
+        }
+        return queries;
+    }
+
+    // A uniformly random link has its source drawn by out-degree and its target by in-degree
+    std::vector<uint64_t> link_end(nodes);
+    uint64_t links = 0;
+    for (uint32_t page = 0; page < nodes; page++) {
+        links += graph.get_out_degree(page);
+        link_end[page] = links;
+    }
+    auto random_link = [&] {
+        const uint64_t link = rng() % links;
+        const auto source = static_cast<uint32_t>(std::ranges::upper_bound(link_end, link) - link_end.begin());
+        const uint64_t first = link_end[source] - graph.get_out_degree(source);
+        return std::pair{source, graph.get_neighbors(source)[link - first]};
+    };
+    while (queries.size() < count) {
+        const uint32_t start = random_link().first;
+        const uint32_t end = random_link().second;
+        if (start != end) {
+            queries.push_back({start, end});
+        }
+    }
+    return queries;
+}
+
+void save_queries(const std::filesystem::path& path, const PageGraph& graph, const std::vector<Query>& queries) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error(std::format("Cannot write {}", path.string()));
+    }
+    const auto& pages = graph.get_pages();
+    for (const Query& query : queries) {
+        out << pages[query.start].page_title << '\t' << pages[query.end].page_title << '\n';
+    }
+}
+
+// Run the queries on `concurrency` threads, each taking the next query when it finished the last one
+template <ProgressPolicy Policy>
+std::vector<QueryResult> replay(const PageGraph& graph, const std::vector<Query>& queries, unsigned int concurrency,
+                                double& wall_seconds) {
+    std::vector<QueryResult> results(queries.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        UIState state;  // Unused, the policies of the replay publish no progress
+        const PerfCounters::Session counters;
+        for (size_t i = next.fetch_add(1); i < queries.size(); i = next.fetch_add(1)) {
+            QueryResult& result = results[i];
+            const CounterValues counters_before = counters.read();
+            const auto start = std::chrono::steady_clock::now();
+            const auto paths = graph.all_shortest_paths<Policy>(state, queries[i].start, queries[i].end, &result.stats);
+            result.latency_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.counters = counters.read() - counters_before;
+            result.paths = paths.size();
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < concurrency; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return results;
+}
+
+// Percentiles of one per-query metric
+std::string distribution_json(std::vector<double> values) {
+    std::ranges::sort(values);
+    double sum = 0;
+    for (double value : values) {
+        sum += value;
+    }
+    return std::format(
+        "{{\"mean\": {:.9g}, \"p50\": {:.9g}, \"p90\": {:.9g}, \"p99\": {:.9g}, \"p999\": {:.9g}, \"max\": {:.9g}}}",
+        values.empty() ? 0.0 : sum / static_cast<double>(values.size()), Report::percentile(values, 0.5),
+        Report::percentile(values, 0.9), Report::percentile(values, 0.99), Report::percentile(values, 0.999),
+        values.empty() ? 0.0 : values.back());
+}
+
+// Latency counts in power-of-two microsecond buckets, "le_us" is the inclusive upper bound of a bucket
+std::string histogram_json(const std::vector<QueryResult>& results) {
+    std::vector<uint64_t> buckets;
+    for (const QueryResult& result : results) {
+        const auto micros = static_cast<uint64_t>(std::ceil(result.latency_seconds * 1e6));
+        const size_t bucket = micros <= 1 ? 0 : std::bit_width(micros - 1);
+        buckets.resize(std::max(buckets.size(), bucket + 1), 0);
+        buckets[bucket]++;
+    }
+    std::string out = "[";
+    for (size_t i = 0; i < buckets.size(); i++) {
+        out += std::format("{}{{\"le_us\": {}, \"count\": {}}}", i == 0 ? "" : ", ", uint64_t{1} << i, buckets[i]);
+    }
+    return out + "]";
+}
+
+// Per-layer BFS counters of a query, only with --bfs-stats
+std::string bfs_json(const BFSStats& bfs) {
+    std::string out = std::format("{{\"max_frontier\": {}, \"bytes_allocated\": {}, \"layers\": [", bfs.max_frontier,
+                                  bfs.bytes_allocated);
+    for (size_t i = 0; i < bfs.layers.size(); i++) {
+        const BFSLayerStats& layer = bfs.layers[i];
+        out += std::format(
+            "{}{{\"layer\": {}, \"frontier\": {}, \"edges_scanned\": {}, \"discovered\": {}, "
+            "\"duplicate_parents\": {}, \"already_visited\": {}, \"parent_appends\": {}, \"ms\": {:.6f}}}",
+            i == 0 ? "" : ", ", layer.layer, layer.frontier, layer.edges_scanned, layer.discovered,
+            layer.duplicate_parents, layer.already_visited, layer.parent_appends(),
+            static_cast<double>(layer.duration_ns) / 1e6);
+    }
+    return out + "]}";
+}
+
+struct ReplayConfig {
+    std::string source;  // "file" or the sample mode
+    uint64_t seed;
+    unsigned int concurrency;
+    uint64_t unresolved;
+    bool per_query;
+    bool bfs_stats;  // Search with CountersOnly instead of NoProgress
+};
+
+void write_report(const std::filesystem::path& path, const PageGraph& graph, const ReplayConfig& config,
+                  const std::vector<Query>& queries, const std::vector<QueryResult>& results, double wall_seconds) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error(std::format("Cannot write {}", path.string()));
+    }
+    std::vector<double> latency_ms;
+    std::vector<double> nodes;
+    std::vector<double> edges;
+    std::vector<double> max_frontier;
+    std::vector<double> bfs_bytes;
+    uint64_t paths = 0;
+    uint64_t connected = 0;
+    CounterValues counters = results.empty() ? CounterValues{} : results.front().counters;
+    for (size_t i = 1; i < results.size(); i++) {
+        counters += results[i].counters;
+    }
+    for (const QueryResult& result : results) {
+        latency_ms.push_back(result.latency_seconds * 1e3);
+        nodes.push_back(static_cast<double>(result.stats.nodes_explored));
+        edges.push_back(static_cast<double>(result.stats.edges_scanned));
+        max_frontier.push_back(static_cast<double>(result.stats.bfs.max_frontier));
+        bfs_bytes.push_back(static_cast<double>(result.stats.bfs.bytes_allocated));
+        paths += result.paths;
+        connected += result.paths > 0 ? 1 : 0;
+    }
+
+    out << std::format(
+        "{{\n  \"context\": {{\"date\": {}, \"nodes\": {}, \"edges\": {}, \"queries\": {}, \"unresolved\": {}, "
+        "\"source\": {}, \"seed\": {}, \"concurrency\": {}, \"cpu_count\": {}}},\n",
+        json_string(Report::timestamp()), graph.get_number_of_pages(), graph.get_number_of_links(), queries.size(),
+        config.unresolved, json_string(config.source), config.seed, config.concurrency,
+        ResourceProbe::get().cpu_count);
+    out << std::format(
+        "  \"summary\": {{\"wall_seconds\": {:.6f}, \"queries_per_second\": {:.3f}, \"latency_ms\": {}, "
+        "\"nodes_explored\": {}, \"edges_scanned\": {}, \"connected\": {}, \"paths\": {}, \"counters\": {}}},\n",
+        wall_seconds, wall_seconds > 0 ? static_cast<double>(results.size()) / wall_seconds : 0.0,
+        distribution_json(latency_ms), distribution_json(nodes), distribution_json(edges), connected, paths,
+        Report::counters_json(counters));
+    if (config.bfs_stats) {
+        out << std::format("  \"bfs\": {{\"max_frontier\": {}, \"bytes_allocated\": {}}},\n",
+                           distribution_json(max_frontier), distribution_json(bfs_bytes));
+    }
+    out << "  \"latency_histogram\": " << histogram_json(results);
+
+    if (config.per_query) {
+        out << ",\n  \"queries\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const QueryResult& result = results[i];
+            out << std::format(
+                "    {{\"start\": {}, \"end\": {}, \"latency_ms\": {:.6f}, \"nodes_explored\": {}, "
+                "\"edges_scanned\": {}, \"distance\": {}, \"paths\": {}, \"counters\": {}, \"bfs\": {}}}{}\n",
+                queries[i].start, queries[i].end, result.latency_seconds * 1e3, result.stats.nodes_explored,
+                result.stats.edges_scanned,
+                result.stats.distance == UINT32_MAX ? -1 : static_cast<int64_t>(result.stats.distance), result.paths,
+                Report::counters_json(result.counters), config.bfs_stats ? bfs_json(result.stats.bfs) : "null",
+                i + 1 < results.size() ? "," : "");
+        }
+        out << "  ]";
+    }
+    out << "\n}\n";
+}
+
+void print_usage() {
+    std::cout << "Usage: wikigraph_replay [options]\n"
+                 "Loads a dump set, replays shortest-path queries and writes latency percentiles as JSON.\n\n"
+                 "Graph:\n"
+                 "  --dir DIR            Directory of the dump files (default: data)\n"
+                 "  --prefix NAME        Wiki prefix (default: en)\n"
+                 "  --date YYYYMMDD      Dump date, required unless --synthetic is given\n"
+                 "  --synthetic N        Generate a synthetic dump of N pages in a temporary directory\n"
+                 "Queries:\n"
+                 "  --queries FILE       Replay tab-separated start/end title pairs, e.g. from a query log\n"
+                 "  --sample N           Sample N random pairs instead (default: 1000)\n"
+                 "  --mode MODE          uniform, or degree to weight the ends by their links (default: uniform)\n"
+                 "  --seed N             Seed of the sampling (default: 1)\n"
+                 "  --save-queries FILE  Write the sampled pairs as a query file\n"
+                 "Run:\n"
+                 "  --concurrency N      Queries running at once (default: 1)\n"
+                 "  --out FILE           JSON report (default: wikigraph_replay.json)\n"
+                 "  --trace FILE         Write a Chrome trace-event timeline of the load and the queries\n"
+                 "  --counters           Record hardware performance counters per query (Linux perf_event_open)\n"
+                 "  --bfs-stats          Record per-layer search statistics of every query\n"
+                 "  --per-query          Include every query in the report\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    DumpSet dump;
+    uint64_t synthetic_pages = 0;
+    std::filesystem::path queries_file;
+    std::filesystem::path save_file;
+    std::filesystem::path out = "wikigraph_replay.json";
+    std::filesystem::path trace;
+    uint64_t sample = 1000;
+    std::string mode = "uniform";
+    ReplayConfig config{
+        .source = "", .seed = 1, .concurrency = 1, .unresolved = 0, .per_query = false, .bfs_stats = false};
+
+    const std::map<std::string_view, std::function<void(const std::string&)>> flags{
+        {"--dir", [&](const std::string& value) { dump.dir = value; }},
+        {"--prefix", [&](const std::string& value) { dump.prefix = value; }},
+        {"--date", [&](const std::string& value) { dump.date = value; }},
+        {"--synthetic", [&](const std::string& value) { synthetic_pages = std::stoull(value); }},
+        {"--queries", [&](const std::string& value) { queries_file = value; }},
+        {"--sample", [&](const std::string& value) { sample = std::stoull(value); }},
+        {"--mode", [&](const std::string& value) { mode = value; }},
+        {"--seed", [&](const std::string& value) { config.seed = std::stoull(value); }},
+        {"--save-queries", [&](const std::string& value) { save_file = value; }},
+        {"--concurrency",
+         [&](const std::string& value) {
+             config.concurrency = std::max(1U, static_cast<unsigned int>(std::stoul(value)));
+         }},
+        {"--out", [&](const std::string& value) { out = value; }},
+        {"--trace",
+         [&](const std::string& value) {
+             trace = value;
+             Trace::start(trace);
+         }},
+    };
+
+    spdlog::set_level(spdlog::level::warn);
+    std::unique_ptr<TemporaryDump> synthetic;
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                print_usage();
+                return EXIT_SUCCESS;
+            }
+            if (arg == "--per-query") {
+                config.per_query = true;
+                continue;
+            }
+            if (arg == "--bfs-stats") {
+                config.bfs_stats = true;
+                continue;
+            }
+            if (arg == "--counters") {
+                PerfCounters::request();
+                continue;
+            }
+            auto flag = flags.find(arg);
+            if (flag == flags.end() || i + 1 == argc) {
+                std::cerr << std::format("Unknown option or missing value: {}\n", arg);
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            flag->second(argv[++i]);
+        }
+        if (mode != "uniform" && mode != "degree") {
+            std::cerr << std::format("Unknown sampling mode: {}\n", mode);
+            return EXIT_FAILURE;
+        }
+
+        if (synthetic_pages > 0) {
+            synthetic = std::make_unique<TemporaryDump>(synthetic_pages);
+            dump = synthetic->dump();
+        } else if (dump.date.size() != 8) {
+            std::cerr << "Give the dump date as --date YYYYMMDD, or --synthetic N\n";
+            return EXIT_FAILURE;
+        }
+
+        const auto load_start = std::chrono::steady_clock::now();
+        const auto loaded = load_graph(dump);
+        const PageGraph& graph = *loaded->graph;
+        std::cout << std::format(
+            "Loaded {} nodes and {} edges in {:.1f} s\n", graph.get_number_of_pages(), graph.get_number_of_links(),
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count());
+
+        std::vector<Query> queries;
+        if (!queries_file.empty()) {
+            config.source = "file";
+            queries = read_queries(queries_file, loaded->manager.get_page_loader(), config.unresolved);
+            if (config.unresolved > 0) {
+                std::cerr << std::format("Skipped {} queries with unknown titles\n", config.unresolved);
+            }
+        } else {
+            config.source = mode;
+            queries = sample_queries(graph, sample, mode == "degree" ? SampleMode::Degree : SampleMode::Uniform,
+                                     config.seed);
+        }
+        if (!save_file.empty()) {
+            save_queries(save_file, graph, queries);
+        }
+
+        double wall_seconds = 0;
+        const auto results = config.bfs_stats ? replay<CountersOnly>(graph, queries, config.concurrency, wall_seconds)
+                                              : replay<NoProgress>(graph, queries, config.concurrency, wall_seconds);
+        write_report(out, graph, config, queries, results, wall_seconds);
+
+        std::vector<double> latency_ms;
+        for (const QueryResult& result : results) {
+            latency_ms.push_back(result.latency_seconds * 1e3);
+        }
+        std::ranges::sort(latency_ms);
+        std::cout << std::format(
+            "{} queries in {:.2f} s on {} threads: p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms\nWrote {}\n",
+            results.size(), wall_seconds, config.concurrency, Report::percentile(latency_ms, 0.5),
+            Report::percentile(latency_ms, 0.99), latency_ms.empty() ? 0.0 : latency_ms.back(), out.string());
+        if (Trace::write() && !trace.empty()) {
+            std::cout << std::format("Wrote {}\n", trace.string());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << std::format("Error: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}